@@ -7,6 +7,8 @@ TARGET = CCTV_Player
 DESTDIR = bin
 QT += core gui widgets
 #CONFIG += debug
+# 开启性能分析区间（src/profiler.h），右键菜单中可导出各线程的耗时统计
+#DEFINES += CTTV_PROFILE
 #DEFINES += _UNICODE WIN64 QT_WIDGETS_LIB
 
 win32 {
@@ -61,7 +63,26 @@ HEADERS += src/customthread.h \
     src/playlist.h \
     src/show.h \
     src/ctrlbar.h \
-    src/sonic.h
+    src/sonic.h \
+    src/audiomixer.h \
+    src/taskexecutor.h \
+    src/mosaicctl.h \
+    src/mosaicwid.h \
+    src/subtitlestore.h \
+    src/audiovisualizer.h \
+    src/peakoverview.h \
+    src/loudness.h \
+    src/resampler.h \
+    src/gopcache.h \
+    src/framehistory.h \
+    src/synctrace.h \
+    src/profiler.h \
+    src/timesource.h \
+    src/mmapio.h \
+    src/prefetchio.h \
+    src/hlssource.h \
+    src/livelatency.h \
+    src/timeshift.h
 
 SOURCES += src/main.cpp \
     src/about.cpp \
@@ -76,7 +97,26 @@ SOURCES += src/main.cpp \
     src/playlist.cpp \
     src/show.cpp \
     src/title.cpp \
-    src/sonic.cpp
+    src/sonic.cpp \
+    src/audiomixer.cpp \
+    src/taskexecutor.cpp \
+    src/mosaicctl.cpp \
+    src/mosaicwid.cpp \
+    src/subtitlestore.cpp \
+    src/audiovisualizer.cpp \
+    src/peakoverview.cpp \
+    src/loudness.cpp \
+    src/resampler.cpp \
+    src/gopcache.cpp \
+    src/framehistory.cpp \
+    src/synctrace.cpp \
+    src/profiler.cpp \
+    src/timesource.cpp \
+    src/mmapio.cpp \
+    src/prefetchio.cpp \
+    src/hlssource.cpp \
+    src/livelatency.cpp \
+    src/timeshift.cpp
 
 FORMS += src/mainwid.ui \
     src/ctrlbar.ui \
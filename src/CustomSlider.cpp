@@ -1,9 +1,12 @@
-﻿#include "CustomSlider.h"
+﻿#include <QPainter>
+
+#include "CustomSlider.h"
 #include "globalhelper.h"
 
 // 构造函数，初始化滑块
 CustomSlider::CustomSlider(QWidget *parent)
-    : QSlider(parent) // 调用父类QSlider的构造函数
+    : QSlider(parent), // 调用父类QSlider的构造函数
+      m_pPeakOverview(nullptr)
 {
     this->setMaximum(MAX_SLIDER_VALUE); // 设置滑块的最大值
 }
@@ -13,6 +16,33 @@ CustomSlider::~CustomSlider()
 {
 }
 
+// 设置波形概览
+void CustomSlider::SetPeakOverview(PeakOverview *pOverview)
+{
+    m_pPeakOverview = pOverview;
+    update();
+}
+
+// 绘制事件处理函数，先画波形概览，再由父类画滑竿和滑块
+void CustomSlider::paintEvent(QPaintEvent *ev)
+{
+    if (m_pPeakOverview && m_pPeakOverview->GetPeaks(width(), m_vecPeaks))
+    {
+        QPainter painter(this);
+        painter.setPen(QColor(93, 204, 255, 110));
+
+        int nCenter = height() / 2;
+        int nHalf = FFMAX(1, nCenter - 1);
+        for (int x = 0; x < (int)m_vecPeaks.size(); x++)
+        {
+            painter.drawLine(x, nCenter - m_vecPeaks[x].max * nHalf / 127,
+                             x, nCenter - m_vecPeaks[x].min * nHalf / 127);
+        }
+    }
+
+    QSlider::paintEvent(ev);
+}
+
 // 鼠标按下事件处理函数
 void CustomSlider::mousePressEvent(QMouseEvent *ev)
 {
@@ -2,6 +2,11 @@
 
 #include <QSlider>
 #include <QMouseEvent>
+#include <QPaintEvent>
+
+#include <vector>
+
+#include "peakoverview.h"
 
 class CustomSlider : public QSlider
 {
@@ -10,10 +15,18 @@ class CustomSlider : public QSlider
 public:
     CustomSlider(QWidget *parent);
     ~CustomSlider();
+    /**
+     * @brief	设置在滑竿背后绘制的波形概览
+     */
+    void SetPeakOverview(PeakOverview *pOverview);
 protected:
+    void paintEvent(QPaintEvent *ev);
     void mousePressEvent(QMouseEvent *ev);//重写QSlider的mousePressEvent事件
     void mouseReleaseEvent(QMouseEvent *ev);
     void mouseMoveEvent(QMouseEvent *ev);
 signals:
     void SigCustomSliderValueChanged();//自定义的鼠标单击信号，用于捕获并处理
+private:
+    PeakOverview *m_pPeakOverview;      //< 波形概览，为空时不绘制
+    std::vector<PeakPair> m_vecPeaks;   //< 按当前宽度聚合的峰值
 };
@@ -0,0 +1,172 @@
+﻿#include "audiomixer.h"
+
+#pragma execution_character_set("utf-8")
+
+// 构造函数
+AudioMixer::AudioMixer(bool bSimulated)
+    : m_bSimulated(bSimulated),
+      m_bOpened(false),
+      m_nDevice(0)
+{
+    memset(&m_stSpec, 0, sizeof(m_stSpec));
+}
+
+// 析构函数，关闭设备
+AudioMixer::~AudioMixer()
+{
+    if (m_nDevice)
+    {
+        SDL_CloseAudioDevice(m_nDevice);
+        m_nDevice = 0;
+    }
+}
+
+// 添加一路音频
+bool AudioMixer::AddSource(SDL_AudioCallback callback, void *userdata, const SDL_AudioSpec *wanted, SDL_AudioSpec *obtained)
+{
+    if (!m_bOpened && m_bSimulated)
+    {
+        // 模拟输出直接使用期望的格式
+        m_stSpec = *wanted;
+        m_stSpec.callback = MixCallback;
+        m_stSpec.userdata = this;
+        m_stSpec.silence = (m_stSpec.format == AUDIO_U8) ? 0x80 : 0;
+        m_stSpec.size = m_stSpec.samples * m_stSpec.channels * (SDL_AUDIO_BITSIZE(m_stSpec.format) / 8);
+        m_bOpened = true;
+    }
+    else if (!m_bOpened)
+    {
+        SDL_AudioSpec spec = *wanted;
+        spec.callback = MixCallback;
+        spec.userdata = this;
+        m_nDevice = SDL_OpenAudioDevice(NULL, 0, &spec, &m_stSpec, 0);
+        if (!m_nDevice)
+        {
+            av_log(NULL, AV_LOG_WARNING, "AudioMixer: SDL_OpenAudioDevice (%d channels, %d Hz): %s\n",
+                   spec.channels, spec.freq, SDL_GetError());
+            return false;
+        }
+        m_bOpened = true;
+        SDL_PauseAudioDevice(m_nDevice, 0);
+    }
+
+    // 回调线程中会遍历音频列表，修改时需要锁住设备
+    Lock();
+    m_vecSources.push_back({ callback, userdata, true });
+    m_vecMixBuf.resize(m_stSpec.size);
+    Unlock();
+
+    *obtained = m_stSpec;
+    return true;
+}
+
+// 移除一路音频
+void AudioMixer::RemoveSource(void *userdata)
+{
+    if (!m_bOpened)
+    {
+        return;
+    }
+
+    Lock();
+    for (auto it = m_vecSources.begin(); it != m_vecSources.end(); ++it)
+    {
+        if (it->userdata == userdata)
+        {
+            m_vecSources.erase(it);
+            break;
+        }
+    }
+    bool bEmpty = m_vecSources.empty();
+    Unlock();
+
+    if (bEmpty)
+    {
+        if (m_nDevice)
+        {
+            SDL_CloseAudioDevice(m_nDevice);
+        }
+        m_nDevice = 0;
+        m_bOpened = false;
+    }
+}
+
+// 暂停/恢复一路音频
+void AudioMixer::PauseSource(void *userdata, bool bPause)
+{
+    if (!m_bOpened)
+    {
+        return;
+    }
+
+    Lock();
+    for (Source &source : m_vecSources)
+    {
+        if (source.userdata == userdata)
+        {
+            source.paused = bPause;
+        }
+    }
+    Unlock();
+}
+
+// 设备回调：依次拉取每一路音频并混合
+void AudioMixer::MixCallback(void *opaque, Uint8 *stream, int len)
+{
+    AudioMixer *pMixer = (AudioMixer *)opaque;
+
+    memset(stream, pMixer->m_stSpec.silence, len);
+    if ((int)pMixer->m_vecMixBuf.size() < len)
+    {
+        return;
+    }
+
+    for (Source &source : pMixer->m_vecSources)
+    {
+        if (source.paused)
+        {
+            continue;
+        }
+        source.callback(source.userdata, pMixer->m_vecMixBuf.data(), len);
+        SDL_MixAudioFormat(stream, pMixer->m_vecMixBuf.data(), pMixer->m_stSpec.format, len, SDL_MIX_MAXVOLUME);
+    }
+}
+
+// 模拟输出：在调用者线程中执行一次设备回调
+void AudioMixer::Render(Uint8 *stream, int len)
+{
+    if (!m_bSimulated || !m_bOpened)
+    {
+        memset(stream, 0, len);
+        return;
+    }
+
+    Lock();
+    MixCallback(this, stream, len);
+    Unlock();
+}
+
+// 设备回调与修改音频列表互斥，模拟输出时没有设备锁，使用自己的互斥锁
+void AudioMixer::Lock()
+{
+    if (m_bSimulated)
+    {
+        m_mutex.lock();
+    }
+    else
+    {
+        SDL_LockAudioDevice(m_nDevice);
+    }
+}
+
+void AudioMixer::Unlock()
+{
+    if (m_bSimulated)
+    {
+        m_mutex.unlock();
+    }
+    else
+    {
+        SDL_UnlockAudioDevice(m_nDevice);
+    }
+}
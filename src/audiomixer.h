@@ -0,0 +1,79 @@
+﻿#ifndef AUDIOMIXER_H
+#define AUDIOMIXER_H
+
+#include <mutex>
+#include <vector>
+
+#include "globalhelper.h"
+
+/**
+ * @brief	混音输出
+ *
+ * 多个播放引擎共用一个 SDL 音频设备：每个回调周期依次拉取各路音频，
+ * 混合后输出。适用于画中画、预览窗格等需要同时出声的场景，
+ * 不使用混音的引擎各自通过 SDL_OpenAudioDevice 打开独立设备。
+ * 模拟输出模式下不打开设备，按期望的格式输出，由调用者通过 Render 拉取数据，
+ * 用于同步回放按虚拟时钟消耗音频。
+ */
+class AudioMixer
+{
+public:
+    /**
+     * @param	bSimulated 模拟输出，不打开音频设备
+     */
+    explicit AudioMixer(bool bSimulated = false);
+    ~AudioMixer();
+
+    /**
+     * @brief	添加一路音频
+     *
+     * @param	callback 拉取音频数据的回调（输出格式与 obtained 一致）
+     * @param	userdata 回调参数，同时作为该路音频的标识
+     * @param	wanted 期望的音频格式（仅第一路音频打开设备时使用）
+     * @param	obtained 实际的设备格式
+     * @return	true 成功 false 失败
+     * @note 	新加入的音频默认处于暂停状态
+     */
+    bool AddSource(SDL_AudioCallback callback, void *userdata, const SDL_AudioSpec *wanted, SDL_AudioSpec *obtained);
+
+    /**
+     * @brief	移除一路音频，最后一路移除时关闭设备
+     */
+    void RemoveSource(void *userdata);
+
+    /**
+     * @brief	暂停/恢复一路音频
+     */
+    void PauseSource(void *userdata, bool bPause);
+
+    /**
+     * @brief	模拟输出：拉取并混合一个周期的音频
+     *
+     * @param	stream 输出缓冲
+     * @param	len 字节数，通常为 obtained.size
+     * @note 	只用于模拟输出模式，没有音频时输出静音
+     */
+    void Render(Uint8 *stream, int len);
+
+private:
+    static void MixCallback(void *opaque, Uint8 *stream, int len);
+    void Lock();
+    void Unlock();
+
+    struct Source
+    {
+        SDL_AudioCallback callback;
+        void *userdata;
+        bool paused;
+    };
+
+    bool m_bSimulated;              //< 模拟输出，不打开设备
+    bool m_bOpened;                 //< 设备已打开（模拟输出时为格式已确定）
+    SDL_AudioDeviceID m_nDevice;    //< 共享的音频设备
+    SDL_AudioSpec m_stSpec;         //< 设备的实际格式
+    std::vector<Source> m_vecSources;
+    std::vector<Uint8> m_vecMixBuf; //< 单路音频的临时缓冲
+    std::recursive_mutex m_mutex;   //< 模拟输出时代替设备锁
+};
+
+#endif // AUDIOMIXER_H
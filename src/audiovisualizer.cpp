@@ -0,0 +1,276 @@
+﻿#include <algorithm>
+
+#include "audiovisualizer.h"
+
+#pragma execution_character_set("utf-8")
+
+#define VISUALIZER_WINDOW (1 << VISUALIZER_RDFT_BITS)
+#define VISUALIZER_BAR_FALL 0.03f       // 频谱柱每帧最多回落的高度
+#define VISUALIZER_WAVE_COLOR 0xff40e0a0
+
+// 构造函数
+AudioVisualizer::AudioVisualizer() :
+    m_pSamples(NULL),
+    m_nWritePos(0),
+    m_pRdft(NULL),
+    m_pRdftData(NULL),
+    m_nWidth(0),
+    m_nHeight(0),
+    m_nFrontWidth(0),
+    m_nFrontHeight(0),
+    m_bFresh(false),
+    m_bStop(false)
+{
+    memset(m_arrBars, 0, sizeof(m_arrBars));
+}
+
+// 析构函数
+AudioVisualizer::~AudioVisualizer()
+{
+    Stop();
+
+    av_freep(&m_pSamples);
+    if (m_pRdft)
+    {
+        av_rdft_end(m_pRdft);
+    }
+    av_freep(&m_pRdftData);
+}
+
+/* 分配样本缓冲并启动绘制线程 */
+bool AudioVisualizer::Start()
+{
+    m_pSamples = (int16_t *)av_mallocz(SAMPLE_ARRAY_SIZE * sizeof(int16_t));
+    m_pRdft = av_rdft_init(VISUALIZER_RDFT_BITS, DFT_R2C);
+    m_pRdftData = (FFTSample *)av_malloc_array(VISUALIZER_WINDOW, sizeof(*m_pRdftData));
+    if (!m_pSamples || !m_pRdft || !m_pRdftData)
+    {
+        av_log(NULL, AV_LOG_ERROR, "Failed to allocate audio visualizer\n");
+        return false;
+    }
+
+    m_vecWindow.resize(VISUALIZER_WINDOW);
+    for (int i = 0; i < VISUALIZER_WINDOW; i++)
+    {
+        m_vecWindow[i] = 0.5f - 0.5f * cosf(2 * M_PI * i / (VISUALIZER_WINDOW - 1));
+    }
+
+    m_bStop = false;
+    m_stThread = std::thread(&AudioVisualizer::DrawThread, this);
+    return true;
+}
+
+/* 停止绘制线程 */
+void AudioVisualizer::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bStop = true;
+    }
+    m_cond.notify_all();
+
+    if (m_stThread.joinable())
+    {
+        m_stThread.join();
+    }
+}
+
+/* 写入样本：混为单声道后写入环形缓冲，最后发布写位置 */
+void AudioVisualizer::PushSamples(const uint8_t *pData, int nLen, enum AVSampleFormat fmt, int nChannels)
+{
+    uint32_t nPos = m_nWritePos.load(std::memory_order_relaxed);
+    int nFrames;
+
+    if (!m_pSamples || nChannels <= 0)
+    {
+        return;
+    }
+
+    if (fmt == AV_SAMPLE_FMT_S16)
+    {
+        const int16_t *pSrc = (const int16_t *)pData;
+        nFrames = nLen / (nChannels * (int)sizeof(int16_t));
+        for (int i = 0; i < nFrames; i++)
+        {
+            int nSum = 0;
+            for (int ch = 0; ch < nChannels; ch++)
+            {
+                nSum += *pSrc++;
+            }
+            m_pSamples[(nPos + i) & (SAMPLE_ARRAY_SIZE - 1)] = nSum / nChannels;
+        }
+    }
+    else if (fmt == AV_SAMPLE_FMT_FLT)
+    {
+        const float *pSrc = (const float *)pData;
+        nFrames = nLen / (nChannels * (int)sizeof(float));
+        for (int i = 0; i < nFrames; i++)
+        {
+            float fSum = 0;
+            for (int ch = 0; ch < nChannels; ch++)
+            {
+                fSum += *pSrc++;
+            }
+            m_pSamples[(nPos + i) & (SAMPLE_ARRAY_SIZE - 1)] = av_clip_int16(lrintf(fSum / nChannels * 32767));
+        }
+    }
+    else
+    {
+        return;
+    }
+
+    m_nWritePos.store(nPos + nFrames, std::memory_order_release);
+}
+
+void AudioVisualizer::SetSize(int nWidth, int nHeight)
+{
+    m_nWidth = FFMIN(nWidth, VISUALIZER_MAX_WIDTH);
+    m_nHeight = FFMIN(nHeight, VISUALIZER_MAX_HEIGHT);
+}
+
+/* 取最新绘制完成的图像 */
+bool AudioVisualizer::LockFrame(const uint32_t **ppPixels, int *pWidth, int *pHeight)
+{
+    m_frameMutex.lock();
+    if (!m_bFresh)
+    {
+        m_frameMutex.unlock();
+        return false;
+    }
+
+    m_bFresh = false;
+    *ppPixels = m_vecFront.data();
+    *pWidth = m_nFrontWidth;
+    *pHeight = m_nFrontHeight;
+    return true;
+}
+
+void AudioVisualizer::UnlockFrame()
+{
+    m_frameMutex.unlock();
+}
+
+/* 绘制线程：按固定间隔检查新样本，有变化才重新绘制 */
+void AudioVisualizer::DrawThread()
+{
+    uint32_t nLastPos = 0;
+    int nLastWidth = 0, nLastHeight = 0;
+
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_bStop)
+    {
+        m_cond.wait_for(lock, std::chrono::milliseconds(VISUALIZER_INTERVAL), [this] { return m_bStop.load(); });
+        if (m_bStop)
+        {
+            break;
+        }
+        lock.unlock();
+
+        uint32_t nPos = m_nWritePos.load(std::memory_order_acquire);
+        int nWidth = m_nWidth;
+        int nHeight = m_nHeight;
+        // 暂停时样本不再变化，保持最后一帧
+        if (nWidth > 0 && nHeight > 0 && (nPos != nLastPos || nWidth != nLastWidth || nHeight != nLastHeight))
+        {
+            Render(nPos, nWidth, nHeight);
+            nLastPos = nPos;
+            nLastWidth = nWidth;
+            nLastHeight = nHeight;
+        }
+
+        lock.lock();
+    }
+}
+
+/* 绘制一帧：上半部分波形，下半部分频谱 */
+void AudioVisualizer::Render(uint32_t nPos, int nWidth, int nHeight)
+{
+    m_vecBack.assign((size_t)nWidth * nHeight, 0xff000000);
+
+    // 写位置之前的 VISUALIZER_WINDOW 个样本做频谱分析
+    for (int i = 0; i < VISUALIZER_WINDOW; i++)
+    {
+        int16_t nSample = m_pSamples[(nPos - VISUALIZER_WINDOW + i) & (SAMPLE_ARRAY_SIZE - 1)];
+        m_pRdftData[i] = nSample / 32768.0f * m_vecWindow[i];
+    }
+    av_rdft_calc(m_pRdft, m_pRdftData);
+
+    DrawWave(nPos, nWidth, nHeight / 2);
+    DrawSpectrum(nHeight / 2, nWidth, nHeight - nHeight / 2);
+
+    std::lock_guard<std::mutex> lock(m_frameMutex);
+    m_vecFront.swap(m_vecBack);
+    m_nFrontWidth = nWidth;
+    m_nFrontHeight = nHeight;
+    m_bFresh = true;
+}
+
+/* 波形：每列取对应样本区间的最小/最大值画竖线 */
+void AudioVisualizer::DrawWave(uint32_t nPos, int nWidth, int nHeight)
+{
+    int nCenter = nHeight / 2;
+
+    for (int x = 0; x < nWidth; x++)
+    {
+        int nBegin = x * VISUALIZER_WINDOW / nWidth;
+        int nEnd = FFMAX(nBegin + 1, (x + 1) * VISUALIZER_WINDOW / nWidth);
+        int nMin = INT16_MAX, nMax = INT16_MIN;
+        for (int i = nBegin; i < nEnd; i++)
+        {
+            int nSample = m_pSamples[(nPos - VISUALIZER_WINDOW + i) & (SAMPLE_ARRAY_SIZE - 1)];
+            nMin = FFMIN(nMin, nSample);
+            nMax = FFMAX(nMax, nSample);
+        }
+
+        int y0 = av_clip(nCenter - nMax * nCenter / 32768, 0, nHeight - 1);
+        int y1 = av_clip(nCenter - nMin * nCenter / 32768, 0, nHeight - 1);
+        for (int y = y0; y <= y1; y++)
+        {
+            m_vecBack[(size_t)y * nWidth + x] = VISUALIZER_WAVE_COLOR;
+        }
+    }
+}
+
+/* 频谱：频率按对数分段，每段取最大幅度换算为分贝 */
+void AudioVisualizer::DrawSpectrum(int nTop, int nWidth, int nHeight)
+{
+    const int nBins = VISUALIZER_WINDOW / 2;
+    // 满幅正弦经过 Hann 窗后的幅度约为 N/4
+    const float fScale = 4.0f / VISUALIZER_WINDOW;
+    int nBarWidth = FFMAX(1, nWidth / VISUALIZER_BARS);
+
+    for (int b = 0; b < VISUALIZER_BARS; b++)
+    {
+        int nBegin = FFMAX(1, (int)pow(nBins, (double)b / VISUALIZER_BARS));
+        int nEnd = FFMIN(nBins, FFMAX(nBegin + 1, (int)pow(nBins, (double)(b + 1) / VISUALIZER_BARS)));
+        float fMax = 0;
+        for (int k = nBegin; k < nEnd; k++)
+        {
+            float re = m_pRdftData[2 * k], im = m_pRdftData[2 * k + 1];
+            fMax = FFMAX(fMax, re * re + im * im);
+        }
+
+        double dDb = 10 * log10(fMax * fScale * fScale + 1e-12);
+        float fLevel = av_clipf((dDb - VISUALIZER_MIN_DB) / -VISUALIZER_MIN_DB, 0, 1);
+        m_arrBars[b] = FFMAX(fLevel, m_arrBars[b] - VISUALIZER_BAR_FALL);
+
+        int nBarHeight = (int)(m_arrBars[b] * nHeight);
+        int x0 = b * nWidth / VISUALIZER_BARS;
+        int x1 = FFMIN(nWidth, x0 + nBarWidth - (nBarWidth > 2 ? 1 : 0));
+        for (int y = nHeight - nBarHeight; y < nHeight; y++)
+        {
+            // 自下而上由绿到红
+            float t = 1.0f - (float)y / nHeight;
+            uint32_t r = FFMIN(255, (int)(510 * t));
+            uint32_t g = FFMIN(255, (int)(510 * (1 - t)));
+            uint32_t nColor = 0xff000000 | (r << 16) | (g << 8) | 0x20;
+            uint32_t *pRow = &m_vecBack[(size_t)(nTop + y) * nWidth];
+            for (int x = x0; x < x1; x++)
+            {
+                pRow[x] = nColor;
+            }
+        }
+    }
+}
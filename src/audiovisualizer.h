@@ -0,0 +1,105 @@
+﻿#ifndef AUDIOVISUALIZER_H
+#define AUDIOVISUALIZER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "globalhelper.h"
+
+/* NOTE: the size must be big enough to compensate the hardware audio buffersize size */
+#define SAMPLE_ARRAY_SIZE (8 * 65536)
+
+#define VISUALIZER_RDFT_BITS 11         // 频谱分析窗口为 2^11 个样本
+#define VISUALIZER_BARS 64              // 频谱柱数
+#define VISUALIZER_INTERVAL 20          // 绘制间隔（毫秒）
+#define VISUALIZER_MAX_WIDTH 960        // 绘制分辨率上限，显示时由渲染器拉伸
+#define VISUALIZER_MAX_HEIGHT 540
+#define VISUALIZER_MIN_DB -80.0         // 频谱显示的最低电平
+
+/**
+ * @brief	纯音频播放时的频谱/波形显示
+ *
+ * 音频回调把正在输出的样本混为单声道写入环形缓冲，只发布写位置，不加锁；
+ * 低优先级的绘制线程按固定间隔读取最新的样本，做RDFT并把波形和频谱
+ * 绘制到ARGB图像中。图像双缓冲，播放线程取走最新一帧上传到纹理显示。
+ * 有视频时不创建，环形缓冲和RDFT上下文只在 Start 中分配。
+ */
+class AudioVisualizer
+{
+public:
+    AudioVisualizer();
+    ~AudioVisualizer();
+
+    /**
+     * @brief	分配样本缓冲并启动绘制线程
+     *
+     * @return	true 成功 false 失败
+     */
+    bool Start();
+
+    /**
+     * @brief	停止绘制线程
+     */
+    void Stop();
+
+    /**
+     * @brief	写入正在输出的音频样本，在音频回调中调用
+     *
+     * @param	pData 交错存放的样本
+     * @param	nLen 字节数
+     * @param	fmt 样本格式，只支持 S16 和 FLT
+     * @param	nChannels 声道数
+     * @note 	单生产者，不加锁
+     */
+    void PushSamples(const uint8_t *pData, int nLen, enum AVSampleFormat fmt, int nChannels);
+
+    /**
+     * @brief	设置绘制分辨率，超过上限时按上限绘制
+     */
+    void SetSize(int nWidth, int nHeight);
+
+    /**
+     * @brief	取最新绘制完成的图像
+     *
+     * @param	ppPixels ARGB8888 像素
+     * @param	pWidth 宽度
+     * @param	pHeight 高度
+     * @return	true 有新图像，使用完后必须调用 UnlockFrame；false 没有新图像
+     */
+    bool LockFrame(const uint32_t **ppPixels, int *pWidth, int *pHeight);
+    void UnlockFrame();
+
+private:
+    void DrawThread();
+    void Render(uint32_t nPos, int nWidth, int nHeight);
+    void DrawWave(uint32_t nPos, int nWidth, int nHeight);
+    void DrawSpectrum(int nTop, int nWidth, int nHeight);
+
+private:
+    int16_t *m_pSamples;                    ///< 单声道样本环形缓冲，长度为 SAMPLE_ARRAY_SIZE
+    std::atomic<uint32_t> m_nWritePos;      ///< 累计写入的样本数，对 SAMPLE_ARRAY_SIZE 取模即写位置
+
+    RDFTContext *m_pRdft;
+    FFTSample *m_pRdftData;
+    std::vector<float> m_vecWindow;         ///< Hann 窗
+    float m_arrBars[VISUALIZER_BARS];       ///< 各频谱柱当前高度（0~1），带回落
+
+    std::atomic<int> m_nWidth;
+    std::atomic<int> m_nHeight;
+
+    std::mutex m_frameMutex;                ///< 保护前台图像
+    std::vector<uint32_t> m_vecFront;       ///< 绘制完成待显示的图像
+    std::vector<uint32_t> m_vecBack;        ///< 绘制线程正在绘制的图像
+    int m_nFrontWidth, m_nFrontHeight;
+    bool m_bFresh;                          ///< 前台图像是否未被取走
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::atomic<bool> m_bStop;
+    std::thread m_stThread;
+};
+
+#endif // AUDIOVISUALIZER_H
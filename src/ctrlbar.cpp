@@ -1,16 +1,22 @@
 ﻿#include <QDebug>
 #include <QTime>
 #include <QSettings>
+#include <QWidgetAction>
 
 #include "ctrlbar.h"
 #include "ui_ctrlbar.h"
 #include "globalhelper.h"
 #include "mainwid.h"
+#include "videoctl.h"
+
+#define SPEED_SLIDER_SCALE 100  // 速度滑块的值为速率的100倍
 
 // CtrlBar类的构造函数
 CtrlBar::CtrlBar(QWidget *parent) :
     QWidget(parent),
-    ui(new Ui::CtrlBar)
+    ui(new Ui::CtrlBar),
+    m_stSpeedMenu(this),
+    m_pSpeedSlider(nullptr)
 {
     ui->setupUi(this);
 
@@ -48,6 +54,20 @@ bool CtrlBar::Init()
     ui->PlayOrPauseBtn->setToolTip("播放");
     ui->speedBtn->setToolTip("倍速");
 
+    // 倍速按钮弹出速度滑块，可连续调节
+    m_pSpeedSlider = new QSlider(Qt::Horizontal, &m_stSpeedMenu);
+    m_pSpeedSlider->setRange(PLAYBACK_RATE_MIN * SPEED_SLIDER_SCALE, PLAYBACK_RATE_MAX * SPEED_SLIDER_SCALE);
+    m_pSpeedSlider->setSingleStep(PLAYBACK_RATE_FINE_STEP * SPEED_SLIDER_SCALE);
+    m_pSpeedSlider->setPageStep(PLAYBACK_RATE_SCALE * SPEED_SLIDER_SCALE);
+    m_pSpeedSlider->setValue(SPEED_SLIDER_SCALE);
+    m_pSpeedSlider->setMinimumWidth(200);
+    QWidgetAction *pSpeedAction = new QWidgetAction(&m_stSpeedMenu);
+    pSpeedAction->setDefaultWidget(m_pSpeedSlider);
+    m_stSpeedMenu.addAction(pSpeedAction);
+
+    // 进度条背后绘制波形概览
+    ui->PlaySlider->SetPeakOverview(&m_stPeakOverview);
+
     // 连接信号和槽
     ConnectSignalSlots();
 
@@ -72,6 +92,8 @@ bool CtrlBar::ConnectSignalSlots()
     connect(ui->VolumeSlider, &CustomSlider::SigCustomSliderValueChanged, this, &CtrlBar::OnVolumeSliderValueChanged);
     connect(ui->BackwardBtn, &QPushButton::clicked, this, &CtrlBar::SigBackwardPlay);
     connect(ui->ForwardBtn, &QPushButton::clicked, this, &CtrlBar::SigForwardPlay);
+    connect(m_pSpeedSlider, &QSlider::valueChanged, this, &CtrlBar::OnSpeedSliderValueChanged);
+    connect(&m_stPeakOverview, &PeakOverview::SigOverviewReady, this, &CtrlBar::OnPeakOverviewReady, Qt::QueuedConnection);
     return true;
 }
 
@@ -147,6 +169,8 @@ void CtrlBar::OnPauseStat(bool bPaused)
 void CtrlBar::OnStopFinished()
 {
     ui->PlaySlider->setValue(0);
+    m_stPeakOverview.Cancel();
+    ui->PlaySlider->update();
     QTime StopTime(0, 0, 0);
     ui->VideoTotalTimeTimeEdit->setTime(StopTime);
     ui->VideoPlayTimeTimeEdit->setTime(StopTime);
@@ -157,8 +181,63 @@ void CtrlBar::OnStopFinished()
 // 设置播放速度
 void CtrlBar::OnSpeed(float speed)
 {
-    // 更新速度按钮的文本
+    // 更新速度按钮的文本和滑块位置
     ui->speedBtn->setText(QString("倍速:%1").arg(speed));
+    m_pSpeedSlider->blockSignals(true);
+    m_pSpeedSlider->setValue(qRound(speed * SPEED_SLIDER_SCALE));
+    m_pSpeedSlider->blockSignals(false);
+}
+
+// 关键帧扫描时按钮显示扫描倍率，结束后恢复显示播放速度
+void CtrlBar::OnScan(int nSpeed)
+{
+    if (nSpeed > 0)
+    {
+        ui->speedBtn->setText(QString("快进:%1x").arg(nSpeed));
+    }
+    else if (nSpeed < 0)
+    {
+        ui->speedBtn->setText(QString("快退:%1x").arg(-nSpeed));
+    }
+    else
+    {
+        ui->speedBtn->setText(QString("倍速:%1").arg((float)m_pSpeedSlider->value() / SPEED_SLIDER_SCALE));
+    }
+}
+
+// 倒放时按钮显示倒放，结束后恢复显示播放速度
+void CtrlBar::OnReverse(bool bReverse)
+{
+    if (bReverse)
+    {
+        ui->speedBtn->setText("倒放");
+    }
+    else
+    {
+        OnScan(0);
+    }
+}
+
+// 速度滑块拖动
+void CtrlBar::OnSpeedSliderValueChanged(int nValue)
+{
+    emit SigSetSpeed((float)nValue / SPEED_SLIDER_SCALE);
+}
+
+// 开始播放新文件时，在后台生成进度条的波形概览
+void CtrlBar::OnStartPlay(QString strFileName)
+{
+    m_stPeakOverview.Start(strFileName);
+    ui->PlaySlider->update();
+
+    // 新文件从正常播放开始
+    OnScan(0);
+}
+
+// 波形概览生成完成，重绘进度条
+void CtrlBar::OnPeakOverviewReady()
+{
+    ui->PlaySlider->update();
 }
 
 // 播放滑块值改变时的处理
@@ -215,7 +294,8 @@ void CtrlBar::on_SettingBtn_clicked()
 // 倍速按钮点击事件的处理
 void CtrlBar::on_speedBtn_clicked()
 {
-    // 设置变速
-    emit SigSpeed();
+    // 在按钮上方弹出速度滑块
+    QPoint pos = ui->speedBtn->mapToGlobal(QPoint(0, -m_stSpeedMenu.sizeHint().height()));
+    m_stSpeedMenu.popup(pos);
 }
 
@@ -12,7 +12,10 @@
 #define CTRLBAR_H
 
 #include <QWidget>
+#include <QMenu>
+#include <QSlider>
 #include "CustomSlider.h"
+#include "peakoverview.h"
 
 namespace Ui {
 class CtrlBar;
@@ -40,9 +43,14 @@ public:
     void OnPauseStat(bool bPaused);
     void OnStopFinished();
     void OnSpeed(float speed);
+    void OnScan(int nSpeed);
+    void OnReverse(bool bReverse);
+    void OnStartPlay(QString strFileName);
 private:
     void OnPlaySliderValueChanged();
+    void OnPeakOverviewReady();
     void OnVolumeSliderValueChanged();
+    void OnSpeedSliderValueChanged(int nValue);
 private slots:
     void on_PlayOrPauseBtn_clicked();
     void on_VolumeBtn_clicked();
@@ -69,12 +77,17 @@ signals:
     void SigBackwardPlay();
     void SigShowMenu();
     void SigShowSetting();
-    void SigSpeed();
+    void SigSetSpeed(float fRate);
 private:
     Ui::CtrlBar *ui;
 
     int m_nTotalPlaySeconds;
     double m_dLastVolumePercent;
+
+    PeakOverview m_stPeakOverview; ///< 进度条的波形概览
+
+    QMenu m_stSpeedMenu;    ///< 倍速按钮弹出的速度滑块
+    QSlider *m_pSpeedSlider;
 };
 
 #endif // CTRLBAR_H
@@ -9,8 +9,14 @@
 #include <unistd.h>
 #endif
 
+#include <atomic>
 #include <thread>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AUDIO_INTERLEAVE_SSE2 1
+#endif
+
 #include <inttypes.h>
 #include <math.h>
 #include <limits.h>
@@ -19,9 +25,25 @@
 #include <assert.h>
 
 #include "globalhelper.h"
+#include "taskexecutor.h"
+#include "subtitlestore.h"
+#include "audiovisualizer.h"
+#include "loudness.h"
+#include "resampler.h"
+#include "gopcache.h"
+#include "framehistory.h"
+#include "profiler.h"
+
+class VideoCtl;
+class MmapIO;
+class PrefetchIO;
+class HlsSource;
+class LiveLatencyController;
+class TimeshiftBuffer;
 
 #define MAX_QUEUE_SIZE (15 * 1024 * 1024)
 #define MIN_FRAMES 25
+#define NETWORK_QUEUE_SECONDS 5.0    // 网络流的包队列至少缓冲的时长，吸收分片边界和带宽波动
 #define EXTERNAL_CLOCK_MIN_FRAMES 2
 #define EXTERNAL_CLOCK_MAX_FRAMES 10
 
@@ -56,14 +78,26 @@
 /* polls for possible required screen refresh at least this often, should be less than 1/fps */
 #define REFRESH_RATE 0.01
 
-/* NOTE: the size must be big enough to compensate the hardware audio buffersize size */
-/* TODO: We assume that a decoded and resampled frame fits into this buffer */
-#define SAMPLE_ARRAY_SIZE (8 * 65536)
-
 #define CURSOR_HIDE_DELAY 1000000
 
 #define USE_ONEPASS_SUBTITLE_RENDER 1
 
+/* 字幕纹理上记录的有内容区域数，超过时合并为一个外接矩形 */
+#define SUB_MAX_DIRTY_RECTS 16
+
+//播放结束状态
+enum {
+    EOS_STATE_NONE,         // 正常读取
+    EOS_STATE_DRAINING,     // 已读到文件尾，等待解码器与帧队列排空
+    EOS_STATE_ENDED,        // 播放完毕，读取线程挂起等待下一步动作
+};
+
+//读取线程唤醒器（带挂起标志，避免信号在等待之前发出而丢失）
+typedef struct ReadWaker {
+    SDL_mutex *mutex;
+    SDL_cond *cond;
+    int pending;
+} ReadWaker;
 
 
 //数据包列表
@@ -81,6 +115,7 @@ typedef struct PacketQueue {
     int64_t duration;
     int abort_request;
     int serial;
+    AVPacket *flush_pkt;  // 所属播放实例的清理包（按地址识别）
     SDL_mutex *mutex;
     SDL_cond *cond;
 } PacketQueue;
@@ -126,6 +161,8 @@ typedef struct Frame {
     AVRational sar;
     int uploaded;
     int flip_v;
+    uint32_t **sub_argb;  /* 字幕线程预先转换好的ARGB像素，每个字幕矩形一块，行宽为 rect->w */
+    int nb_sub_argb;
 } Frame;
 
 //帧队列
@@ -157,17 +194,20 @@ typedef struct Decoder {
     int pkt_serial;
     int finished;
     int packet_pending;
-    SDL_cond *empty_queue_cond;
     int64_t start_pts;
     AVRational start_pts_tb;
     int64_t next_pts;
     AVRational next_pts_tb;
-    std::thread decode_thread;
+    int reorder_pts;    // 1 使用解码器重排后的pts，0 使用pkt_dts，-1 自动
+    ReadWaker *empty_queue_waker;
+    TaskHandle decode_task; // 解码任务（在任务执行器中运行）
 } Decoder;
 
 //视频状态，管理所有的视频信息及数据
 typedef struct VideoState {
-    std::thread read_tid; //读取线程
+    VideoCtl *ctl;        //所属的播放引擎实例
+    TaskHandle read_task; //读取任务
+    std::atomic<int> streams_opened; //读取线程已打开各路流，进入读包循环
     AVInputFormat *iformat;
     int abort_request; //停止读取标志
     int force_refresh;
@@ -181,10 +221,47 @@ typedef struct VideoState {
     int read_pause_return;
     AVFormatContext *ic;
     int realtime;
+    int network;                    // HTTP/HLS 网络流
+
+    LiveLatencyController *live_ctl;    // 直播目标延迟控制器，非实时流或未开启直播模式时为空
+    std::atomic<double> live_recv_pts;  // 读取线程最近收到的参考流（有音频时为音频）包的时间戳（秒）
+    std::atomic<float> live_speed;      // 轻微调速系数，音频为主时钟时音频回调按该系数增减样本
+    std::atomic<int64_t> live_drop_us;  // 音频回调待丢弃的时长（微秒）
+    double live_rate;                   // 控制器设置的播放速率
+    int64_t live_next_control;          // 下次控制的时间（微秒）
 
     Clock audclk;
     Clock vidclk;
     Clock extclk;
+    Clock scanclk;                  // 关键帧扫描/倒放时钟，按扫描倍率走动（快退、倒放时为负速度）
+
+    std::atomic<int> scan_speed;    // 请求的扫描倍率，正数快进、负数快退，0 为正常播放
+    std::atomic<int> scan_active;   // 读取线程正在执行的扫描倍率
+    int64_t scan_last_key;          // 最近送入解码器的关键帧时间戳（视频流时间基）
+
+    std::atomic<int> reverse_req;   // 请求倒放
+    std::atomic<int> reverse_active;// 读取线程已切换到倒放，视频线程从 gop_cache 取帧
+    int reverse_step_req;           // 进入倒放后后退一帧并暂停
+    GopCache *gop_cache;            // 倒放用的GOP缓存，第一次倒放时创建
+
+    MmapIO *mmap_io;                // 本地文件的内存映射读取，为空时使用 file 协议
+    PrefetchIO *prefetch_io;        // 慢速存储和 HTTP 渐进下载的异步预读
+    HlsSource *hls_source;          // HLS 分片预取，为空时使用 hls 解复用器
+    TimeshiftBuffer *timeshift;     // 直播时移缓冲，不为空时读取线程从中读包，直播源由接收任务读取
+    int timeshift_total;            // 最近一次通知的时移窗口长度（秒），进度条按窗口显示
+    FrameHistory *frame_history;    // 最近解码的视频帧，打开视频流时创建
+    std::atomic<int> history_req;   // 请求从历史帧播放
+    std::atomic<double> history_target; // 请求播放的位置（秒）
+    std::atomic<int> history_active;// 视频线程正在输出历史帧，解码器停在原来的位置
+    int history_skip;               // 切换时帧队列中待丢弃的较新的帧数，受 pictq.mutex 保护
+    int history_serial;             // 切换时的包队列序列号
+    double history_next;            // 下一个要输出的历史帧位置（视频线程使用）
+    FrameHistory *audio_history;    // 最近播放的音频帧，打开音频流时创建，与视频历史一起重放
+    std::atomic<int> audio_history_req; // 请求音频从 history_target 开始重放
+    int audio_history_active;       // 音频回调正在输出历史帧，取完后接着播放 sampq（音频回调使用）
+    int audio_history_serial;       // 切换时的音频包队列序列号
+    double audio_history_next;      // 下一个要输出的历史音频帧位置
+    Frame audio_history_frame;      // 正在输出的历史音频帧
 
     FrameQueue pictq;
     FrameQueue subpq;
@@ -214,21 +291,32 @@ typedef struct VideoState {
     int audio_buf_index; /* in bytes */
     int audio_write_buf_size;
     int audio_volume;
+    SDL_AudioDeviceID audio_dev; // 本实例打开的音频设备（使用混音输出时为0）
+    int64_t audio_callback_time; // 最近一次音频回调的时间
+
+    std::atomic<float> loudness_gain;   // 响度标准化的目标增益（线性）
+    std::atomic<bool> loudness_known;   // 是否已有整个文件的分析结果
+    float loudness_cur_gain;            // 音频回调当前使用的增益，逐步逼近目标增益
+    LoudnessMeter *loudness_live;       // 分析完成前的实时响度估计，只在音频解码线程使用
+    TaskHandle loudness_task;           // 后台响度分析任务
 
     struct AudioParams audio_src;
 
     struct AudioParams audio_tgt;
-    struct SwrContext *swr_ctx;
+    struct SwrContext *swr_ctx;     // 当前使用的重采样上下文，归 VideoCtl::m_stResampler 所有
+    int swr_mode;                   // swr_ctx 的重采样模式
+    int64_t audio_bypass_frames;    // 未经重采样器直接输出的帧数
+    int64_t audio_resample_frames;  // 经过重采样器的帧数
     int frame_drops_early;
     int frame_drops_late;
-
-    int16_t sample_array[SAMPLE_ARRAY_SIZE];
-    int sample_array_index;
-    int last_i_start;
-    RDFTContext *rdft;
-    int rdft_bits;
-    FFTSample *rdft_data;
-    int xpos;
+    int speed_skip_level;           // 倍速播放时视频解码的降级档位
+    float speed_skip_rate;          // 上述档位对应的播放速率
+    int speed_skip_serial;          // 统计周期对应的包序列
+    int64_t speed_skip_start;       // 解码帧率统计周期的开始时间
+    int speed_skip_frames;          // 本周期解码的帧数
+
+    AudioVisualizer *visualizer;    // 纯音频播放时的频谱/波形显示，有视频时为空
+    SDL_Texture *vis_texture;
     double last_vis_time;
 
     SDL_Texture *sub_texture;
@@ -246,8 +334,21 @@ typedef struct VideoState {
     PacketQueue videoq;
     double max_frame_duration;      // maximum duration of a frame - above this, we consider the jump a timestamp discontinuity
     struct SwsContext *img_convert_ctx;
-    struct SwsContext *sub_convert_ctx;
+    SDL_Rect sub_dirty_rects[SUB_MAX_DIRTY_RECTS];  // 字幕纹理上仍有旧内容的区域
+    int nb_sub_dirty_rects;
+    uint8_t *sub_clear_buf;                         // 清除字幕区域用的全零缓冲
+    int sub_clear_buf_size;
+
+    SubtitleStore *sidecar_subs;    // 外挂字幕时间轴
+    TaskHandle sidecar_task;        // 外挂字幕加载任务
+    SubtitleStore *text_subs;       // 当前内嵌文本字幕流的时间轴
+    TaskHandle text_subs_task;      // 内嵌文本字幕预读任务
+    SDL_Texture *text_sub_texture;  // 文本字幕纹理
+    uint64_t text_sub_key;          // 纹理中字幕集合的标识
+    int text_sub_w, text_sub_h;     // 纹理大小
+
     int eof;
+    int infinite_buffer;
 
     char *filename;
     int width, height, xleft, ytop;
@@ -255,10 +356,55 @@ typedef struct VideoState {
 
     int last_video_stream, last_audio_stream, last_subtitle_stream;
 
-    SDL_cond *continue_read_thread;
+    ReadWaker continue_read; //唤醒读取线程
+
+    int eos_state;              // 播放结束状态（EOS_STATE_*）
+    int64_t last_present_time;  // 最近一次送显视频帧/音频数据的时间（微秒）
+
+    AVPacket flush_pkt;         // 本实例的清理包，跳转/切换流时放入各个队列
 } VideoState;
 
-static AVPacket flush_pkt;
+//读取线程唤醒器初始化
+static int read_waker_init(ReadWaker *w)
+{
+    memset(w, 0, sizeof(ReadWaker));
+    if (!(w->mutex = SDL_CreateMutex())) {
+        av_log(NULL, AV_LOG_FATAL, "SDL_CreateMutex(): %s\n", SDL_GetError());
+        return AVERROR(ENOMEM);
+    }
+    if (!(w->cond = SDL_CreateCond())) {
+        av_log(NULL, AV_LOG_FATAL, "SDL_CreateCond(): %s\n", SDL_GetError());
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+//读取线程唤醒器销毁
+static void read_waker_destroy(ReadWaker *w)
+{
+    SDL_DestroyMutex(w->mutex);
+    SDL_DestroyCond(w->cond);
+}
+//唤醒读取线程
+static void read_waker_signal(ReadWaker *w)
+{
+    SDL_LockMutex(w->mutex);
+    w->pending = 1;
+    SDL_CondSignal(w->cond);
+    SDL_UnlockMutex(w->mutex);
+}
+//等待唤醒，timeout_ms < 0 表示一直等待，已有挂起的唤醒时立即返回
+static void read_waker_wait(ReadWaker *w, int timeout_ms)
+{
+    SDL_LockMutex(w->mutex);
+    if (!w->pending) {
+        if (timeout_ms < 0)
+            SDL_CondWait(w->cond, w->mutex);
+        else
+            SDL_CondWaitTimeout(w->cond, w->mutex, timeout_ms);
+    }
+    w->pending = 0;
+    SDL_UnlockMutex(w->mutex);
+}
 
 //数据包队列存放数据包（供队列内部使用）
 static int packet_queue_put_private(PacketQueue *q, AVPacket *pkt)
@@ -273,7 +419,7 @@ static int packet_queue_put_private(PacketQueue *q, AVPacket *pkt)
         return -1;
     pkt1->pkt = *pkt;
     pkt1->next = NULL;
-    if (pkt == &flush_pkt)
+    if (pkt == q->flush_pkt)
         q->serial++;
     pkt1->serial = q->serial;
 
@@ -295,11 +441,11 @@ static int packet_queue_put(PacketQueue *q, AVPacket *pkt)
 {
     int ret;
 
-    SDL_LockMutex(q->mutex);
+    PROFILE_MUTEX_LOCK(q->mutex, PROFILE_LOCK_PACKET_QUEUE);
     ret = packet_queue_put_private(q, pkt);
-    SDL_UnlockMutex(q->mutex);
+    PROFILE_MUTEX_UNLOCK(q->mutex, PROFILE_LOCK_PACKET_QUEUE);
 
-    if (pkt != &flush_pkt && ret < 0)
+    if (pkt != q->flush_pkt && ret < 0)
         av_packet_unref(pkt);
 
     return ret;
@@ -318,9 +464,10 @@ static int packet_queue_put_nullpacket(PacketQueue *q, int stream_index)
 
 /* packet queue handling */
 //数据包队列初始化
-static int packet_queue_init(PacketQueue *q)
+static int packet_queue_init(PacketQueue *q, AVPacket *flush_pkt)
 {
     memset(q, 0, sizeof(PacketQueue));
+    q->flush_pkt = flush_pkt;
     q->mutex = SDL_CreateMutex();
     if (!q->mutex) {
         av_log(NULL, AV_LOG_FATAL, "SDL_CreateMutex(): %s\n", SDL_GetError());
@@ -339,7 +486,7 @@ static void packet_queue_flush(PacketQueue *q)
 {
     MyAVPacketList *pkt, *pkt1;
 
-    SDL_LockMutex(q->mutex);
+    PROFILE_MUTEX_LOCK(q->mutex, PROFILE_LOCK_PACKET_QUEUE);
     for (pkt = q->first_pkt; pkt; pkt = pkt1) {
         pkt1 = pkt->next;
         av_packet_unref(&pkt->pkt);
@@ -350,7 +497,7 @@ static void packet_queue_flush(PacketQueue *q)
     q->nb_packets = 0;
     q->size = 0;
     q->duration = 0;
-    SDL_UnlockMutex(q->mutex);
+    PROFILE_MUTEX_UNLOCK(q->mutex, PROFILE_LOCK_PACKET_QUEUE);
 }
 //数据包队列销毁
 static void packet_queue_destroy(PacketQueue *q)
@@ -362,25 +509,21 @@ static void packet_queue_destroy(PacketQueue *q)
 //数据包队列停用
 static void packet_queue_abort(PacketQueue *q)
 {
-    SDL_LockMutex(q->mutex);
+    PROFILE_MUTEX_LOCK(q->mutex, PROFILE_LOCK_PACKET_QUEUE);
 
     q->abort_request = 1;
 
     SDL_CondSignal(q->cond);
 
-    SDL_UnlockMutex(q->mutex);
+    PROFILE_MUTEX_UNLOCK(q->mutex, PROFILE_LOCK_PACKET_QUEUE);
 }
 //数据包队列开始使用
 static void packet_queue_start(PacketQueue *q)
 {
-    //初始化清理包
-    av_init_packet(&flush_pkt);
-    flush_pkt.data = (uint8_t *)&flush_pkt;
-
-    SDL_LockMutex(q->mutex);
+    PROFILE_MUTEX_LOCK(q->mutex, PROFILE_LOCK_PACKET_QUEUE);
     q->abort_request = 0;
-    packet_queue_put_private(q, &flush_pkt);
-    SDL_UnlockMutex(q->mutex);
+    packet_queue_put_private(q, q->flush_pkt);
+    PROFILE_MUTEX_UNLOCK(q->mutex, PROFILE_LOCK_PACKET_QUEUE);
 }
 
 /* return < 0 if aborted, 0 if no packet and > 0 if packet.  */
@@ -390,7 +533,7 @@ static int packet_queue_get(PacketQueue *q, AVPacket *pkt, int block, int *seria
     MyAVPacketList *pkt1;
     int ret;
 
-    SDL_LockMutex(q->mutex);
+    PROFILE_MUTEX_LOCK(q->mutex, PROFILE_LOCK_PACKET_QUEUE);
 
     for (;;) {
         if (q->abort_request) {
@@ -418,24 +561,23 @@ static int packet_queue_get(PacketQueue *q, AVPacket *pkt, int block, int *seria
             break;
         }
         else {
-            SDL_CondWait(q->cond, q->mutex);
+            PROFILE_COND_WAIT(q->cond, q->mutex, PROFILE_LOCK_PACKET_QUEUE);
         }
     }
-    SDL_UnlockMutex(q->mutex);
+    PROFILE_MUTEX_UNLOCK(q->mutex, PROFILE_LOCK_PACKET_QUEUE);
     return ret;
 }
 
 //解码器初始化（绑定解码结构体、数据包队列、信号量，初始化pts）
-static void decoder_init(Decoder *d, AVCodecContext *avctx, PacketQueue *queue, SDL_cond *empty_queue_cond) {
+static void decoder_init(Decoder *d, AVCodecContext *avctx, PacketQueue *queue, ReadWaker *empty_queue_waker) {
     memset(d, 0, sizeof(Decoder));
     d->avctx = avctx;
     d->queue = queue;
-    d->empty_queue_cond = empty_queue_cond;
+    d->empty_queue_waker = empty_queue_waker;
     d->start_pts = AV_NOPTS_VALUE;
+    d->reorder_pts = -1;
 }
 
-
-static int decoder_reorder_pts = -1;
 #if 0
 //解码一帧数据
 static int decoder_decode_frame(Decoder *d, AVFrame *frame, AVSubtitle *sub) {
@@ -451,17 +593,17 @@ static int decoder_decode_frame(Decoder *d, AVFrame *frame, AVSubtitle *sub) {
             AVPacket pkt;
             do {
                 if (d->queue->nb_packets == 0)
-                    SDL_CondSignal(d->empty_queue_cond);
+                    read_waker_signal(d->empty_queue_waker);
                 //从对应的队列中获取原始数据
                 if (packet_queue_get(d->queue, &pkt, 1, &d->pkt_serial) < 0)
                     return -1;
-                if (pkt.data == flush_pkt.data) {
+                if (pkt.data == d->queue->flush_pkt->data) {
                     avcodec_flush_buffers(d->avctx);
                     d->finished = 0;
                     d->next_pts = d->start_pts;
                     d->next_pts_tb = d->start_pts_tb;
                 }
-            } while (pkt.data == flush_pkt.data || d->queue->serial != d->pkt_serial);
+            } while (pkt.data == d->queue->flush_pkt->data || d->queue->serial != d->pkt_serial);
             av_packet_unref(&d->pkt);
             d->pkt_temp = d->pkt = pkt;
             d->packet_pending = 1;
@@ -472,10 +614,10 @@ static int decoder_decode_frame(Decoder *d, AVFrame *frame, AVSubtitle *sub) {
             //解码视频帧
             ret = avcodec_decode_video2(d->avctx, frame, &got_frame, &d->pkt_temp);
             if (got_frame) {
-                if (decoder_reorder_pts == -1) {
+                if (d->reorder_pts == -1) {
                     frame->pts = av_frame_get_best_effort_timestamp(frame);
                 }
-                else if (!decoder_reorder_pts) {
+                else if (!d->reorder_pts) {
                     frame->pts = frame->pkt_dts;
                 }
             }
@@ -542,18 +684,24 @@ static int decoder_decode_frame(Decoder *d, AVFrame *frame, AVSubtitle *sub) {
                 // 1.2. 获取解码帧
                 switch (d->avctx->codec_type) {
                 case AVMEDIA_TYPE_VIDEO:
-                    ret = avcodec_receive_frame(d->avctx, frame);
+                    {
+                        PROFILE_SCOPE(PROFILE_ZONE_DECODE_RECEIVE);
+                        ret = avcodec_receive_frame(d->avctx, frame);
+                    }
                     //printf("frame pts:%ld, dts:%ld\n", frame->pts, frame->pkt_dts);
                     if (ret >= 0) {
-                        if (decoder_reorder_pts == -1) {
+                        if (d->reorder_pts == -1) {
                             frame->pts = frame->best_effort_timestamp;
-                        } else if (!decoder_reorder_pts) {
+                        } else if (!d->reorder_pts) {
                             frame->pts = frame->pkt_dts;
                         }
                     }
                     break;
                 case AVMEDIA_TYPE_AUDIO:
-                    ret = avcodec_receive_frame(d->avctx, frame);
+                    {
+                        PROFILE_SCOPE(PROFILE_ZONE_DECODE_RECEIVE);
+                        ret = avcodec_receive_frame(d->avctx, frame);
+                    }
                     if (ret >= 0) {
                         AVRational tb = {1, frame->sample_rate};    //
                         if (frame->pts != AV_NOPTS_VALUE) {
@@ -580,6 +728,8 @@ static int decoder_decode_frame(Decoder *d, AVFrame *frame, AVSubtitle *sub) {
                     d->finished = d->pkt_serial;
                     printf("avcodec_flush_buffers %s(%d)\n", __FUNCTION__, __LINE__);
                     avcodec_flush_buffers(d->avctx);
+                    read_waker_signal(d->empty_queue_waker); // 通知read_thread解码器已排空
+
                     return 0;
                 }
                 // 1.4. 正常解码返回1
@@ -590,9 +740,9 @@ static int decoder_decode_frame(Decoder *d, AVFrame *frame, AVSubtitle *sub) {
 
         // 2 获取一个packet，如果播放序列不一致(数据不连续)则过滤掉“过时”的packet
         do {
-            // 2.1 如果没有数据可读则唤醒read_thread, 实际是continue_read_thread SDL_cond
+            // 2.1 如果没有数据可读则唤醒read_thread, 实际是continue_read唤醒器
             if (d->queue->nb_packets == 0)  // 没有数据可读
-                SDL_CondSignal(d->empty_queue_cond);// 通知read_thread放入packet
+                read_waker_signal(d->empty_queue_waker);// 通知read_thread放入packet
             // 2.2 如果还有pending的packet则使用它
             if (d->packet_pending) {
                 av_packet_move_ref(&pkt, &d->pkt);
@@ -611,13 +761,14 @@ static int decoder_decode_frame(Decoder *d, AVFrame *frame, AVSubtitle *sub) {
         } while (d->queue->serial != d->pkt_serial);// 如果不是同一播放序列(流不连续)则继续读取
 
         // 3 将packet送入解码器
-        if (pkt.data == flush_pkt.data) {//
+        if (pkt.data == d->queue->flush_pkt->data) {//
             // when seeking or when switching to a different stream
             avcodec_flush_buffers(d->avctx); //清空里面的缓存帧
             d->finished = 0;        // 重置为0
             d->next_pts = d->start_pts;     // 主要用在了audio
             d->next_pts_tb = d->start_pts_tb;// 主要用在了audio
         } else {
+            PROFILE_SCOPE(PROFILE_ZONE_DECODE_SEND);
             if (d->avctx->codec_type == AVMEDIA_TYPE_SUBTITLE) {
                 int got_frame = 0;
                 ret = avcodec_decode_subtitle2(d->avctx, sub, &got_frame, &pkt);
@@ -648,11 +799,107 @@ static void decoder_destroy(Decoder *d) {
     avcodec_free_context(&d->avctx);
 }
 
+//解码降级档位，档位越高解码越省，画质/流畅度越差
+enum {
+    DECODE_SKIP_NONE = 0,       // 完整解码
+    DECODE_SKIP_LOOP_FILTER,    // 跳过环路滤波
+    DECODE_SKIP_NONREF,         // 丢弃非参考帧
+    DECODE_SKIP_NONKEY,         // 只解码关键帧
+    DECODE_SKIP_MAX = DECODE_SKIP_NONKEY
+};
+
+//在容器索引中查找不晚于 ts 的关键帧时间戳（流时间基），没有索引时返回 AV_NOPTS_VALUE
+static int64_t index_keyframe_before(AVStream *st, int64_t ts)
+{
+    int idx;
+
+    if (st->nb_index_entries <= 0)
+        return AV_NOPTS_VALUE;
+    idx = av_index_search_timestamp(st, ts, AVSEEK_FLAG_BACKWARD);
+    if (idx < 0)
+        return AV_NOPTS_VALUE;
+    return st->index_entries[idx].timestamp;
+}
+
+//设置视频解码降级档位，下一次送包时生效
+static void decoder_set_skip_level(AVCodecContext *avctx, int level)
+{
+    avctx->skip_loop_filter = level >= DECODE_SKIP_LOOP_FILTER ? AVDISCARD_ALL : AVDISCARD_DEFAULT;
+    if (level >= DECODE_SKIP_NONKEY)
+        avctx->skip_frame = AVDISCARD_NONKEY;
+    else if (level >= DECODE_SKIP_NONREF)
+        avctx->skip_frame = AVDISCARD_NONREF;
+    else
+        avctx->skip_frame = AVDISCARD_DEFAULT;
+}
+
 static void frame_queue_unref_item(Frame *vp)
 {
+    int i;
+    for (i = 0; i < vp->nb_sub_argb; i++)
+        av_freep(&vp->sub_argb[i]);
+    av_freep(&vp->sub_argb);
+    vp->nb_sub_argb = 0;
     av_frame_unref(vp->frame);
     avsubtitle_free(&vp->sub);
 }
+
+/* 按调色板把一行PAL8索引转换为ARGB，调色板与 SDL_PIXELFORMAT_ARGB8888 同为本机字节序的 0xAARRGGBB */
+static void subtitle_palette_row(uint32_t *dst, const uint8_t *src, const uint32_t *pal, int w)
+{
+    int x = 0;
+    for (; x + 4 <= w; x += 4) {
+        dst[x]     = pal[src[x]];
+        dst[x + 1] = pal[src[x + 1]];
+        dst[x + 2] = pal[src[x + 2]];
+        dst[x + 3] = pal[src[x + 3]];
+    }
+    for (; x < w; x++)
+        dst[x] = pal[src[x]];
+}
+
+/* 在字幕线程中预先把位图字幕转换为可直接上传的ARGB像素
+ * 同时按字幕画布大小裁剪字幕矩形，渲染线程只需上传 */
+static int subtitle_rasterize(Frame *sp)
+{
+    unsigned int i;
+    int y;
+
+    if (!sp->sub.num_rects)
+        return 0;
+
+    sp->sub_argb = (uint32_t **)av_mallocz_array(sp->sub.num_rects, sizeof(*sp->sub_argb));
+    if (!sp->sub_argb)
+        return AVERROR(ENOMEM);
+    sp->nb_sub_argb = sp->sub.num_rects;
+
+    for (i = 0; i < sp->sub.num_rects; i++) {
+        AVSubtitleRect *sub_rect = sp->sub.rects[i];
+        const uint32_t *pal = (const uint32_t *)sub_rect->data[1];
+
+        sub_rect->x = av_clip(sub_rect->x, 0, sp->width);
+        sub_rect->y = av_clip(sub_rect->y, 0, sp->height);
+        sub_rect->w = av_clip(sub_rect->w, 0, sp->width - sub_rect->x);
+        sub_rect->h = av_clip(sub_rect->h, 0, sp->height - sub_rect->y);
+        if (!sub_rect->w || !sub_rect->h || !pal)
+            continue;
+
+        sp->sub_argb[i] = (uint32_t *)av_malloc((size_t)sub_rect->w * sub_rect->h * 4);
+        if (!sp->sub_argb[i])
+            return AVERROR(ENOMEM);
+        for (y = 0; y < sub_rect->h; y++)
+            subtitle_palette_row(sp->sub_argb[i] + (size_t)y * sub_rect->w,
+                                 sub_rect->data[0] + (size_t)y * sub_rect->linesize[0], pal, sub_rect->w);
+    }
+    return 0;
+}
+
+/* 矩形 a 是否完全被矩形 b 覆盖 */
+static int sub_rect_covered(const SDL_Rect *a, const SDL_Rect *b)
+{
+    return a->x >= b->x && a->y >= b->y &&
+           a->x + a->w <= b->x + b->w && a->y + a->h <= b->y + b->h;
+}
 //帧队列初始化（绑定数据包队列，初始化最大值）
 static int frame_queue_init(FrameQueue *f, PacketQueue *pktq, int max_size, int keep_last)
 {
@@ -690,9 +937,9 @@ static void frame_queue_destory(FrameQueue *f)
 //帧队列信号
 static void frame_queue_signal(FrameQueue *f)
 {
-    SDL_LockMutex(f->mutex);
+    PROFILE_MUTEX_LOCK(f->mutex, PROFILE_LOCK_FRAME_QUEUE);
     SDL_CondSignal(f->cond);
-    SDL_UnlockMutex(f->mutex);
+    PROFILE_MUTEX_UNLOCK(f->mutex, PROFILE_LOCK_FRAME_QUEUE);
 }
 
 static Frame *frame_queue_peek(FrameQueue *f)
@@ -713,12 +960,12 @@ static Frame *frame_queue_peek_last(FrameQueue *f)
 static Frame *frame_queue_peek_writable(FrameQueue *f)
 {
     /* wait until we have space to put a new frame */
-    SDL_LockMutex(f->mutex);
+    PROFILE_MUTEX_LOCK(f->mutex, PROFILE_LOCK_FRAME_QUEUE);
     while (f->size >= f->max_size &&
         !f->pktq->abort_request) {
-        SDL_CondWait(f->cond, f->mutex);
+        PROFILE_COND_WAIT(f->cond, f->mutex, PROFILE_LOCK_FRAME_QUEUE);
     }
-    SDL_UnlockMutex(f->mutex);
+    PROFILE_MUTEX_UNLOCK(f->mutex, PROFILE_LOCK_FRAME_QUEUE);
 
     if (f->pktq->abort_request)
         return NULL;
@@ -729,12 +976,12 @@ static Frame *frame_queue_peek_writable(FrameQueue *f)
 static Frame *frame_queue_peek_readable(FrameQueue *f)
 {
     /* wait until we have a readable a new frame */
-    SDL_LockMutex(f->mutex);
+    PROFILE_MUTEX_LOCK(f->mutex, PROFILE_LOCK_FRAME_QUEUE);
     while (f->size - f->rindex_shown <= 0 &&
         !f->pktq->abort_request) {
-        SDL_CondWait(f->cond, f->mutex);
+        PROFILE_COND_WAIT(f->cond, f->mutex, PROFILE_LOCK_FRAME_QUEUE);
     }
-    SDL_UnlockMutex(f->mutex);
+    PROFILE_MUTEX_UNLOCK(f->mutex, PROFILE_LOCK_FRAME_QUEUE);
 
     if (f->pktq->abort_request)
         return NULL;
@@ -746,10 +993,10 @@ static void frame_queue_push(FrameQueue *f)
 {
     if (++f->windex == f->max_size)
         f->windex = 0;
-    SDL_LockMutex(f->mutex);
+    PROFILE_MUTEX_LOCK(f->mutex, PROFILE_LOCK_FRAME_QUEUE);
     f->size++;
     SDL_CondSignal(f->cond);
-    SDL_UnlockMutex(f->mutex);
+    PROFILE_MUTEX_UNLOCK(f->mutex, PROFILE_LOCK_FRAME_QUEUE);
 }
 
 static void frame_queue_next(FrameQueue *f)
@@ -761,10 +1008,10 @@ static void frame_queue_next(FrameQueue *f)
     frame_queue_unref_item(&f->queue[f->rindex]);
     if (++f->rindex == f->max_size)
         f->rindex = 0;
-    SDL_LockMutex(f->mutex);
+    PROFILE_MUTEX_LOCK(f->mutex, PROFILE_LOCK_FRAME_QUEUE);
     f->size--;
     SDL_CondSignal(f->cond);
-    SDL_UnlockMutex(f->mutex);
+    PROFILE_MUTEX_UNLOCK(f->mutex, PROFILE_LOCK_FRAME_QUEUE);
 }
 
 /* return the number of undisplayed frames in the queue */
@@ -787,6 +1034,87 @@ static void decoder_abort(Decoder *d, FrameQueue *fq)
 {
     packet_queue_abort(d->queue);
     frame_queue_signal(fq);
-    d->decode_thread.join();
+    d->decode_task.Wait();
     packet_queue_flush(d->queue);
 }
+
+/* 输出样本乘以增益，S16/S32 饱和截断；不支持的格式返回 -1 */
+static int audio_apply_gain(uint8_t *dst, const uint8_t *src, int len, enum AVSampleFormat fmt, float gain)
+{
+    int i;
+
+    switch (fmt) {
+    case AV_SAMPLE_FMT_S16: {
+        const int16_t *in = (const int16_t *)src;
+        int16_t *out = (int16_t *)dst;
+        int64_t g = llrintf(gain * 65536);
+        for (i = 0; i < len / 2; i++)
+            out[i] = av_clip_int16((int)((in[i] * g) >> 16));
+        return 0;
+    }
+    case AV_SAMPLE_FMT_S32: {
+        const int32_t *in = (const int32_t *)src;
+        int32_t *out = (int32_t *)dst;
+        int64_t g = llrintf(gain * 65536);
+        for (i = 0; i < len / 4; i++)
+            out[i] = av_clipl_int32((in[i] * g) >> 16);
+        return 0;
+    }
+    case AV_SAMPLE_FMT_FLT: {
+        const float *in = (const float *)src;
+        float *out = (float *)dst;
+        for (i = 0; i < len / 4; i++)
+            out[i] = in[i] * gain;
+        return 0;
+    }
+    default:
+        return -1;
+    }
+}
+
+/* planar 转 packed：立体声的 16/32 位样本用 SSE2 成对交错，其余情况逐样本拷贝 */
+static void audio_interleave(uint8_t *dst, uint8_t * const *src, int nb_samples, int channels, int bytes_per_sample)
+{
+    int i = 0, ch;
+
+#if AUDIO_INTERLEAVE_SSE2
+    if (channels == 2 && bytes_per_sample == 4) {
+        const float *l = (const float *)src[0], *r = (const float *)src[1];
+        float *out = (float *)dst;
+        for (; i + 4 <= nb_samples; i += 4) {
+            __m128 a = _mm_loadu_ps(l + i);
+            __m128 b = _mm_loadu_ps(r + i);
+            _mm_storeu_ps(out + 2 * i, _mm_unpacklo_ps(a, b));
+            _mm_storeu_ps(out + 2 * i + 4, _mm_unpackhi_ps(a, b));
+        }
+    } else if (channels == 2 && bytes_per_sample == 2) {
+        const int16_t *l = (const int16_t *)src[0], *r = (const int16_t *)src[1];
+        int16_t *out = (int16_t *)dst;
+        for (; i + 8 <= nb_samples; i += 8) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(l + i));
+            __m128i b = _mm_loadu_si128((const __m128i *)(r + i));
+            _mm_storeu_si128((__m128i *)(out + 2 * i), _mm_unpacklo_epi16(a, b));
+            _mm_storeu_si128((__m128i *)(out + 2 * i + 8), _mm_unpackhi_epi16(a, b));
+        }
+    }
+#endif
+
+    // 剩余样本
+    switch (bytes_per_sample) {
+    case 2:
+        for (; i < nb_samples; i++)
+            for (ch = 0; ch < channels; ch++)
+                ((int16_t *)dst)[i * channels + ch] = ((const int16_t *)src[ch])[i];
+        break;
+    case 4:
+        for (; i < nb_samples; i++)
+            for (ch = 0; ch < channels; ch++)
+                ((int32_t *)dst)[i * channels + ch] = ((const int32_t *)src[ch])[i];
+        break;
+    default:
+        for (; i < nb_samples; i++)
+            for (ch = 0; ch < channels; ch++)
+                memcpy(dst + (i * channels + ch) * bytes_per_sample, src[ch] + i * bytes_per_sample, bytes_per_sample);
+        break;
+    }
+}
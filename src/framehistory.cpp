@@ -0,0 +1,206 @@
+﻿#include <cmath>
+
+#include "framehistory.h"
+
+#pragma execution_character_set("utf-8")
+
+// 构造函数
+FrameHistory::FrameHistory() :
+    m_nBytes(0),
+    m_nFullBytes(0),
+    m_nFull(0),
+    m_nSerial(-1),
+    m_pSwsCtx(NULL)
+{
+}
+
+// 析构函数
+FrameHistory::~FrameHistory()
+{
+    Clear();
+    sws_freeContext(m_pSwsCtx);
+}
+
+/* 加入一帧：超出原始分辨率的额度时缩小最早的原始帧，超出总额度时淘汰最早的帧 */
+void FrameHistory::Push(const AVFrame *frame, double pts, double duration, int serial)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (serial != m_nSerial) {
+        for (Entry &entry : m_deqEntries)
+            FreeEntry(entry);
+        m_deqEntries.clear();
+        m_nBytes = m_nFullBytes = m_nFull = 0;
+        m_nSerial = serial;
+    }
+    // 时间戳无效或不递增（如 B 帧排序异常）时无法按时间查找，直接丢弃
+    if (std::isnan(pts) || (!m_deqEntries.empty() && pts <= m_deqEntries.back().pts))
+        return;
+
+    Entry entry;
+    entry.frame = av_frame_alloc();
+    if (!entry.frame || av_frame_ref(entry.frame, frame) < 0) {
+        av_frame_free(&entry.frame);
+        return;
+    }
+    entry.pts = pts;
+    entry.duration = duration;
+    entry.bytes = FrameBytes(entry.frame);
+    entry.small = false;
+    m_deqEntries.push_back(entry);
+    m_nBytes += entry.bytes;
+    m_nFullBytes += entry.bytes;
+    m_nFull++;
+
+    // 原始分辨率的帧位于队尾，从其中最早的一帧开始缩小
+    while (m_nFullBytes > FRAME_HISTORY_FULL_BUDGET && m_nFull > 1) {
+        Entry &oldest = m_deqEntries[m_deqEntries.size() - m_nFull];
+        size_t nOld = oldest.bytes;
+        m_nFullBytes -= nOld;
+        m_nFull--;
+        if (Shrink(oldest) < 0) {
+            // 转换失败时保留原始帧，只是不再计入原始分辨率的额度
+            continue;
+        }
+        m_nBytes = m_nBytes - nOld + oldest.bytes;
+    }
+
+    while (m_deqEntries.size() > 1 &&
+           (m_nBytes > FRAME_HISTORY_BUDGET ||
+            m_deqEntries.back().pts - m_deqEntries.front().pts > FRAME_HISTORY_MAX_SECONDS)) {
+        Entry &front = m_deqEntries.front();
+        m_nBytes -= front.bytes;
+        if (!front.small && m_deqEntries.size() <= m_nFull) {
+            m_nFullBytes -= front.bytes;
+            m_nFull--;
+        }
+        FreeEntry(front);
+        m_deqEntries.pop_front();
+    }
+}
+
+void FrameHistory::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (Entry &entry : m_deqEntries)
+        FreeEntry(entry);
+    m_deqEntries.clear();
+    m_nBytes = m_nFullBytes = m_nFull = 0;
+    m_nSerial = -1;
+}
+
+bool FrameHistory::Covers(double dPts, int serial)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return serial == m_nSerial && !m_deqEntries.empty() &&
+            dPts >= m_deqEntries.front().pts && dPts < m_deqEntries.back().pts;
+}
+
+double FrameHistory::PtsAtOrBefore(double dPts)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto it = m_deqEntries.rbegin(); it != m_deqEntries.rend(); ++it) {
+        if (it->pts <= dPts)
+            return it->pts;
+    }
+    return NAN;
+}
+
+double FrameHistory::PtsBefore(double dPts, int serial)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (serial != m_nSerial)
+        return NAN;
+    // 允许 1ms 的误差，显示时钟由帧时间换算而来
+    for (auto it = m_deqEntries.rbegin(); it != m_deqEntries.rend(); ++it) {
+        if (it->pts < dPts - 0.001)
+            return it->pts;
+    }
+    return NAN;
+}
+
+int FrameHistory::Get(double dPts, AVFrame *frame, double *pPts, double *pDuration)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (const Entry &entry : m_deqEntries) {
+        if (entry.pts >= dPts) {
+            int ret = av_frame_ref(frame, entry.frame);
+            if (ret < 0)
+                return ret;
+            *pPts = entry.pts;
+            *pDuration = entry.duration;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* 转换为缩小的 YUV420P 帧，释放解码器的缓冲 */
+int FrameHistory::Shrink(Entry &entry)
+{
+    AVFrame *src = entry.frame;
+    AVFrame *dst;
+    int nScale = 1;
+    int ret;
+
+    // 音频帧没有画面，保持原样
+    if (!src->width || !src->height)
+        return AVERROR(EINVAL);
+
+    while ((int64_t)(src->width / nScale) * (src->height / nScale) > FRAME_HISTORY_SMALL_PIXELS)
+        nScale *= 2;
+
+    dst = av_frame_alloc();
+    if (!dst)
+        return AVERROR(ENOMEM);
+    dst->format = AV_PIX_FMT_YUV420P;
+    dst->width = FFMAX(src->width / nScale, 2) & ~1;
+    dst->height = FFMAX(src->height / nScale, 2) & ~1;
+    ret = av_frame_get_buffer(dst, 32);
+    if (ret >= 0) {
+        m_pSwsCtx = sws_getCachedContext(m_pSwsCtx, src->width, src->height, (AVPixelFormat)src->format,
+                                         dst->width, dst->height, AV_PIX_FMT_YUV420P,
+                                         SWS_FAST_BILINEAR, NULL, NULL, NULL);
+        if (!m_pSwsCtx)
+            ret = AVERROR(EINVAL);
+        else
+            sws_scale(m_pSwsCtx, src->data, src->linesize, 0, src->height, dst->data, dst->linesize);
+    }
+    if (ret >= 0)
+        ret = av_frame_copy_props(dst, src);
+    if (ret < 0) {
+        av_frame_free(&dst);
+        return ret;
+    }
+    // 缩小后保持原来的显示宽高比
+    dst->sample_aspect_ratio = av_mul_q(src->sample_aspect_ratio.num ? src->sample_aspect_ratio : AVRational{ 1, 1 },
+                                        { src->width * dst->height, src->height * dst->width });
+
+    av_frame_free(&entry.frame);
+    entry.frame = dst;
+    entry.bytes = FrameBytes(dst);
+    entry.small = true;
+    return 0;
+}
+
+void FrameHistory::FreeEntry(Entry &entry)
+{
+    av_frame_free(&entry.frame);
+}
+
+/* 帧引用的缓冲总大小 */
+size_t FrameHistory::FrameBytes(const AVFrame *frame)
+{
+    size_t nBytes = 0;
+
+    for (int i = 0; i < AV_NUM_DATA_POINTERS && frame->buf[i]; i++)
+        nBytes += frame->buf[i]->size;
+    if (!nBytes)
+        nBytes = av_image_get_buffer_size((AVPixelFormat)frame->format, frame->width, frame->height, 1);
+    return nBytes;
+}
@@ -0,0 +1,101 @@
+﻿#ifndef FRAMEHISTORY_H
+#define FRAMEHISTORY_H
+
+#include <deque>
+#include <mutex>
+
+#include "globalhelper.h"
+
+#define FRAME_HISTORY_BUDGET (256 * 1024 * 1024)        // 历史帧的内存总上限
+#define FRAME_HISTORY_FULL_BUDGET (64 * 1024 * 1024)    // 其中保留原始分辨率的最近帧的上限
+#define FRAME_HISTORY_SMALL_PIXELS (960 * 544)          // 较早的帧缩小到不超过该像素数
+#define FRAME_HISTORY_MAX_SECONDS 15.0                  // 最多保留的时长（秒）
+
+/**
+ * @brief	最近解码的视频帧历史
+ *
+ * 视频线程把解码出的每一帧加入历史（引用解码器的缓冲，不复制），
+ * 最近的帧保持原始分辨率，超过 FRAME_HISTORY_FULL_BUDGET 后较早的帧转换为
+ * 缩小的 YUV420P，总量超过 FRAME_HISTORY_BUDGET 或 FRAME_HISTORY_MAX_SECONDS 时淘汰最早的帧。
+ * 序列号变化（seek）时清空。后退一帧、小范围后退时直接从历史中取帧显示。
+ * 音频回调用另一个实例记录播放过的音频帧，后退时音频同样从历史中重放；音频帧不缩小。
+ */
+class FrameHistory
+{
+public:
+    FrameHistory();
+    ~FrameHistory();
+
+    /**
+     * @brief	加入一帧
+     *
+     * @param	frame 解码帧，只增加引用
+     * @param	pts 显示时间（秒）
+     * @param	duration 帧时长（秒）
+     * @param	serial 包队列序列号，与已有的帧不同时先清空
+     */
+    void Push(const AVFrame *frame, double pts, double duration, int serial);
+
+    /**
+     * @brief	清空历史
+     */
+    void Clear();
+
+    /**
+     * @brief	历史能否从指定位置开始播放
+     *
+     * @param	dPts 目标位置（秒）
+     * @param	serial 当前包队列序列号
+     * @return	目标位置在最早的帧和最新的帧之间时返回 true
+     */
+    bool Covers(double dPts, int serial);
+
+    /**
+     * @brief	不晚于指定位置的最后一帧的时间
+     *
+     * @return	没有这样的帧时返回 NAN
+     */
+    double PtsAtOrBefore(double dPts);
+
+    /**
+     * @brief	早于指定位置的最后一帧的时间，用于后退一帧
+     *
+     * @return	没有这样的帧时返回 NAN
+     */
+    double PtsBefore(double dPts, int serial);
+
+    /**
+     * @brief	取出不早于指定位置的第一帧
+     *
+     * @param	dPts 位置（秒）
+     * @param	frame 输出帧（新的引用）
+     * @param	pPts 帧的显示时间
+     * @param	pDuration 帧时长
+     * @return	1 取得一帧 0 已超出最新的帧 <0 错误
+     */
+    int Get(double dPts, AVFrame *frame, double *pPts, double *pDuration);
+
+private:
+    struct Entry {
+        AVFrame *frame;
+        double pts;
+        double duration;
+        size_t bytes;
+        bool small;     ///< 已缩小分辨率
+    };
+
+    int Shrink(Entry &entry);
+    void FreeEntry(Entry &entry);
+    static size_t FrameBytes(const AVFrame *frame);
+
+private:
+    std::mutex m_mutex;
+    std::deque<Entry> m_deqEntries;     ///< 按显示时间升序
+    size_t m_nBytes;
+    size_t m_nFullBytes;                ///< 原始分辨率帧占用的内存
+    size_t m_nFull;                     ///< 原始分辨率帧的个数（位于队尾）
+    int m_nSerial;
+    struct SwsContext *m_pSwsCtx;
+};
+
+#endif // FRAMEHISTORY_H
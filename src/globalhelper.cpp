@@ -90,6 +90,118 @@ void GlobalHelper::GetPlayVolume(double& nVolume)
     nVolume = settings.value("volume/size", nVolume).toDouble(); // 将读取的值转换为双精度浮点数并赋值
 }
 
+// 保存播放结束动作到配置文件
+void GlobalHelper::SavePlayEndAction(int nAction)
+{
+    QString strPlayerConfigFileName = PLAYER_CONFIG_BASEDIR + QDir::separator() + PLAYER_CONFIG; // 配置文件路径
+    QSettings settings(strPlayerConfigFileName, QSettings::IniFormat); // 使用INI格式的QSettings对象
+    settings.setValue("play/end_action", nAction); // 保存播放结束动作
+}
+
+// 从配置文件读取播放结束动作，默认为停止
+int GlobalHelper::GetPlayEndAction()
+{
+    QString strPlayerConfigFileName = PLAYER_CONFIG_BASEDIR + QDir::separator() + PLAYER_CONFIG; // 配置文件路径
+    QSettings settings(strPlayerConfigFileName, QSettings::IniFormat); // 使用INI格式的QSettings对象
+    return settings.value("play/end_action", 0).toInt();
+}
+
+// 保存响度标准化开关到配置文件
+void GlobalHelper::SaveLoudnessNormalization(bool bEnable)
+{
+    QString strPlayerConfigFileName = PLAYER_CONFIG_BASEDIR + QDir::separator() + PLAYER_CONFIG; // 配置文件路径
+    QSettings settings(strPlayerConfigFileName, QSettings::IniFormat); // 使用INI格式的QSettings对象
+    settings.setValue("volume/loudness_normalization", bEnable); // 保存响度标准化开关
+}
+
+// 从配置文件读取响度标准化开关，默认关闭
+bool GlobalHelper::GetLoudnessNormalization()
+{
+    QString strPlayerConfigFileName = PLAYER_CONFIG_BASEDIR + QDir::separator() + PLAYER_CONFIG; // 配置文件路径
+    QSettings settings(strPlayerConfigFileName, QSettings::IniFormat); // 使用INI格式的QSettings对象
+    return settings.value("volume/loudness_normalization", false).toBool();
+}
+
+// 保存重采样质量到配置文件
+void GlobalHelper::SaveResamplerMode(int nMode)
+{
+    QString strPlayerConfigFileName = PLAYER_CONFIG_BASEDIR + QDir::separator() + PLAYER_CONFIG; // 配置文件路径
+    QSettings settings(strPlayerConfigFileName, QSettings::IniFormat); // 使用INI格式的QSettings对象
+    settings.setValue("volume/resampler_mode", nMode); // 保存重采样质量
+}
+
+// 从配置文件读取重采样质量，默认自动
+int GlobalHelper::GetResamplerMode()
+{
+    QString strPlayerConfigFileName = PLAYER_CONFIG_BASEDIR + QDir::separator() + PLAYER_CONFIG; // 配置文件路径
+    QSettings settings(strPlayerConfigFileName, QSettings::IniFormat); // 使用INI格式的QSettings对象
+    return settings.value("volume/resampler_mode", 0).toInt();
+}
+
+// 保存直播低延迟模式开关到配置文件
+void GlobalHelper::SaveLiveMode(bool bEnable)
+{
+    QString strPlayerConfigFileName = PLAYER_CONFIG_BASEDIR + QDir::separator() + PLAYER_CONFIG; // 配置文件路径
+    QSettings settings(strPlayerConfigFileName, QSettings::IniFormat); // 使用INI格式的QSettings对象
+    settings.setValue("live/mode", bEnable); // 保存直播低延迟模式开关
+}
+
+// 从配置文件读取直播低延迟模式开关，默认关闭
+bool GlobalHelper::GetLiveMode()
+{
+    QString strPlayerConfigFileName = PLAYER_CONFIG_BASEDIR + QDir::separator() + PLAYER_CONFIG; // 配置文件路径
+    QSettings settings(strPlayerConfigFileName, QSettings::IniFormat); // 使用INI格式的QSettings对象
+    return settings.value("live/mode", false).toBool();
+}
+
+// 保存直播目标延迟到配置文件
+void GlobalHelper::SaveLiveTargetLatency(double dSeconds)
+{
+    QString strPlayerConfigFileName = PLAYER_CONFIG_BASEDIR + QDir::separator() + PLAYER_CONFIG; // 配置文件路径
+    QSettings settings(strPlayerConfigFileName, QSettings::IniFormat); // 使用INI格式的QSettings对象
+    settings.setValue("live/target_latency", dSeconds); // 保存直播目标延迟
+}
+
+// 从配置文件读取直播目标延迟（秒），默认1秒
+double GlobalHelper::GetLiveTargetLatency()
+{
+    QString strPlayerConfigFileName = PLAYER_CONFIG_BASEDIR + QDir::separator() + PLAYER_CONFIG; // 配置文件路径
+    QSettings settings(strPlayerConfigFileName, QSettings::IniFormat); // 使用INI格式的QSettings对象
+    return settings.value("live/target_latency", 1.0).toDouble();
+}
+
+// 保存直播时移开关到配置文件
+void GlobalHelper::SaveTimeshift(bool bEnable)
+{
+    QString strPlayerConfigFileName = PLAYER_CONFIG_BASEDIR + QDir::separator() + PLAYER_CONFIG; // 配置文件路径
+    QSettings settings(strPlayerConfigFileName, QSettings::IniFormat); // 使用INI格式的QSettings对象
+    settings.setValue("live/timeshift", bEnable); // 保存直播时移开关
+}
+
+// 从配置文件读取直播时移开关，默认关闭
+bool GlobalHelper::GetTimeshift()
+{
+    QString strPlayerConfigFileName = PLAYER_CONFIG_BASEDIR + QDir::separator() + PLAYER_CONFIG; // 配置文件路径
+    QSettings settings(strPlayerConfigFileName, QSettings::IniFormat); // 使用INI格式的QSettings对象
+    return settings.value("live/timeshift", false).toBool();
+}
+
+// 保存时移窗口到配置文件
+void GlobalHelper::SaveTimeshiftWindow(double dSeconds)
+{
+    QString strPlayerConfigFileName = PLAYER_CONFIG_BASEDIR + QDir::separator() + PLAYER_CONFIG; // 配置文件路径
+    QSettings settings(strPlayerConfigFileName, QSettings::IniFormat); // 使用INI格式的QSettings对象
+    settings.setValue("live/timeshift_window", dSeconds); // 保存时移窗口
+}
+
+// 从配置文件读取时移窗口（秒），默认2小时
+double GlobalHelper::GetTimeshiftWindow()
+{
+    QString strPlayerConfigFileName = PLAYER_CONFIG_BASEDIR + QDir::separator() + PLAYER_CONFIG; // 配置文件路径
+    QSettings settings(strPlayerConfigFileName, QSettings::IniFormat); // 使用INI格式的QSettings对象
+    return settings.value("live/timeshift_window", 7200.0).toDouble();
+}
+
 // 获取应用版本号
 QString GlobalHelper::GetAppVersion()
 {
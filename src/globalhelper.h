@@ -43,6 +43,20 @@ public:
     static void GetPlaylist(QStringList& playList);     // 获取播放列表
     static void SavePlayVolume(double& nVolume);        // 保存音量
     static void GetPlayVolume(double& nVolume);         // 获取音量
+    static void SavePlayEndAction(int nAction);         // 保存播放结束动作
+    static int GetPlayEndAction();                      // 获取播放结束动作
+    static void SaveLoudnessNormalization(bool bEnable);// 保存响度标准化开关
+    static bool GetLoudnessNormalization();             // 获取响度标准化开关
+    static void SaveResamplerMode(int nMode);           // 保存重采样质量
+    static int GetResamplerMode();                      // 获取重采样质量
+    static void SaveLiveMode(bool bEnable);             // 保存直播低延迟模式开关
+    static bool GetLiveMode();                          // 获取直播低延迟模式开关
+    static void SaveLiveTargetLatency(double dSeconds); // 保存直播目标延迟
+    static double GetLiveTargetLatency();               // 获取直播目标延迟
+    static void SaveTimeshift(bool bEnable);            // 保存直播时移开关
+    static bool GetTimeshift();                         // 获取直播时移开关
+    static void SaveTimeshiftWindow(double dSeconds);   // 保存时移窗口
+    static double GetTimeshiftWindow();                 // 获取时移窗口
 
     static QString GetAppVersion();
 };
@@ -0,0 +1,363 @@
+﻿#include <algorithm>
+#include <chrono>
+
+#include "gopcache.h"
+
+#pragma execution_character_set("utf-8")
+
+// 构造函数
+GopCache::GopCache(TaskExecutor *pExecutor) :
+    m_pExecutor(pExecutor ? pExecutor : TaskExecutor::Shared()),
+    m_pFormatCtx(NULL),
+    m_pCodecCtx(NULL),
+    m_pSwsCtx(NULL),
+    m_pStream(NULL),
+    m_nStreamIndex(-1),
+    m_nScale(1),
+    m_nGopBudget(GOP_CACHE_BUDGET / 2),
+    m_bNextReady(false),
+    m_bDecoding(false),
+    m_bBegin(false),
+    m_nError(0),
+    m_nGeneration(0),
+    m_bAbort(false)
+{
+    m_stCurrent.start = m_stNext.start = AV_NOPTS_VALUE;
+    m_stCurrent.bytes = m_stNext.bytes = 0;
+}
+
+// 析构函数
+GopCache::~GopCache()
+{
+    Stop();
+    sws_freeContext(m_pSwsCtx);
+    avcodec_free_context(&m_pCodecCtx);
+    avformat_close_input(&m_pFormatCtx);
+}
+
+/* 打开视频流并按分辨率和GOP长度确定缓存帧的缩小倍数 */
+int GopCache::Open(const char *filename, int nStreamIndex)
+{
+    AVCodec *codec;
+    AVDictionary *opts = NULL;
+    int ret;
+
+    m_pFormatCtx = avformat_alloc_context();
+    if (!m_pFormatCtx)
+        return AVERROR(ENOMEM);
+    m_pFormatCtx->interrupt_callback.callback = InterruptCallback;
+    m_pFormatCtx->interrupt_callback.opaque = this;
+
+    if ((ret = avformat_open_input(&m_pFormatCtx, filename, NULL, NULL)) < 0)
+        return ret;
+    if ((ret = avformat_find_stream_info(m_pFormatCtx, NULL)) < 0)
+        return ret;
+    if (nStreamIndex < 0 || nStreamIndex >= (int)m_pFormatCtx->nb_streams)
+        return AVERROR(EINVAL);
+
+    for (unsigned int i = 0; i < m_pFormatCtx->nb_streams; i++)
+        m_pFormatCtx->streams[i]->discard = (int)i == nStreamIndex ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+    m_nStreamIndex = nStreamIndex;
+    m_pStream = m_pFormatCtx->streams[nStreamIndex];
+
+    codec = avcodec_find_decoder(m_pStream->codecpar->codec_id);
+    if (!codec)
+        return AVERROR_DECODER_NOT_FOUND;
+    m_pCodecCtx = avcodec_alloc_context3(codec);
+    if (!m_pCodecCtx)
+        return AVERROR(ENOMEM);
+    if ((ret = avcodec_parameters_to_context(m_pCodecCtx, m_pStream->codecpar)) < 0)
+        return ret;
+    m_pCodecCtx->pkt_timebase = m_pStream->time_base;
+    av_dict_set(&opts, "threads", "auto", 0);
+    ret = avcodec_open2(m_pCodecCtx, codec, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+
+    // 单个GOP的帧放不下时缩小分辨率，4K等高分辨率内容至少缩小一半
+    int w = m_pStream->codecpar->width, h = m_pStream->codecpar->height;
+    int64_t nGopFrames = EstimateGopFrames();
+    m_nGopBudget = GOP_CACHE_BUDGET / 2;
+    m_nScale = 1;
+    while (m_nScale < GOP_CACHE_MAX_SCALE) {
+        int sw = w / m_nScale, sh = h / m_nScale;
+        int64_t nFrameBytes = av_image_get_buffer_size(AV_PIX_FMT_YUV420P, FFMAX(sw, 1), FFMAX(sh, 1), 1);
+        if ((int64_t)sw * sh <= GOP_CACHE_MAX_PIXELS && nFrameBytes * nGopFrames <= (int64_t)m_nGopBudget)
+            break;
+        m_nScale *= 2;
+    }
+    av_log(NULL, AV_LOG_VERBOSE, "gop cache: %dx%d, ~%" PRId64 " frames per gop, scale 1/%d\n",
+           w, h, nGopFrames, m_nScale);
+    return 0;
+}
+
+/* 从指定位置开始倒序输出 */
+void GopCache::Start(double dPos)
+{
+    Stop();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bAbort = false;
+    int64_t nEnd = av_rescale_q((int64_t)(dPos * AV_TIME_BASE), AV_TIME_BASE_Q, m_pStream->time_base);
+    SubmitDecode(nEnd, m_nGeneration);
+}
+
+/* 停止预取并释放缓存的帧 */
+void GopCache::Stop()
+{
+    TaskHandle stTask;
+
+    // 置位后 Take 不再提交预取，取到的句柄就是最后一个任务
+    m_bAbort = true;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        stTask = m_stTask;
+    }
+    stTask.Wait();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_nGeneration++;
+    FreeGop(m_stCurrent);
+    FreeGop(m_stNext);
+    m_bNextReady = false;
+    m_bDecoding = false;
+    m_bBegin = false;
+    m_nError = 0;
+    m_cond.notify_all();
+}
+
+/* 取出下一帧：当前GOP取完时换上预取的GOP，并开始预取再前一个GOP */
+int GopCache::Take(AVFrame *frame, int nTimeoutMs)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(nTimeoutMs);
+
+    for (;;) {
+        if (!m_stCurrent.frames.empty()) {
+            AVFrame *cached = m_stCurrent.frames.back();
+            m_stCurrent.frames.pop_back();
+            av_frame_move_ref(frame, cached);
+            av_frame_free(&cached);
+            frame->pts = av_rescale_q(frame->pts, m_pStream->time_base, AV_TIME_BASE_Q);
+            return 1;
+        }
+        if (m_bNextReady) {
+            FreeGop(m_stCurrent);
+            std::swap(m_stCurrent, m_stNext);
+            m_bNextReady = false;
+            if (!m_bBegin && !m_bDecoding && !m_bAbort)
+                SubmitDecode(m_stCurrent.start, m_nGeneration);
+            continue;
+        }
+        if (m_nError < 0)
+            return m_nError;
+        if (m_bBegin && !m_bDecoding)
+            return AVERROR_EOF;
+        if (m_cond.wait_until(lock, deadline) == std::cv_status::timeout)
+            return 0;
+    }
+}
+
+/* 在视频通道中解码结束于 nEnd 的GOP，调用时持有 m_mutex */
+void GopCache::SubmitDecode(int64_t nEnd, int nGeneration)
+{
+    m_bDecoding = true;
+    m_stTask = m_pExecutor->Submit(TASK_LANE_VIDEO, [this, nEnd, nGeneration] {
+        Gop gop;
+        gop.start = AV_NOPTS_VALUE;
+        gop.bytes = 0;
+        int ret = DecodeGop(nEnd, gop);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bDecoding = false;
+        if (nGeneration != m_nGeneration) {
+            FreeGop(gop);
+        } else if (ret == AVERROR_EOF) {
+            // 结束位置之前已没有关键帧，到达文件开头
+            FreeGop(gop);
+            m_bBegin = true;
+        } else if (ret < 0) {
+            FreeGop(gop);
+            m_nError = ret;
+        } else {
+            m_stNext = gop;
+            m_bNextReady = true;
+        }
+        m_cond.notify_all();
+    });
+}
+
+/* 跳转到 nEnd 之前最近的关键帧，正向解码到 nEnd 为止 */
+int GopCache::DecodeGop(int64_t nEnd, Gop &gop)
+{
+    AVPacket *pkt = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    int nStride = 1, nDecoded = 0, done = 0, ret;
+
+    if (!pkt || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    avcodec_flush_buffers(m_pCodecCtx);
+    ret = avformat_seek_file(m_pFormatCtx, m_nStreamIndex, INT64_MIN, nEnd - 1, nEnd - 1, 0);
+    if (ret < 0) {
+        ret = AVERROR_EOF;
+        goto fail;
+    }
+
+    for (int i = 0; i < GOP_CACHE_MAX_PACKETS && !done && !m_bAbort; i++) {
+        ret = av_read_frame(m_pFormatCtx, pkt);
+        if (ret < 0) {
+            // 文件结束，取出解码器中剩余的帧
+            avcodec_send_packet(m_pCodecCtx, NULL);
+            done = 1;
+        } else if (pkt->stream_index != m_nStreamIndex) {
+            av_packet_unref(pkt);
+            continue;
+        } else {
+            if (gop.start == AV_NOPTS_VALUE) {
+                // 从关键帧开始，关键帧不早于结束位置说明前面已没有GOP
+                if (!(pkt->flags & AV_PKT_FLAG_KEY)) {
+                    av_packet_unref(pkt);
+                    continue;
+                }
+                gop.start = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+                if (gop.start == AV_NOPTS_VALUE || gop.start >= nEnd) {
+                    av_packet_unref(pkt);
+                    ret = AVERROR_EOF;
+                    goto fail;
+                }
+            }
+            avcodec_send_packet(m_pCodecCtx, pkt);
+            av_packet_unref(pkt);
+        }
+
+        while (avcodec_receive_frame(m_pCodecCtx, frame) >= 0) {
+            int64_t pts = frame->best_effort_timestamp;
+            if (pts != AV_NOPTS_VALUE && pts >= nEnd)
+                done = 1;
+            else if (pts != AV_NOPTS_VALUE && pts >= gop.start && (ret = CacheFrame(frame, gop, nStride, nDecoded)) < 0)
+                goto fail;
+            av_frame_unref(frame);
+        }
+    }
+
+    if (m_bAbort) {
+        ret = AVERROR_EXIT;
+        goto fail;
+    }
+    if (gop.start == AV_NOPTS_VALUE) {
+        ret = AVERROR_EOF;
+        goto fail;
+    }
+
+    std::sort(gop.frames.begin(), gop.frames.end(), [](const AVFrame *a, const AVFrame *b) {
+        return a->pts < b->pts;
+    });
+    ret = 0;
+
+fail:
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+    return ret;
+}
+
+/* 保存一帧，需要时缩小分辨率；超过内存上限时隔帧丢弃已缓存的帧 */
+int GopCache::CacheFrame(AVFrame *frame, Gop &gop, int &nStride, int &nDecoded)
+{
+    AVFrame *cached;
+    int ret;
+
+    if (nDecoded++ % nStride)
+        return 0;
+
+    cached = av_frame_alloc();
+    if (!cached)
+        return AVERROR(ENOMEM);
+
+    if (m_nScale == 1) {
+        ret = av_frame_ref(cached, frame);
+    } else {
+        cached->format = AV_PIX_FMT_YUV420P;
+        cached->width = FFMAX(frame->width / m_nScale, 2) & ~1;
+        cached->height = FFMAX(frame->height / m_nScale, 2) & ~1;
+        ret = av_frame_get_buffer(cached, 32);
+        if (ret >= 0) {
+            m_pSwsCtx = sws_getCachedContext(m_pSwsCtx, frame->width, frame->height, (AVPixelFormat)frame->format,
+                                             cached->width, cached->height, AV_PIX_FMT_YUV420P,
+                                             SWS_FAST_BILINEAR, NULL, NULL, NULL);
+            if (!m_pSwsCtx)
+                ret = AVERROR(EINVAL);
+            else
+                sws_scale(m_pSwsCtx, frame->data, frame->linesize, 0, frame->height, cached->data, cached->linesize);
+        }
+        if (ret >= 0)
+            ret = av_frame_copy_props(cached, frame);
+    }
+    if (ret < 0) {
+        av_frame_free(&cached);
+        return ret;
+    }
+
+    cached->pts = frame->best_effort_timestamp;
+    gop.frames.push_back(cached);
+    gop.bytes += av_image_get_buffer_size((AVPixelFormat)cached->format, cached->width, cached->height, 1);
+
+    while (gop.bytes > m_nGopBudget && gop.frames.size() > 1) {
+        size_t nKeep = 0;
+        gop.bytes = 0;
+        for (size_t i = 0; i < gop.frames.size(); i++) {
+            if (i % 2) {
+                av_frame_free(&gop.frames[i]);
+            } else {
+                gop.bytes += av_image_get_buffer_size((AVPixelFormat)gop.frames[i]->format,
+                                                      gop.frames[i]->width, gop.frames[i]->height, 1);
+                gop.frames[nKeep++] = gop.frames[i];
+            }
+        }
+        gop.frames.resize(nKeep);
+        nStride *= 2;
+    }
+    return 0;
+}
+
+void GopCache::FreeGop(Gop &gop)
+{
+    for (AVFrame *&frame : gop.frames)
+        av_frame_free(&frame);
+    gop.frames.clear();
+    gop.start = AV_NOPTS_VALUE;
+    gop.bytes = 0;
+}
+
+/* 由索引中的关键帧间隔估计每个GOP的帧数 */
+int GopCache::EstimateGopFrames()
+{
+    AVRational frame_rate = av_guess_frame_rate(m_pFormatCtx, m_pStream, NULL);
+    double fps = frame_rate.num && frame_rate.den ? av_q2d(frame_rate) : 25.0;
+    double gop_seconds = GOP_CACHE_DEFAULT_GOP;
+    int nKeyframes = 0;
+    int64_t first = AV_NOPTS_VALUE, last = AV_NOPTS_VALUE;
+
+    for (int i = 0; i < m_pStream->nb_index_entries; i++) {
+        const AVIndexEntry *entry = &m_pStream->index_entries[i];
+        if (!(entry->flags & AVINDEX_KEYFRAME))
+            continue;
+        if (first == AV_NOPTS_VALUE)
+            first = entry->timestamp;
+        last = entry->timestamp;
+        nKeyframes++;
+    }
+    if (nKeyframes > 1 && last > first)
+        gop_seconds = (last - first) * av_q2d(m_pStream->time_base) / (nKeyframes - 1);
+
+    return FFMAX(1, (int)(gop_seconds * fps + 0.5));
+}
+
+int GopCache::InterruptCallback(void *ctx)
+{
+    GopCache *pCache = (GopCache *)ctx;
+    return pCache->m_bAbort;
+}
@@ -0,0 +1,101 @@
+﻿#ifndef GOPCACHE_H
+#define GOPCACHE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "globalhelper.h"
+#include "taskexecutor.h"
+
+#define GOP_CACHE_BUDGET (256 * 1024 * 1024)    // 当前GOP与预取GOP的解码帧内存总上限
+#define GOP_CACHE_MAX_PIXELS (1920 * 1088)      // 超过该像素数（如4K）时缓存缩小分辨率的帧
+#define GOP_CACHE_MAX_SCALE 8                   // 最多缩小到 1/8
+#define GOP_CACHE_MAX_PACKETS 4000              // 解码一个GOP最多读取的包数
+#define GOP_CACHE_DEFAULT_GOP 2.0               // 无法从索引估计时假定的GOP时长（秒）
+
+/**
+ * @brief	倒放用的GOP缓存
+ *
+ * 使用独立的解复用器和解码器，从给定位置向前逐个GOP解码：
+ * 跳转到不晚于上一个GOP起点的关键帧，正向解码到上一个GOP起点为止，
+ * 解码帧放入缓存后按时间倒序取出。取出当前GOP的同时在执行器的视频通道中
+ * 预取再前一个GOP。两个GOP的帧内存合计不超过 GOP_CACHE_BUDGET，
+ * 分辨率过高（如4K）或GOP过长时缓存缩小分辨率的帧，仍超出时隔帧丢弃。
+ */
+class GopCache
+{
+public:
+    explicit GopCache(TaskExecutor *pExecutor);
+    ~GopCache();
+
+    /**
+     * @brief	打开文件的视频流
+     *
+     * @param	filename 媒体文件
+     * @param	nStreamIndex 视频流序号
+     * @return	0 成功 <0 失败
+     */
+    int Open(const char *filename, int nStreamIndex);
+
+    /**
+     * @brief	从指定位置开始倒序输出，之前缓存的帧全部丢弃
+     *
+     * @param	dPos 起始位置（秒），只输出时间戳小于该位置的帧
+     */
+    void Start(double dPos);
+
+    /**
+     * @brief	停止预取并释放缓存的帧
+     */
+    void Stop();
+
+    /**
+     * @brief	按时间倒序取出下一帧
+     *
+     * @param	frame 输出帧，pts 为秒数乘以 AV_TIME_BASE
+     * @param	nTimeoutMs 没有可用帧时的最长等待时间
+     * @return	1 取得一帧 0 超时 AVERROR_EOF 已到文件开头 <0 错误
+     */
+    int Take(AVFrame *frame, int nTimeoutMs);
+
+private:
+    //一个GOP的解码帧，按时间戳升序
+    struct Gop {
+        std::vector<AVFrame *> frames;
+        int64_t start;      ///< 关键帧时间戳（流时间基）
+        size_t bytes;
+    };
+
+    void SubmitDecode(int64_t nEnd, int nGeneration);
+    int DecodeGop(int64_t nEnd, Gop &gop);
+    int CacheFrame(AVFrame *frame, Gop &gop, int &nStride, int &nDecoded);
+    void FreeGop(Gop &gop);
+    int EstimateGopFrames();
+    static int InterruptCallback(void *ctx);
+
+private:
+    TaskExecutor *m_pExecutor;
+    AVFormatContext *m_pFormatCtx;
+    AVCodecContext *m_pCodecCtx;
+    struct SwsContext *m_pSwsCtx;
+    AVStream *m_pStream;
+    int m_nStreamIndex;
+    int m_nScale;           ///< 缓存帧的缩小倍数
+    size_t m_nGopBudget;    ///< 单个GOP的内存上限
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    Gop m_stCurrent;        ///< 正在输出的GOP
+    Gop m_stNext;           ///< 预取好的前一个GOP
+    bool m_bNextReady;
+    bool m_bDecoding;
+    bool m_bBegin;          ///< 已解码到文件开头
+    int m_nError;
+    int m_nGeneration;      ///< 每次 Start/Stop 加一，丢弃过期的预取结果
+    std::atomic<bool> m_bAbort;
+    TaskHandle m_stTask;
+};
+
+#endif // GOPCACHE_H
@@ -0,0 +1,689 @@
+﻿#include <algorithm>
+#include <chrono>
+
+#include "hlssource.h"
+
+#pragma execution_character_set("utf-8")
+
+/* 属性列表中的值（BANDWIDTH=...，带引号时去掉引号） */
+static std::string attr_value(const std::string &line, const char *name)
+{
+    std::string key = std::string(name) + "=";
+    size_t pos = 0;
+
+    // 名字前必须是 ':' 或 ','，避免 BANDWIDTH 匹配到 AVERAGE-BANDWIDTH
+    while ((pos = line.find(key, pos)) != std::string::npos) {
+        if (pos > 0 && (line[pos - 1] == ':' || line[pos - 1] == ','))
+            break;
+        pos += key.size();
+    }
+    if (pos == std::string::npos)
+        return std::string();
+
+    pos += key.size();
+    if (pos < line.size() && line[pos] == '"') {
+        size_t end = line.find('"', pos + 1);
+        return line.substr(pos + 1, end == std::string::npos ? std::string::npos : end - pos - 1);
+    }
+    return line.substr(pos, line.find(',', pos) - pos);
+}
+
+/* 按行拆分，去掉行尾的 \r 和空白 */
+static std::vector<std::string> split_lines(const std::string &text)
+{
+    std::vector<std::string> lines;
+    size_t pos = 0;
+
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos)
+            end = text.size();
+        size_t last = end;
+        while (last > pos && isspace((unsigned char)text[last - 1]))
+            last--;
+        lines.push_back(text.substr(pos, last - pos));
+        pos = end + 1;
+    }
+    return lines;
+}
+
+static bool starts_with(const std::string &line, const char *prefix)
+{
+    return !line.compare(0, strlen(prefix), prefix);
+}
+
+// 构造函数
+HlsSource::HlsSource(TaskExecutor *pExecutor) :
+    m_pExecutor(pExecutor),
+    m_pAvio(NULL),
+    m_dBufferTarget(HLS_BUFFER_TARGET),
+    m_nVariant(0),
+    m_bLive(false),
+    m_nNextToken(0),
+    m_nReadSeq(0),
+    m_nReadOffset(0),
+    m_nSegBase(0),
+    m_dOrigin(0),
+    m_bStarted(false),
+    m_nActive(0),
+    m_nBusyStart(0),
+    m_nBusyUs(0),
+    m_nBusyBytes(0),
+    m_nSampleUs(0),
+    m_nSampleBytes(0),
+    m_dFastEstimate(0),
+    m_dSlowEstimate(0),
+    m_nOpenTime(0),
+    m_bAbort(false)
+{
+    memset(&m_stInterrupt, 0, sizeof(m_stInterrupt));
+    memset(&m_stStats, 0, sizeof(m_stStats));
+}
+
+// 析构函数
+HlsSource::~HlsSource()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bAbort = true;
+        m_cond.notify_all();
+    }
+    for (TaskHandle &task : m_vecTasks)
+        task.Wait();
+
+    if (m_pAvio)
+    {
+        av_freep(&m_pAvio->buffer);
+        avio_context_free(&m_pAvio);
+    }
+}
+
+bool HlsSource::IsHlsUrl(const char *url)
+{
+    if (!av_strstart(url, "http://", NULL) && !av_strstart(url, "https://", NULL))
+        return false;
+    const char *end = url + strcspn(url, "?#");
+    return end - url >= 5 && !av_strncasecmp(end - 5, ".m3u8", 5);
+}
+
+/* 相对地址按播放列表的地址解析 */
+std::string HlsSource::ResolveUrl(const std::string &base, const std::string &uri)
+{
+    if (uri.find("://") != std::string::npos)
+        return uri;
+
+    size_t scheme = base.find("://");
+    if (uri[0] == '/') {
+        size_t host_end = base.find('/', scheme == std::string::npos ? 0 : scheme + 3);
+        return base.substr(0, host_end) + uri;
+    }
+    std::string path = base.substr(0, base.find_first_of("?#"));
+    return path.substr(0, path.rfind('/') + 1) + uri;
+}
+
+int HlsSource::ParseMaster(const std::string &text, const std::string &base, std::vector<Variant> &variants)
+{
+    Variant variant = Variant();
+    bool bPending = false;
+
+    for (const std::string &line : split_lines(text)) {
+        if (line.empty())
+            continue;
+        if (starts_with(line, "#EXT-X-STREAM-INF:")) {
+            variant = Variant();
+            variant.bandwidth = strtoll(attr_value(line, "BANDWIDTH").c_str(), NULL, 10);
+            sscanf(attr_value(line, "RESOLUTION").c_str(), "%dx%d", &variant.width, &variant.height);
+            bPending = true;
+        } else if (starts_with(line, "#EXT-X-MEDIA:")) {
+            // 独立的音频轨道需要同时解复用两个流
+            if (attr_value(line, "TYPE") == "AUDIO" && !attr_value(line, "URI").empty())
+                return AVERROR_PATCHWELCOME;
+        } else if (line[0] != '#' && bPending) {
+            variant.url = ResolveUrl(base, line);
+            variants.push_back(variant);
+            bPending = false;
+        }
+    }
+    return variants.empty() ? AVERROR_INVALIDDATA : 0;
+}
+
+int HlsSource::ParseMedia(const std::string &text, const std::string &base, MediaPlaylist &playlist)
+{
+    double duration = -1;
+
+    playlist.first_sequence = 0;
+    playlist.target_duration = 0;
+    playlist.ended = false;
+    playlist.durations.clear();
+    playlist.urls.clear();
+
+    if (!starts_with(text, "#EXTM3U"))
+        return AVERROR_INVALIDDATA;
+    for (const std::string &line : split_lines(text)) {
+        if (line.empty())
+            continue;
+        if (starts_with(line, "#EXT-X-TARGETDURATION:")) {
+            playlist.target_duration = atof(line.c_str() + 22);
+        } else if (starts_with(line, "#EXT-X-MEDIA-SEQUENCE:")) {
+            playlist.first_sequence = strtoll(line.c_str() + 22, NULL, 10);
+        } else if (starts_with(line, "#EXTINF:")) {
+            duration = atof(line.c_str() + 8);
+        } else if (starts_with(line, "#EXT-X-ENDLIST")) {
+            playlist.ended = true;
+        } else if (starts_with(line, "#EXT-X-KEY:")) {
+            if (attr_value(line, "METHOD") != "NONE")
+                return AVERROR_PATCHWELCOME;
+        } else if (starts_with(line, "#EXT-X-MAP:") || starts_with(line, "#EXT-X-BYTERANGE:")) {
+            return AVERROR_PATCHWELCOME;
+        } else if (starts_with(line, "#EXT-X-STREAM-INF:")) {
+            return AVERROR_INVALIDDATA;
+        } else if (line[0] != '#') {
+            playlist.durations.push_back(duration >= 0 ? duration : playlist.target_duration);
+            playlist.urls.push_back(ResolveUrl(base, line));
+            duration = -1;
+        }
+    }
+    return playlist.urls.empty() ? AVERROR_INVALIDDATA : 0;
+}
+
+int HlsSource::InterruptCallback(void *ctx)
+{
+    HlsSource *pSource = (HlsSource *)ctx;
+    return pSource->m_bAbort ||
+            (pSource->m_stInterrupt.callback && pSource->m_stInterrupt.callback(pSource->m_stInterrupt.opaque));
+}
+
+/* 下载整个文件，分片的数据量计入带宽估计 */
+int HlsSource::Download(const std::string &url, std::vector<uint8_t> &data, bool bSegment)
+{
+    AVIOInterruptCB cb = { InterruptCallback, this };
+    AVIOContext *pb = NULL;
+    int ret;
+
+    data.clear();
+    ret = avio_open2(&pb, url.c_str(), AVIO_FLAG_READ, &cb, NULL);
+    if (ret < 0)
+        return ret;
+
+    int64_t size = avio_size(pb);
+    if (size > 0)
+        data.reserve((size_t)size);
+    for (;;) {
+        size_t old = data.size();
+        data.resize(old + HLS_READ_CHUNK);
+        ret = avio_read(pb, data.data() + old, HLS_READ_CHUNK);
+        data.resize(old + FFMAX(ret, 0));
+        if (ret <= 0)
+            break;
+        if (bSegment) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_nBusyBytes += ret;
+            m_stStats.bytes += ret;
+        }
+    }
+    avio_closep(&pb);
+    return ret == 0 || ret == AVERROR_EOF ? 0 : ret;
+}
+
+int HlsSource::LoadMedia(const std::string &url, MediaPlaylist &playlist)
+{
+    std::vector<uint8_t> data;
+    int ret = Download(url, data, false);
+    if (ret < 0)
+        return ret;
+    return ParseMedia(std::string(data.begin(), data.end()), url, playlist);
+}
+
+/* 更新码率档的分片地址，新出现的分片加入时间线，调用时持有锁 */
+void HlsSource::ApplyMedia(int nVariant, const MediaPlaylist &playlist)
+{
+    Variant &variant = m_vecVariants[nVariant];
+
+    variant.first_sequence = playlist.first_sequence;
+    variant.urls = playlist.urls;
+    variant.target_duration = playlist.target_duration;
+    variant.ended = playlist.ended;
+    variant.loaded = true;
+
+    for (size_t i = 0; i < playlist.urls.size(); i++) {
+        int64_t seq = playlist.first_sequence + (int64_t)i;
+        if (m_vecTimeline.empty()) {
+            Segment seg = { seq, 0, playlist.durations[i] };
+            m_vecTimeline.push_back(seg);
+            continue;
+        }
+        // 重新加载太晚时中间的分片已移出窗口，按目标时长补上，下载时跳过
+        while (m_vecTimeline.back().sequence < seq) {
+            const Segment &last = m_vecTimeline.back();
+            Segment seg = { last.sequence + 1, last.start + last.duration,
+                            last.sequence + 1 == seq ? playlist.durations[i] : playlist.target_duration };
+            m_vecTimeline.push_back(seg);
+        }
+    }
+    if (nVariant == m_nVariant)
+        m_bLive = !variant.ended;
+}
+
+const HlsSource::Segment *HlsSource::FindSegment(int64_t nSequence)
+{
+    if (m_vecTimeline.empty() || nSequence < m_vecTimeline.front().sequence ||
+            nSequence > m_vecTimeline.back().sequence)
+        return NULL;
+    return &m_vecTimeline[nSequence - m_vecTimeline.front().sequence];
+}
+
+int HlsSource::Open(const char *url, const AVIOInterruptCB *interrupt)
+{
+    std::vector<uint8_t> data;
+    MediaPlaylist playlist;
+    int ret;
+
+    if (interrupt)
+        m_stInterrupt = *interrupt;
+    m_nOpenTime = av_gettime_relative();
+    ret = Download(url, data, false);
+    if (ret < 0)
+        return ret;
+
+    std::string text(data.begin(), data.end());
+    if (text.find("#EXT-X-STREAM-INF:") != std::string::npos) {
+        ret = ParseMaster(text, url, m_vecVariants);
+        if (ret < 0)
+            return ret;
+        // 按码率升序排列，从列表中的第一档开始
+        std::string first = m_vecVariants[0].url;
+        std::stable_sort(m_vecVariants.begin(), m_vecVariants.end(),
+                         [](const Variant &a, const Variant &b) { return a.bandwidth < b.bandwidth; });
+        for (size_t i = 0; i < m_vecVariants.size(); i++) {
+            if (m_vecVariants[i].url == first)
+                m_nVariant = (int)i;
+        }
+        ret = LoadMedia(first, playlist);
+    } else {
+        Variant variant = Variant();
+        variant.url = url;
+        m_vecVariants.push_back(variant);
+        ret = ParseMedia(text, url, playlist);
+    }
+    if (ret < 0)
+        return ret;
+    ApplyMedia(m_nVariant, playlist);
+
+    // 直播从接近最新的分片开始
+    m_nReadSeq = m_vecTimeline.front().sequence;
+    if (m_bLive)
+        m_nReadSeq = FFMAX(m_nReadSeq, m_vecTimeline.back().sequence - HLS_LIVE_EDGE_SEGMENTS + 1);
+    m_nSegBase = m_nReadSeq << HLS_OFFSET_BITS;
+    m_dOrigin = FindSegment(m_nReadSeq)->start;
+
+    unsigned char *buffer = (unsigned char *)av_malloc(HLS_READ_CHUNK);
+    if (buffer)
+        m_pAvio = avio_alloc_context(buffer, HLS_READ_CHUNK, 0, this, ReadPacket, NULL, SeekPacket);
+    if (!m_pAvio) {
+        av_free(buffer);
+        return AVERROR(ENOMEM);
+    }
+
+    // 下载为解复用供数据，和读取线程使用同一通道
+    for (int i = 0; i < HLS_PARALLEL_FETCHES; i++)
+        m_vecTasks.push_back(m_pExecutor->Submit(TASK_LANE_AUDIO, [this] { FetchLoop(); }, true));
+    if (m_bLive)
+        m_vecTasks.push_back(m_pExecutor->Submit(TASK_LANE_AUDIO, [this] { ReloadLoop(); }, true));
+
+    av_log(NULL, AV_LOG_VERBOSE, "hls: %d variants, start at %" PRId64 " bps, %s, %d segments\n",
+           (int)m_vecVariants.size(), m_vecVariants[m_nVariant].bandwidth, m_bLive ? "live" : "vod",
+           (int)m_vecTimeline.size());
+    return 0;
+}
+
+bool HlsSource::IsLive()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_bLive;
+}
+
+double HlsSource::Duration()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_bLive || m_vecTimeline.empty())
+        return 0;
+    return m_vecTimeline.back().start + m_vecTimeline.back().duration - m_dOrigin;
+}
+
+int64_t HlsSource::SegmentOffset(double dSeconds)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    double t = m_dOrigin + dSeconds;
+
+    // 时间线按开头升序，找最后一个开头不晚于 t 的分片
+    auto it = std::upper_bound(m_vecTimeline.begin(), m_vecTimeline.end(), t,
+                               [](double v, const Segment &seg) { return v < seg.start; });
+    if (it != m_vecTimeline.begin())
+        --it;
+    return it->sequence << HLS_OFFSET_BITS;
+}
+
+/* 已下载、从读取位置开始连续的时长，调用时持有锁 */
+double HlsSource::BufferedAhead()
+{
+    double buffered = 0;
+
+    for (int64_t seq = m_nReadSeq; ; seq++) {
+        auto it = m_mapSlots.find(seq);
+        const Segment *seg = FindSegment(seq);
+        if (it == m_mapSlots.end() || it->second.state != SLOT_READY || !seg)
+            break;
+        double remain = 1.0;
+        if (seq == m_nReadSeq && !it->second.data.empty())
+            remain -= (double)m_nReadOffset / it->second.data.size();
+        buffered += seg->duration * remain;
+    }
+    return buffered;
+}
+
+HlsStats HlsSource::Stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    HlsStats stats = m_stStats;
+
+    stats.variants = (int)m_vecVariants.size();
+    stats.variant = m_nVariant;
+    stats.variant_bandwidth = m_vecVariants.empty() ? 0 : m_vecVariants[m_nVariant].bandwidth;
+    stats.buffered = BufferedAhead();
+    return stats;
+}
+
+/* 读取位置之后第一个还没有下载的分片，超出缓冲目标或播放列表时返回 -1，调用时持有锁 */
+int64_t HlsSource::NextFetchSequence()
+{
+    const Segment *cur = FindSegment(m_nReadSeq);
+    if (!cur)
+        return -1;
+
+    for (int64_t seq = m_nReadSeq; ; seq++) {
+        const Segment *seg = FindSegment(seq);
+        if (!seg)
+            return -1;
+        // 至少保证当前和下一个分片在下载
+        if (seq > m_nReadSeq + 1 && seg->start - cur->start >= m_dBufferTarget)
+            return -1;
+        if (!m_mapSlots.count(seq))
+            return seq;
+    }
+}
+
+/* 选择不超过估计带宽一定比例的最高码率档，缓冲不足时不升档，调用时持有锁 */
+int HlsSource::ChooseVariant()
+{
+    if (m_vecVariants.size() < 2 || m_stStats.bandwidth <= 0)
+        return m_nVariant;
+
+    int best = 0;
+    for (size_t i = 0; i < m_vecVariants.size(); i++) {
+        if (m_vecVariants[i].bandwidth <= m_stStats.bandwidth * HLS_SAFETY_FACTOR)
+            best = (int)i;
+    }
+    if (best > m_nVariant && BufferedAhead() < HLS_SWITCH_UP_BUFFER)
+        best = m_nVariant;
+    return best;
+}
+
+/* 一个分片下载结束，按所有下载合计的吞吐量更新带宽估计，调用时持有锁 */
+void HlsSource::EndTransfer()
+{
+    int64_t now = av_gettime_relative();
+
+    if (--m_nActive == 0)
+        m_nBusyUs += now - m_nBusyStart;
+
+    int64_t busy = m_nBusyUs + (m_nActive > 0 ? now - m_nBusyStart : 0);
+    int64_t us = busy - m_nSampleUs;
+    if (us < HLS_MIN_SAMPLE_US)
+        return;
+
+    double bps = (m_nBusyBytes - m_nSampleBytes) * 8 * 1000000.0 / us;
+    m_dFastEstimate = m_dFastEstimate > 0 ? m_dFastEstimate + HLS_EWMA_FAST * (bps - m_dFastEstimate) : bps;
+    m_dSlowEstimate = m_dSlowEstimate > 0 ? m_dSlowEstimate + HLS_EWMA_SLOW * (bps - m_dSlowEstimate) : bps;
+    m_nSampleUs = busy;
+    m_nSampleBytes = m_nBusyBytes;
+    // 带宽下降时快速反应，上升时保守
+    m_stStats.bandwidth = (int64_t)FFMIN(m_dFastEstimate, m_dSlowEstimate);
+}
+
+/* 下载任务：取读取位置之后第一个没有下载的分片，按带宽选择码率档 */
+void HlsSource::FetchLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (!m_bAbort) {
+        int64_t seq = NextFetchSequence();
+        if (seq < 0) {
+            m_cond.wait(lock);
+            continue;
+        }
+
+        int nVariant = ChooseVariant();
+        if (nVariant != m_nVariant && !m_vecVariants[nVariant].loaded) {
+            // 第一次切换到该档（或直播中该档已过期），先加载播放列表
+            Variant &variant = m_vecVariants[nVariant];
+            if (!variant.loading) {
+                MediaPlaylist playlist;
+                std::string url = variant.url;
+                variant.loading = true;
+                lock.unlock();
+                int ret = LoadMedia(url, playlist);
+                lock.lock();
+                m_vecVariants[nVariant].loading = false;
+                if (ret >= 0) {
+                    ApplyMedia(nVariant, playlist);
+                    continue;
+                }
+                av_log(NULL, AV_LOG_WARNING, "hls: failed to load %s\n", url.c_str());
+            }
+            nVariant = m_nVariant;
+        }
+
+        // 目标档没有该分片时使用当前档
+        std::string url;
+        for (int v : { nVariant, m_nVariant }) {
+            const Variant &variant = m_vecVariants[v];
+            int64_t index = seq - variant.first_sequence;
+            if (variant.loaded && index >= 0 && index < (int64_t)variant.urls.size()) {
+                url = variant.urls[index];
+                nVariant = v;
+                break;
+            }
+        }
+
+        Slot &slot = m_mapSlots[seq];
+        slot.token = ++m_nNextToken;
+        slot.variant = nVariant;
+        if (url.empty()) {
+            // 已移出直播窗口，读取时跳过
+            slot.state = SLOT_FAILED;
+            m_cond.notify_all();
+            continue;
+        }
+        slot.state = SLOT_FETCHING;
+        if (nVariant != m_nVariant) {
+            av_log(NULL, AV_LOG_INFO, "hls: switch %" PRId64 " -> %" PRId64 " bps (estimate %" PRId64 " bps)\n",
+                   m_vecVariants[m_nVariant].bandwidth, m_vecVariants[nVariant].bandwidth, m_stStats.bandwidth);
+            m_nVariant = nVariant;
+            m_bLive = !m_vecVariants[nVariant].ended;
+            m_stStats.switches++;
+        }
+
+        int64_t token = slot.token;
+        if (m_nActive++ == 0)
+            m_nBusyStart = av_gettime_relative();
+        lock.unlock();
+
+        std::vector<uint8_t> data;
+        int ret = AVERROR(EIO);
+        for (int i = 0; i < HLS_RETRY_COUNT && !m_bAbort; i++) {
+            ret = Download(url, data, true);
+            if (ret >= 0 || ret == AVERROR_EXIT)
+                break;
+        }
+
+        lock.lock();
+        EndTransfer();
+        // 下载期间发生跳转，槽位已作废
+        auto it = m_mapSlots.find(seq);
+        if (it == m_mapSlots.end() || it->second.token != token)
+            continue;
+        if (ret < 0) {
+            if (ret != AVERROR_EXIT)
+                av_log(NULL, AV_LOG_WARNING, "hls: failed to download %s\n", url.c_str());
+            it->second.state = SLOT_FAILED;
+            m_stStats.errors++;
+        } else {
+            it->second.state = SLOT_READY;
+            it->second.data.swap(data);
+            m_stStats.segments++;
+        }
+        m_cond.notify_all();
+    }
+}
+
+/* 直播：按目标分片时长重新加载当前档的播放列表，没有新分片时间隔减半 */
+void HlsSource::ReloadLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    bool bGrew = true;
+
+    while (!m_bAbort && m_bLive) {
+        double interval = FFMAX(m_vecVariants[m_nVariant].target_duration, 1.0);
+        if (!bGrew)
+            interval /= 2;
+        m_cond.wait_for(lock, std::chrono::milliseconds((int64_t)(interval * 1000)), [this] { return (bool)m_bAbort; });
+        if (m_bAbort)
+            break;
+
+        int nVariant = m_nVariant;
+        std::string url = m_vecVariants[nVariant].url;
+        int64_t last = m_vecTimeline.back().sequence;
+        MediaPlaylist playlist;
+        lock.unlock();
+        int ret = LoadMedia(url, playlist);
+        lock.lock();
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_WARNING, "hls: failed to reload %s\n", url.c_str());
+            bGrew = false;
+            continue;
+        }
+        ApplyMedia(nVariant, playlist);
+        // 其它档的分片列表已过期，切换时重新加载
+        for (size_t i = 0; i < m_vecVariants.size(); i++) {
+            if ((int)i != nVariant)
+                m_vecVariants[i].loaded = false;
+        }
+        bGrew = m_vecTimeline.back().sequence > last;
+        m_cond.notify_all();
+    }
+}
+
+/* 从指定分片开头开始读取，保留其后缓冲目标内已下载的分片，调用时持有锁 */
+void HlsSource::JumpTo(int64_t nSequence)
+{
+    const Segment *target = FindSegment(nSequence);
+
+    for (auto it = m_mapSlots.begin(); it != m_mapSlots.end();) {
+        const Segment *seg = FindSegment(it->first);
+        if (it->first < nSequence || !seg || seg->start - target->start >= m_dBufferTarget)
+            it = m_mapSlots.erase(it);
+        else
+            ++it;
+    }
+    m_nReadSeq = nSequence;
+    m_nReadOffset = 0;
+    m_nSegBase = nSequence << HLS_OFFSET_BITS;
+    m_cond.notify_all();
+}
+
+int HlsSource::Read(uint8_t *buf, int size)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    int64_t t0 = 0;
+
+    for (;;) {
+        auto it = m_mapSlots.find(m_nReadSeq);
+        if (it != m_mapSlots.end() && it->second.state == SLOT_READY) {
+            Slot &slot = it->second;
+            if (m_nReadOffset < (int64_t)slot.data.size()) {
+                int n = (int)FFMIN((int64_t)size, (int64_t)slot.data.size() - m_nReadOffset);
+                memcpy(buf, slot.data.data() + m_nReadOffset, n);
+                m_nReadOffset += n;
+
+                int64_t now = av_gettime_relative();
+                if (!m_bStarted) {
+                    m_bStarted = true;
+                    m_stStats.startup_us = now - m_nOpenTime;
+                } else if (t0) {
+                    m_stStats.stalls++;
+                    m_stStats.stall_us += now - t0;
+                    m_stStats.max_stall_us = FFMAX(m_stStats.max_stall_us, now - t0);
+                }
+                return n;
+            }
+            // 分片读完，释放后读下一个
+            m_nSegBase += slot.data.size();
+            m_mapSlots.erase(it);
+            m_nReadSeq++;
+            m_nReadOffset = 0;
+            m_cond.notify_all();
+            continue;
+        }
+        if (it != m_mapSlots.end() && it->second.state == SLOT_FAILED) {
+            m_mapSlots.erase(it);
+            m_nReadSeq++;
+            m_nReadOffset = 0;
+            m_cond.notify_all();
+            continue;
+        }
+        if (!m_bLive && !FindSegment(m_nReadSeq))
+            return AVERROR_EOF;
+
+        if (!t0)
+            t0 = av_gettime_relative();
+        m_cond.wait_for(lock, std::chrono::milliseconds(HLS_WAIT_MS));
+        if (InterruptCallback(this))
+            return AVERROR_EXIT;
+    }
+}
+
+int64_t HlsSource::Seek(int64_t offset, int whence)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    whence &= ~AVSEEK_FORCE;
+    if (whence == SEEK_CUR)
+        offset += m_nSegBase + m_nReadOffset;
+    else if (whence != SEEK_SET)
+        return AVERROR(ENOSYS);
+
+    // 当前分片内
+    auto it = m_mapSlots.find(m_nReadSeq);
+    int64_t size = it != m_mapSlots.end() && it->second.state == SLOT_READY ? (int64_t)it->second.data.size() : 0;
+    if (offset >= m_nSegBase && offset <= m_nSegBase + size) {
+        m_nReadOffset = offset - m_nSegBase;
+        return offset;
+    }
+
+    // 分片开头
+    int64_t seq = offset >> HLS_OFFSET_BITS;
+    if ((offset & (((int64_t)1 << HLS_OFFSET_BITS) - 1)) || !FindSegment(seq))
+        return AVERROR(EINVAL);
+    JumpTo(seq);
+    return offset;
+}
+
+int HlsSource::ReadPacket(void *opaque, uint8_t *buf, int size)
+{
+    return ((HlsSource *)opaque)->Read(buf, size);
+}
+
+int64_t HlsSource::SeekPacket(void *opaque, int64_t offset, int whence)
+{
+    return ((HlsSource *)opaque)->Seek(offset, whence);
+}
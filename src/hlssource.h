@@ -0,0 +1,211 @@
+﻿#ifndef HLSSOURCE_H
+#define HLSSOURCE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "globalhelper.h"
+#include "taskexecutor.h"
+
+#define HLS_PARALLEL_FETCHES 3              // 同时下载的分片数
+#define HLS_BUFFER_TARGET 30.0              // 默认预取领先读取位置的时长（秒）
+#define HLS_LIVE_EDGE_SEGMENTS 3            // 直播从倒数第3个分片开始播放
+#define HLS_SAFETY_FACTOR 0.8               // 选择码率不超过估计带宽的该比例
+#define HLS_SWITCH_UP_BUFFER 8.0            // 已下载的时长不足时不升码率（秒）
+#define HLS_EWMA_FAST 0.5                   // 带宽估计的快/慢两个滑动平均系数，取较小值
+#define HLS_EWMA_SLOW 0.1
+#define HLS_MIN_SAMPLE_US 50000             // 下载时间不足该值时累计到下一个分片再估计
+#define HLS_RETRY_COUNT 3                   // 分片下载失败的重试次数
+#define HLS_READ_CHUNK (64 * 1024)
+#define HLS_WAIT_MS 10                      // 等待分片时检查中断的间隔
+#define HLS_OFFSET_BITS 40                  // 虚拟读取位置的高位为分片序号
+
+//HLS播放统计
+typedef struct HlsStats {
+    int variants;               // 码率档数
+    int variant;                // 当前下载的档（按码率升序）
+    int64_t variant_bandwidth;  // 当前档的标称码率（bps）
+    int64_t bandwidth;          // 估计的下载带宽（bps），未测量时为0
+    double buffered;            // 已下载未读取的时长（秒）
+    int segments;               // 已下载的分片数
+    int64_t bytes;              // 下载的字节数
+    int switches;               // 切换码率的次数
+    int errors;                 // 重试后仍下载失败、被跳过的分片数
+    int64_t startup_us;         // 打开到第一个分片可读的时间
+    int stalls;                 // 播放开始后读取等待分片的次数
+    int64_t stall_us;           // 累计等待时间
+    int64_t max_stall_us;
+} HlsStats;
+
+/**
+ * @brief	HLS 分片预取
+ *
+ * 代替 libavformat 的 hls 解复用器，把 MPEG-TS 分片按顺序拼接成一个字节流，
+ * 作为 mpegts 解复用的自定义 AVIOContext：
+ * 多个后台任务并行下载读取位置之后的分片，已下载的时长达到缓冲目标后暂停；
+ * 按所有下载合计的吞吐量估计带宽，下一个分片选择不超过估计带宽 HLS_SAFETY_FACTOR 的
+ * 最高码率档，缓冲不足时不升档。直播流按目标分片时长重新加载播放列表。
+ * 读取位置的高位为分片序号，跳转通过 SegmentOffset 换算后用 avio_seek 完成。
+ * 加密、字节范围、fMP4 分片和独立音频轨道的播放列表不支持，Open 失败后应改用 hls 解复用器。
+ */
+class HlsSource
+{
+public:
+    explicit HlsSource(TaskExecutor *pExecutor);
+    ~HlsSource();
+
+    /**
+     * @brief	是否为 HTTP(S) 上的 m3u8 播放列表
+     */
+    static bool IsHlsUrl(const char *url);
+
+    /**
+     * @brief	设置缓冲目标，需在 Open 之前调用
+     *
+     * @param	dSeconds 预取领先读取位置的时长（秒）
+     */
+    void SetBufferTarget(double dSeconds) { m_dBufferTarget = dSeconds; }
+
+    /**
+     * @brief	加载播放列表并开始预取
+     *
+     * @param	url 主播放列表或媒体播放列表
+     * @param	interrupt 中断回调，下载和等待分片时检查
+     * @return	0 成功 AVERROR_PATCHWELCOME 不支持的播放列表 <0 失败
+     */
+    int Open(const char *url, const AVIOInterruptCB *interrupt);
+
+    /**
+     * @brief	交给 AVFormatContext::pb 使用的上下文，需要同时设置 AVFMT_FLAG_CUSTOM_IO
+     * @note 	归 HlsSource 所有，avformat_close_input 之后再删除 HlsSource
+     */
+    AVIOContext *Context() { return m_pAvio; }
+
+    /**
+     * @brief	是否为直播（播放列表没有结束标记）
+     */
+    bool IsLive();
+
+    /**
+     * @brief	点播的总时长（秒），直播返回0
+     */
+    double Duration();
+
+    /**
+     * @brief	换算跳转位置
+     *
+     * @param	dSeconds 相对第一个播放的分片开头的时间（秒）
+     * @return	包含该时间的分片在字节流中的位置，交给 avio_seek 使用
+     */
+    int64_t SegmentOffset(double dSeconds);
+
+    HlsStats Stats();
+
+private:
+    //一个分片在时间线上的位置
+    struct Segment {
+        int64_t sequence;
+        double start;           ///< 相对第一个分片（秒）
+        double duration;
+    };
+
+    //一个码率档
+    struct Variant {
+        std::string url;
+        int64_t bandwidth;
+        int width;
+        int height;
+        int64_t first_sequence; ///< urls[0] 的序号
+        std::vector<std::string> urls;
+        double target_duration;
+        bool ended;
+        bool loaded;
+        bool loading;
+    };
+
+    //分片的下载状态
+    enum SlotState {
+        SLOT_FETCHING = 0,
+        SLOT_READY,
+        SLOT_FAILED
+    };
+
+    struct Slot {
+        SlotState state;
+        int64_t token;          ///< 每次分配加一，丢弃被跳转作废后又重新分配的槽位的下载结果
+        int variant;
+        std::vector<uint8_t> data;
+    };
+
+    struct MediaPlaylist {
+        int64_t first_sequence;
+        double target_duration;
+        bool ended;
+        std::vector<double> durations;
+        std::vector<std::string> urls;
+    };
+
+    int Download(const std::string &url, std::vector<uint8_t> &data, bool bSegment);
+    int LoadMedia(const std::string &url, MediaPlaylist &playlist);
+    static int ParseMaster(const std::string &text, const std::string &base, std::vector<Variant> &variants);
+    static int ParseMedia(const std::string &text, const std::string &base, MediaPlaylist &playlist);
+    static std::string ResolveUrl(const std::string &base, const std::string &uri);
+
+    void ApplyMedia(int nVariant, const MediaPlaylist &playlist);
+    const Segment *FindSegment(int64_t nSequence);
+    int64_t NextFetchSequence();
+    int ChooseVariant();
+    double BufferedAhead();
+    void EndTransfer();
+
+    void FetchLoop();
+    void ReloadLoop();
+    void JumpTo(int64_t nSequence);
+    int Read(uint8_t *buf, int size);
+    int64_t Seek(int64_t offset, int whence);
+
+    static int InterruptCallback(void *ctx);
+    static int ReadPacket(void *opaque, uint8_t *buf, int size);
+    static int64_t SeekPacket(void *opaque, int64_t offset, int whence);
+
+private:
+    TaskExecutor *m_pExecutor;
+    AVIOInterruptCB m_stInterrupt;      ///< 调用者的中断回调
+    AVIOContext *m_pAvio;
+    double m_dBufferTarget;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::vector<Variant> m_vecVariants; ///< 按码率升序
+    int m_nVariant;                     ///< 当前下载的档
+    bool m_bLive;
+    std::vector<Segment> m_vecTimeline; ///< 按序号连续
+    std::map<int64_t, Slot> m_mapSlots; ///< 正在下载和已下载未读完的分片
+    int64_t m_nNextToken;
+    int64_t m_nReadSeq;                 ///< 正在读取的分片
+    int64_t m_nReadOffset;              ///< 分片内的读取位置
+    int64_t m_nSegBase;                 ///< 正在读取的分片开头在字节流中的位置
+    double m_dOrigin;                   ///< 第一个播放的分片在时间线上的开头
+    bool m_bStarted;
+
+    // 带宽估计：只计算至少有一个分片在下载的时间
+    int m_nActive;
+    int64_t m_nBusyStart;
+    int64_t m_nBusyUs;
+    int64_t m_nBusyBytes;
+    int64_t m_nSampleUs;                ///< 上次估计时的累计值
+    int64_t m_nSampleBytes;
+    double m_dFastEstimate;
+    double m_dSlowEstimate;
+
+    int64_t m_nOpenTime;
+    HlsStats m_stStats;
+    std::atomic<bool> m_bAbort;
+    std::vector<TaskHandle> m_vecTasks;
+};
+
+#endif // HLSSOURCE_H
@@ -0,0 +1,124 @@
+﻿#include "livelatency.h"
+
+#pragma execution_character_set("utf-8")
+
+// 构造函数
+LiveLatencyController::LiveLatencyController()
+{
+    Reset(LIVE_TARGET_LATENCY);
+}
+
+/* 清空状态和统计，开始新的直播流 */
+void LiveLatencyController::Reset(double dTarget)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_dTarget = dTarget;
+    m_dSmoothed = NAN;
+    m_dMax = 0;
+    m_bCatchup = false;
+    m_nLastDrop = AV_NOPTS_VALUE;
+    m_stDecision.speed = 1.0;
+    m_stDecision.rate = 1.0;
+    m_stDecision.drop = 0;
+    m_nSamples = 0;
+    m_nCatchups = 0;
+    m_nDrops = 0;
+    m_dDropped = 0;
+    m_vecHist.assign(LIVE_HIST_BINS, 0);
+}
+
+/* 加入一次延迟测量，按平滑后的偏差选择调速、追赶或丢帧 */
+LiveDecision LiveLatencyController::Update(double dLatency, int64_t nNow)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // 时间戳跳变（直播源重启、节目切换）时测量值没有意义，保持当前输出
+    if (std::isnan(dLatency) || fabs(dLatency) > LIVE_MAX_LATENCY)
+        return m_stDecision;
+
+    int bin = dLatency <= 0 ? 0 : FFMIN((int)(dLatency * 1000 / LIVE_HIST_BIN_MS), LIVE_HIST_BINS - 1);
+    m_vecHist[bin]++;
+    m_nSamples++;
+    m_dMax = FFMAX(m_dMax, dLatency);
+
+    // 包按突发到达，测量值在一个包间隔内跳动，平滑后再控制
+    if (std::isnan(m_dSmoothed))
+        m_dSmoothed = dLatency;
+    else
+        m_dSmoothed += LIVE_SMOOTHING * (dLatency - m_dSmoothed);
+
+    LiveDecision decision;
+    decision.speed = 1.0;
+    decision.rate = 1.0;
+    decision.drop = 0;
+
+    double err = m_dSmoothed - m_dTarget;
+
+    // 落后过多：丢弃一段，平滑值直接扣除丢弃的时长，之后的测量会修正实际效果
+    if (err > LIVE_DROP_ENTER && (m_nLastDrop == AV_NOPTS_VALUE || nNow - m_nLastDrop >= LIVE_DROP_INTERVAL)) {
+        decision.drop = FFMIN(err, LIVE_DROP_MAX);
+        m_dSmoothed -= decision.drop;
+        err -= decision.drop;
+        m_nLastDrop = nNow;
+        m_nDrops++;
+        m_dDropped += decision.drop;
+    }
+
+    // 明显落后时变速追赶，退出阈值低于进入阈值，避免速率来回切换
+    if (m_bCatchup ? err > LIVE_CATCHUP_EXIT : err > LIVE_CATCHUP_ENTER) {
+        if (!m_bCatchup) {
+            m_bCatchup = true;
+            m_nCatchups++;
+        }
+        decision.rate = LIVE_CATCHUP_RATE;
+    }
+    else {
+        m_bCatchup = false;
+        // 死区外按比例轻微调速，延迟低于目标时放慢，让缓冲慢慢积累
+        if (fabs(err) > LIVE_DEADBAND) {
+            double excess = err > 0 ? err - LIVE_DEADBAND : err + LIVE_DEADBAND;
+            decision.speed = 1.0 + av_clipd(excess / LIVE_GENTLE_RANGE, -1.0, 1.0) * LIVE_GENTLE_MAX;
+        }
+    }
+
+    m_stDecision = decision;
+    m_stDecision.drop = 0;
+    return decision;
+}
+
+/* 按直方图计算分位数，取所在档的中点 */
+double LiveLatencyController::Percentile(double dFraction) const
+{
+    if (m_nSamples == 0)
+        return 0;
+
+    int64_t rank = (int64_t)ceil(dFraction * m_nSamples);
+    int64_t count = 0;
+    for (int i = 0; i < LIVE_HIST_BINS; i++) {
+        count += m_vecHist[i];
+        if (count >= rank)
+            return (i + 0.5) * LIVE_HIST_BIN_MS / 1000.0;
+    }
+    return m_dMax;
+}
+
+LiveLatencyStats LiveLatencyController::Stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    LiveLatencyStats stats;
+
+    stats.target = m_dTarget;
+    stats.current = std::isnan(m_dSmoothed) ? 0 : m_dSmoothed;
+    stats.p50 = Percentile(0.50);
+    stats.p90 = Percentile(0.90);
+    stats.p99 = Percentile(0.99);
+    stats.max = m_dMax;
+    stats.samples = m_nSamples;
+    stats.catchups = m_nCatchups;
+    stats.drops = m_nDrops;
+    stats.dropped = m_dDropped;
+    stats.speed = m_stDecision.speed;
+    stats.rate = m_stDecision.rate;
+    return stats;
+}
@@ -0,0 +1,98 @@
+﻿#ifndef LIVELATENCY_H
+#define LIVELATENCY_H
+
+#include <mutex>
+#include <vector>
+
+#include "globalhelper.h"
+
+#define LIVE_TARGET_LATENCY 1.0         // 默认目标延迟（秒）
+#define LIVE_CONTROL_INTERVAL 100000    // 控制周期（微秒）
+#define LIVE_RATE_SETTLE 500000         // 切换播放速率后暂停测量的时间（微秒），等待各时钟按新速率更新
+#define LIVE_SMOOTHING 0.1              // 延迟测量的指数平滑系数，约1秒的时间常数
+#define LIVE_MAX_LATENCY 60.0           // 测得的延迟超过该值视为时间戳不连续，不参与控制
+#define LIVE_DEADBAND 0.08              // 偏差在该范围内不调速（秒）
+#define LIVE_GENTLE_MAX 0.02            // 轻微调速的最大幅度（2%，重采样补偿，听不出音调变化）
+#define LIVE_GENTLE_RANGE 1.0           // 偏差达到该值时轻微调速达到最大幅度（秒）
+#define LIVE_CATCHUP_ENTER 1.5          // 超出目标该值时改用 sonic 变速追赶（秒）
+#define LIVE_CATCHUP_EXIT 0.3           // 追赶到超出目标不足该值时恢复正常速率（秒）
+#define LIVE_CATCHUP_RATE 1.25          // 追赶时的播放速率
+#define LIVE_DROP_ENTER 5.0             // 超出目标该值时直接丢帧（秒）
+#define LIVE_DROP_MAX 2.0               // 每次最多丢弃的时长（秒）
+#define LIVE_DROP_INTERVAL 3000000      // 两次丢帧的最小间隔（微秒），等待上次丢帧反映到测量中
+#define LIVE_HIST_BIN_MS 5              // 延迟直方图每档 5ms
+#define LIVE_HIST_BINS 2000             // 0 ~ 10 秒，更大的延迟计入最后一档
+
+//直播延迟统计（秒）
+typedef struct LiveLatencyStats {
+    double target;      // 目标延迟
+    double current;     // 平滑后的当前延迟
+    double p50, p90, p99, max;
+    int64_t samples;    // 测量次数
+    int catchups;       // 变速追赶次数
+    int drops;          // 丢帧次数
+    double dropped;     // 丢弃的总时长
+    double speed;       // 当前的轻微调速系数
+    double rate;        // 当前的播放速率
+} LiveLatencyStats;
+
+//控制器的一次输出
+typedef struct LiveDecision {
+    double speed;       // 轻微调速系数，1.0 为不调整，通过重采样补偿或外部时钟速度实现
+    double rate;        // 播放速率，追赶时为 LIVE_CATCHUP_RATE，通过 sonic 变速实现
+    double drop;        // 本次要丢弃的时长（秒），0 为不丢帧
+} LiveDecision;
+
+/**
+ * @brief	直播目标延迟控制器
+ *
+ * 延迟为最新收到的包的时间戳与当前播放位置之差，包含包队列、帧队列和音频输出缓冲，
+ * 平滑后与目标比较，按偏差分三级处理：
+ * 偏差较小时在 ±LIVE_GENTLE_MAX 内按比例调速；超出 LIVE_CATCHUP_ENTER 时用 sonic
+ * 以 LIVE_CATCHUP_RATE 追赶，回到 LIVE_CATCHUP_EXIT 以内才退出，避免速率来回切换；
+ * 超出 LIVE_DROP_ENTER 时丢弃一段（不超过 LIVE_DROP_MAX），两次丢帧至少间隔
+ * LIVE_DROP_INTERVAL。原始测量值计入直方图，用于统计延迟分位数。
+ * 不依赖播放器，控制周期内由刷新循环调用，统计可在其他线程读取。
+ */
+class LiveLatencyController
+{
+public:
+    LiveLatencyController();
+
+    /**
+     * @brief	清空状态和统计
+     *
+     * @param	dTarget 目标延迟（秒）
+     */
+    void Reset(double dTarget);
+
+    /**
+     * @brief	加入一次延迟测量并计算控制输出
+     *
+     * @param	dLatency 测得的延迟（秒）
+     * @param	nNow 当前时间（微秒）
+     * @return	控制输出，测量值无效时保持上一次的输出
+     */
+    LiveDecision Update(double dLatency, int64_t nNow);
+
+    LiveLatencyStats Stats();
+
+private:
+    double Percentile(double dFraction) const;
+
+private:
+    std::mutex m_mutex;
+    double m_dTarget;
+    double m_dSmoothed;         ///< 平滑后的延迟，NAN 表示还没有测量
+    double m_dMax;
+    bool m_bCatchup;
+    int64_t m_nLastDrop;
+    LiveDecision m_stDecision;  ///< 最近一次输出
+    int64_t m_nSamples;
+    int m_nCatchups;
+    int m_nDrops;
+    double m_dDropped;
+    std::vector<uint32_t> m_vecHist;
+};
+
+#endif // LIVELATENCY_H
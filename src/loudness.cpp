@@ -0,0 +1,400 @@
+﻿#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSettings>
+
+#include "loudness.h"
+
+#pragma execution_character_set("utf-8")
+
+const QString LOUDNESS_CACHE = QDir::tempPath() + "/CTTV_Player_loudness.ini"; // 响度分析缓存
+
+/* 读取帧中某声道的一个样本，归一化到 -1~1 */
+static double read_sample(const AVFrame *frame, enum AVSampleFormat fmt, int ch, int i)
+{
+    int planar = av_sample_fmt_is_planar(fmt);
+    const uint8_t *data = planar ? frame->extended_data[ch] : frame->extended_data[0];
+    int idx = planar ? i : i * frame->channels + ch;
+
+    switch (av_get_packed_sample_fmt(fmt)) {
+    case AV_SAMPLE_FMT_U8:
+        return (data[idx] - 128) / 128.0;
+    case AV_SAMPLE_FMT_S16:
+        return ((const int16_t *)data)[idx] / 32768.0;
+    case AV_SAMPLE_FMT_S32:
+        return ((const int32_t *)data)[idx] / 2147483648.0;
+    case AV_SAMPLE_FMT_FLT:
+        return ((const float *)data)[idx];
+    case AV_SAMPLE_FMT_DBL:
+        return ((const double *)data)[idx];
+    default:
+        return 0;
+    }
+}
+
+/* 直方图档位对应的块能量 */
+static double hist_bin_energy(int bin)
+{
+    double loudness = -70.0 + bin / 10.0;
+    return pow(10.0, (loudness + 0.691) / 10.0);
+}
+
+// 构造函数
+LoudnessMeter::LoudnessMeter() :
+    m_nChannels(0),
+    m_bTruePeak(false),
+    m_nSubBlockSize(0),
+    m_nSubBlockFill(0),
+    m_dSubBlockEnergy(0),
+    m_nSubBlocks(0),
+    m_nBlocks(0),
+    m_nTpPos(0),
+    m_dPeak(0)
+{
+    memset(m_arrState, 0, sizeof(m_arrState));
+    memset(m_arrSubBlocks, 0, sizeof(m_arrSubBlocks));
+    memset(m_arrTpHistory, 0, sizeof(m_arrTpHistory));
+}
+
+/* 初始化：按采样率计算K计权滤波器系数（BS.1770 给出的是48kHz系数，这里按模拟原型重新推导） */
+bool LoudnessMeter::Init(int nSampleRate, int nChannels, bool bTruePeak)
+{
+    if (nSampleRate <= 0 || nChannels <= 0)
+    {
+        return false;
+    }
+
+    m_nChannels = FFMIN(nChannels, LOUDNESS_MAX_CHANNELS);
+    m_bTruePeak = bTruePeak;
+    m_nSubBlockSize = FFMAX(1, nSampleRate / 10);
+    m_vecHist.assign(LOUDNESS_HIST_BINS, 0);
+
+    // 5.1 及以上按 FL FR FC LFE BL BR 排列：LFE 不计入，环绕声道加权 1.41
+    for (int ch = 0; ch < m_nChannels; ch++)
+    {
+        m_arrWeights[ch] = 1.0;
+        if (nChannels >= 6 && ch == 3)
+            m_arrWeights[ch] = 0.0;
+        else if (nChannels >= 6 && (ch == 4 || ch == 5))
+            m_arrWeights[ch] = 1.41;
+    }
+
+    // 高频搁架滤波器
+    double f0 = 1681.974450955533;
+    double G = 3.999843853973347;
+    double Q = 0.7071752369554196;
+    double K = tan(M_PI * f0 / nSampleRate);
+    double Vh = pow(10.0, G / 20.0);
+    double Vb = pow(Vh, 0.4996667741545416);
+    double a0 = 1.0 + K / Q + K * K;
+    m_arrB[0][0] = (Vh + Vb * K / Q + K * K) / a0;
+    m_arrB[0][1] = 2.0 * (K * K - Vh) / a0;
+    m_arrB[0][2] = (Vh - Vb * K / Q + K * K) / a0;
+    m_arrA[0][0] = 1.0;
+    m_arrA[0][1] = 2.0 * (K * K - 1.0) / a0;
+    m_arrA[0][2] = (1.0 - K / Q + K * K) / a0;
+
+    // RLB 高通滤波器
+    f0 = 38.13547087602444;
+    Q = 0.5003270373238773;
+    K = tan(M_PI * f0 / nSampleRate);
+    a0 = 1.0 + K / Q + K * K;
+    m_arrB[1][0] = 1.0;
+    m_arrB[1][1] = -2.0;
+    m_arrB[1][2] = 1.0;
+    m_arrA[1][0] = 1.0;
+    m_arrA[1][1] = 2.0 * (K * K - 1.0) / a0;
+    m_arrA[1][2] = (1.0 - K / Q + K * K) / a0;
+
+    // 4倍过采样插值滤波器：加 Hann 窗的 sinc，各相位增益归一化为1
+    if (m_bTruePeak)
+    {
+        int nTaps = LOUDNESS_TP_TAPS * LOUDNESS_TP_PHASES;
+        double dSum = 0;
+        m_vecTpCoeffs.resize(nTaps);
+        for (int m = 0; m < nTaps; m++)
+        {
+            double x = (m - (nTaps - 1) / 2.0) / LOUDNESS_TP_PHASES;
+            double sinc = x == 0 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+            double window = 0.5 - 0.5 * cos(2 * M_PI * (m + 0.5) / nTaps);
+            m_vecTpCoeffs[m] = sinc * window;
+            dSum += m_vecTpCoeffs[m];
+        }
+        for (int m = 0; m < nTaps; m++)
+        {
+            m_vecTpCoeffs[m] *= LOUDNESS_TP_PHASES / dSum;
+        }
+    }
+
+    return true;
+}
+
+/* 加入一帧音频 */
+void LoudnessMeter::AddFrame(const AVFrame *frame)
+{
+    enum AVSampleFormat fmt = (enum AVSampleFormat)frame->format;
+    double arrSamples[LOUDNESS_MAX_CHANNELS];
+    int nChannels = FFMIN(m_nChannels, frame->channels);
+
+    if (!m_nChannels)
+    {
+        return;
+    }
+
+    for (int i = 0; i < frame->nb_samples; i++)
+    {
+        for (int ch = 0; ch < m_nChannels; ch++)
+        {
+            arrSamples[ch] = ch < nChannels ? read_sample(frame, fmt, ch, i) : 0;
+        }
+        ProcessSample(arrSamples);
+    }
+}
+
+/* 处理一个采样点的所有声道 */
+void LoudnessMeter::ProcessSample(double *pSamples)
+{
+    for (int ch = 0; ch < m_nChannels; ch++)
+    {
+        double x = pSamples[ch];
+
+        if (m_bTruePeak)
+        {
+            m_dPeak = FFMAX(m_dPeak, TruePeakSample(ch, x));
+        }
+        else
+        {
+            m_dPeak = FFMAX(m_dPeak, fabs(x));
+        }
+
+        // 两级双二阶滤波（直接II型转置）
+        for (int s = 0; s < 2; s++)
+        {
+            double *st = m_arrState[ch][s];
+            double y = m_arrB[s][0] * x + st[0];
+            st[0] = m_arrB[s][1] * x - m_arrA[s][1] * y + st[1];
+            st[1] = m_arrB[s][2] * x - m_arrA[s][2] * y;
+            x = y;
+        }
+        m_dSubBlockEnergy += m_arrWeights[ch] * x * x;
+    }
+    if (m_bTruePeak)
+    {
+        m_nTpPos = (m_nTpPos + 1) % LOUDNESS_TP_TAPS;
+    }
+
+    if (++m_nSubBlockFill < m_nSubBlockSize)
+    {
+        return;
+    }
+
+    // 满 100ms，与前3个 100ms 组成一个 400ms 块
+    m_arrSubBlocks[m_nSubBlocks % 4] = m_dSubBlockEnergy / m_nSubBlockSize;
+    m_nSubBlocks++;
+    m_nSubBlockFill = 0;
+    m_dSubBlockEnergy = 0;
+    if (m_nSubBlocks < 4)
+    {
+        return;
+    }
+
+    double dEnergy = (m_arrSubBlocks[0] + m_arrSubBlocks[1] + m_arrSubBlocks[2] + m_arrSubBlocks[3]) / 4;
+    if (dEnergy <= 0)
+    {
+        return;
+    }
+    double dLoudness = -0.691 + 10.0 * log10(dEnergy);
+    if (dLoudness < -70.0)
+    {
+        return;
+    }
+    int nBin = FFMIN(LOUDNESS_HIST_BINS - 1, (int)((dLoudness + 70.0) * 10.0));
+    m_vecHist[nBin]++;
+    m_nBlocks++;
+}
+
+/* 真峰值：把当前样本放入历史，计算4个插值相位的最大绝对值 */
+double LoudnessMeter::TruePeakSample(int nChannel, double dSample)
+{
+    double *pHistory = m_arrTpHistory[nChannel];
+    double dMax = 0;
+
+    pHistory[m_nTpPos] = dSample;
+    for (int p = 0; p < LOUDNESS_TP_PHASES; p++)
+    {
+        double y = 0;
+        for (int k = 0; k < LOUDNESS_TP_TAPS; k++)
+        {
+            int nIndex = (m_nTpPos - k + LOUDNESS_TP_TAPS) % LOUDNESS_TP_TAPS;
+            y += pHistory[nIndex] * m_vecTpCoeffs[k * LOUDNESS_TP_PHASES + p];
+        }
+        dMax = FFMAX(dMax, fabs(y));
+    }
+    return dMax;
+}
+
+/* 综合响度：先用绝对门限的平均能量得到相对门限，再对相对门限以上的块求平均 */
+double LoudnessMeter::Integrated() const
+{
+    double dEnergy = 0;
+    int64_t nCount = 0;
+
+    for (int i = 0; i < (int)m_vecHist.size(); i++)
+    {
+        dEnergy += m_vecHist[i] * hist_bin_energy(i);
+        nCount += m_vecHist[i];
+    }
+    if (!nCount)
+    {
+        return -HUGE_VAL;
+    }
+
+    double dRelativeGate = -0.691 + 10.0 * log10(dEnergy / nCount) - 10.0;
+    int nStart = FFMAX(0, (int)ceil((dRelativeGate + 70.0) * 10.0));
+
+    dEnergy = 0;
+    nCount = 0;
+    for (int i = nStart; i < (int)m_vecHist.size(); i++)
+    {
+        dEnergy += m_vecHist[i] * hist_bin_energy(i);
+        nCount += m_vecHist[i];
+    }
+    if (!nCount)
+    {
+        return -HUGE_VAL;
+    }
+    return -0.691 + 10.0 * log10(dEnergy / nCount);
+}
+
+double LoudnessMeter::Peak() const
+{
+    return m_dPeak > 0 ? 20.0 * log10(m_dPeak) : -HUGE_VAL;
+}
+
+/* 标准化增益 */
+float LoudnessMeter::NormalizeGain(double dIntegrated, double dPeak)
+{
+    if (!std::isfinite(dIntegrated))
+    {
+        return 1.0f;
+    }
+
+    double dGain = FFMIN(LOUDNESS_TARGET - dIntegrated, LOUDNESS_MAX_BOOST);
+    if (std::isfinite(dPeak))
+    {
+        dGain = FFMIN(dGain, LOUDNESS_PEAK_CEILING - dPeak);
+    }
+    return (float)pow(10.0, dGain / 20.0);
+}
+
+/* 缓存键：文件路径、大小和修改时间的哈希 */
+QString LoudnessAnalyzer::CacheKey(const QString &strFile)
+{
+    QFileInfo stInfo(strFile);
+    QString strKey = QString("%1|%2|%3").arg(stInfo.absoluteFilePath())
+            .arg(stInfo.size()).arg(stInfo.lastModified().toMSecsSinceEpoch());
+    return QString("loudness/") + QCryptographicHash::hash(strKey.toUtf8(), QCryptographicHash::Sha1).toHex();
+}
+
+bool LoudnessAnalyzer::Lookup(const QString &strFile, LoudnessInfo &info)
+{
+    QSettings settings(LOUDNESS_CACHE, QSettings::IniFormat);
+    QStringList listValue = settings.value(CacheKey(strFile)).toStringList();
+    if (listValue.size() != 2)
+    {
+        return false;
+    }
+
+    info.integrated = listValue.at(0).toDouble();
+    info.true_peak = listValue.at(1).toDouble();
+    return true;
+}
+
+void LoudnessAnalyzer::Save(const QString &strFile, const LoudnessInfo &info)
+{
+    QSettings settings(LOUDNESS_CACHE, QSettings::IniFormat);
+    QStringList listValue = { QString::number(info.integrated), QString::number(info.true_peak) };
+    settings.setValue(CacheKey(strFile), listValue);
+}
+
+/* 分析整个文件的音频 */
+int LoudnessAnalyzer::Analyze(const char *filename, LoudnessInfo *info, const AVIOInterruptCB *interrupt)
+{
+    AVFormatContext *ic = NULL;
+    AVCodecContext *avctx = NULL;
+    AVCodec *codec = NULL;
+    AVPacket *pkt = NULL;
+    AVFrame *frame = NULL;
+    LoudnessMeter meter;
+    int stream_index, ret;
+
+    ic = avformat_alloc_context();
+    if (!ic)
+        return AVERROR(ENOMEM);
+    ic->interrupt_callback = *interrupt;
+
+    ret = avformat_open_input(&ic, filename, NULL, NULL);
+    if (ret < 0)
+        return ret;
+    if ((ret = avformat_find_stream_info(ic, NULL)) < 0)
+        goto fail;
+
+    stream_index = av_find_best_stream(ic, AVMEDIA_TYPE_AUDIO, -1, -1, &codec, 0);
+    if (stream_index < 0) {
+        ret = stream_index;
+        goto fail;
+    }
+    for (unsigned int i = 0; i < ic->nb_streams; i++)
+        ic->streams[i]->discard = (int)i == stream_index ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+
+    avctx = avcodec_alloc_context3(NULL);
+    pkt = av_packet_alloc();
+    frame = av_frame_alloc();
+    if (!avctx || !pkt || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if ((ret = avcodec_parameters_to_context(avctx, ic->streams[stream_index]->codecpar)) < 0)
+        goto fail;
+    avctx->pkt_timebase = ic->streams[stream_index]->time_base;
+    if ((ret = avcodec_open2(avctx, codec, NULL)) < 0)
+        goto fail;
+    if (!meter.Init(avctx->sample_rate, avctx->channels, true)) {
+        ret = AVERROR(EINVAL);
+        goto fail;
+    }
+
+    for (;;) {
+        if (interrupt->callback(interrupt->opaque)) {
+            ret = AVERROR_EXIT;
+            goto fail;
+        }
+
+        ret = av_read_frame(ic, pkt);
+        if (ret < 0) {
+            avcodec_send_packet(avctx, NULL);
+        } else {
+            if (pkt->stream_index == stream_index)
+                avcodec_send_packet(avctx, pkt);
+            av_packet_unref(pkt);
+        }
+
+        while (avcodec_receive_frame(avctx, frame) >= 0)
+            meter.AddFrame(frame);
+
+        if (ret < 0)
+            break;
+    }
+
+    info->integrated = meter.Integrated();
+    info->true_peak = meter.Peak();
+    ret = std::isfinite(info->integrated) ? 0 : AVERROR(EINVAL);
+
+fail:
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+    avcodec_free_context(&avctx);
+    avformat_close_input(&ic);
+    return ret;
+}
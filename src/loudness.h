@@ -0,0 +1,132 @@
+﻿#ifndef LOUDNESS_H
+#define LOUDNESS_H
+
+#include <QString>
+
+#include <vector>
+
+#include "globalhelper.h"
+
+#define LOUDNESS_TARGET -18.0               // 标准化的目标响度（LUFS）
+#define LOUDNESS_PEAK_CEILING -1.0          // 标准化后峰值不超过该电平（dBTP）
+#define LOUDNESS_MAX_BOOST 12.0             // 最大提升（dB）
+#define LOUDNESS_MAX_CHANNELS 8
+#define LOUDNESS_HIST_BINS 751              // 块响度直方图，-70 ~ +5 LUFS，0.1 LU 一档
+#define LOUDNESS_TP_PHASES 4                // 真峰值按4倍过采样估计
+#define LOUDNESS_TP_TAPS 12                 // 过采样滤波器每相位的抽头数
+#define LOUDNESS_LIVE_MIN_BLOCKS 30         // 实时估计至少积累的块数（3秒）才开始使用
+#define LOUDNESS_GAIN_STEP 1.0593f          // 每次音频回调增益最多变化 0.5 dB，避免切换时跳变
+
+//文件的响度分析结果
+typedef struct LoudnessInfo {
+    double integrated;  // 综合响度（LUFS）
+    double true_peak;   // 真峰值（dBTP）
+} LoudnessInfo;
+
+/**
+ * @brief	EBU R128 / ITU-R BS.1770 响度计
+ *
+ * K计权滤波后按 400ms 块（每 100ms 一块，重叠75%）计算块响度，放入直方图，
+ * 综合响度经 -70 LUFS 绝对门限和 -10 LU 相对门限计算，查询只需遍历直方图。
+ * 可选按4倍过采样估计真峰值，未开启时记录样本峰值。
+ */
+class LoudnessMeter
+{
+public:
+    LoudnessMeter();
+
+    /**
+     * @brief	初始化
+     *
+     * @param	nSampleRate 采样率
+     * @param	nChannels 声道数，超过 LOUDNESS_MAX_CHANNELS 的声道忽略
+     * @param	bTruePeak 是否计算真峰值
+     * @return	true 成功 false 参数不支持
+     */
+    bool Init(int nSampleRate, int nChannels, bool bTruePeak);
+
+    /**
+     * @brief	加入解码得到的音频帧，支持所有 packed/planar 的 S16/S32/FLT/DBL 格式
+     */
+    void AddFrame(const AVFrame *frame);
+
+    /**
+     * @brief	综合响度（LUFS），没有有效块时为 -HUGE_VAL
+     */
+    double Integrated() const;
+
+    /**
+     * @brief	峰值电平（dBTP 或 dBFS）
+     */
+    double Peak() const;
+
+    int BlockCount() const { return m_nBlocks; }
+
+    /**
+     * @brief	计算标准化增益：达到目标响度，同时峰值不超过上限
+     *
+     * @return	线性增益，响度无效时为 1
+     */
+    static float NormalizeGain(double dIntegrated, double dPeak);
+
+private:
+    void ProcessSample(double *pSamples);
+    double TruePeakSample(int nChannel, double dSample);
+
+private:
+    int m_nChannels;
+    bool m_bTruePeak;
+    double m_arrWeights[LOUDNESS_MAX_CHANNELS];
+
+    // K计权：高频搁架滤波器 + RLB高通滤波器，每声道两级双二阶
+    double m_arrB[2][3], m_arrA[2][3];
+    double m_arrState[LOUDNESS_MAX_CHANNELS][2][4];
+
+    int m_nSubBlockSize;            ///< 100ms 的样本数
+    int m_nSubBlockFill;
+    double m_dSubBlockEnergy;       ///< 当前 100ms 内按声道加权的平方和
+    double m_arrSubBlocks[4];       ///< 最近4个 100ms 的均方值
+    int m_nSubBlocks;
+    int m_nBlocks;
+    std::vector<uint32_t> m_vecHist;
+
+    std::vector<double> m_vecTpCoeffs;
+    double m_arrTpHistory[LOUDNESS_MAX_CHANNELS][LOUDNESS_TP_TAPS];
+    int m_nTpPos;
+    double m_dPeak;                 ///< 线性峰值
+};
+
+/**
+ * @brief	文件响度分析与缓存
+ *
+ * 分析结果按文件路径、大小和修改时间缓存在临时目录的 ini 文件中，
+ * 同一文件再次播放时直接使用缓存的增益。
+ */
+class LoudnessAnalyzer
+{
+public:
+    /**
+     * @brief	查询缓存的分析结果
+     */
+    static bool Lookup(const QString &strFile, LoudnessInfo &info);
+
+    /**
+     * @brief	保存分析结果
+     */
+    static void Save(const QString &strFile, const LoudnessInfo &info);
+
+    /**
+     * @brief	只解码音频流，测量整个文件的综合响度和真峰值
+     *
+     * @param	filename 媒体文件
+     * @param	info 分析结果
+     * @param	interrupt 中断回调，返回非0时中止
+     * @return	0 成功 <0 失败或被中止
+     */
+    static int Analyze(const char *filename, LoudnessInfo *info, const AVIOInterruptCB *interrupt);
+
+private:
+    static QString CacheKey(const QString &strFile);
+};
+
+#endif // LOUDNESS_H
@@ -15,6 +15,9 @@
 #include "ui_mainwid.h"
 #include "globalhelper.h"
 #include "videoctl.h"
+#include "profiler.h"
+#include "livelatency.h"
+#include "timeshift.h"
 
 const int FULLSCREEN_MOUSE_DETECT_TIME = 500;
 
@@ -30,7 +33,13 @@ MainWid::MainWid(QMainWindow *parent) :
     m_stActExit(this),
     m_stActAbout(this),
     m_stActOpen(this),
-    m_stActFullscreen(this)
+    m_stActFullscreen(this),
+    m_stActMosaic(this),
+    m_stPlayEndActionGroup(this),
+    m_stResamplerModeGroup(this),
+    m_stLiveTargetGroup(this),
+    m_stTimeshiftWindowGroup(this),
+    m_stVideoCtl(this)
 {
     ui->setupUi(this);
     //无边框、无系统菜单、 任务栏点击最小化
@@ -77,6 +86,8 @@ MainWid::MainWid(QMainWindow *parent) :
 //析构函数释放窗口
 MainWid::~MainWid()
 {
+    // 先停止播放，播放窗口随 ui 一起销毁
+    m_stVideoCtl.StopPlay();
     delete ui;
 }
 
@@ -100,6 +111,12 @@ bool MainWid::Init()
 //         pHelper->setRubberBandOnMove(true);  //设置橡皮筋效果-可移动
 //         pHelper->setRubberBandOnResize(true);  //设置橡皮筋效果-可缩放
 
+    //初始化播放引擎
+    if (m_stVideoCtl.Init() == false)
+    {
+        return false;
+    }
+
     //连接自定义信号与槽
     if (ConnectSignalSlots() == false)
     {
@@ -108,7 +125,7 @@ bool MainWid::Init()
 
     if (ui->CtrlBarWid->Init() == false ||
             m_stPlaylist.Init() == false ||
-            ui->ShowWid->Init() == false ||
+            ui->ShowWid->Init(&m_stVideoCtl) == false ||
             m_stTitle.Init() == false)
     {
         return false;
@@ -130,6 +147,110 @@ bool MainWid::Init()
     m_stActOpen.setText("打开文件");
     m_stMenu.addAction(&m_stActOpen);
 
+    m_stActMosaic.setText("多画面监控");
+    m_stMenu.addAction(&m_stActMosaic);
+
+    //播放结束后的动作，顺序与 PlayEndAction 一致
+    QMenu *pPlayEndMenu = m_stMenu.addMenu("播放结束后");
+    QStringList listPlayEnd = { "停止", "单个循环", "列表循环" };
+    int nPlayEndAction = GlobalHelper::GetPlayEndAction();
+    for (int i = 0; i < listPlayEnd.size(); i++)
+    {
+        QAction *pAction = m_stPlayEndActionGroup.addAction(listPlayEnd.at(i));
+        pAction->setData(i);
+        pAction->setCheckable(true);
+        pAction->setChecked(i == nPlayEndAction);
+        pPlayEndMenu->addAction(pAction);
+    }
+    m_stVideoCtl.SetPlayEndAction(nPlayEndAction);
+
+    //按 EBU R128 统一各文件的响度
+    m_stActLoudnessNorm.setText("音量标准化");
+    m_stActLoudnessNorm.setCheckable(true);
+    m_stActLoudnessNorm.setChecked(GlobalHelper::GetLoudnessNormalization());
+    m_stMenu.addAction(&m_stActLoudnessNorm);
+    m_stVideoCtl.SetLoudnessNormalization(m_stActLoudnessNorm.isChecked());
+
+    //重采样质量，顺序与 ResamplerMode 一致
+    QMenu *pResamplerMenu = m_stMenu.addMenu("重采样质量");
+    QStringList listResampler = { "自动", "快速", "标准", "高质量" };
+    int nResamplerMode = GlobalHelper::GetResamplerMode();
+    for (int i = 0; i < listResampler.size(); i++)
+    {
+        QAction *pAction = m_stResamplerModeGroup.addAction(listResampler.at(i));
+        pAction->setData(i);
+        pAction->setCheckable(true);
+        pAction->setChecked(i == nResamplerMode);
+        pResamplerMenu->addAction(pAction);
+    }
+    m_stVideoCtl.SetResamplerMode(nResamplerMode);
+
+    //音视频同步跟踪，排查音画不同步用，不保存设置
+    QMenu *pSyncTraceMenu = m_stMenu.addMenu("同步跟踪");
+    m_stActSyncTrace.setText("记录");
+    m_stActSyncTrace.setCheckable(true);
+    pSyncTraceMenu->addAction(&m_stActSyncTrace);
+    m_stActSyncTraceExport.setText("导出...");
+    pSyncTraceMenu->addAction(&m_stActSyncTraceExport);
+
+    //直播：实时流按目标延迟调速追赶、写入磁盘时移，从下一个文件开始生效
+    QMenu *pLiveMenu = m_stMenu.addMenu("直播");
+    m_stActLiveMode.setText("低延迟模式");
+    m_stActLiveMode.setCheckable(true);
+    m_stActLiveMode.setChecked(GlobalHelper::GetLiveMode());
+    pLiveMenu->addAction(&m_stActLiveMode);
+    m_stVideoCtl.SetLiveMode(m_stActLiveMode.isChecked());
+
+    QMenu *pLiveTargetMenu = pLiveMenu->addMenu("目标延迟");
+    QList<double> listLiveTarget = { 0.5, 1.0, 2.0, 3.0, 5.0 };
+    double dLiveTarget = GlobalHelper::GetLiveTargetLatency();
+    for (double dTarget : listLiveTarget)
+    {
+        QAction *pAction = m_stLiveTargetGroup.addAction(QString("%1 秒").arg(dTarget));
+        pAction->setData(dTarget);
+        pAction->setCheckable(true);
+        pAction->setChecked(qAbs(dTarget - dLiveTarget) < 0.01);
+        pLiveTargetMenu->addAction(pAction);
+    }
+    m_stVideoCtl.SetLiveTargetLatency(dLiveTarget);
+
+    pLiveMenu->addSeparator();
+    m_stActTimeshift.setText("时移");
+    m_stActTimeshift.setCheckable(true);
+    m_stActTimeshift.setChecked(GlobalHelper::GetTimeshift());
+    pLiveMenu->addAction(&m_stActTimeshift);
+    m_stVideoCtl.SetTimeshift(m_stActTimeshift.isChecked());
+
+    QMenu *pTimeshiftWindowMenu = pLiveMenu->addMenu("时移窗口");
+    QStringList listWindowText = { "10 分钟", "30 分钟", "1 小时", "2 小时", "4 小时" };
+    QList<double> listWindow = { 600, 1800, 3600, 7200, 14400 };
+    double dWindow = GlobalHelper::GetTimeshiftWindow();
+    for (int i = 0; i < listWindow.size(); i++)
+    {
+        QAction *pAction = m_stTimeshiftWindowGroup.addAction(listWindowText.at(i));
+        pAction->setData(listWindow.at(i));
+        pAction->setCheckable(true);
+        pAction->setChecked(qAbs(listWindow.at(i) - dWindow) < 1);
+        pTimeshiftWindowMenu->addAction(pAction);
+    }
+    m_stVideoCtl.SetTimeshiftWindow(dWindow);
+
+    m_stActTimeshiftLive.setText("回到直播");
+    pLiveMenu->addAction(&m_stActTimeshiftLive);
+
+    pLiveMenu->addSeparator();
+    m_stActLiveStatsExport.setText("导出直播统计...");
+    pLiveMenu->addAction(&m_stActLiveStatsExport);
+
+#ifdef CTTV_PROFILE
+    //性能统计，只在编译时开启 CTTV_PROFILE 后提供
+    QMenu *pProfileMenu = m_stMenu.addMenu("性能统计");
+    m_stActProfileDump.setText("导出...");
+    pProfileMenu->addAction(&m_stActProfileDump);
+    m_stActProfileReset.setText("清空");
+    pProfileMenu->addAction(&m_stActProfileReset);
+#endif
+
     m_stActAbout.setText("关于我们");
     m_stMenu.addAction(&m_stActAbout);
     
@@ -176,21 +297,31 @@ bool MainWid::ConnectSignalSlots()
     //连接处理显示窗口的各种操作信号，调用视频控制器或其他相关槽函数
     connect(ui->ShowWid, &Show::SigOpenFile, &m_stPlaylist, &Playlist::OnAddFileAndPlay);
     connect(ui->ShowWid, &Show::SigFullScreen, this, &MainWid::OnFullScreenPlay);
-    connect(ui->ShowWid, &Show::SigPlayOrPause, VideoCtl::GetInstance(), &VideoCtl::OnPause);
-    connect(ui->ShowWid, &Show::SigStop, VideoCtl::GetInstance(), &VideoCtl::OnStop);
+    connect(ui->ShowWid, &Show::SigPlayOrPause, &m_stVideoCtl, &VideoCtl::OnPause);
+    connect(ui->ShowWid, &Show::SigStop, &m_stVideoCtl, &VideoCtl::OnStop);
     connect(ui->ShowWid, &Show::SigShowMenu, this, &MainWid::OnShowMenu);
-    connect(ui->ShowWid, &Show::SigSeekForward, VideoCtl::GetInstance(), &VideoCtl::OnSeekForward);
-    connect(ui->ShowWid, &Show::SigSeekBack, VideoCtl::GetInstance(), &VideoCtl::OnSeekBack);
-    connect(ui->ShowWid, &Show::SigAddVolume, VideoCtl::GetInstance(), &VideoCtl::OnAddVolume);
-    connect(ui->ShowWid, &Show::SigSubVolume, VideoCtl::GetInstance(), &VideoCtl::OnSubVolume);
+    connect(ui->ShowWid, &Show::SigSeekForward, &m_stVideoCtl, &VideoCtl::OnSeekForward);
+    connect(ui->ShowWid, &Show::SigSeekBack, &m_stVideoCtl, &VideoCtl::OnSeekBack);
+    connect(ui->ShowWid, &Show::SigAddVolume, &m_stVideoCtl, &VideoCtl::OnAddVolume);
+    connect(ui->ShowWid, &Show::SigSubVolume, &m_stVideoCtl, &VideoCtl::OnSubVolume);
 
     //连接处理控制栏的各种操作信号，调用视频控制器、播放列表或其他相关槽函数
-    connect(ui->CtrlBarWid, &CtrlBar::SigSpeed, VideoCtl::GetInstance(), &VideoCtl::OnSpeed);
+    connect(ui->CtrlBarWid, &CtrlBar::SigSetSpeed, &m_stVideoCtl, &VideoCtl::OnSetSpeed);
+    connect(ui->ShowWid, &Show::SigSpeedStep, &m_stVideoCtl, &VideoCtl::OnSpeedStep);
+    connect(this, &MainWid::SigSpeedStep, &m_stVideoCtl, &VideoCtl::OnSpeedStep);
+    connect(ui->ShowWid, &Show::SigFastForward, &m_stVideoCtl, &VideoCtl::OnFastForward);
+    connect(ui->ShowWid, &Show::SigFastRewind, &m_stVideoCtl, &VideoCtl::OnFastRewind);
+    connect(this, &MainWid::SigFastForward, &m_stVideoCtl, &VideoCtl::OnFastForward);
+    connect(this, &MainWid::SigFastRewind, &m_stVideoCtl, &VideoCtl::OnFastRewind);
+    connect(ui->ShowWid, &Show::SigReverseToggle, &m_stVideoCtl, &VideoCtl::OnToggleReverse);
+    connect(ui->ShowWid, &Show::SigStepBackward, &m_stVideoCtl, &VideoCtl::OnStepBackward);
+    connect(this, &MainWid::SigReverseToggle, &m_stVideoCtl, &VideoCtl::OnToggleReverse);
+    connect(this, &MainWid::SigStepBackward, &m_stVideoCtl, &VideoCtl::OnStepBackward);
     connect(ui->CtrlBarWid, &CtrlBar::SigShowOrHidePlaylist, this, &MainWid::OnShowOrHidePlaylist);
-    connect(ui->CtrlBarWid, &CtrlBar::SigPlaySeek, VideoCtl::GetInstance(), &VideoCtl::OnPlaySeek);
-    connect(ui->CtrlBarWid, &CtrlBar::SigPlayVolume, VideoCtl::GetInstance(), &VideoCtl::OnPlayVolume);
-    connect(ui->CtrlBarWid, &CtrlBar::SigPlayOrPause, VideoCtl::GetInstance(), &VideoCtl::OnPause);
-    connect(ui->CtrlBarWid, &CtrlBar::SigStop, VideoCtl::GetInstance(), &VideoCtl::OnStop);
+    connect(ui->CtrlBarWid, &CtrlBar::SigPlaySeek, &m_stVideoCtl, &VideoCtl::OnPlaySeek);
+    connect(ui->CtrlBarWid, &CtrlBar::SigPlayVolume, &m_stVideoCtl, &VideoCtl::OnPlayVolume);
+    connect(ui->CtrlBarWid, &CtrlBar::SigPlayOrPause, &m_stVideoCtl, &VideoCtl::OnPause);
+    connect(ui->CtrlBarWid, &CtrlBar::SigStop, &m_stVideoCtl, &VideoCtl::OnStop);
     connect(ui->CtrlBarWid, &CtrlBar::SigBackwardPlay, &m_stPlaylist, &Playlist::OnBackwardPlay);
     connect(ui->CtrlBarWid, &CtrlBar::SigForwardPlay, &m_stPlaylist, &Playlist::OnForwardPlay);
     connect(ui->CtrlBarWid, &CtrlBar::SigShowMenu, this, &MainWid::OnShowMenu);
@@ -198,23 +329,28 @@ bool MainWid::ConnectSignalSlots()
 
     //连接处理主窗口的各种操作信号，调用视频控制器、播放列表或标题栏的相关槽函数
     connect(this, &MainWid::SigShowMax, &m_stTitle, &Title::OnChangeMaxBtnStyle);
-    connect(this, &MainWid::SigSeekForward, VideoCtl::GetInstance(), &VideoCtl::OnSeekForward);
-    connect(this, &MainWid::SigSeekBack, VideoCtl::GetInstance(), &VideoCtl::OnSeekBack);
-    connect(this, &MainWid::SigAddVolume, VideoCtl::GetInstance(), &VideoCtl::OnAddVolume);
-    connect(this, &MainWid::SigSubVolume, VideoCtl::GetInstance(), &VideoCtl::OnSubVolume);
+    connect(this, &MainWid::SigSeekForward, &m_stVideoCtl, &VideoCtl::OnSeekForward);
+    connect(this, &MainWid::SigSeekBack, &m_stVideoCtl, &VideoCtl::OnSeekBack);
+    connect(this, &MainWid::SigAddVolume, &m_stVideoCtl, &VideoCtl::OnAddVolume);
+    connect(this, &MainWid::SigSubVolume, &m_stVideoCtl, &VideoCtl::OnSubVolume);
     connect(this, &MainWid::SigOpenFile, &m_stPlaylist, &Playlist::OnAddFileAndPlay);
     
     //连接处理视频控制器的各种信号，调用控制栏、显示窗口或标题栏的相关槽函数
-    connect(VideoCtl::GetInstance(), &VideoCtl::SigSpeed, ui->CtrlBarWid, &CtrlBar::OnSpeed);
-    connect(VideoCtl::GetInstance(), &VideoCtl::SigVideoTotalSeconds, ui->CtrlBarWid, &CtrlBar::OnVideoTotalSeconds);
-    connect(VideoCtl::GetInstance(), &VideoCtl::SigVideoPlaySeconds, ui->CtrlBarWid, &CtrlBar::OnVideoPlaySeconds);
-    connect(VideoCtl::GetInstance(), &VideoCtl::SigVideoVolume, ui->CtrlBarWid, &CtrlBar::OnVideopVolume);
-    connect(VideoCtl::GetInstance(), &VideoCtl::SigPauseStat, ui->CtrlBarWid, &CtrlBar::OnPauseStat, Qt::QueuedConnection);
-    connect(VideoCtl::GetInstance(), &VideoCtl::SigStopFinished, ui->CtrlBarWid, &CtrlBar::OnStopFinished, Qt::QueuedConnection);
-    connect(VideoCtl::GetInstance(), &VideoCtl::SigStopFinished, ui->ShowWid, &Show::OnStopFinished, Qt::QueuedConnection);
-    connect(VideoCtl::GetInstance(), &VideoCtl::SigFrameDimensionsChanged, ui->ShowWid, &Show::OnFrameDimensionsChanged, Qt::QueuedConnection);
-    connect(VideoCtl::GetInstance(), &VideoCtl::SigStopFinished, &m_stTitle, &Title::OnStopFinished, Qt::DirectConnection);
-    connect(VideoCtl::GetInstance(), &VideoCtl::SigStartPlay, &m_stTitle, &Title::OnPlay, Qt::DirectConnection);
+    connect(&m_stVideoCtl, &VideoCtl::SigSpeed, ui->CtrlBarWid, &CtrlBar::OnSpeed);
+    connect(&m_stVideoCtl, &VideoCtl::SigScan, ui->CtrlBarWid, &CtrlBar::OnScan);
+    connect(&m_stVideoCtl, &VideoCtl::SigReverse, ui->CtrlBarWid, &CtrlBar::OnReverse);
+    connect(&m_stVideoCtl, &VideoCtl::SigVideoTotalSeconds, ui->CtrlBarWid, &CtrlBar::OnVideoTotalSeconds);
+    connect(&m_stVideoCtl, &VideoCtl::SigVideoPlaySeconds, ui->CtrlBarWid, &CtrlBar::OnVideoPlaySeconds);
+    connect(&m_stVideoCtl, &VideoCtl::SigVideoVolume, ui->CtrlBarWid, &CtrlBar::OnVideopVolume);
+    connect(&m_stVideoCtl, &VideoCtl::SigPauseStat, ui->CtrlBarWid, &CtrlBar::OnPauseStat, Qt::QueuedConnection);
+    connect(&m_stVideoCtl, &VideoCtl::SigStopFinished, ui->CtrlBarWid, &CtrlBar::OnStopFinished, Qt::QueuedConnection);
+    connect(&m_stVideoCtl, &VideoCtl::SigStopFinished, ui->ShowWid, &Show::OnStopFinished, Qt::QueuedConnection);
+    connect(&m_stVideoCtl, &VideoCtl::SigFrameDimensionsChanged, ui->ShowWid, &Show::OnFrameDimensionsChanged, Qt::QueuedConnection);
+    connect(&m_stVideoCtl, &VideoCtl::SigStopFinished, &m_stTitle, &Title::OnStopFinished, Qt::DirectConnection);
+    connect(&m_stVideoCtl, &VideoCtl::SigStartPlay, &m_stTitle, &Title::OnPlay, Qt::DirectConnection);
+    // 排在上一个文件的停止通知之后处理
+    connect(&m_stVideoCtl, &VideoCtl::SigStartPlay, ui->CtrlBarWid, &CtrlBar::OnStartPlay, Qt::QueuedConnection);
+    connect(&m_stVideoCtl, &VideoCtl::SigPlayNext, &m_stPlaylist, &Playlist::OnForwardPlay, Qt::QueuedConnection);
 
     //连接控制栏动画计时器的超时信号，调用 OnCtrlBarAnimationTimeOut 槽函数
     connect(&m_stCtrlBarAnimationTimer, &QTimer::timeout, this, &MainWid::OnCtrlBarAnimationTimeOut);
@@ -227,6 +363,22 @@ bool MainWid::ConnectSignalSlots()
     connect(&m_stActFullscreen, &QAction::triggered, this, &MainWid::OnFullScreenPlay);
     connect(&m_stActExit, &QAction::triggered, this, &MainWid::OnCloseBtnClicked);
     connect(&m_stActOpen, &QAction::triggered, this, &MainWid::OpenFile);
+    connect(&m_stActMosaic, &QAction::triggered, this, &MainWid::OnOpenMosaic);
+    connect(&m_stPlayEndActionGroup, &QActionGroup::triggered, this, &MainWid::OnPlayEndActionTriggered);
+    connect(&m_stResamplerModeGroup, &QActionGroup::triggered, this, &MainWid::OnResamplerModeTriggered);
+    connect(&m_stActLoudnessNorm, &QAction::toggled, this, &MainWid::OnLoudnessNormToggled);
+    connect(&m_stActSyncTrace, &QAction::toggled, this, &MainWid::OnSyncTraceToggled);
+    connect(&m_stActSyncTraceExport, &QAction::triggered, this, &MainWid::OnSyncTraceExport);
+    connect(&m_stActLiveMode, &QAction::toggled, this, &MainWid::OnLiveModeToggled);
+    connect(&m_stLiveTargetGroup, &QActionGroup::triggered, this, &MainWid::OnLiveTargetTriggered);
+    connect(&m_stActLiveStatsExport, &QAction::triggered, this, &MainWid::OnLiveStatsExport);
+    connect(&m_stActTimeshift, &QAction::toggled, this, &MainWid::OnTimeshiftToggled);
+    connect(&m_stTimeshiftWindowGroup, &QActionGroup::triggered, this, &MainWid::OnTimeshiftWindowTriggered);
+    connect(&m_stActTimeshiftLive, &QAction::triggered, &m_stVideoCtl, &VideoCtl::OnTimeshiftLive);
+#ifdef CTTV_PROFILE
+    connect(&m_stActProfileDump, &QAction::triggered, this, &MainWid::OnProfileDump);
+    connect(&m_stActProfileReset, &QAction::triggered, this, &MainWid::OnProfileReset);
+#endif
     
     return true;
 }
@@ -265,6 +417,24 @@ void MainWid::keyReleaseEvent(QKeyEvent *event)
     case Qt::Key_Space://暂停播放
         emit SigPlayOrPause();
         break; 
+    case Qt::Key_BracketLeft://减速
+        emit SigSpeedStep(-1);
+        break;
+    case Qt::Key_BracketRight://加速
+        emit SigSpeedStep(1);
+        break;
+    case Qt::Key_Period://关键帧快进
+        emit SigFastForward();
+        break;
+    case Qt::Key_Comma://关键帧快退
+        emit SigFastRewind();
+        break;
+    case Qt::Key_R://倒放
+        emit SigReverseToggle();
+        break;
+    case Qt::Key_B://后退一帧
+        emit SigStepBackward();
+        break;
     default:
         break;
     }
@@ -461,6 +631,18 @@ void MainWid::OpenFile()
     emit SigOpenFile(strFileName);
 }
 
+// 多画面监控：选择多个文件在同一窗口中同时播放
+void MainWid::OnOpenMosaic()
+{
+    QStringList listFiles = QFileDialog::getOpenFileNames(this, "选择要同时播放的文件", QDir::homePath(),
+                                                          "视频文件(*.mkv *.rmvb *.mp4 *.avi *.flv *.wmv *.3gp *.ts)");
+    if (listFiles.isEmpty())
+    {
+        return;
+    }
+    m_stMosaicWid.Play(listFiles);
+}
+
 // 显示设置窗口处理函数
 void MainWid::OnShowSettingWid()
 {
@@ -468,6 +650,162 @@ void MainWid::OnShowSettingWid()
     m_stSettingWid.show();
 }
 
+// 播放结束动作菜单处理函数
+void MainWid::OnPlayEndActionTriggered(QAction *action)
+{
+    int nAction = action->data().toInt();
+    m_stVideoCtl.SetPlayEndAction(nAction);
+    GlobalHelper::SavePlayEndAction(nAction);
+}
+
+// 响度标准化菜单处理函数
+void MainWid::OnLoudnessNormToggled(bool bChecked)
+{
+    m_stVideoCtl.SetLoudnessNormalization(bChecked);
+    GlobalHelper::SaveLoudnessNormalization(bChecked);
+}
+
+// 重采样质量菜单处理函数
+void MainWid::OnResamplerModeTriggered(QAction *action)
+{
+    int nMode = action->data().toInt();
+    m_stVideoCtl.SetResamplerMode(nMode);
+    GlobalHelper::SaveResamplerMode(nMode);
+}
+
+// 同步跟踪记录菜单处理函数
+void MainWid::OnSyncTraceToggled(bool bChecked)
+{
+    if (!m_stVideoCtl.SetSyncTrace(bChecked))
+    {
+        qDebug() << "同步跟踪缓冲分配失败";
+        m_stActSyncTrace.setChecked(false);
+    }
+}
+
+// 导出同步跟踪，可用 Perfetto 或 chrome://tracing 打开
+void MainWid::OnSyncTraceExport()
+{
+    QString strFileName = QFileDialog::getSaveFileName(this, "导出同步跟踪", QDir::homePath() + "/sync_trace.json",
+                                                       "Chrome trace(*.json)");
+    if (strFileName.isEmpty())
+    {
+        return;
+    }
+    int nCount = m_stVideoCtl.ExportSyncTrace(strFileName);
+    qDebug() << "导出同步跟踪" << strFileName << nCount;
+}
+
+// 直播低延迟模式菜单处理函数
+void MainWid::OnLiveModeToggled(bool bChecked)
+{
+    m_stVideoCtl.SetLiveMode(bChecked);
+    GlobalHelper::SaveLiveMode(bChecked);
+}
+
+// 直播目标延迟菜单处理函数
+void MainWid::OnLiveTargetTriggered(QAction *action)
+{
+    double dTarget = action->data().toDouble();
+    m_stVideoCtl.SetLiveTargetLatency(dTarget);
+    GlobalHelper::SaveLiveTargetLatency(dTarget);
+}
+
+// 时移菜单处理函数
+void MainWid::OnTimeshiftToggled(bool bChecked)
+{
+    m_stVideoCtl.SetTimeshift(bChecked);
+    GlobalHelper::SaveTimeshift(bChecked);
+}
+
+// 时移窗口菜单处理函数
+void MainWid::OnTimeshiftWindowTriggered(QAction *action)
+{
+    double dWindow = action->data().toDouble();
+    m_stVideoCtl.SetTimeshiftWindow(dWindow);
+    GlobalHelper::SaveTimeshiftWindow(dWindow);
+}
+
+// 导出当前直播流的延迟分位数、追赶丢帧统计和时移状态
+void MainWid::OnLiveStatsExport()
+{
+    LiveLatencyStats stats;
+    TimeshiftStats stTimeshift;
+    bool bLive = m_stVideoCtl.GetLiveLatencyStats(stats);
+    bool bTimeshift = m_stVideoCtl.GetTimeshiftStats(stTimeshift);
+    if (!bLive && !bTimeshift)
+    {
+        qDebug() << "没有以低延迟模式或时移播放的直播流";
+        return;
+    }
+    QString strFileName = QFileDialog::getSaveFileName(this, "导出直播统计", QDir::homePath() + "/live_stats.txt",
+                                                       "文本文件(*.txt)");
+    if (strFileName.isEmpty())
+    {
+        return;
+    }
+    QFile file(strFileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    {
+        qDebug() << "导出直播统计失败" << strFileName;
+        return;
+    }
+    QString strText;
+    if (bTimeshift)
+    {
+        strText += QString::asprintf("timeshift window %.3f ~ %.3f s, position %.3f s (%.3f s behind live)\n",
+                                     stTimeshift.start, stTimeshift.live, stTimeshift.position,
+                                     stTimeshift.live - stTimeshift.position);
+        strText += QString::asprintf("timeshift %d segments %.1f MB, pending %.1f KB, packets %lld dropped %lld, "
+                                     "write %.3f s (max %.1f ms)\n",
+                                     stTimeshift.segments, stTimeshift.disk_bytes / 1048576.0, stTimeshift.pending_bytes / 1024.0,
+                                     (long long)stTimeshift.packets, (long long)stTimeshift.dropped,
+                                     stTimeshift.write_us / 1000000.0, stTimeshift.max_write_us / 1000.0);
+    }
+    if (!bLive)
+    {
+        file.write(strText.toUtf8());
+        return;
+    }
+    strText += QString::asprintf("target   %.3f s\n", stats.target);
+    strText += QString::asprintf("current  %.3f s\n", stats.current);
+    strText += QString::asprintf("p50      %.3f s\n", stats.p50);
+    strText += QString::asprintf("p90      %.3f s\n", stats.p90);
+    strText += QString::asprintf("p99      %.3f s\n", stats.p99);
+    strText += QString::asprintf("max      %.3f s\n", stats.max);
+    strText += QString::asprintf("samples  %lld\n", (long long)stats.samples);
+    strText += QString::asprintf("catchups %d\n", stats.catchups);
+    strText += QString::asprintf("drops    %d (%.3f s)\n", stats.drops, stats.dropped);
+    strText += QString::asprintf("speed    %.4f, rate %.2f\n", stats.speed, stats.rate);
+    file.write(strText.toUtf8());
+}
+
+#ifdef CTTV_PROFILE
+// 导出各线程的耗时直方图
+void MainWid::OnProfileDump()
+{
+    QString strFileName = QFileDialog::getSaveFileName(this, "导出性能统计", QDir::homePath() + "/profile.txt",
+                                                       "文本文件(*.txt)");
+    if (strFileName.isEmpty())
+    {
+        return;
+    }
+    QFile file(strFileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    {
+        qDebug() << "导出性能统计失败" << strFileName;
+        return;
+    }
+    file.write(Profiler::Dump().toUtf8());
+}
+
+// 清空性能统计，从现在开始重新计时
+void MainWid::OnProfileReset()
+{
+    Profiler::Reset();
+}
+#endif
+
 // 关闭按钮点击处理函数
 void MainWid::OnCloseBtnClicked()
 {
@@ -6,6 +6,7 @@
 #include <QDragEnterEvent>
 #include <QMenu>
 #include <QAction>
+#include <QActionGroup>
 #include <QPropertyAnimation>
 #include <QTimer>
 #include <QMainWindow>
@@ -13,6 +14,8 @@
 #include "playlist.h"
 #include "title.h"
 #include "settingwid.h"
+#include "videoctl.h"
+#include "mosaicwid.h"
 
 namespace Ui {
 class MainWid;
@@ -80,8 +83,23 @@ private:
     void OnShowMenu();
     void OnShowAbout();
     void OpenFile();
+    void OnOpenMosaic();
 
     void OnShowSettingWid();
+    void OnPlayEndActionTriggered(QAction *action);
+    void OnLoudnessNormToggled(bool bChecked);
+    void OnResamplerModeTriggered(QAction *action);
+    void OnSyncTraceToggled(bool bChecked);
+    void OnSyncTraceExport();
+    void OnLiveModeToggled(bool bChecked);
+    void OnLiveTargetTriggered(QAction *action);
+    void OnLiveStatsExport();
+    void OnTimeshiftToggled(bool bChecked);
+    void OnTimeshiftWindowTriggered(QAction *action);
+#ifdef CTTV_PROFILE
+    void OnProfileDump();
+    void OnProfileReset();
+#endif
 
 signals:
     //最大化信号
@@ -89,6 +107,11 @@ signals:
     void SigSeekForward();
     void SigSeekBack();
     void SigAddVolume();
+    void SigSpeedStep(int nSteps);
+    void SigFastForward();
+    void SigFastRewind();
+    void SigReverseToggle();
+    void SigStepBackward();
     void SigSubVolume();
     void SigPlayOrPause();
     void SigOpenFile(QString strFilename);
@@ -131,6 +154,27 @@ private:
     QAction m_stActAbout;
     QAction m_stActOpen;
     QAction m_stActFullscreen;
+    QAction m_stActMosaic;
+    QAction m_stActLoudnessNorm;
+    QAction m_stActSyncTrace;       //< 记录音视频同步跟踪
+    QAction m_stActSyncTraceExport; //< 导出同步跟踪
+    QAction m_stActLiveMode;        //< 直播低延迟模式
+    QAction m_stActLiveStatsExport; //< 导出直播延迟和时移统计
+    QAction m_stActTimeshift;       //< 直播时移
+    QAction m_stActTimeshiftLive;   //< 时移时回到直播
+#ifdef CTTV_PROFILE
+    QAction m_stActProfileDump;     //< 导出性能统计
+    QAction m_stActProfileReset;    //< 清空性能统计
+#endif
+
+    QActionGroup m_stPlayEndActionGroup; //< 播放结束动作（停止/单个循环/列表循环）
+    QActionGroup m_stResamplerModeGroup; //< 重采样质量（自动/快速/标准/高质量）
+    QActionGroup m_stLiveTargetGroup;    //< 直播目标延迟
+    QActionGroup m_stTimeshiftWindowGroup; //< 时移窗口
+
+    MosaicWid m_stMosaicWid; ///< 多画面监控窗口
+
+    VideoCtl m_stVideoCtl; ///< 本窗口的播放引擎
 };
 
 #endif // MainWid_H
@@ -0,0 +1,381 @@
+﻿#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <mutex>
+#endif
+
+#include "mmapio.h"
+
+#pragma execution_character_set("utf-8")
+
+#ifndef _WIN32
+static thread_local sigjmp_buf *volatile s_pCopyJump = NULL;   // 当前线程正在从映射区复制，volatile 防止赋值被优化掉
+static struct sigaction s_stPrevSigbus;
+
+/* 复制映射区时的 SIGBUS 跳回 CopyFromView，其它来源交给原来的处理方式 */
+static void OnSigbus(int, siginfo_t *, void *)
+{
+    if (s_pCopyJump)
+        siglongjmp(*s_pCopyJump, 1);
+    // 恢复原来的处理方式后返回，出错的指令重新执行时由其处理
+    sigaction(SIGBUS, &s_stPrevSigbus, NULL);
+}
+
+static void InstallSigbusHandler()
+{
+    static std::once_flag s_stOnce;
+    std::call_once(s_stOnce, []() {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = OnSigbus;
+        sa.sa_flags = SA_SIGINFO;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGBUS, &sa, &s_stPrevSigbus);
+    });
+}
+#endif
+
+/* 从映射区复制，文件在映射后被截短时返回 AVERROR(EIO) */
+static int CopyFromView(uint8_t *dst, const uint8_t *src, int size)
+{
+#ifndef _WIN32
+    sigjmp_buf jump;
+    if (sigsetjmp(jump, 1))
+    {
+        s_pCopyJump = NULL;
+        return AVERROR(EIO);
+    }
+    s_pCopyJump = &jump;
+    memcpy(dst, src, size);
+    s_pCopyJump = NULL;
+#else
+    // Windows 下映射中的文件不能被截短
+    memcpy(dst, src, size);
+#endif
+    return size;
+}
+
+// 构造函数
+MmapIO::MmapIO() :
+#ifdef _WIN32
+    m_hFile(INVALID_HANDLE_VALUE),
+    m_hMapping(NULL),
+    m_nMappingSize(0),
+#else
+    m_nFd(-1),
+#endif
+    m_nGranularity(4096),
+    m_pView(NULL),
+    m_nViewStart(0),
+    m_nViewSize(0),
+    m_nFileSize(0),
+    m_nPos(0),
+    m_nReadaheadStart(0),
+    m_nReadaheadEnd(0),
+    m_nNextStat(MMAP_IO_STAT_INTERVAL),
+    m_nRemaps(0),
+    m_bFallback(false),
+    m_pAvio(NULL)
+{
+}
+
+// 析构函数
+MmapIO::~MmapIO()
+{
+    if (m_pAvio)
+    {
+        av_freep(&m_pAvio->buffer);
+        avio_context_free(&m_pAvio);
+    }
+    Unmap();
+#ifdef _WIN32
+    if (m_hMapping)
+        CloseHandle(m_hMapping);
+    if (m_hFile != INVALID_HANDLE_VALUE)
+        CloseHandle(m_hFile);
+#else
+    if (m_nFd >= 0)
+        close(m_nFd);
+#endif
+}
+
+bool MmapIO::IsLocalFile(const char *filename)
+{
+    if (av_strstart(filename, "file:", NULL))
+        return true;
+    // Windows 盘符（C:\）不是协议前缀
+    const char *colon = strchr(filename, ':');
+    return !colon || colon - filename == 1;
+}
+
+MmapIO *MmapIO::Open(const char *filename)
+{
+    MmapIO *pIO = new MmapIO();
+    av_strstart(filename, "file:", &filename);
+
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    LARGE_INTEGER size;
+
+    GetSystemInfo(&info);
+    pIO->m_nGranularity = info.dwAllocationGranularity;
+    // 允许其它进程继续写入（录制中的文件）
+    pIO->m_hFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (pIO->m_hFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(pIO->m_hFile, &size))
+    {
+        delete pIO;
+        return NULL;
+    }
+    pIO->m_nFileSize = size.QuadPart;
+#else
+    struct stat st;
+
+    pIO->m_nGranularity = sysconf(_SC_PAGESIZE);
+    pIO->m_nFd = open(filename, O_RDONLY);
+    if (pIO->m_nFd < 0 || fstat(pIO->m_nFd, &st) < 0 || !S_ISREG(st.st_mode))
+    {
+        delete pIO;
+        return NULL;
+    }
+    pIO->m_nFileSize = st.st_size;
+    InstallSigbusHandler();
+#endif
+
+    // 空文件无法映射
+    if (pIO->m_nFileSize <= 0 || pIO->MapView(0) < 0)
+    {
+        delete pIO;
+        return NULL;
+    }
+
+    unsigned char *buffer = (unsigned char *)av_malloc(MMAP_IO_BUFFER_SIZE);
+    if (buffer)
+        pIO->m_pAvio = avio_alloc_context(buffer, MMAP_IO_BUFFER_SIZE, 0, pIO, ReadPacket, NULL, SeekPacket);
+    if (!pIO->m_pAvio)
+    {
+        av_free(buffer);
+        delete pIO;
+        return NULL;
+    }
+    // 直接模式：大块读取不经过内部缓冲，跳转也不在内部缓冲中查找
+    pIO->m_pAvio->direct = 1;
+    return pIO;
+}
+
+/* 映射包含 pos 的窗口 */
+int MmapIO::MapView(int64_t pos)
+{
+    Unmap();
+
+    int64_t start = pos / m_nGranularity * m_nGranularity;
+    int64_t size = FFMIN(MMAP_IO_VIEW_SIZE, m_nFileSize - start);
+    if (size <= 0)
+        return AVERROR_EOF;
+
+#ifdef _WIN32
+    // 映射对象的大小在创建时确定，文件增长后需要重新创建
+    if (!m_hMapping || m_nMappingSize < start + size)
+    {
+        if (m_hMapping)
+            CloseHandle(m_hMapping);
+        m_hMapping = CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        m_nMappingSize = m_nFileSize;
+        if (!m_hMapping)
+            return AVERROR(EIO);
+    }
+    m_pView = (uint8_t *)MapViewOfFile(m_hMapping, FILE_MAP_READ, (DWORD)(start >> 32), (DWORD)start, (SIZE_T)size);
+    if (!m_pView)
+        return AVERROR(EIO);
+#else
+    void *addr = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, m_nFd, (off_t)start);
+    if (addr == MAP_FAILED)
+        return AVERROR(errno);
+    m_pView = (uint8_t *)addr;
+    madvise(m_pView, (size_t)size, MADV_SEQUENTIAL);
+#endif
+
+    m_nViewStart = start;
+    m_nViewSize = size;
+    m_nReadaheadStart = m_nReadaheadEnd = 0;
+    m_nRemaps++;
+    return 0;
+}
+
+void MmapIO::Unmap()
+{
+    if (!m_pView)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(m_pView);
+#else
+    munmap(m_pView, (size_t)m_nViewSize);
+#endif
+    m_pView = NULL;
+    m_nViewSize = 0;
+}
+
+/* 读取位置离开已预读的范围或剩余不足一半时，预读下一段 */
+void MmapIO::Readahead()
+{
+    if (m_nPos >= m_nReadaheadStart && m_nPos + MMAP_IO_READAHEAD / 2 <= m_nReadaheadEnd)
+        return;
+
+    int64_t start = m_nPos < m_nReadaheadStart || m_nPos >= m_nReadaheadEnd ? m_nPos : m_nReadaheadEnd;
+    int64_t end = FFMIN(m_nPos + MMAP_IO_READAHEAD, m_nViewStart + m_nViewSize);
+    start = start / m_nGranularity * m_nGranularity;
+    if (start < m_nViewStart)
+        start = m_nViewStart;
+    if (end <= start)
+        return;
+#ifndef _WIN32
+    madvise(m_pView + (start - m_nViewStart), (size_t)(end - start), MADV_WILLNEED);
+#endif
+    // Windows 下由文件的顺序访问标志和缓存管理器预读
+    if (m_nPos < m_nReadaheadStart || m_nPos >= m_nReadaheadEnd)
+        m_nReadaheadStart = start;
+    m_nReadaheadEnd = end;
+}
+
+/* 重新获取文件大小，变化时丢弃超出新大小或需要扩展的窗口 */
+int64_t MmapIO::RefreshSize()
+{
+    int64_t size = m_nFileSize;
+
+#ifdef _WIN32
+    LARGE_INTEGER li;
+    if (GetFileSizeEx(m_hFile, &li))
+        size = li.QuadPart;
+#else
+    struct stat st;
+    if (!fstat(m_nFd, &st))
+        size = st.st_size;
+#endif
+
+    if (size < m_nFileSize && !m_bFallback)
+    {
+        // 文件被截短或重写，之后的截短可能发生在两次检查之间
+        StartFallback();
+    }
+    if (size != m_nFileSize)
+    {
+        bool bViewAtEnd = m_nViewStart + m_nViewSize == m_nFileSize;
+        if (size < m_nViewStart + m_nViewSize || (size > m_nFileSize && bViewAtEnd && m_nViewSize < MMAP_IO_VIEW_SIZE))
+            Unmap();
+        av_log(NULL, AV_LOG_VERBOSE, "mmapio: file size %" PRId64 " -> %" PRId64 "\n", m_nFileSize, size);
+        m_nFileSize = size;
+    }
+    m_nNextStat = m_nPos + MMAP_IO_STAT_INTERVAL;
+    return m_nFileSize;
+}
+
+int MmapIO::Read(uint8_t *buf, int size)
+{
+    if (m_nPos >= m_nFileSize || m_nPos >= m_nNextStat)
+        RefreshSize();
+    if (m_nPos >= m_nFileSize)
+        return AVERROR_EOF;
+    if (m_bFallback)
+        return ReadFallback(buf, size);
+
+    if (!m_pView || m_nPos < m_nViewStart || m_nPos >= m_nViewStart + m_nViewSize)
+    {
+        int ret = MapView(m_nPos);
+        if (ret < 0)
+            return ret;
+    }
+
+    int64_t available = FFMIN(m_nViewStart + m_nViewSize, m_nFileSize) - m_nPos;
+    int n = (int)FFMIN((int64_t)size, available);
+    Readahead();
+    if (CopyFromView(buf, m_pView + (m_nPos - m_nViewStart), n) < 0)
+    {
+        // 映射区中这部分已超出被截短的文件
+        StartFallback();
+        RefreshSize();
+        if (m_nPos >= m_nFileSize)
+            return AVERROR_EOF;
+        return ReadFallback(buf, size);
+    }
+    m_nPos += n;
+    return n;
+}
+
+/* 放弃映射，之后的读取都使用 ReadFallback */
+void MmapIO::StartFallback()
+{
+    av_log(NULL, AV_LOG_WARNING, "mmapio: file shrank while mapped, falling back to positional reads\n");
+    m_bFallback = true;
+    Unmap();
+}
+
+/* 按位置读取，读到文件末尾时返回实际读到的字节数 */
+int MmapIO::ReadFallback(uint8_t *buf, int size)
+{
+#ifdef _WIN32
+    OVERLAPPED ov;
+    DWORD n = 0;
+
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset = (DWORD)m_nPos;
+    ov.OffsetHigh = (DWORD)(m_nPos >> 32);
+    if (!ReadFile(m_hFile, buf, (DWORD)size, &n, &ov))
+        return GetLastError() == ERROR_HANDLE_EOF ? AVERROR_EOF : AVERROR(EIO);
+#else
+    ssize_t n;
+
+    do {
+        n = pread(m_nFd, buf, (size_t)size, (off_t)m_nPos);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0)
+        return AVERROR(errno);
+#endif
+    if (n == 0)
+        return AVERROR_EOF;
+    m_nPos += n;
+    return (int)n;
+}
+
+int64_t MmapIO::Seek(int64_t offset, int whence)
+{
+    int64_t pos;
+
+    whence &= ~AVSEEK_FORCE;
+    switch (whence)
+    {
+    case AVSEEK_SIZE:
+        return RefreshSize();
+    case SEEK_SET:
+        pos = offset;
+        break;
+    case SEEK_CUR:
+        pos = m_nPos + offset;
+        break;
+    case SEEK_END:
+        pos = RefreshSize() + offset;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+    m_nPos = pos;
+    return pos;
+}
+
+int MmapIO::ReadPacket(void *opaque, uint8_t *buf, int size)
+{
+    return ((MmapIO *)opaque)->Read(buf, size);
+}
+
+int64_t MmapIO::SeekPacket(void *opaque, int64_t offset, int whence)
+{
+    return ((MmapIO *)opaque)->Seek(offset, whence);
+}
@@ -0,0 +1,86 @@
+﻿#ifndef MMAPIO_H
+#define MMAPIO_H
+
+#include "globalhelper.h"
+
+#define MMAP_IO_VIEW_SIZE (sizeof(void *) > 4 ? ((int64_t)1 << 30) : ((int64_t)64 << 20))  // 映射窗口，32位进程地址空间有限
+#define MMAP_IO_READAHEAD (8 << 20)         // 预读窗口，剩余不足一半时预读下一段
+#define MMAP_IO_BUFFER_SIZE (64 * 1024)     // AVIO 内部缓冲，只用于小块读取
+#define MMAP_IO_STAT_INTERVAL (4 << 20)     // 每读取这么多字节检查一次文件大小
+
+/**
+ * @brief	内存映射的本地文件读取
+ *
+ * 代替 file 协议作为 avformat 的自定义 AVIOContext：按窗口映射文件，
+ * 读取只是从映射区复制，不产生 read 系统调用。AVIO 使用直接模式，
+ * 包数据等大块读取从映射区一次复制到包的缓冲区，不经过 AVIO 内部缓冲。
+ * 映射时声明顺序访问，并随读取位置预读 MMAP_IO_READAHEAD 的数据（MADV_WILLNEED），
+ * 跳转后从新位置重新预读。读到已知结尾或每读取 MMAP_IO_STAT_INTERVAL 后检查文件大小，
+ * 正在录制而增长的文件会重新映射，变小的文件按新的大小结束。
+ * 两次检查之间文件被截短时，访问映射区超出文件末尾的部分会触发 SIGBUS，
+ * 复制过程中捕获该信号并返回错误；文件变小或捕获到 SIGBUS 后改用普通的
+ * 按位置读取，与 file 协议一样得到不完整的读取而不是崩溃。
+ */
+class MmapIO
+{
+public:
+    ~MmapIO();
+
+    /**
+     * @brief	是否为可以映射的本地文件路径（没有协议前缀或为 file: 协议）
+     */
+    static bool IsLocalFile(const char *filename);
+
+    /**
+     * @brief	打开文件
+     *
+     * @return	失败（包括空文件）返回 NULL，调用者应改用默认的 file 协议
+     */
+    static MmapIO *Open(const char *filename);
+
+    /**
+     * @brief	交给 AVFormatContext::pb 使用的上下文，需要同时设置 AVFMT_FLAG_CUSTOM_IO
+     * @note 	归 MmapIO 所有，avformat_close_input 之后再删除 MmapIO
+     */
+    AVIOContext *Context() { return m_pAvio; }
+
+    int RemapCount() const { return m_nRemaps; }
+
+private:
+    MmapIO();
+
+    int Read(uint8_t *buf, int size);
+    int ReadFallback(uint8_t *buf, int size);
+    void StartFallback();
+    int64_t Seek(int64_t offset, int whence);
+    int MapView(int64_t pos);
+    void Unmap();
+    void Readahead();
+    int64_t RefreshSize();
+
+    static int ReadPacket(void *opaque, uint8_t *buf, int size);
+    static int64_t SeekPacket(void *opaque, int64_t offset, int whence);
+
+private:
+#ifdef _WIN32
+    void *m_hFile;
+    void *m_hMapping;
+    int64_t m_nMappingSize;     ///< 映射对象创建时的文件大小
+#else
+    int m_nFd;
+#endif
+    int64_t m_nGranularity;     ///< 映射起点的对齐单位
+    uint8_t *m_pView;
+    int64_t m_nViewStart;
+    int64_t m_nViewSize;
+    int64_t m_nFileSize;
+    int64_t m_nPos;
+    int64_t m_nReadaheadStart;  ///< 已预读的范围
+    int64_t m_nReadaheadEnd;
+    int64_t m_nNextStat;        ///< 读到该位置时检查文件大小
+    int m_nRemaps;
+    bool m_bFallback;           ///< 文件被截短过，不再映射，改用按位置读取
+    AVIOContext *m_pAvio;
+};
+
+#endif // MMAPIO_H
@@ -0,0 +1,510 @@
+﻿#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+
+#include "mosaicctl.h"
+
+#pragma execution_character_set("utf-8")
+
+MosaicCtl::MosaicCtl(QObject *parent) :
+    QObject(parent),
+    m_pExecutor(TaskExecutor::Shared()),
+    m_nInFlight(0),
+    m_bRunning(false),
+    m_widPlayWid(0),
+    m_bInited(false),
+    m_pWindow(nullptr),
+    m_pRenderer(nullptr)
+{
+    // 初始化网络格式，用于打开网络流
+    avformat_network_init();
+}
+
+MosaicCtl::~MosaicCtl()
+{
+    StopPlay();
+
+    avformat_network_deinit();
+
+    if (m_bInited)
+    {
+        SDL_QuitSubSystem(SDL_INIT_VIDEO | SDL_INIT_TIMER);
+    }
+}
+
+/* 开始播放 */
+bool MosaicCtl::StartPlay(const QStringList &listFiles, WId widPlayWid)
+{
+    StopPlay();
+
+    int nTiles = FFMIN(listFiles.size(), MOSAIC_MAX_TILES);
+    if (nTiles <= 0)
+    {
+        return false;
+    }
+
+    // SDL内部按子系统计数，与播放引擎各自初始化互不影响
+    if (!m_bInited)
+    {
+        if (SDL_InitSubSystem(SDL_INIT_VIDEO | SDL_INIT_TIMER))
+        {
+            av_log(NULL, AV_LOG_FATAL, "Could not initialize SDL - %s\n", SDL_GetError());
+            return false;
+        }
+        m_bInited = true;
+    }
+
+    for (int i = 0; i < nTiles; i++)
+    {
+        MosaicTile *tile = new MosaicTile();
+        tile->index = i;
+        tile->filename = listFiles.at(i);
+        tile->stream_index = -1;
+        tile->applied_skip = -1;
+        tile->skip_level = DECODE_SKIP_NONE;
+        m_vecTiles.push_back(tile);
+    }
+
+    m_widPlayWid = widPlayWid;
+    m_bRunning = true;
+
+    m_stPresentTask = m_pExecutor->Submit(TASK_LANE_VIDEO, [this] { PresentThread(); }, true);
+
+    return true;
+}
+
+/* 设置任务执行器 */
+void MosaicCtl::SetTaskExecutor(TaskExecutor *pExecutor)
+{
+    m_pExecutor = pExecutor ? pExecutor : TaskExecutor::Shared();
+}
+
+/* 停止播放 */
+void MosaicCtl::StopPlay()
+{
+    m_bRunning = false;
+
+    m_stPresentTask.Wait();
+
+    // 正在执行的任务会因中断回调尽快返回，排队中的任务执行时直接退出
+    while (m_nInFlight > 0)
+    {
+        av_usleep(1000);
+    }
+
+    for (MosaicTile *tile : m_vecTiles)
+    {
+        CloseTile(tile);
+        delete tile;
+    }
+    m_vecTiles.clear();
+}
+
+/* 停止时打断阻塞的网络读取 */
+int MosaicCtl::InterruptCallback(void *ctx)
+{
+    MosaicCtl *pMosaicCtl = (MosaicCtl *)ctx;
+    return !pMosaicCtl->m_bRunning;
+}
+
+/* 打开一路画面：只打开最佳视频流，其它流全部丢弃 */
+int MosaicCtl::OpenTile(MosaicTile *tile)
+{
+    AVCodec *codec = NULL;
+    AVStream *st;
+    AVRational frame_rate;
+    int ret;
+
+    tile->ic = avformat_alloc_context();
+    if (!tile->ic)
+        return AVERROR(ENOMEM);
+    tile->ic->interrupt_callback.callback = InterruptCallback;
+    tile->ic->interrupt_callback.opaque = this;
+
+    ret = avformat_open_input(&tile->ic, tile->filename.toLocal8Bit().data(), NULL, NULL);
+    if (ret < 0)
+        return ret;
+
+    ret = avformat_find_stream_info(tile->ic, NULL);
+    if (ret < 0)
+        return ret;
+
+    // 实时流没有数据时立即返回，把工作线程让给其它画面
+    tile->ic->flags |= AVFMT_FLAG_NONBLOCK;
+
+    ret = av_find_best_stream(tile->ic, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    if (ret < 0)
+        return ret;
+    tile->stream_index = ret;
+
+    for (unsigned int i = 0; i < tile->ic->nb_streams; i++)
+        tile->ic->streams[i]->discard = (int)i == tile->stream_index ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+
+    st = tile->ic->streams[tile->stream_index];
+    tile->avctx = avcodec_alloc_context3(NULL);
+    if (!tile->avctx)
+        return AVERROR(ENOMEM);
+
+    ret = avcodec_parameters_to_context(tile->avctx, st->codecpar);
+    if (ret < 0)
+        return ret;
+    tile->avctx->pkt_timebase = st->time_base;
+    // 解码并发由共享执行器控制，不再为每路画面开解码器内部线程
+    tile->avctx->thread_count = 1;
+
+    ret = avcodec_open2(tile->avctx, codec, NULL);
+    if (ret < 0)
+        return ret;
+
+    tile->time_base = st->time_base;
+    frame_rate = av_guess_frame_rate(tile->ic, st, NULL);
+    tile->frame_duration = (frame_rate.num && frame_rate.den ? av_q2d({ frame_rate.den, frame_rate.num }) : 0.04);
+
+    tile->pkt = av_packet_alloc();
+    tile->decoded = av_frame_alloc();
+    if (!tile->pkt || !tile->decoded)
+        return AVERROR(ENOMEM);
+
+    return 0;
+}
+
+/* 关闭一路画面，释放解码相关资源 */
+void MosaicCtl::CloseTile(MosaicTile *tile)
+{
+    for (int i = 0; i < MOSAIC_FRAME_QUEUE_SIZE; i++)
+        av_frame_free(&tile->frames[i]);
+    tile->size = 0;
+
+    av_frame_free(&tile->decoded);
+    av_packet_free(&tile->pkt);
+    sws_freeContext(tile->sws_ctx);
+    tile->sws_ctx = NULL;
+    avcodec_free_context(&tile->avctx);
+    avformat_close_input(&tile->ic);
+}
+
+/* 解码出一帧并放入待显示队列
+ * 返回 1 得到一帧，0 暂时没有数据，<0 出错 */
+int MosaicCtl::DecodeOneFrame(MosaicTile *tile)
+{
+    AVFrame *frame;
+    double pts;
+    int ret;
+
+    // 呈现线程调整的降级档位在这里生效，解码器只在工作线程中访问
+    int skip_level = tile->skip_level;
+    if (skip_level != tile->applied_skip) {
+        decoder_set_skip_level(tile->avctx, skip_level);
+        tile->applied_skip = skip_level;
+    }
+
+    for (;;) {
+        ret = avcodec_receive_frame(tile->avctx, tile->decoded);
+        if (ret >= 0)
+            break;
+
+        if (ret == AVERROR_EOF) {
+            // 文件播放完毕，回到开头循环播放
+            int64_t start = tile->ic->start_time != AV_NOPTS_VALUE ? tile->ic->start_time : 0;
+            avcodec_flush_buffers(tile->avctx);
+            tile->draining = 0;
+            ret = avformat_seek_file(tile->ic, -1, INT64_MIN, start, INT64_MAX, 0);
+            if (ret < 0)
+                return ret;
+            continue;
+        }
+        if (ret != AVERROR(EAGAIN))
+            return ret;
+
+        ret = av_read_frame(tile->ic, tile->pkt);
+        if (ret == AVERROR(EAGAIN))
+            return 0;
+        if (ret == AVERROR_EOF || (ret < 0 && tile->ic->pb && avio_feof(tile->ic->pb))) {
+            // 送入空包，取出解码器中剩余的帧
+            if (!tile->draining) {
+                avcodec_send_packet(tile->avctx, NULL);
+                tile->draining = 1;
+            }
+            continue;
+        }
+        if (ret < 0)
+            return ret;
+
+        // 损坏的数据包只影响当前帧，忽略送包错误继续解码
+        if (tile->pkt->stream_index == tile->stream_index)
+            avcodec_send_packet(tile->avctx, tile->pkt);
+        av_packet_unref(tile->pkt);
+    }
+
+    if (tile->decoded->best_effort_timestamp != AV_NOPTS_VALUE)
+        pts = tile->decoded->best_effort_timestamp * av_q2d(tile->time_base);
+    else
+        pts = tile->next_pts;
+    tile->next_pts = pts + tile->frame_duration;
+
+    // 统一转换为YUV420P，呈现线程只需上传纹理
+    frame = av_frame_alloc();
+    if (!frame) {
+        av_frame_unref(tile->decoded);
+        return AVERROR(ENOMEM);
+    }
+    if (tile->decoded->format == AV_PIX_FMT_YUV420P) {
+        av_frame_move_ref(frame, tile->decoded);
+    } else {
+        tile->sws_ctx = sws_getCachedContext(tile->sws_ctx,
+                                             tile->decoded->width, tile->decoded->height, (AVPixelFormat)tile->decoded->format,
+                                             tile->decoded->width, tile->decoded->height, AV_PIX_FMT_YUV420P,
+                                             SWS_BILINEAR, NULL, NULL, NULL);
+        frame->format = AV_PIX_FMT_YUV420P;
+        frame->width = tile->decoded->width;
+        frame->height = tile->decoded->height;
+        if (!tile->sws_ctx || av_frame_get_buffer(frame, 32) < 0) {
+            av_frame_free(&frame);
+            av_frame_unref(tile->decoded);
+            return AVERROR(ENOMEM);
+        }
+        sws_scale(tile->sws_ctx, (const uint8_t * const *)tile->decoded->data, tile->decoded->linesize,
+                  0, tile->decoded->height, frame->data, frame->linesize);
+        av_frame_unref(tile->decoded);
+    }
+
+    std::lock_guard<std::mutex> lock(tile->mutex);
+    int windex = (tile->rindex + tile->size) % MOSAIC_FRAME_QUEUE_SIZE;
+    tile->frames[windex] = frame;
+    tile->pts[windex] = pts;
+    tile->size++;
+
+    return 1;
+}
+
+/* 执行器中的单步任务：必要时打开文件，然后解码一帧 */
+void MosaicCtl::DecodeStep(MosaicTile *tile)
+{
+    int ret = 0;
+
+    if (m_bRunning && !tile->ic)
+        ret = OpenTile(tile);
+    if (m_bRunning && ret >= 0)
+        ret = DecodeOneFrame(tile);
+
+    if (ret < 0 && m_bRunning) {
+        char errbuf[AV_ERROR_MAX_STRING_SIZE] = { 0 };
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        av_log(NULL, AV_LOG_ERROR, "mosaic tile %d (%s): %s\n", tile->index, tile->filename.toLocal8Bit().data(), errbuf);
+        tile->failed = true;
+        emit SigTileError(tile->index, QString(errbuf));
+    }
+
+    // 得到一帧后排到队尾继续解码，其它画面的任务先执行，新任务沿用本任务的名额
+    // 最后才减少计数：计数归零前 StopPlay 不会释放画面
+    tile->scheduled = false;
+    if (ret > 0)
+        ScheduleTile(tile, 1);
+    m_nInFlight--;
+}
+
+/* 待显示队列未满且没有排队中的任务时，提交一个解码任务
+ * 同时执行的任务数达到上限时暂不提交，由呈现任务下一次刷新时再调度
+ * nOwned 为调用者自己占用、即将释放的名额 */
+void MosaicCtl::ScheduleTile(MosaicTile *tile, int nOwned)
+{
+    if (!m_bRunning || tile->failed)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(tile->mutex);
+        if (tile->size >= MOSAIC_FRAME_QUEUE_SIZE)
+            return;
+    }
+
+    bool expected = false;
+    if (!tile->scheduled.compare_exchange_strong(expected, true))
+        return;
+
+    if (++m_nInFlight > MOSAIC_MAX_WORKERS + nOwned) {
+        m_nInFlight--;
+        tile->scheduled = false;
+        return;
+    }
+
+    if (!m_pExecutor->Submit(TASK_LANE_VIDEO, [this, tile] { DecodeStep(tile); }).IsValid()) {
+        m_nInFlight--;
+        tile->scheduled = false;
+    }
+}
+
+/* 取出到期的帧并上传纹理，有多帧到期时只显示最新的一帧 */
+void MosaicCtl::UpdateTile(MosaicTile *tile, double now)
+{
+    AVFrame *show = NULL;
+    double show_late = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(tile->mutex);
+        while (tile->size > 0) {
+            double pts = tile->pts[tile->rindex];
+
+            // 首帧、循环回到开头或严重落后时重新对齐时钟
+            if (!tile->clock_init || pts < tile->last_pts || now - (tile->clock_base + pts) > MOSAIC_MAX_LATE) {
+                if (tile->clock_init && pts >= tile->last_pts)
+                    tile->drops++;
+                tile->clock_base = now - pts;
+                tile->clock_init = 1;
+            }
+            if (tile->clock_base + pts > now)
+                break;
+
+            if (show) {
+                av_frame_free(&show);
+                tile->drops++;
+            }
+            show = tile->frames[tile->rindex];
+            tile->frames[tile->rindex] = NULL;
+            tile->rindex = (tile->rindex + 1) % MOSAIC_FRAME_QUEUE_SIZE;
+            tile->size--;
+            tile->last_pts = pts;
+            show_late = now - (tile->clock_base + pts);
+        }
+    }
+
+    if (!show)
+        return;
+
+    // 解码慢于实时时队列总是空的，帧不会被丢弃而是越来越晚才显示，同样计入降级依据
+    // 允许一个刷新周期的调度误差
+    if (show_late > tile->frame_duration + REFRESH_RATE)
+        tile->late++;
+
+    if (UploadFrame(tile, show) == 0)
+        tile->shown++;
+    av_frame_free(&show);
+}
+
+/* 把YUV420P帧上传到本路画面的纹理 */
+int MosaicCtl::UploadFrame(MosaicTile *tile, AVFrame *frame)
+{
+    if (!tile->texture || tile->tex_w != frame->width || tile->tex_h != frame->height) {
+        if (tile->texture)
+            SDL_DestroyTexture(tile->texture);
+        tile->texture = SDL_CreateTexture(m_pRenderer, SDL_PIXELFORMAT_IYUV, SDL_TEXTUREACCESS_STREAMING,
+                                          frame->width, frame->height);
+        if (!tile->texture) {
+            av_log(NULL, AV_LOG_ERROR, "SDL_CreateTexture: %s\n", SDL_GetError());
+            return -1;
+        }
+        tile->tex_w = frame->width;
+        tile->tex_h = frame->height;
+    }
+
+    return SDL_UpdateYUVTexture(tile->texture, NULL,
+                                frame->data[0], frame->linesize[0],
+                                frame->data[1], frame->linesize[1],
+                                frame->data[2], frame->linesize[2]);
+}
+
+/* 统计周期结束：根据丢帧和迟显情况调整降级档位并上报 */
+void MosaicCtl::UpdateStats(MosaicTile *tile, double elapsed)
+{
+    int skip_level = tile->skip_level;
+    int missed = tile->drops + tile->late;
+
+    // 丢帧和迟显超过一成说明来不及解码/显示，降低一档；连续若干周期都没有再提升一档
+    if (missed * 10 > tile->shown + tile->drops) {
+        tile->healthy_intervals = 0;
+        if (skip_level < DECODE_SKIP_MAX)
+            skip_level++;
+    } else if (missed == 0 && ++tile->healthy_intervals >= MOSAIC_RECOVER_INTERVALS) {
+        tile->healthy_intervals = 0;
+        if (skip_level > DECODE_SKIP_NONE)
+            skip_level--;
+    }
+    tile->skip_level = skip_level;
+
+    if (!tile->failed)
+        emit SigTileStats(tile->index, tile->shown / elapsed, missed, skip_level);
+
+    tile->shown = 0;
+    tile->drops = 0;
+    tile->late = 0;
+}
+
+/* 呈现任务：调度解码任务，把所有画面合成到一个渲染器中显示 */
+void MosaicCtl::PresentThread()
+{
+    m_pWindow = SDL_CreateWindowFrom((void *)m_widPlayWid);
+    if (!m_pWindow) {
+        av_log(NULL, AV_LOG_FATAL, "SDL: could not create window - %s\n", SDL_GetError());
+        return;
+    }
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
+    m_pRenderer = SDL_CreateRenderer(m_pWindow, -1, SDL_RENDERER_ACCELERATED);
+    if (!m_pRenderer) {
+        av_log(NULL, AV_LOG_WARNING, "Failed to initialize a hardware accelerated renderer: %s\n", SDL_GetError());
+        m_pRenderer = SDL_CreateRenderer(m_pWindow, -1, 0);
+    }
+
+    int nTiles = (int)m_vecTiles.size();
+    int nCols = (int)ceil(sqrt((double)nTiles));
+    int nRows = (nTiles + nCols - 1) / nCols;
+    int64_t stats_start = av_gettime_relative();
+
+    while (m_bRunning && m_pRenderer) {
+        double now = av_gettime_relative() / 1000000.0;
+        int w, h;
+
+        for (MosaicTile *tile : m_vecTiles) {
+            ScheduleTile(tile);
+            UpdateTile(tile, now);
+        }
+
+        // 所有画面在一次渲染中合成，每个画面按原比例居中显示在自己的格子里
+        SDL_GetRendererOutputSize(m_pRenderer, &w, &h);
+        SDL_SetRenderDrawColor(m_pRenderer, 0, 0, 0, 255);
+        SDL_RenderClear(m_pRenderer);
+        for (MosaicTile *tile : m_vecTiles) {
+            if (!tile->texture)
+                continue;
+
+            int cell_w = w / nCols;
+            int cell_h = h / nRows;
+            int width = cell_w;
+            int height = (int)lrint(width * (double)tile->tex_h / tile->tex_w);
+            if (height > cell_h) {
+                height = cell_h;
+                width = (int)lrint(height * (double)tile->tex_w / tile->tex_h);
+            }
+
+            SDL_Rect rect;
+            rect.x = (tile->index % nCols) * cell_w + (cell_w - width) / 2;
+            rect.y = (tile->index / nCols) * cell_h + (cell_h - height) / 2;
+            rect.w = width;
+            rect.h = height;
+            SDL_RenderCopy(m_pRenderer, tile->texture, NULL, &rect);
+        }
+        SDL_RenderPresent(m_pRenderer);
+
+        int64_t cur_time = av_gettime_relative();
+        if (cur_time - stats_start >= MOSAIC_STATS_INTERVAL) {
+            for (MosaicTile *tile : m_vecTiles)
+                UpdateStats(tile, (cur_time - stats_start) / 1000000.0);
+            stats_start = cur_time;
+        }
+
+        av_usleep((int64_t)(REFRESH_RATE * 1000000.0));
+    }
+
+    // 纹理属于渲染器，在呈现任务中释放
+    for (MosaicTile *tile : m_vecTiles) {
+        if (tile->texture) {
+            SDL_DestroyTexture(tile->texture);
+            tile->texture = NULL;
+        }
+    }
+    if (m_pRenderer) {
+        SDL_DestroyRenderer(m_pRenderer);
+        m_pRenderer = nullptr;
+    }
+    SDL_DestroyWindow(m_pWindow);
+    m_pWindow = nullptr;
+}
@@ -0,0 +1,140 @@
+﻿#ifndef MOSAICCTL_H
+#define MOSAICCTL_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QWidget>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "datactl.h"
+#include "taskexecutor.h"
+
+#define MOSAIC_MAX_TILES 16             // 最多同时显示的画面数
+#define MOSAIC_FRAME_QUEUE_SIZE 3       // 每路画面解码完成待显示的帧数
+#define MOSAIC_MAX_WORKERS 4            // 同时执行的解复用/解码任务数上限
+#define MOSAIC_STATS_INTERVAL 1000000   // 统计周期（微秒）
+#define MOSAIC_RECOVER_INTERVALS 5      // 连续多少个健康的统计周期后提升一档画质
+#define MOSAIC_MAX_LATE 1.0             // 落后超过该秒数时重新对齐时钟
+
+//多画面中的一路画面
+typedef struct MosaicTile {
+    int index;
+    QString filename;
+
+    // 以下由工作线程访问（同一时刻只有一个任务在处理本路画面）
+    AVFormatContext *ic;
+    AVCodecContext *avctx;
+    struct SwsContext *sws_ctx;
+    AVPacket *pkt;
+    AVFrame *decoded;
+    int stream_index;
+    AVRational time_base;
+    double frame_duration;      // 标称帧间隔（秒）
+    double next_pts;            // 无时间戳时推算的pts
+    int applied_skip;           // 当前解码器使用的降级档位
+    int draining;               // 已送入空包，正在取出解码器内剩余帧
+
+    // 已解码待显示的帧，工作线程写入，呈现线程读取
+    std::mutex mutex;
+    AVFrame *frames[MOSAIC_FRAME_QUEUE_SIZE];
+    double pts[MOSAIC_FRAME_QUEUE_SIZE];
+    int rindex;
+    int size;
+
+    std::atomic<bool> scheduled;    // 是否已有任务在执行器中
+    std::atomic<bool> failed;       // 打开或解码失败
+    std::atomic<int> skip_level;    // 呈现线程要求的降级档位
+
+    // 以下只由呈现线程访问
+    SDL_Texture *texture;
+    int tex_w, tex_h;
+    int clock_init;
+    double clock_base;          // 显示时间 = clock_base + pts
+    double last_pts;
+    int shown;                  // 当前统计周期内显示的帧数
+    int drops;                  // 当前统计周期内丢弃的帧数
+    int late;                   // 当前统计周期内晚于到期时间一帧以上才显示的帧数
+    int healthy_intervals;      // 连续无丢帧、无迟显的统计周期数
+} MosaicTile;
+
+/**
+ * @brief	多画面（电视墙）播放引擎
+ *
+ * 所有画面的解复用和解码被拆成单步任务，在共享的任务执行器视频通道中
+ * 轮流执行，同时执行的任务数有上限；呈现任务把所有画面合成到同一个
+ * SDL渲染器中，一次提交显示。某路画面来不及显示（丢帧或解码跟不上而迟显）时
+ * 逐档跳过环路滤波/非参考帧/非关键帧，恢复后再逐档提升。只显示视频，不输出音频。
+ */
+class MosaicCtl : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MosaicCtl(QObject *parent = nullptr);
+    ~MosaicCtl();
+
+    /**
+     * @brief	开始播放
+     *
+     * @param	listFiles 文件或流地址，超过 MOSAIC_MAX_TILES 的部分忽略
+     * @param	widPlayWid 显示窗口id
+     * @return	true 成功 false 失败
+     * @note 	文件在执行器中异步打开，打开失败通过 SigTileError 通知
+     */
+    bool StartPlay(const QStringList &listFiles, WId widPlayWid);
+
+    /**
+     * @brief	设置任务执行器，默认使用进程共享的执行器
+     */
+    void SetTaskExecutor(TaskExecutor *pExecutor);
+
+    /**
+     * @brief	停止播放，等待呈现任务和解码任务结束并释放所有画面
+     */
+    void StopPlay();
+
+signals:
+    /**
+     * @brief	每路画面的统计信息，每个统计周期发出一次
+     *
+     * @param	nIndex 画面序号
+     * @param	dFps 实际显示帧率
+     * @param	nDrops 本周期丢弃和迟显的帧数
+     * @param	nSkipLevel 当前解码降级档位
+     */
+    void SigTileStats(int nIndex, double dFps, int nDrops, int nSkipLevel);
+    void SigTileError(int nIndex, QString strMsg);
+
+private:
+    int OpenTile(MosaicTile *tile);
+    void CloseTile(MosaicTile *tile);
+    int DecodeOneFrame(MosaicTile *tile);
+    void DecodeStep(MosaicTile *tile);
+    void ScheduleTile(MosaicTile *tile, int nOwned = 0);
+
+    void PresentThread();
+    void UpdateTile(MosaicTile *tile, double now);
+    int UploadFrame(MosaicTile *tile, AVFrame *frame);
+    void UpdateStats(MosaicTile *tile, double elapsed);
+
+    static int InterruptCallback(void *ctx);
+
+private:
+    std::vector<MosaicTile *> m_vecTiles;
+    TaskExecutor *m_pExecutor;      ///< 解复用/解码/呈现任务的执行器
+    std::atomic<int> m_nInFlight;   ///< 已提交未结束的解码任务数
+    TaskHandle m_stPresentTask;     ///< 呈现任务
+    std::atomic<bool> m_bRunning;
+    WId m_widPlayWid;
+    bool m_bInited;                 ///< SDL视频子系统是否已初始化
+
+    SDL_Window *m_pWindow;
+    SDL_Renderer *m_pRenderer;
+};
+
+#endif // MOSAICCTL_H
@@ -0,0 +1,85 @@
+﻿#include <QVBoxLayout>
+
+#include "mosaicwid.h"
+
+#pragma execution_character_set("utf-8")
+
+MosaicWid::MosaicWid(QWidget *parent) :
+    QWidget(parent),
+    m_stVideoLabel(this),
+    m_stStatsLabel(this),
+    m_stMosaicCtl(this)
+{
+    setWindowTitle("多画面监控");
+    resize(1280, 760);
+
+    // 显示区域由SDL绘制，防止Qt刷新覆盖画面
+    m_stVideoLabel.setAttribute(Qt::WA_OpaquePaintEvent);
+    m_stVideoLabel.setUpdatesEnabled(false);
+    m_stVideoLabel.setStyleSheet("background-color: black;");
+    m_stStatsLabel.setWordWrap(true);
+
+    QVBoxLayout *pLayout = new QVBoxLayout(this);
+    pLayout->setContentsMargins(0, 0, 0, 0);
+    pLayout->setSpacing(0);
+    pLayout->addWidget(&m_stVideoLabel, 1);
+    pLayout->addWidget(&m_stStatsLabel);
+
+    connect(&m_stMosaicCtl, &MosaicCtl::SigTileStats, this, &MosaicWid::OnTileStats, Qt::QueuedConnection);
+    connect(&m_stMosaicCtl, &MosaicCtl::SigTileError, this, &MosaicWid::OnTileError, Qt::QueuedConnection);
+}
+
+MosaicWid::~MosaicWid()
+{
+    // 先停止播放，显示区域随窗口一起销毁
+    m_stMosaicCtl.StopPlay();
+}
+
+/* 显示窗口并开始播放 */
+bool MosaicWid::Play(const QStringList &listFiles)
+{
+    m_listTileStats.clear();
+    for (int i = 0; i < listFiles.size() && i < MOSAIC_MAX_TILES; i++)
+    {
+        m_listTileStats.append(QString("%1: 打开中").arg(i + 1));
+    }
+    UpdateStatsText();
+
+    show();
+    return m_stMosaicCtl.StartPlay(listFiles, m_stVideoLabel.winId());
+}
+
+/* 关闭窗口时停止播放 */
+void MosaicWid::closeEvent(QCloseEvent *event)
+{
+    m_stMosaicCtl.StopPlay();
+    QWidget::closeEvent(event);
+}
+
+/* 更新一路画面的统计信息 */
+void MosaicWid::OnTileStats(int nIndex, double dFps, int nDrops, int nSkipLevel)
+{
+    if (nIndex < 0 || nIndex >= m_listTileStats.size())
+    {
+        return;
+    }
+    m_listTileStats[nIndex] = QString("%1: %2fps 丢帧/迟显%3 降级%4")
+            .arg(nIndex + 1).arg(dFps, 0, 'f', 1).arg(nDrops).arg(nSkipLevel);
+    UpdateStatsText();
+}
+
+/* 显示一路画面的错误信息 */
+void MosaicWid::OnTileError(int nIndex, QString strMsg)
+{
+    if (nIndex < 0 || nIndex >= m_listTileStats.size())
+    {
+        return;
+    }
+    m_listTileStats[nIndex] = QString("%1: %2").arg(nIndex + 1).arg(strMsg);
+    UpdateStatsText();
+}
+
+void MosaicWid::UpdateStatsText()
+{
+    m_stStatsLabel.setText(m_listTileStats.join("    "));
+}
@@ -0,0 +1,50 @@
+﻿#ifndef MOSAICWID_H
+#define MOSAICWID_H
+
+#include <QWidget>
+#include <QLabel>
+#include <QStringList>
+#include <QCloseEvent>
+
+#include "mosaicctl.h"
+
+/**
+ * @brief	多画面监控窗口
+ *
+ * 以网格方式同时显示多个文件或流，底部显示每路画面的帧率、丢帧和降级档位。
+ */
+class MosaicWid : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit MosaicWid(QWidget *parent = nullptr);
+    ~MosaicWid();
+
+    /**
+     * @brief	显示窗口并开始播放
+     *
+     * @param	listFiles 文件或流地址，最多 MOSAIC_MAX_TILES 个
+     * @return	true 成功 false 失败
+     */
+    bool Play(const QStringList &listFiles);
+
+protected:
+    /**
+     * @brief	关闭窗口时停止播放
+     */
+    void closeEvent(QCloseEvent *event);
+
+private:
+    void OnTileStats(int nIndex, double dFps, int nDrops, int nSkipLevel);
+    void OnTileError(int nIndex, QString strMsg);
+    void UpdateStatsText();
+
+private:
+    QLabel m_stVideoLabel;          ///< 视频显示区域
+    QLabel m_stStatsLabel;          ///< 统计信息
+    QStringList m_listTileStats;    ///< 每路画面的统计文字
+    MosaicCtl m_stMosaicCtl;        ///< 多画面播放引擎
+};
+
+#endif // MOSAICWID_H
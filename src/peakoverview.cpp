@@ -0,0 +1,310 @@
+﻿#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include "peakoverview.h"
+
+#pragma execution_character_set("utf-8")
+
+const QString PEAK_CACHE_DIR = QDir::tempPath() + "/CTTV_Player_peaks"; // 概览缓存目录
+
+// 构造函数
+PeakOverview::PeakOverview(QObject *parent) :
+    QObject(parent),
+    m_pExecutor(TaskExecutor::Shared()),
+    m_bAbort(false)
+{
+}
+
+// 析构函数
+PeakOverview::~PeakOverview()
+{
+    Cancel();
+}
+
+void PeakOverview::SetTaskExecutor(TaskExecutor *pExecutor)
+{
+    m_pExecutor = pExecutor ? pExecutor : TaskExecutor::Shared();
+}
+
+/* 为文件生成概览 */
+void PeakOverview::Start(const QString &strFile)
+{
+    std::vector<PeakPair> vecBase;
+
+    Cancel();
+
+    if (!QFileInfo(strFile).isFile())
+    {
+        return;
+    }
+
+    QString strCacheFile = CacheFileName(strFile);
+    if (LoadCache(strCacheFile, vecBase))
+    {
+        BuildPyramid(vecBase);
+        emit SigOverviewReady();
+        return;
+    }
+
+    m_bAbort = false;
+    m_stScanTask = m_pExecutor->Submit(TASK_LANE_BACKGROUND, [this, strFile, strCacheFile] {
+        ScanTask(strFile, strCacheFile);
+    });
+}
+
+/* 取消扫描并清除概览 */
+void PeakOverview::Cancel()
+{
+    m_bAbort = true;
+    m_stScanTask.Wait();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_vecLevels.clear();
+}
+
+/* 按宽度聚合峰值：选择不少于宽度的最粗一层，每个像素取对应区间的最小/最大值 */
+bool PeakOverview::GetPeaks(int nWidth, std::vector<PeakPair> &vecPeaks)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_vecLevels.empty() || nWidth <= 0)
+    {
+        return false;
+    }
+
+    size_t nLevel = 0;
+    while (nLevel + 1 < m_vecLevels.size() && (int)m_vecLevels[nLevel + 1].size() >= nWidth)
+    {
+        nLevel++;
+    }
+    const std::vector<PeakPair> &vecLevel = m_vecLevels[nLevel];
+    int64_t nCount = vecLevel.size();
+
+    vecPeaks.resize(nWidth);
+    for (int x = 0; x < nWidth; x++)
+    {
+        int64_t nBegin = x * nCount / nWidth;
+        int64_t nEnd = FFMAX(nBegin + 1, (x + 1) * nCount / nWidth);
+        PeakPair stPeak = vecLevel[nBegin];
+        for (int64_t i = nBegin + 1; i < nEnd; i++)
+        {
+            stPeak.min = FFMIN(stPeak.min, vecLevel[i].min);
+            stPeak.max = FFMAX(stPeak.max, vecLevel[i].max);
+        }
+        vecPeaks[x] = stPeak;
+    }
+    return true;
+}
+
+/* 扫描任务：解码得到底层峰值，写入缓存并通知界面 */
+void PeakOverview::ScanTask(QString strFile, QString strCacheFile)
+{
+    std::vector<PeakPair> vecBase;
+
+    if (Scan(strFile, vecBase) < 0 || vecBase.empty())
+    {
+        return;
+    }
+
+    SaveCache(strCacheFile, vecBase);
+    BuildPyramid(vecBase);
+    emit SigOverviewReady();
+}
+
+/* 只解码音频流，统计每 1/PEAK_BASE_RATE 秒的最小/最大值 */
+int PeakOverview::Scan(const QString &strFile, std::vector<PeakPair> &vecBase)
+{
+    AVFormatContext *ic = NULL;
+    AVCodecContext *avctx = NULL;
+    AVCodec *codec = NULL;
+    struct SwrContext *swr_ctx = NULL;
+    AVPacket *pkt = NULL;
+    AVFrame *frame = NULL;
+    std::vector<float> vecMono;
+    int stream_index, samples_per_peak, nb_samples = 0, has_video = 0;
+    float peak_min = 0, peak_max = 0;
+    int ret;
+
+    ic = avformat_alloc_context();
+    if (!ic)
+        return AVERROR(ENOMEM);
+    ic->interrupt_callback.callback = InterruptCallback;
+    ic->interrupt_callback.opaque = this;
+
+    ret = avformat_open_input(&ic, strFile.toLocal8Bit().constData(), NULL, NULL);
+    if (ret < 0)
+        return ret;
+    if ((ret = avformat_find_stream_info(ic, NULL)) < 0)
+        goto fail;
+
+    stream_index = av_find_best_stream(ic, AVMEDIA_TYPE_AUDIO, -1, -1, &codec, 0);
+    if (stream_index < 0) {
+        ret = stream_index;
+        goto fail;
+    }
+
+    // 概览面向以音频为主的内容，高码率视频文件不值得整个读一遍
+    for (unsigned int i = 0; i < ic->nb_streams; i++) {
+        AVStream *st = ic->streams[i];
+        if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && !(st->disposition & AV_DISPOSITION_ATTACHED_PIC))
+            has_video = 1;
+        st->discard = (int)i == stream_index ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+    }
+    if (has_video && ic->bit_rate > PEAK_MAX_VIDEO_BITRATE) {
+        ret = AVERROR(ENOTSUP);
+        goto fail;
+    }
+
+    avctx = avcodec_alloc_context3(NULL);
+    pkt = av_packet_alloc();
+    frame = av_frame_alloc();
+    if (!avctx || !pkt || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if ((ret = avcodec_parameters_to_context(avctx, ic->streams[stream_index]->codecpar)) < 0)
+        goto fail;
+    avctx->pkt_timebase = ic->streams[stream_index]->time_base;
+    if ((ret = avcodec_open2(avctx, codec, NULL)) < 0)
+        goto fail;
+
+    samples_per_peak = FFMAX(1, avctx->sample_rate / PEAK_BASE_RATE);
+    if (ic->duration > 0)
+        vecBase.reserve(ic->duration * PEAK_BASE_RATE / AV_TIME_BASE + 1);
+
+    while (!m_bAbort) {
+        ret = av_read_frame(ic, pkt);
+        if (ret < 0) {
+            // 文件结束，送入空包取出剩余的帧
+            avcodec_send_packet(avctx, NULL);
+        } else {
+            if (pkt->stream_index == stream_index)
+                avcodec_send_packet(avctx, pkt);
+            av_packet_unref(pkt);
+        }
+
+        while (avcodec_receive_frame(avctx, frame) >= 0) {
+            // 统一转换为单声道浮点，采样率不变
+            if (!swr_ctx) {
+                int64_t layout = frame->channel_layout ? frame->channel_layout : av_get_default_channel_layout(frame->channels);
+                swr_ctx = swr_alloc_set_opts(NULL, AV_CH_LAYOUT_MONO, AV_SAMPLE_FMT_FLT, frame->sample_rate,
+                                             layout, (enum AVSampleFormat)frame->format, frame->sample_rate, 0, NULL);
+                if (!swr_ctx || swr_init(swr_ctx) < 0) {
+                    ret = AVERROR(EINVAL);
+                    goto fail;
+                }
+            }
+
+            vecMono.resize(frame->nb_samples + 256);
+            uint8_t *out = (uint8_t *)vecMono.data();
+            int len = swr_convert(swr_ctx, &out, (int)vecMono.size(), (const uint8_t **)frame->extended_data, frame->nb_samples);
+            for (int i = 0; i < len; i++) {
+                peak_min = FFMIN(peak_min, vecMono[i]);
+                peak_max = FFMAX(peak_max, vecMono[i]);
+                if (++nb_samples == samples_per_peak) {
+                    PeakPair stPeak;
+                    stPeak.min = (int8_t)av_clip(lrintf(peak_min * 127), -127, 127);
+                    stPeak.max = (int8_t)av_clip(lrintf(peak_max * 127), -127, 127);
+                    vecBase.push_back(stPeak);
+                    nb_samples = 0;
+                    peak_min = peak_max = 0;
+                }
+            }
+        }
+
+        if (ret < 0)
+            break;
+    }
+    ret = m_bAbort ? AVERROR_EXIT : 0;
+
+fail:
+    swr_free(&swr_ctx);
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+    avcodec_free_context(&avctx);
+    avformat_close_input(&ic);
+    return ret;
+}
+
+/* 由底层峰值逐层两两合并构建金字塔 */
+void PeakOverview::BuildPyramid(std::vector<PeakPair> &vecBase)
+{
+    std::vector<std::vector<PeakPair>> vecLevels;
+
+    vecLevels.push_back(std::move(vecBase));
+    while (vecLevels.back().size() / 2 >= PEAK_MIN_LEVEL_SIZE)
+    {
+        const std::vector<PeakPair> &vecPrev = vecLevels.back();
+        std::vector<PeakPair> vecNext(vecPrev.size() / 2);
+        for (size_t i = 0; i < vecNext.size(); i++)
+        {
+            vecNext[i].min = FFMIN(vecPrev[2 * i].min, vecPrev[2 * i + 1].min);
+            vecNext[i].max = FFMAX(vecPrev[2 * i].max, vecPrev[2 * i + 1].max);
+        }
+        vecLevels.push_back(std::move(vecNext));
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_vecLevels.swap(vecLevels);
+}
+
+/* 缓存文件名：由文件路径、大小和修改时间计算，文件变化后缓存自然失效 */
+QString PeakOverview::CacheFileName(const QString &strFile)
+{
+    QFileInfo stInfo(strFile);
+    QString strKey = QString("%1|%2|%3").arg(stInfo.absoluteFilePath())
+            .arg(stInfo.size()).arg(stInfo.lastModified().toMSecsSinceEpoch());
+    QByteArray hash = QCryptographicHash::hash(strKey.toUtf8(), QCryptographicHash::Sha1);
+    return PEAK_CACHE_DIR + "/" + hash.toHex() + ".peak";
+}
+
+bool PeakOverview::LoadCache(const QString &strCacheFile, std::vector<PeakPair> &vecBase)
+{
+    QFile file(strCacheFile);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    quint32 nMagic = 0, nVersion = 0, nCount = 0;
+    stream >> nMagic >> nVersion >> nCount;
+    if (nMagic != PEAK_CACHE_MAGIC || nVersion != PEAK_CACHE_VERSION || nCount == 0 ||
+            file.size() - file.pos() != (qint64)nCount * sizeof(PeakPair))
+    {
+        return false;
+    }
+
+    vecBase.resize(nCount);
+    return stream.readRawData((char *)vecBase.data(), nCount * sizeof(PeakPair)) == (int)(nCount * sizeof(PeakPair));
+}
+
+bool PeakOverview::SaveCache(const QString &strCacheFile, const std::vector<PeakPair> &vecBase)
+{
+    QDir().mkpath(PEAK_CACHE_DIR);
+
+    // 先写临时文件再改名，避免读到写了一半的缓存
+    QString strTmpFile = strCacheFile + ".tmp";
+    QFile file(strTmpFile);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream << (quint32)PEAK_CACHE_MAGIC << (quint32)PEAK_CACHE_VERSION << (quint32)vecBase.size();
+    stream.writeRawData((const char *)vecBase.data(), vecBase.size() * sizeof(PeakPair));
+    file.close();
+
+    QFile::remove(strCacheFile);
+    return QFile::rename(strTmpFile, strCacheFile);
+}
+
+int PeakOverview::InterruptCallback(void *ctx)
+{
+    PeakOverview *pOverview = (PeakOverview *)ctx;
+    return pOverview->m_bAbort;
+}
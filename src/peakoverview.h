@@ -0,0 +1,90 @@
+﻿#ifndef PEAKOVERVIEW_H
+#define PEAKOVERVIEW_H
+
+#include <QObject>
+#include <QString>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "globalhelper.h"
+#include "taskexecutor.h"
+
+#define PEAK_BASE_RATE 50                   // 最底层每秒的峰值数
+#define PEAK_MIN_LEVEL_SIZE 256             // 金字塔最上层的峰值数不少于该值
+#define PEAK_MAX_VIDEO_BITRATE 1500000      // 含视频的文件码率超过该值时不生成概览
+#define PEAK_CACHE_MAGIC 0x4354504B         // "CTPK"
+#define PEAK_CACHE_VERSION 1
+
+//一段时间内的最小/最大样本值，量化到 -127~127
+typedef struct PeakPair {
+    int8_t min;
+    int8_t max;
+} PeakPair;
+
+/**
+ * @brief	进度条的音频波形概览
+ *
+ * 后台只解码音频（丢弃其它流），每 1/PEAK_BASE_RATE 秒记录一对最小/最大值作为底层，
+ * 逐层两两合并得到多分辨率的峰值金字塔，绘制时选择与宽度最接近的一层聚合到像素。
+ * 底层峰值以 int8 存入临时目录下的缓存文件，再次打开同一文件时直接读取缓存重建金字塔。
+ * 扫描任务在执行器的后台通道（低优先级）中运行，不影响播放。
+ */
+class PeakOverview : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PeakOverview(QObject *parent = nullptr);
+    ~PeakOverview();
+
+    /**
+     * @brief	设置任务执行器，默认使用进程共享的执行器
+     */
+    void SetTaskExecutor(TaskExecutor *pExecutor);
+
+    /**
+     * @brief	为文件生成概览，取消上一个文件的扫描
+     *
+     * @param	strFile 本地文件路径，网络流不生成概览
+     * @note 	有缓存时立即可用，否则完成扫描后发出 SigOverviewReady
+     */
+    void Start(const QString &strFile);
+
+    /**
+     * @brief	取消扫描并清除概览
+     */
+    void Cancel();
+
+    /**
+     * @brief	获取按宽度聚合的峰值
+     *
+     * @param	nWidth 像素宽度
+     * @param	vecPeaks 每个像素一对峰值
+     * @return	true 成功 false 没有概览
+     */
+    bool GetPeaks(int nWidth, std::vector<PeakPair> &vecPeaks);
+
+signals:
+    void SigOverviewReady();
+
+private:
+    void ScanTask(QString strFile, QString strCacheFile);
+    int Scan(const QString &strFile, std::vector<PeakPair> &vecBase);
+    void BuildPyramid(std::vector<PeakPair> &vecBase);
+
+    static QString CacheFileName(const QString &strFile);
+    static bool LoadCache(const QString &strCacheFile, std::vector<PeakPair> &vecBase);
+    static bool SaveCache(const QString &strCacheFile, const std::vector<PeakPair> &vecBase);
+    static int InterruptCallback(void *ctx);
+
+private:
+    std::mutex m_mutex;
+    std::vector<std::vector<PeakPair>> m_vecLevels;   ///< [0] 为底层，逐层减半
+    TaskExecutor *m_pExecutor;
+    TaskHandle m_stScanTask;
+    std::atomic<bool> m_bAbort;
+};
+
+#endif // PEAKOVERVIEW_H
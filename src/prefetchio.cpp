@@ -0,0 +1,361 @@
+﻿#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/vfs.h>
+#endif
+
+#include <chrono>
+
+#include "prefetchio.h"
+
+#pragma execution_character_set("utf-8")
+
+// 构造函数
+PrefetchIO::PrefetchIO(TaskExecutor *pExecutor, int nBlockSize, int nDepth) :
+    m_pExecutor(pExecutor),
+    m_nBlockSize(FFMAX(nBlockSize, 4096)),
+    m_nDepth(FFMAX(nDepth, 0)),
+    m_nThrottleBytes(0),
+    m_pSource(NULL),
+    m_pAvio(NULL),
+    m_nFileSize(-1),
+    m_nStart(0),
+    m_nEnd(0),
+    m_nPos(0),
+    m_nSeekReq(-1),
+    m_nGeneration(0),
+    m_bEof(false),
+    m_nError(0),
+    m_bAbort(false)
+{
+    memset(&m_stThrottle, 0, sizeof(m_stThrottle));
+    memset(&m_stInterrupt, 0, sizeof(m_stInterrupt));
+    memset(&m_stStats, 0, sizeof(m_stStats));
+}
+
+// 析构函数
+PrefetchIO::~PrefetchIO()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bAbort = true;
+        m_cond.notify_all();
+    }
+    m_stTask.Wait();
+
+    if (m_pAvio)
+    {
+        av_freep(&m_pAvio->buffer);
+        avio_context_free(&m_pAvio);
+    }
+    avio_closep(&m_pSource);
+}
+
+/* 按文件系统类型判断，Windows 下为网络驱动器、UNC 路径、可移动磁盘和光盘 */
+bool PrefetchIO::IsSlowStorage(const char *filename)
+{
+    av_strstart(filename, "file:", &filename);
+
+#ifdef _WIN32
+    if ((filename[0] == '\\' || filename[0] == '/') && (filename[1] == '\\' || filename[1] == '/'))
+        return true;
+
+    char root[4] = { filename[0], ':', '\\', 0 };
+    // 相对路径取当前目录所在的驱动器
+    UINT type = GetDriveTypeA(filename[0] && filename[1] == ':' ? root : NULL);
+    return type == DRIVE_REMOTE || type == DRIVE_REMOVABLE || type == DRIVE_CDROM;
+#elif defined(__linux__)
+    struct statfs st;
+
+    if (statfs(filename, &st) < 0)
+        return false;
+    switch ((uint32_t)st.f_type)
+    {
+    case 0x6969:        // NFS
+    case 0x517B:        // SMB
+    case 0xFF534D42:    // CIFS
+    case 0xFE534D42:    // SMB2
+    case 0x65735546:    // FUSE（sshfs 等）
+    case 0x4D44:        // FAT（U盘）
+    case 0x2011BAB0:    // exFAT
+    case 0x9660:        // ISO9660
+        return true;
+    default:
+        return false;
+    }
+#else
+    return false;
+#endif
+}
+
+bool PrefetchIO::IsHttpUrl(const char *url)
+{
+    return av_strstart(url, "http://", NULL) || av_strstart(url, "https://", NULL);
+}
+
+int PrefetchIO::Open(const char *filename, const AVIOInterruptCB *interrupt)
+{
+    int ret;
+
+    if (interrupt)
+        m_stInterrupt = *interrupt;
+    ret = avio_open2(&m_pSource, filename, AVIO_FLAG_READ, interrupt, NULL);
+    if (ret < 0)
+        return ret;
+    m_nFileSize = avio_size(m_pSource);
+
+    unsigned char *buffer = (unsigned char *)av_malloc(PREFETCH_IO_BUFFER_SIZE);
+    if (buffer)
+        m_pAvio = avio_alloc_context(buffer, PREFETCH_IO_BUFFER_SIZE, 0, this, ReadPacket, NULL,
+                                     (m_pSource->seekable & AVIO_SEEKABLE_NORMAL) ? SeekPacket : NULL);
+    if (!m_pAvio)
+    {
+        av_free(buffer);
+        return AVERROR(ENOMEM);
+    }
+
+    if (m_nDepth > 0)
+    {
+        m_vecRing.resize((size_t)m_nBlockSize * m_nDepth);
+        // 预读为解复用供数据，和读取线程使用同一通道
+        m_stTask = m_pExecutor->Submit(TASK_LANE_AUDIO, [this] { FetchLoop(); }, true);
+        if (!m_stTask.IsValid())
+            return AVERROR(EINVAL);
+    }
+    return 0;
+}
+
+PrefetchStats PrefetchIO::Stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stStats;
+}
+
+bool PrefetchIO::Interrupted()
+{
+    return m_stInterrupt.callback && m_stInterrupt.callback(m_stInterrupt.opaque);
+}
+
+/* 分段休眠，关闭时尽快返回 */
+void PrefetchIO::ThrottleSleep(int64_t us)
+{
+    int64_t end = av_gettime_relative() + us;
+    int64_t now;
+
+    while (!m_bAbort && (now = av_gettime_relative()) < end)
+        av_usleep((unsigned)FFMIN(end - now, PREFETCH_IO_WAIT_MS * 1000LL));
+}
+
+/* 从存储读取，设置了限速时模拟延迟和带宽 */
+int PrefetchIO::ReadSource(uint8_t *buf, int size)
+{
+    int64_t delay = m_stThrottle.latency_ms;
+    int ret;
+
+    // 尖峰按读取的数据量出现，与每次读取的大小无关
+    if (m_stThrottle.spike_bytes > 0 &&
+        (m_nThrottleBytes + size) / m_stThrottle.spike_bytes > m_nThrottleBytes / m_stThrottle.spike_bytes)
+        delay += m_stThrottle.spike_ms;
+    if (delay > 0)
+        ThrottleSleep(delay * 1000);
+
+    ret = avio_read(m_pSource, buf, size);
+    if (ret > 0)
+        m_nThrottleBytes += ret;
+    if (ret > 0 && m_stThrottle.bytes_per_sec > 0)
+        ThrottleSleep(ret * 1000000LL / m_stThrottle.bytes_per_sec);
+    return ret == 0 ? AVERROR_EOF : ret;
+}
+
+/* 后台预读：缓冲中未读的数据不足时继续读下一块，空间不够时淘汰最早的已读数据 */
+void PrefetchIO::FetchLoop()
+{
+    int64_t capacity = (int64_t)m_vecRing.size();
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (!m_bAbort)
+    {
+        if (m_nSeekReq >= 0)
+        {
+            int64_t target = m_nSeekReq;
+            int nGeneration = m_nGeneration;
+            m_nSeekReq = -1;
+            lock.unlock();
+            int64_t ret = avio_seek(m_pSource, target, SEEK_SET);
+            lock.lock();
+            // 期间又有新的跳转，重新处理
+            if (nGeneration != m_nGeneration)
+                continue;
+            if (ret < 0)
+                m_nError = (int)ret;
+            m_cond.notify_all();
+            continue;
+        }
+
+        // 向前跳过时读取位置可能超出缓冲
+        int64_t unread = m_nEnd - FFMIN(m_nPos, m_nEnd);
+        if (m_bEof || m_nError < 0 || unread > capacity - m_nBlockSize)
+        {
+            m_cond.wait(lock);
+            continue;
+        }
+
+        // 写入的区域不跨过缓冲末尾，写入前先从读者可见的范围中去掉
+        int64_t pos = m_nEnd;
+        int64_t offset = pos % capacity;
+        int size = (int)FFMIN((int64_t)m_nBlockSize, capacity - offset);
+        int nGeneration = m_nGeneration;
+        m_nStart = FFMAX(m_nStart, pos + size - capacity);
+        lock.unlock();
+        int ret = ReadSource(m_vecRing.data() + offset, size);
+        lock.lock();
+        // 读取期间发生了跳转，数据作废
+        if (nGeneration != m_nGeneration)
+            continue;
+        if (ret > 0)
+        {
+            m_nEnd += ret;
+            m_stStats.bytes_fetched += ret;
+        }
+        else if (ret == AVERROR_EOF)
+        {
+            m_bEof = true;
+        }
+        else
+        {
+            m_nError = ret;
+        }
+        m_cond.notify_all();
+    }
+}
+
+int PrefetchIO::Read(uint8_t *buf, int size)
+{
+    int64_t t0 = 0;
+
+    // 不预读：直接访问存储，每次读取都计为等待
+    if (m_nDepth <= 0)
+    {
+        t0 = av_gettime_relative();
+        int ret = ReadSource(buf, size);
+        int64_t elapsed = av_gettime_relative() - t0;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stStats.reads++;
+        m_stStats.stalls++;
+        m_stStats.stall_us += elapsed;
+        m_stStats.max_stall_us = FFMAX(m_stStats.max_stall_us, elapsed);
+        if (ret > 0)
+        {
+            m_stStats.bytes_read += ret;
+            m_stStats.bytes_fetched += ret;
+        }
+        return ret;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_nPos >= m_nEnd)
+    {
+        if (m_nSeekReq < 0 && m_nError < 0)
+            return m_nError;
+        if (m_nSeekReq < 0 && m_bEof)
+            return AVERROR_EOF;
+        if (!t0)
+            t0 = av_gettime_relative();
+        m_cond.wait_for(lock, std::chrono::milliseconds(PREFETCH_IO_WAIT_MS));
+        if (Interrupted())
+            return AVERROR_EXIT;
+    }
+
+    int64_t capacity = (int64_t)m_vecRing.size();
+    int n = 0;
+    while (n < size && m_nPos < m_nEnd)
+    {
+        int64_t offset = m_nPos % capacity;
+        int len = (int)FFMIN3((int64_t)(size - n), m_nEnd - m_nPos, capacity - offset);
+        memcpy(buf + n, m_vecRing.data() + offset, len);
+        n += len;
+        m_nPos += len;
+    }
+
+    m_stStats.reads++;
+    m_stStats.bytes_read += n;
+    if (t0)
+    {
+        int64_t elapsed = av_gettime_relative() - t0;
+        m_stStats.stalls++;
+        m_stStats.stall_us += elapsed;
+        m_stStats.max_stall_us = FFMAX(m_stStats.max_stall_us, elapsed);
+    }
+    else
+    {
+        m_stStats.hits++;
+    }
+    // 读走的数据可以被淘汰，唤醒后台继续预读
+    m_cond.notify_all();
+    return n;
+}
+
+int64_t PrefetchIO::Seek(int64_t offset, int whence)
+{
+    int64_t pos;
+
+    whence &= ~AVSEEK_FORCE;
+    if (m_nDepth <= 0)
+    {
+        if (whence == AVSEEK_SIZE)
+            return m_nFileSize >= 0 ? m_nFileSize : AVERROR(ENOSYS);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stStats.seeks++;
+        return avio_seek(m_pSource, offset, whence);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    switch (whence)
+    {
+    case AVSEEK_SIZE:
+        return m_nFileSize >= 0 ? m_nFileSize : AVERROR(ENOSYS);
+    case SEEK_SET:
+        pos = offset;
+        break;
+    case SEEK_CUR:
+        pos = m_nPos + offset;
+        break;
+    case SEEK_END:
+        if (m_nFileSize < 0)
+            return AVERROR(ENOSYS);
+        pos = m_nFileSize + offset;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+
+    m_stStats.seeks++;
+    if (m_nSeekReq < 0 && m_nError >= 0 && pos >= m_nStart && pos <= m_nEnd + PREFETCH_IO_SKIP_AHEAD)
+    {
+        // 在缓冲范围内或稍微超前，后台继续顺序读取
+        m_nPos = pos;
+        m_stStats.seek_hits++;
+    }
+    else
+    {
+        m_nSeekReq = pos;
+        m_nGeneration++;
+        m_nStart = m_nEnd = m_nPos = pos;
+        m_bEof = false;
+        m_nError = 0;
+    }
+    m_cond.notify_all();
+    return pos;
+}
+
+int PrefetchIO::ReadPacket(void *opaque, uint8_t *buf, int size)
+{
+    return ((PrefetchIO *)opaque)->Read(buf, size);
+}
+
+int64_t PrefetchIO::SeekPacket(void *opaque, int64_t offset, int whence)
+{
+    return ((PrefetchIO *)opaque)->Seek(offset, whence);
+}
@@ -0,0 +1,129 @@
+﻿#ifndef PREFETCHIO_H
+#define PREFETCHIO_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "globalhelper.h"
+#include "taskexecutor.h"
+
+#define PREFETCH_IO_BLOCK_SIZE (256 * 1024)     // 后台每次读取的块大小
+#define PREFETCH_IO_DEPTH 128                   // 环形缓冲的块数，默认共 32 MB
+#define PREFETCH_IO_SKIP_AHEAD (2 * 1024 * 1024)    // 向前跳过不超过该距离时等待后台读到，不重新定位
+#define PREFETCH_IO_BUFFER_SIZE (64 * 1024)     // AVIO 内部缓冲
+#define PREFETCH_IO_WAIT_MS 10                  // 等待数据时检查中断的间隔
+
+//预读统计
+typedef struct PrefetchStats {
+    int64_t reads;          // 读取次数
+    int64_t hits;           // 数据已在缓冲中、不需要等待的读取
+    int64_t stalls;         // 需要等待后台读取的读取
+    int64_t stall_us;       // 累计等待时间（微秒）
+    int64_t max_stall_us;   // 最长一次等待
+    int64_t seeks;          // 跳转次数
+    int64_t seek_hits;      // 落在已预读范围内、从内存读取的跳转
+    int64_t bytes_read;     // 交给 avformat 的字节数
+    int64_t bytes_fetched;  // 后台从存储读取的字节数
+} PrefetchStats;
+
+//人为限速，用于在本地模拟慢速存储
+typedef struct PrefetchThrottle {
+    int64_t bytes_per_sec;  // 带宽上限，0 不限制
+    int latency_ms;         // 每次读取的固定延迟
+    int spike_ms;           // 周期性的延迟尖峰
+    int64_t spike_bytes;    // 每读取这么多字节出现一次尖峰，0 不出现
+} PrefetchThrottle;
+
+/**
+ * @brief	异步预读的文件读取
+ *
+ * 代替 file 协议作为 avformat 的自定义 AVIOContext，用于网络共享、U盘等延迟不稳定的存储：
+ * 后台任务按块从存储顺序读取到环形缓冲中，读取线程只从缓冲中复制，
+ * 存储的延迟尖峰由缓冲中已有的数据吸收，不再直接阻塞 av_read_frame。
+ * 缓冲保留已读过的数据直到空间被新数据占用，落在缓冲范围内的跳转（包括向回跳转）
+ * 直接从内存读取，向前小距离跳过时等待后台读到，其它跳转丢弃缓冲后从新位置重新预读。
+ * 深度为0时不预读，每次读取在调用线程中直接访问存储，用于对比。
+ */
+class PrefetchIO
+{
+public:
+    /**
+     * @param	pExecutor 执行后台读取的执行器
+     * @param	nBlockSize 每次从存储读取的字节数
+     * @param	nDepth 环形缓冲的块数，0 表示不预读
+     */
+    explicit PrefetchIO(TaskExecutor *pExecutor, int nBlockSize = PREFETCH_IO_BLOCK_SIZE, int nDepth = PREFETCH_IO_DEPTH);
+    ~PrefetchIO();
+
+    /**
+     * @brief	本地路径是否位于慢速存储（网络共享、可移动磁盘、光盘）上
+     */
+    static bool IsSlowStorage(const char *filename);
+
+    /**
+     * @brief	是否为 HTTP(S) 地址，渐进下载的文件同样通过预读吸收网络抖动
+     */
+    static bool IsHttpUrl(const char *url);
+
+    /**
+     * @brief	设置人为限速，需在 Open 之前调用
+     */
+    void SetThrottle(const PrefetchThrottle &throttle) { m_stThrottle = throttle; }
+
+    /**
+     * @brief	打开文件并开始预读
+     *
+     * @param	filename 文件路径或 URL
+     * @param	interrupt 中断回调，等待数据时检查，返回非0时读取返回 AVERROR_EXIT
+     * @return	0 成功 <0 失败
+     */
+    int Open(const char *filename, const AVIOInterruptCB *interrupt);
+
+    /**
+     * @brief	交给 AVFormatContext::pb 使用的上下文，需要同时设置 AVFMT_FLAG_CUSTOM_IO
+     * @note 	归 PrefetchIO 所有，avformat_close_input 之后再删除 PrefetchIO
+     */
+    AVIOContext *Context() { return m_pAvio; }
+
+    PrefetchStats Stats();
+
+private:
+    int Read(uint8_t *buf, int size);
+    int64_t Seek(int64_t offset, int whence);
+    void FetchLoop();
+    int ReadSource(uint8_t *buf, int size);
+    void ThrottleSleep(int64_t us);
+    bool Interrupted();
+
+    static int ReadPacket(void *opaque, uint8_t *buf, int size);
+    static int64_t SeekPacket(void *opaque, int64_t offset, int whence);
+
+private:
+    TaskExecutor *m_pExecutor;
+    int m_nBlockSize;
+    int m_nDepth;
+    PrefetchThrottle m_stThrottle;
+    int64_t m_nThrottleBytes;   ///< 限速时已读取的字节数
+    AVIOInterruptCB m_stInterrupt;
+    AVIOContext *m_pSource;     ///< 存储上的文件，只在后台任务中访问（深度为0时在调用线程中访问）
+    AVIOContext *m_pAvio;
+    int64_t m_nFileSize;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::vector<uint8_t> m_vecRing;
+    int64_t m_nStart;           ///< 缓冲中数据的文件范围 [m_nStart, m_nEnd)
+    int64_t m_nEnd;
+    int64_t m_nPos;             ///< 读取位置
+    int64_t m_nSeekReq;         ///< 待后台执行的跳转，-1 表示没有
+    int m_nGeneration;          ///< 每次重新定位加一，丢弃过期的读取结果
+    bool m_bEof;
+    int m_nError;
+    PrefetchStats m_stStats;
+    std::atomic<bool> m_bAbort;
+    TaskHandle m_stTask;
+};
+
+#endif // PREFETCHIO_H
@@ -0,0 +1,187 @@
+﻿#include "profiler.h"
+
+#pragma execution_character_set("utf-8")
+
+#ifdef CTTV_PROFILE
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+//一个计时区间的统计
+struct ProfileHistogram {
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> max;
+    std::atomic<uint32_t> buckets[PROFILE_BUCKETS];
+};
+
+//一个线程的统计，只由该线程写入
+struct ProfileThread {
+    int index;
+    ProfileHistogram zones[PROFILE_ZONE_NB];
+    int lock_depth[PROFILE_LOCK_NB];        // SDL 互斥锁可重入，只在最外层计时
+    int64_t lock_since[PROFILE_LOCK_NB];
+};
+
+static std::mutex s_mutexThreads;
+static std::vector<ProfileThread *> s_vecThreads;   // 不释放，线程结束后仍可导出
+static thread_local ProfileThread *s_pThread = NULL;
+
+static ProfileThread *profile_thread()
+{
+    if (!s_pThread) {
+        ProfileThread *t = new ProfileThread();
+        std::lock_guard<std::mutex> lock(s_mutexThreads);
+        t->index = (int)s_vecThreads.size();
+        s_vecThreads.push_back(t);
+        s_pThread = t;
+    }
+    return s_pThread;
+}
+
+static int profile_bucket(int64_t ns)
+{
+    int b = 0;
+    while (b < PROFILE_BUCKETS - 1 && (ns >> (b + 1)) > 0)
+        b++;
+    return b;
+}
+
+/* 按直方图估计分位数，返回所在档的上限（纳秒） */
+static uint64_t profile_percentile(const ProfileHistogram &h, double q)
+{
+    uint64_t count = h.count.load(std::memory_order_relaxed);
+    uint64_t want = (uint64_t)(count * q), seen = 0;
+
+    for (int b = 0; b < PROFILE_BUCKETS; b++) {
+        seen += h.buckets[b].load(std::memory_order_relaxed);
+        if (seen > want)
+            return 2ULL << b;
+    }
+    return h.max.load(std::memory_order_relaxed);
+}
+
+int64_t Profiler::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::Add(int nZone, int64_t nNs)
+{
+    ProfileHistogram &h = profile_thread()->zones[nZone];
+
+    if (nNs < 0)
+        nNs = 0;
+    h.count.fetch_add(1, std::memory_order_relaxed);
+    h.total.fetch_add(nNs, std::memory_order_relaxed);
+    if ((uint64_t)nNs > h.max.load(std::memory_order_relaxed))
+        h.max.store(nNs, std::memory_order_relaxed);
+    h.buckets[profile_bucket(nNs)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void Profiler::LockMutex(SDL_mutex *mutex, int nLock)
+{
+    ProfileThread *t = profile_thread();
+    int64_t start = Now();
+
+    SDL_LockMutex(mutex);
+    if (t->lock_depth[nLock]++ == 0) {
+        int64_t now = Now();
+        Add(PROFILE_ZONE_PACKET_QUEUE_WAIT + nLock * 3, now - start);
+        t->lock_since[nLock] = now;
+    }
+}
+
+void Profiler::UnlockMutex(SDL_mutex *mutex, int nLock)
+{
+    ProfileThread *t = profile_thread();
+
+    if (t->lock_depth[nLock] > 0 && --t->lock_depth[nLock] == 0)
+        Add(PROFILE_ZONE_PACKET_QUEUE_HOLD + nLock * 3, Now() - t->lock_since[nLock]);
+    SDL_UnlockMutex(mutex);
+}
+
+int Profiler::CondWait(SDL_cond *cond, SDL_mutex *mutex, int nLock)
+{
+    ProfileThread *t = profile_thread();
+    int64_t start = Now();
+    int ret;
+
+    // 等待期间锁已释放，之前的持有时间先记一段
+    if (t->lock_depth[nLock] > 0)
+        Add(PROFILE_ZONE_PACKET_QUEUE_HOLD + nLock * 3, start - t->lock_since[nLock]);
+    ret = SDL_CondWait(cond, mutex);
+    t->lock_since[nLock] = Now();
+    Add(PROFILE_ZONE_PACKET_QUEUE_COND + nLock * 3, t->lock_since[nLock] - start);
+    return ret;
+}
+
+const char *Profiler::ZoneName(int nZone)
+{
+    static const char *s_arrNames[PROFILE_ZONE_NB] = {
+        "read_frame",
+        "decode_send",
+        "decode_receive",
+        "queue_picture",
+        "upload_texture",
+        "render_present",
+        "audio_decode",
+        "sonic",
+        "packet_queue_wait",
+        "packet_queue_hold",
+        "packet_queue_cond",
+        "frame_queue_wait",
+        "frame_queue_hold",
+        "frame_queue_cond",
+    };
+    return nZone >= 0 && nZone < PROFILE_ZONE_NB ? s_arrNames[nZone] : "unknown";
+}
+
+QString Profiler::Dump()
+{
+    std::lock_guard<std::mutex> lock(s_mutexThreads);
+    QString strReport;
+
+    for (ProfileThread *t : s_vecThreads) {
+        QString strThread;
+        for (int z = 0; z < PROFILE_ZONE_NB; z++) {
+            const ProfileHistogram &h = t->zones[z];
+            uint64_t count = h.count.load(std::memory_order_relaxed);
+            if (!count)
+                continue;
+            uint64_t total = h.total.load(std::memory_order_relaxed);
+            strThread += QString::asprintf("  %-20s %10llu %12.3f %10.2f %10.2f %10.2f %10.2f\n",
+                                           ZoneName(z), (unsigned long long)count, total / 1e6,
+                                           total / 1e3 / count,
+                                           profile_percentile(h, 0.5) / 1e3,
+                                           profile_percentile(h, 0.99) / 1e3,
+                                           h.max.load(std::memory_order_relaxed) / 1e3);
+        }
+        if (strThread.isEmpty())
+            continue;
+        strReport += QString::asprintf("thread %d\n  %-20s %10s %12s %10s %10s %10s %10s\n", t->index,
+                                       "zone", "count", "total(ms)", "avg(us)", "p50(us)", "p99(us)", "max(us)");
+        strReport += strThread;
+    }
+    return strReport;
+}
+
+void Profiler::Reset()
+{
+    std::lock_guard<std::mutex> lock(s_mutexThreads);
+
+    for (ProfileThread *t : s_vecThreads) {
+        for (ProfileHistogram &h : t->zones) {
+            h.count.store(0, std::memory_order_relaxed);
+            h.total.store(0, std::memory_order_relaxed);
+            h.max.store(0, std::memory_order_relaxed);
+            for (std::atomic<uint32_t> &b : h.buckets)
+                b.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+#endif // CTTV_PROFILE
@@ -0,0 +1,112 @@
+﻿#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QString>
+
+#include "globalhelper.h"
+
+/**
+ * 性能分析区间，编译时在 CTTV_Player.pro 中加上 DEFINES += CTTV_PROFILE 开启，
+ * 未开启时下面的宏展开为空语句或原来的 SDL 调用，没有任何开销。
+ *
+ * PROFILE_SCOPE(zone)                      在当前作用域内计时
+ * PROFILE_MUTEX_LOCK(mutex, lock)          加锁，记录等待时间，并开始记录持有时间
+ * PROFILE_MUTEX_UNLOCK(mutex, lock)        解锁，记录持有时间
+ * PROFILE_COND_WAIT(cond, mutex, lock)     条件变量等待，等待期间不计入持有时间
+ */
+
+//计时区间
+enum ProfileZone {
+    PROFILE_ZONE_READ_FRAME = 0,        // 读取线程 av_read_frame
+    PROFILE_ZONE_DECODE_SEND,           // avcodec_send_packet / avcodec_decode_subtitle2
+    PROFILE_ZONE_DECODE_RECEIVE,        // avcodec_receive_frame
+    PROFILE_ZONE_QUEUE_PICTURE,         // queue_picture，包括等待帧队列空位
+    PROFILE_ZONE_UPLOAD_TEXTURE,        // upload_texture
+    PROFILE_ZONE_RENDER_PRESENT,        // SDL_RenderPresent
+    PROFILE_ZONE_AUDIO_DECODE,          // audio_decode_frame
+    PROFILE_ZONE_SONIC,                 // sonic 变速
+    PROFILE_ZONE_PACKET_QUEUE_WAIT,     // 包队列加锁等待
+    PROFILE_ZONE_PACKET_QUEUE_HOLD,     // 包队列持有锁
+    PROFILE_ZONE_PACKET_QUEUE_COND,     // 包队列条件变量等待
+    PROFILE_ZONE_FRAME_QUEUE_WAIT,      // 帧队列加锁等待
+    PROFILE_ZONE_FRAME_QUEUE_HOLD,      // 帧队列持有锁
+    PROFILE_ZONE_FRAME_QUEUE_COND,      // 帧队列条件变量等待
+    PROFILE_ZONE_NB
+};
+
+//加锁统计的锁类别，每类对应 WAIT/HOLD/COND 三个计时区间
+enum ProfileLock {
+    PROFILE_LOCK_PACKET_QUEUE = 0,
+    PROFILE_LOCK_FRAME_QUEUE,
+    PROFILE_LOCK_NB
+};
+
+#ifdef CTTV_PROFILE
+
+#define PROFILE_BUCKETS 40              // 直方图按 2 的幂分档，从 1ns 到约 9 分钟
+
+/**
+ * @brief	分线程的耗时直方图
+ *
+ * 每个线程第一次记录时分配自己的统计数据，只由该线程写入，
+ * 导出时读取所有线程的数据。线程结束后数据保留，以便导出。
+ */
+class Profiler
+{
+public:
+    /**
+     * @brief	单调时钟（纳秒）
+     */
+    static int64_t Now();
+
+    /**
+     * @brief	记录当前线程一次计时
+     */
+    static void Add(int nZone, int64_t nNs);
+
+    /**
+     * @brief	导出所有线程的统计：次数、总时间、平均值、P50/P99（按直方图分档的上限估计）和最大值
+     */
+    static QString Dump();
+
+    /**
+     * @brief	清空统计
+     */
+    static void Reset();
+
+    static const char *ZoneName(int nZone);
+
+    static void LockMutex(SDL_mutex *mutex, int nLock);
+    static void UnlockMutex(SDL_mutex *mutex, int nLock);
+    static int CondWait(SDL_cond *cond, SDL_mutex *mutex, int nLock);
+};
+
+//作用域计时
+class ProfileScope
+{
+public:
+    explicit ProfileScope(int nZone) : m_nZone(nZone), m_nStart(Profiler::Now()) {}
+    ~ProfileScope() { Profiler::Add(m_nZone, Profiler::Now() - m_nStart); }
+
+private:
+    int m_nZone;
+    int64_t m_nStart;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(zone) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(zone)
+#define PROFILE_MUTEX_LOCK(mutex, lock) Profiler::LockMutex(mutex, lock)
+#define PROFILE_MUTEX_UNLOCK(mutex, lock) Profiler::UnlockMutex(mutex, lock)
+#define PROFILE_COND_WAIT(cond, mutex, lock) Profiler::CondWait(cond, mutex, lock)
+
+#else
+
+#define PROFILE_SCOPE(zone) ((void)0)
+#define PROFILE_MUTEX_LOCK(mutex, lock) SDL_LockMutex(mutex)
+#define PROFILE_MUTEX_UNLOCK(mutex, lock) SDL_UnlockMutex(mutex)
+#define PROFILE_COND_WAIT(cond, mutex, lock) SDL_CondWait(cond, mutex)
+
+#endif // CTTV_PROFILE
+
+#endif // PROFILER_H
@@ -0,0 +1,155 @@
+﻿#include <thread>
+
+#include "resampler.h"
+
+#pragma execution_character_set("utf-8")
+
+// 构造函数
+AudioResampler::AudioResampler() :
+    m_nTick(0),
+    m_nCreated(0),
+    m_nReused(0)
+{
+}
+
+// 析构函数
+AudioResampler::~AudioResampler()
+{
+    Clear();
+}
+
+/* 自动模式：高倍速时单位时间要处理的样本成倍增加，双核及以下的机器也优先省电 */
+int AudioResampler::ResolveMode(int nMode, double dPlaybackRate)
+{
+    if (nMode > RESAMPLER_MODE_AUTO && nMode < RESAMPLER_MODE_NB)
+    {
+        return nMode;
+    }
+
+    if (dPlaybackRate >= RESAMPLER_FAST_RATE || std::thread::hardware_concurrency() <= 2)
+    {
+        return RESAMPLER_MODE_FAST;
+    }
+    return RESAMPLER_MODE_DEFAULT;
+}
+
+const char *AudioResampler::ModeName(int nMode)
+{
+    switch (nMode)
+    {
+    case RESAMPLER_MODE_AUTO:
+        return "auto";
+    case RESAMPLER_MODE_FAST:
+        return "fast";
+    case RESAMPLER_MODE_DEFAULT:
+        return "default";
+    case RESAMPLER_MODE_HIGH:
+        return "high";
+    default:
+        return "unknown";
+    }
+}
+
+/* 按模式设置滤波器参数，需在 swr_init 之前调用 */
+int AudioResampler::ApplyMode(struct SwrContext *ctx, int nMode, enum AVSampleFormat out_fmt)
+{
+    int ret = 0;
+
+    switch (nMode)
+    {
+    case RESAMPLER_MODE_FAST:
+        ret |= av_opt_set_int(ctx, "filter_size", 8, 0);
+        ret |= av_opt_set_int(ctx, "phase_shift", 6, 0);
+        ret |= av_opt_set_int(ctx, "linear_interp", 1, 0);
+        ret |= av_opt_set_double(ctx, "cutoff", 0.9, 0);
+        break;
+    case RESAMPLER_MODE_HIGH:
+        ret |= av_opt_set_int(ctx, "filter_size", 64, 0);
+        ret |= av_opt_set_int(ctx, "phase_shift", 12, 0);
+        ret |= av_opt_set_int(ctx, "linear_interp", 1, 0);
+        ret |= av_opt_set_int(ctx, "exact_rational", 1, 0);
+        ret |= av_opt_set_double(ctx, "cutoff", 0.98, 0);
+        if (av_get_packed_sample_fmt(out_fmt) == AV_SAMPLE_FMT_S16)
+            ret |= av_opt_set_int(ctx, "dither_method", SWR_DITHER_TRIANGULAR_HIGHPASS, 0);
+        break;
+    default:
+        break;
+    }
+    return ret < 0 ? AVERROR(EINVAL) : 0;
+}
+
+/* 配置重采样参数：先在缓存中找相同参数的上下文，找不到再新建 */
+struct SwrContext *AudioResampler::Configure(const ResamplerParams &params, int nMode)
+{
+    Entry *pEntry = NULL;
+
+    m_nTick++;
+    for (Entry &entry : m_vecCache)
+    {
+        if (entry.mode == nMode && !memcmp(&entry.params, &params, sizeof(params)))
+        {
+            pEntry = &entry;
+            break;
+        }
+    }
+
+    if (pEntry)
+    {
+        // 参数相同，swr_init 只清空残留的样本，滤波器系数保留
+        if (swr_init(pEntry->ctx) < 0)
+        {
+            return NULL;
+        }
+        pEntry->last_used = m_nTick;
+        m_nReused++;
+        return pEntry->ctx;
+    }
+
+    struct SwrContext *ctx = swr_alloc_set_opts(NULL,
+                                                params.out_layout, params.out_fmt, params.out_rate,
+                                                params.in_layout, params.in_fmt, params.in_rate,
+                                                0, NULL);
+    if (!ctx || ApplyMode(ctx, nMode, params.out_fmt) < 0 || swr_init(ctx) < 0)
+    {
+        swr_free(&ctx);
+        return NULL;
+    }
+
+    // 缓存满时淘汰最久未使用的上下文
+    if ((int)m_vecCache.size() >= RESAMPLER_CACHE_SIZE)
+    {
+        auto oldest = m_vecCache.begin();
+        for (auto it = m_vecCache.begin(); it != m_vecCache.end(); ++it)
+        {
+            if (it->last_used < oldest->last_used)
+            {
+                oldest = it;
+            }
+        }
+        swr_free(&oldest->ctx);
+        m_vecCache.erase(oldest);
+    }
+
+    Entry entry;
+    entry.params = params;
+    entry.mode = nMode;
+    entry.ctx = ctx;
+    entry.last_used = m_nTick;
+    m_vecCache.push_back(entry);
+    m_nCreated++;
+
+    av_log(NULL, AV_LOG_VERBOSE, "resampler: %d Hz %s -> %d Hz %s, mode %s\n",
+           params.in_rate, av_get_sample_fmt_name(params.in_fmt),
+           params.out_rate, av_get_sample_fmt_name(params.out_fmt), ModeName(nMode));
+    return ctx;
+}
+
+/* 释放所有缓存的上下文 */
+void AudioResampler::Clear()
+{
+    for (Entry &entry : m_vecCache)
+    {
+        swr_free(&entry.ctx);
+    }
+    m_vecCache.clear();
+}
@@ -0,0 +1,90 @@
+﻿#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <vector>
+
+#include "globalhelper.h"
+
+#define RESAMPLER_CACHE_SIZE 4          // 保留的重采样上下文个数
+#define RESAMPLER_FAST_RATE 1.5         // 自动模式下播放速率不低于该值时使用快速模式
+
+//重采样质量
+enum ResamplerMode {
+    RESAMPLER_MODE_AUTO = 0,    // 高倍速播放或低性能机器用快速模式，否则用标准模式
+    RESAMPLER_MODE_FAST,        // 短滤波器 + 线性插值
+    RESAMPLER_MODE_DEFAULT,     // swr 默认参数
+    RESAMPLER_MODE_HIGH,        // 长滤波器，S16 输出时加高通三角抖动
+    RESAMPLER_MODE_NB
+};
+
+//一组重采样参数
+typedef struct ResamplerParams {
+    int64_t in_layout;
+    enum AVSampleFormat in_fmt;
+    int in_rate;
+    int64_t out_layout;
+    enum AVSampleFormat out_fmt;
+    int out_rate;
+} ResamplerParams;
+
+/**
+ * @brief	可配置的音频重采样器
+ *
+ * 按模式设置 swr 的滤波器参数，并缓存最近使用的几个 SwrContext：
+ * 参数相同的配置（包括下一个文件）直接复用已有的上下文，swr_init 只清空缓冲，
+ * 滤波器系数不会重新计算；缓存满时淘汰最久未使用的上下文。
+ * 只在音频回调线程中使用。
+ */
+class AudioResampler
+{
+public:
+    AudioResampler();
+    ~AudioResampler();
+
+    /**
+     * @brief	按播放状态确定实际使用的模式
+     *
+     * @param	nMode ResamplerMode
+     * @param	dPlaybackRate 播放速率
+     * @return	RESAMPLER_MODE_FAST/DEFAULT/HIGH
+     */
+    static int ResolveMode(int nMode, double dPlaybackRate);
+
+    static const char *ModeName(int nMode);
+
+    /**
+     * @brief	配置重采样参数
+     *
+     * @param	params 输入/输出参数
+     * @param	nMode 已确定的模式（不能为 RESAMPLER_MODE_AUTO）
+     * @return	可以使用的上下文，失败返回 NULL
+     * @note 	返回的上下文归重采样器所有，调用者不能释放
+     */
+    struct SwrContext *Configure(const ResamplerParams &params, int nMode);
+
+    /**
+     * @brief	释放所有缓存的上下文
+     */
+    void Clear();
+
+    int CreateCount() const { return m_nCreated; }
+    int ReuseCount() const { return m_nReused; }
+
+private:
+    static int ApplyMode(struct SwrContext *ctx, int nMode, enum AVSampleFormat out_fmt);
+
+    struct Entry
+    {
+        ResamplerParams params;
+        int mode;
+        struct SwrContext *ctx;
+        uint64_t last_used;
+    };
+
+    std::vector<Entry> m_vecCache;
+    uint64_t m_nTick;
+    int m_nCreated;     ///< 新建上下文的次数
+    int m_nReused;      ///< 复用上下文的次数
+};
+
+#endif // RESAMPLER_H
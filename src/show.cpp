@@ -9,14 +9,12 @@
 // 设置字符集为 UTF-8
 #pragma execution_character_set("utf-8")
 
-// 定义一个全局互斥量，用于保护显示区域的几何变化
-QMutex g_show_rect_mutex;
-
 Show::Show(QWidget *parent) :
     QWidget(parent),
     ui(new Ui::Show),          // 创建 UI 实例
     m_stActionGroup(this),     // 创建动作组
-    m_stMenu(this)             // 创建菜单
+    m_stMenu(this),            // 创建菜单
+    m_pVideoCtl(nullptr)
 {
     ui->setupUi(this); // 设置 UI
 
@@ -48,8 +46,12 @@ Show::~Show()
     delete ui; // 删除 UI 实例
 }
 
-bool Show::Init()
+bool Show::Init(VideoCtl *pVideoCtl)
 {
+    // 绑定播放引擎，显示区域变化时通过互斥量通知引擎
+    m_pVideoCtl = pVideoCtl;
+    m_pVideoCtl->SetShowRectMutex(&m_stRectMutex);
+
     // 连接信号和槽
     if (ConnectSignalSlots() == false)
     {
@@ -72,7 +74,7 @@ void Show::OnFrameDimensionsChanged(int nFrameWidth, int nFrameHeight)
 // 改变显示区域
 void Show::ChangeShow()
 {
-    g_show_rect_mutex.lock(); // 加锁以保护显示区域的几何变化
+    m_stRectMutex.lock(); // 加锁以保护显示区域的几何变化
 
     if (m_nLastFrameWidth == 0 && m_nLastFrameHeight == 0)
     {
@@ -100,7 +102,7 @@ void Show::ChangeShow()
         ui->label->setGeometry(x, y, width, height); // 设置 label 的几何形状
     }
 
-    g_show_rect_mutex.unlock(); // 解锁
+    m_stRectMutex.unlock(); // 解锁
 }
 
 // 拖放事件进入时调用
@@ -142,6 +144,24 @@ void Show::keyReleaseEvent(QKeyEvent *event)
     case Qt::Key_Space: // 播放/暂停
         emit SigPlayOrPause();
         break;
+    case Qt::Key_BracketLeft: // 减速
+        emit SigSpeedStep(-1);
+        break;
+    case Qt::Key_BracketRight: // 加速
+        emit SigSpeedStep(1);
+        break;
+    case Qt::Key_Period: // 关键帧快进
+        emit SigFastForward();
+        break;
+    case Qt::Key_Comma: // 关键帧快退
+        emit SigFastRewind();
+        break;
+    case Qt::Key_R: // 倒放
+        emit SigReverseToggle();
+        break;
+    case Qt::Key_B: // 后退一帧
+        emit SigStepBackward();
+        break;
 
     default:
         QWidget::keyPressEvent(event); // 处理其他按键事件
@@ -169,7 +189,7 @@ void Show::OnDisplayMsg(QString strMsg)
 // 播放文件的槽函数
 void Show::OnPlay(QString strFile)
 {
-    VideoCtl::GetInstance()->StartPlay(strFile, ui->label->winId());
+    m_pVideoCtl->StartPlay(strFile, ui->label->winId());
 }
 
 // 停止播放完成后的处理
@@ -27,7 +27,7 @@ public:
     /**
      * @brief	初始化
      */
-    bool Init();
+    bool Init(VideoCtl *pVideoCtl);
 
 protected:
     /**
@@ -116,6 +116,11 @@ signals:
     void SigSeekForward();
     void SigSeekBack();
     void SigAddVolume();
+    void SigSpeedStep(int nSteps);
+    void SigFastForward();
+    void SigFastRewind();
+    void SigReverseToggle();
+    void SigStepBackward();
     void SigSubVolume();
 private:
     Ui::Show *ui;
@@ -127,6 +132,9 @@ private:
 
     QMenu m_stMenu;
     QActionGroup m_stActionGroup;
+
+    VideoCtl *m_pVideoCtl;  ///< 本窗口使用的播放引擎
+    QMutex m_stRectMutex;   ///< 保护显示区域的几何变化，调整大小时引擎暂停刷新
 };
 
 #endif // DISPLAY_H
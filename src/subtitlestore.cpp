@@ -0,0 +1,473 @@
+﻿#include <QFile>
+#include <QFileInfo>
+#include <QTextCodec>
+#include <QRegularExpression>
+
+#include <algorithm>
+
+#include "subtitlestore.h"
+
+#pragma execution_character_set("utf-8")
+
+#define SUBTITLE_DEFAULT_DURATION 3000  // 没有结束时间的字幕默认显示时长（毫秒）
+
+SubtitleStore::SubtitleStore() :
+    m_bTreeDirty(false),
+    m_nLastKey(0),
+    m_nNextId(1),
+    m_nStreamIndex(-1),
+    m_bAbort(false)
+{
+}
+
+SubtitleStore::~SubtitleStore()
+{
+}
+
+/* 查找并加载与视频同名的外挂字幕 */
+bool SubtitleStore::LoadSidecar(const QString &strVideoFile)
+{
+    QFileInfo stVideoInfo(strVideoFile);
+    if (!stVideoInfo.isFile())
+    {
+        return false;
+    }
+
+    QString strBase = stVideoInfo.absolutePath() + "/" + stVideoInfo.completeBaseName();
+    QStringList listExt = { ".srt", ".ass", ".ssa" };
+    for (const QString &strExt : listExt)
+    {
+        if (QFile::exists(strBase + strExt) && LoadFile(strBase + strExt))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* 加载 SRT/ASS 字幕文件 */
+bool SubtitleStore::LoadFile(const QString &strFile)
+{
+    QFile file(strFile);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+    QByteArray data = file.readAll();
+    file.close();
+
+    // 有BOM时按BOM解码，否则优先按UTF-8解码，存在非法字符时按本地编码（如GBK）解码
+    QString strContent;
+    QTextCodec *pCodec = QTextCodec::codecForUtfText(data, nullptr);
+    if (pCodec)
+    {
+        strContent = pCodec->toUnicode(data);
+    }
+    else
+    {
+        QTextCodec::ConverterState state;
+        strContent = QTextCodec::codecForName("UTF-8")->toUnicode(data.constData(), data.size(), &state);
+        if (state.invalidChars > 0)
+        {
+            strContent = QString::fromLocal8Bit(data);
+        }
+    }
+    strContent.replace("\r\n", "\n");
+
+    QString strSuffix = QFileInfo(strFile).suffix().toLower();
+    if (strSuffix == "ass" || strSuffix == "ssa")
+    {
+        return ParseAss(strContent);
+    }
+    return ParseSrt(strContent);
+}
+
+/* 解析 SRT：序号行、时间行、若干文本行，空行分隔 */
+bool SubtitleStore::ParseSrt(const QString &strContent)
+{
+    static const QRegularExpression reTime("(\\d+):(\\d+):(\\d+)[,.](\\d+)\\s*-->\\s*(\\d+):(\\d+):(\\d+)[,.](\\d+)");
+    static const QRegularExpression reTag("<[^>]*>");
+    QStringList listLines = strContent.split('\n');
+    bool bLoaded = false;
+
+    for (int i = 0; i < listLines.size(); i++)
+    {
+        QRegularExpressionMatch match = reTime.match(listLines.at(i));
+        if (!match.hasMatch())
+        {
+            continue;
+        }
+
+        int64_t nStart = ((match.captured(1).toLongLong() * 60 + match.captured(2).toLongLong()) * 60
+                          + match.captured(3).toLongLong()) * 1000 + match.captured(4).toLongLong();
+        int64_t nEnd = ((match.captured(5).toLongLong() * 60 + match.captured(6).toLongLong()) * 60
+                        + match.captured(7).toLongLong()) * 1000 + match.captured(8).toLongLong();
+
+        QStringList listText;
+        while (i + 1 < listLines.size() && !listLines.at(i + 1).trimmed().isEmpty())
+        {
+            listText.append(listLines.at(++i).trimmed());
+        }
+
+        QString strText = listText.join("\n");
+        strText.remove(reTag);
+        if (!strText.isEmpty())
+        {
+            AddCue(nStart, nEnd, strText);
+            bLoaded = true;
+        }
+    }
+    return bLoaded;
+}
+
+/* 解析 ASS/SSA：只取 [Events] 中的 Dialogue 行 */
+bool SubtitleStore::ParseAss(const QString &strContent)
+{
+    static const QRegularExpression reTime("(\\d+):(\\d+):(\\d+)\\.(\\d+)");
+    QStringList listLines = strContent.split('\n');
+    bool bLoaded = false;
+
+    for (const QString &strLine : listLines)
+    {
+        if (!strLine.startsWith("Dialogue:"))
+        {
+            continue;
+        }
+
+        // Dialogue: Layer,Start,End,Style,Name,MarginL,MarginR,MarginV,Effect,Text
+        QStringList listFields = strLine.mid(9).split(',');
+        if (listFields.size() < 10)
+        {
+            continue;
+        }
+
+        int64_t nTimes[2];
+        bool bValid = true;
+        for (int j = 0; j < 2; j++)
+        {
+            QRegularExpressionMatch match = reTime.match(listFields.at(1 + j));
+            if (!match.hasMatch())
+            {
+                bValid = false;
+                break;
+            }
+            nTimes[j] = ((match.captured(1).toLongLong() * 60 + match.captured(2).toLongLong()) * 60
+                         + match.captured(3).toLongLong()) * 1000 + match.captured(4).toLongLong() * 10;
+        }
+        if (!bValid)
+        {
+            continue;
+        }
+
+        QString strText = AssToPlainText(QStringList(listFields.mid(9)).join(","));
+        if (!strText.isEmpty())
+        {
+            AddCue(nTimes[0], nTimes[1], strText);
+            bLoaded = true;
+        }
+    }
+    return bLoaded;
+}
+
+/* ASS 对话文本转纯文本 */
+QString SubtitleStore::AssToPlainText(const QString &strAss)
+{
+    static const QRegularExpression reOverride("\\{[^}]*\\}");
+    QString strText = strAss;
+    strText.remove(reOverride);
+    strText.replace("\\N", "\n").replace("\\n", "\n").replace("\\h", " ");
+    return strText.trimmed();
+}
+
+/* 加入一条字幕 */
+void SubtitleStore::AddCue(int64_t nStartMs, int64_t nEndMs, const QString &strText)
+{
+    if (nEndMs <= nStartMs)
+    {
+        nEndMs = nStartMs + SUBTITLE_DEFAULT_DURATION;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = std::upper_bound(m_vecCues.begin(), m_vecCues.end(), nStartMs,
+                               [](int64_t nStart, const SubtitleCue &cue) { return nStart < cue.start_ms; });
+
+    // 预读和播放中解码可能得到同一条字幕，开始时间相同的字幕中查重
+    for (auto dup = it; dup != m_vecCues.begin() && (dup - 1)->start_ms == nStartMs; --dup)
+    {
+        if ((dup - 1)->end_ms == nEndMs && (dup - 1)->text == strText)
+        {
+            return;
+        }
+    }
+
+    SubtitleCue cue;
+    cue.start_ms = nStartMs;
+    cue.end_ms = nEndMs;
+    cue.id = m_nNextId++;
+    cue.text = strText;
+
+    m_vecCues.insert(it, cue);
+
+    // 预读时连续加入大量字幕，区间树在下次查询时一次重建
+    m_bTreeDirty = true;
+}
+
+/* 重建区间树，m_vecCues 已按开始时间排序，下标顺序即开始时间顺序 */
+void SubtitleStore::BuildTree()
+{
+    m_vecTree.clear();
+    m_vecByStart.clear();
+    m_vecByEnd.clear();
+    m_bTreeDirty = false;
+    if (m_vecCues.empty())
+    {
+        return;
+    }
+
+    std::vector<int> vecItems(m_vecCues.size());
+    for (size_t i = 0; i < vecItems.size(); i++)
+    {
+        vecItems[i] = (int)i;
+    }
+    BuildNode(vecItems);
+}
+
+/* 建立一个子树，vecItems 按开始时间升序，返回节点下标（子节点先于父节点加入） */
+int SubtitleStore::BuildNode(std::vector<int> &vecItems)
+{
+    if (vecItems.empty())
+    {
+        return -1;
+    }
+
+    // 以开始时间居中的字幕的开始时间为中心点，该字幕一定留在本节点，
+    // 左右子树各自不超过一半，树高为 O(log n)
+    IntervalNode node;
+    node.center = m_vecCues[vecItems[vecItems.size() / 2]].start_ms;
+
+    std::vector<int> vecLeft, vecRight, vecHere;
+    for (int i : vecItems)
+    {
+        const SubtitleCue &cue = m_vecCues[i];
+        if (cue.end_ms <= node.center)
+        {
+            vecLeft.push_back(i);
+        }
+        else if (cue.start_ms > node.center)
+        {
+            vecRight.push_back(i);
+        }
+        else
+        {
+            vecHere.push_back(i);
+        }
+    }
+    vecItems.clear();
+    vecItems.shrink_to_fit();
+
+    node.left = BuildNode(vecLeft);
+    node.right = BuildNode(vecRight);
+    node.begin = (int)m_vecByStart.size();
+    node.count = (int)vecHere.size();
+
+    m_vecByStart.insert(m_vecByStart.end(), vecHere.begin(), vecHere.end());
+    std::stable_sort(vecHere.begin(), vecHere.end(),
+                     [this](int a, int b) { return m_vecCues[a].end_ms > m_vecCues[b].end_ms; });
+    m_vecByEnd.insert(m_vecByEnd.end(), vecHere.begin(), vecHere.end());
+
+    m_vecTree.push_back(node);
+    return (int)m_vecTree.size() - 1;
+}
+
+/* 加入解码得到的文本字幕 */
+void SubtitleStore::AddSubtitle(const AVSubtitle *sub, double dPts)
+{
+    int64_t nBase = (int64_t)(dPts * 1000);
+    int64_t nStart = nBase + sub->start_display_time;
+    int64_t nEnd = sub->end_display_time == UINT32_MAX ? nStart : nBase + sub->end_display_time;
+
+    for (unsigned int i = 0; i < sub->num_rects; i++)
+    {
+        AVSubtitleRect *rect = sub->rects[i];
+        QString strText;
+
+        if (rect->type == SUBTITLE_ASS && rect->ass)
+        {
+            // ReadOrder,Layer,Style,Name,MarginL,MarginR,MarginV,Effect,Text
+            // 旧版本解码器输出完整的 Dialogue 行，多一个时间字段
+            QString strLine = QString::fromUtf8(rect->ass);
+            int nSkip = strLine.startsWith("Dialogue:") ? 9 : 8;
+            int nPos = 0;
+            for (int j = 0; j < nSkip && nPos >= 0; j++)
+            {
+                nPos = strLine.indexOf(',', nPos);
+                if (nPos >= 0)
+                {
+                    nPos++;
+                }
+            }
+            if (nPos < 0)
+            {
+                continue;
+            }
+            strText = AssToPlainText(strLine.mid(nPos));
+        }
+        else if (rect->type == SUBTITLE_TEXT && rect->text)
+        {
+            strText = QString::fromUtf8(rect->text).trimmed();
+        }
+
+        if (!strText.isEmpty())
+        {
+            AddCue(nStart, nEnd, strText);
+        }
+    }
+}
+
+/* 查询某一时刻显示的字幕 */
+uint64_t SubtitleStore::Lookup(int64_t nTimeMs, QString &strText)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_bTreeDirty)
+    {
+        BuildTree();
+    }
+
+    // 沿区间树下降：查询时间在中心点之前时，本节点中已开始的字幕都命中（结束时间都晚于中心点）；
+    // 否则本节点中尚未结束的字幕都命中（开始时间都不晚于中心点），两种情况都在第一条不命中处停止
+    m_vecHits.clear();
+    int nNode = m_vecTree.empty() ? -1 : (int)m_vecTree.size() - 1;
+    while (nNode >= 0)
+    {
+        const IntervalNode &node = m_vecTree[nNode];
+        if (nTimeMs < node.center)
+        {
+            for (int i = node.begin; i < node.begin + node.count && m_vecCues[m_vecByStart[i]].start_ms <= nTimeMs; i++)
+            {
+                m_vecHits.push_back(m_vecByStart[i]);
+            }
+            nNode = node.left;
+        }
+        else
+        {
+            for (int i = node.begin; i < node.begin + node.count && m_vecCues[m_vecByEnd[i]].end_ms > nTimeMs; i++)
+            {
+                m_vecHits.push_back(m_vecByEnd[i]);
+            }
+            nNode = node.right;
+        }
+    }
+    if (m_vecHits.empty())
+    {
+        strText.clear();
+        return 0;
+    }
+
+    // 按开始时间顺序拼接，同时计算字幕集合的标识；集合不变时直接返回上次的结果
+    std::sort(m_vecHits.begin(), m_vecHits.end());
+    uint64_t nKey = 14695981039346656037ULL;
+    for (int hit : m_vecHits)
+    {
+        nKey = (nKey ^ m_vecCues[hit].id) * 1099511628211ULL;
+    }
+    nKey = nKey ? nKey : 1;
+    if (nKey != m_nLastKey)
+    {
+        m_strLastText.clear();
+        for (int hit : m_vecHits)
+        {
+            if (hit != m_vecHits.front())
+            {
+                m_strLastText += "\n";
+            }
+            m_strLastText += m_vecCues[hit].text;
+        }
+        m_nLastKey = nKey;
+    }
+    strText = m_strLastText;
+    return nKey;
+}
+
+bool SubtitleStore::IsEmpty()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_vecCues.empty();
+}
+
+void SubtitleStore::Abort()
+{
+    m_bAbort = true;
+}
+
+int SubtitleStore::InterruptCallback(void *ctx)
+{
+    SubtitleStore *pStore = (SubtitleStore *)ctx;
+    return pStore->m_bAbort;
+}
+
+/* 后台预读内嵌文本字幕流 */
+int SubtitleStore::PreReadStream(const char *filename, int nStreamIndex)
+{
+    AVFormatContext *ic = NULL;
+    AVCodecContext *avctx = NULL;
+    AVCodec *codec;
+    AVPacket pkt;
+    int ret;
+
+    m_nStreamIndex = nStreamIndex;
+
+    ic = avformat_alloc_context();
+    if (!ic)
+        return AVERROR(ENOMEM);
+    ic->interrupt_callback.callback = InterruptCallback;
+    ic->interrupt_callback.opaque = this;
+
+    ret = avformat_open_input(&ic, filename, NULL, NULL);
+    if (ret < 0)
+        return ret;
+
+    // 只预读本地小文件，避免后台把整部大文件从磁盘读一遍
+    if (!ic->pb || (ic->pb->seekable & AVIO_SEEKABLE_NORMAL) == 0 ||
+            avio_size(ic->pb) <= 0 || avio_size(ic->pb) > SUBTITLE_PREREAD_MAX_FILE ||
+            nStreamIndex < 0 || nStreamIndex >= (int)ic->nb_streams) {
+        ret = AVERROR(EINVAL);
+        goto fail;
+    }
+
+    for (unsigned int i = 0; i < ic->nb_streams; i++)
+        ic->streams[i]->discard = (int)i == nStreamIndex ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+
+    codec = avcodec_find_decoder(ic->streams[nStreamIndex]->codecpar->codec_id);
+    avctx = avcodec_alloc_context3(NULL);
+    if (!codec || !avctx) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if ((ret = avcodec_parameters_to_context(avctx, ic->streams[nStreamIndex]->codecpar)) < 0)
+        goto fail;
+    avctx->pkt_timebase = ic->streams[nStreamIndex]->time_base;
+    if ((ret = avcodec_open2(avctx, codec, NULL)) < 0)
+        goto fail;
+
+    av_init_packet(&pkt);
+    while (!m_bAbort && av_read_frame(ic, &pkt) >= 0) {
+        if (pkt.stream_index == nStreamIndex) {
+            AVSubtitle sub;
+            int got_subtitle = 0;
+            if (avcodec_decode_subtitle2(avctx, &sub, &got_subtitle, &pkt) >= 0 && got_subtitle) {
+                if (sub.format != 0 && sub.pts != AV_NOPTS_VALUE)
+                    AddSubtitle(&sub, sub.pts / (double)AV_TIME_BASE);
+                avsubtitle_free(&sub);
+            }
+        }
+        av_packet_unref(&pkt);
+    }
+    ret = m_bAbort ? AVERROR_EXIT : 0;
+
+fail:
+    avcodec_free_context(&avctx);
+    avformat_close_input(&ic);
+    return ret;
+}
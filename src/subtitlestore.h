@@ -0,0 +1,128 @@
+﻿#ifndef SUBTITLESTORE_H
+#define SUBTITLESTORE_H
+
+#include <QString>
+#include <QStringList>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "globalhelper.h"
+
+#define SUBTITLE_PREREAD_MAX_FILE (512LL * 1024 * 1024) // 超过该大小的文件不预读内嵌文本字幕
+
+//一条字幕
+typedef struct SubtitleCue {
+    int64_t start_ms;
+    int64_t end_ms;
+    uint32_t id;        // 加入顺序编号，用于识别当前显示的字幕是否变化
+    QString text;
+} SubtitleCue;
+
+/**
+ * @brief	文本字幕时间轴
+ *
+ * 字幕按开始时间排序，查询前按需建立中心区间树：每个节点保存跨过中心点的字幕，
+ * 分别按开始时间升序和结束时间降序排列，查询时只沿一条路径下降，
+ * 复杂度为 O(log n + 命中数)，与字幕的时长和重叠方式无关。
+ * seek 后可以立即查到字幕，不依赖解码器。
+ * 字幕可以来自外挂 SRT/ASS 文件、后台预读的内嵌文本字幕流，
+ * 或播放过程中字幕线程解码出的文本字幕，重复的字幕只保留一条。
+ */
+class SubtitleStore
+{
+public:
+    SubtitleStore();
+    ~SubtitleStore();
+
+    /**
+     * @brief	查找并加载与视频同名的外挂字幕（.srt/.ass/.ssa）
+     *
+     * @param	strVideoFile 视频文件路径
+     * @return	true 找到并加载 false 没有外挂字幕
+     */
+    bool LoadSidecar(const QString &strVideoFile);
+
+    /**
+     * @brief	加载 SRT/ASS 字幕文件，文件编码为 UTF-8 或本地编码
+     */
+    bool LoadFile(const QString &strFile);
+
+    /**
+     * @brief	后台预读内嵌文本字幕流的全部字幕
+     *
+     * @param	filename 媒体文件
+     * @param	nStreamIndex 字幕流序号
+     * @return	0 成功 <0 失败或被中止
+     * @note 	单独打开文件读取，不影响播放；超过 SUBTITLE_PREREAD_MAX_FILE 的文件不预读
+     */
+    int PreReadStream(const char *filename, int nStreamIndex);
+
+    /**
+     * @brief	中止正在进行的预读
+     */
+    void Abort();
+
+    /**
+     * @brief	加入一条字幕，与已有字幕完全相同时忽略
+     */
+    void AddCue(int64_t nStartMs, int64_t nEndMs, const QString &strText);
+
+    /**
+     * @brief	加入解码得到的文本字幕（ASS 事件或纯文本）
+     *
+     * @param	sub 解码得到的字幕
+     * @param	dPts 字幕时间戳（秒）
+     */
+    void AddSubtitle(const AVSubtitle *sub, double dPts);
+
+    /**
+     * @brief	查询某一时刻显示的字幕
+     *
+     * @param	nTimeMs 时间（毫秒）
+     * @param	strText 多条字幕按开始时间用换行连接
+     * @return	当前字幕集合的标识，没有字幕时为0
+     */
+    uint64_t Lookup(int64_t nTimeMs, QString &strText);
+
+    bool IsEmpty();
+    int StreamIndex() const { return m_nStreamIndex; }
+
+    /**
+     * @brief	把 ASS 对话文本转换为纯文本：去掉 {} 中的样式标记，\N 转为换行
+     */
+    static QString AssToPlainText(const QString &strAss);
+
+private:
+    //区间树的节点，包含 [start, end) 跨过 center 的字幕
+    struct IntervalNode {
+        int64_t center;
+        int left;           ///< 结束时间不晚于 center 的字幕组成的子树，-1 为空
+        int right;          ///< 开始时间晚于 center 的字幕组成的子树，-1 为空
+        int begin;          ///< 在 m_vecByStart/m_vecByEnd 中的起始位置
+        int count;
+    };
+
+    void BuildTree();
+    int BuildNode(std::vector<int> &vecItems);
+    bool ParseSrt(const QString &strContent);
+    bool ParseAss(const QString &strContent);
+    static int InterruptCallback(void *ctx);
+
+private:
+    std::mutex m_mutex;
+    std::vector<SubtitleCue> m_vecCues;     ///< 按开始时间排序
+    std::vector<IntervalNode> m_vecTree;    ///< 区间树，根节点在最后
+    std::vector<int> m_vecByStart;          ///< 各节点的字幕按开始时间升序
+    std::vector<int> m_vecByEnd;            ///< 各节点的字幕按结束时间降序
+    bool m_bTreeDirty;                      ///< 加入字幕后需要在下次查询前重建区间树
+    std::vector<int> m_vecHits;             ///< 查询结果，复用避免每帧分配
+    uint64_t m_nLastKey;                    ///< 上次查询的字幕集合和拼接结果
+    QString m_strLastText;
+    uint32_t m_nNextId;
+    int m_nStreamIndex;                     ///< 预读的字幕流，外挂字幕为 -1
+    std::atomic<bool> m_bAbort;
+};
+
+#endif // SUBTITLESTORE_H
@@ -0,0 +1,220 @@
+﻿#include <algorithm>
+
+#include "syncreplay.h"
+
+#pragma execution_character_set("utf-8")
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+/* 按字节累加 FNV-1a 指纹 */
+static uint64_t fingerprint_add(uint64_t hash, int64_t value)
+{
+    for (int i = 0; i < 8; i++) {
+        hash ^= (uint64_t)(value >> (i * 8)) & 0xff;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/* 帧队列已填满，或者该路流不存在、解码已结束 */
+static bool frame_queue_ready(AVStream *st, FrameQueue *f, Decoder *d, PacketQueue *q)
+{
+    return !st || f->size >= f->max_size || d->finished == q->serial;
+}
+
+SyncReplay::SyncReplay() :
+    m_stClock(SYNC_REPLAY_START_TIME),
+    m_stSink(true),
+    m_dDiffSum(0)
+{
+}
+
+SyncReplay::~SyncReplay()
+{
+}
+
+/* 等待视频和音频帧队列就绪，超时返回 false */
+bool SyncReplay::WaitReady(VideoState *is)
+{
+    int64_t nDeadline = av_gettime_relative() + SYNC_REPLAY_STALL_MS * 1000LL;
+
+    while (!frame_queue_ready(is->video_st, &is->pictq, &is->viddec, &is->videoq) ||
+           !frame_queue_ready(is->audio_st, &is->sampq, &is->auddec, &is->audioq))
+    {
+        if (!m_stCtl.m_bPlayLoop)
+        {
+            return true;
+        }
+        if (av_gettime_relative() > nDeadline)
+        {
+            return false;
+        }
+        av_usleep(100);
+    }
+    return true;
+}
+
+/* 记录一次送显 */
+void SyncReplay::Present(VideoState *is, int64_t nElapsed, SyncReplayReport *report)
+{
+    Frame *vp = frame_queue_peek_last(&is->pictq);
+
+    report->frames_presented++;
+    report->fingerprint = fingerprint_add(report->fingerprint, (int64_t)(vp->pts * 1000000.0));
+    report->fingerprint = fingerprint_add(report->fingerprint, nElapsed);
+
+    // 两个时钟都按 pts / 播放速率保存，换算回媒体时间
+    double diff = (m_stCtl.get_clock(&is->vidclk) - m_stCtl.get_clock(&is->audclk)) * m_stCtl.pf_playback_rate;
+    if (std::isnan(diff))
+    {
+        return;
+    }
+
+    size_t nMinute = (size_t)(nElapsed / 60000000LL);
+    if (report->av_minute_max.size() <= nMinute)
+    {
+        report->av_minute_max.resize(nMinute + 1, 0.0);
+    }
+    report->av_minute_max[nMinute] = FFMAX(report->av_minute_max[nMinute], fabs(diff));
+    report->av_max = FFMAX(report->av_max, fabs(diff));
+    report->av_count++;
+    m_dDiffSum += diff;
+    m_vecAbsDiff.push_back(fabs(diff));
+}
+
+/* 汇总统计 */
+void SyncReplay::Finish(VideoState *is, SyncReplayReport *report)
+{
+    report->drops_early = is->frame_drops_early;
+    report->drops_late = is->frame_drops_late;
+    report->fingerprint = fingerprint_add(report->fingerprint, report->drops_late);
+
+    if (report->av_count)
+    {
+        report->av_mean = m_dDiffSum / report->av_count;
+        size_t nIndex = (size_t)(m_vecAbsDiff.size() * 0.99);
+        nIndex = FFMIN(nIndex, m_vecAbsDiff.size() - 1);
+        std::nth_element(m_vecAbsDiff.begin(), m_vecAbsDiff.begin() + nIndex, m_vecAbsDiff.end());
+        report->av_p99 = m_vecAbsDiff[nIndex];
+    }
+}
+
+/* 以虚拟时钟驱动刷新和音频输出，直到文件结束或达到指定时长 */
+int SyncReplay::Run(const char *filename, double dMaxSeconds, SyncReplayReport *report)
+{
+    VideoState *is;
+    std::vector<Uint8> vecAudio;
+    int64_t nWallStart = av_gettime_relative();
+    int64_t nStart, nEnd, nNow, nNextRefresh, nNextAudio, nPeriod = 0, nLastPresent = 0;
+
+    *report = SyncReplayReport();
+    report->fingerprint = FNV_OFFSET;
+    m_vecAbsDiff.clear();
+    m_dDiffSum = 0;
+
+    if (!m_stCtl.Init())
+    {
+        return -1;
+    }
+    m_stCtl.m_bSyncReplay = true;
+    m_stCtl.SetTimeSource(&m_stClock);
+    m_stCtl.SetAudioMixer(&m_stSink);
+    m_stCtl.m_bPlayLoop = true;
+
+    is = m_stCtl.stream_open(filename);
+    if (!is)
+    {
+        return -1;
+    }
+    m_stCtl.m_CurStream = is;
+
+    // 等待读取线程打开各路流，打开失败时读取线程会结束播放循环
+    int64_t nDeadline = av_gettime_relative() + SYNC_REPLAY_OPEN_MS * 1000LL;
+    while (!is->streams_opened && m_stCtl.m_bPlayLoop && av_gettime_relative() < nDeadline)
+    {
+        av_usleep(1000);
+    }
+    if (!is->streams_opened)
+    {
+        m_stCtl.stream_close(is);
+        m_stCtl.m_CurStream = nullptr;
+        return -1;
+    }
+
+    // 模拟输出每个周期消耗一个硬件缓冲的音频
+    if (is->audio_st && is->audio_tgt.bytes_per_sec > 0)
+    {
+        nPeriod = 1000000LL * is->audio_hw_buf_size / is->audio_tgt.bytes_per_sec;
+        vecAudio.resize(is->audio_hw_buf_size);
+    }
+
+    nStart = m_stClock.Now();
+    nEnd = dMaxSeconds > 0 ? nStart + (int64_t)(dMaxSeconds * 1000000.0) : INT64_MAX;
+    nNextRefresh = nNextAudio = nStart;
+
+    while (m_stCtl.m_bPlayLoop && m_stClock.Now() < nEnd)
+    {
+        if (!WaitReady(is))
+        {
+            report->stalls++;
+        }
+
+        nNow = m_stClock.Now();
+        if (nNow >= nNextRefresh)
+        {
+            // 与 refresh_loop_wait_event 相同，只是等待由推进虚拟时间代替
+            double remaining_time = REFRESH_RATE;
+            if (!is->paused || is->force_refresh)
+                m_stCtl.video_refresh(is, &remaining_time);
+            nNextRefresh = nNow + FFMAX((int64_t)(remaining_time * 1000000.0), 1);
+
+            if (is->last_present_time != nLastPresent)
+            {
+                nLastPresent = is->last_present_time;
+                if (is->video_st)
+                    Present(is, nNow - nStart, report);
+            }
+        }
+        if (nPeriod && nNow >= nNextAudio)
+        {
+            m_stSink.Render(vecAudio.data(), (int)vecAudio.size());
+            nNextAudio += nPeriod;
+            report->audio_periods++;
+        }
+
+        m_stClock.Set(nPeriod ? FFMIN(nNextRefresh, nNextAudio) : nNextRefresh);
+    }
+
+    report->media_seconds = (m_stClock.Now() - nStart) / 1000000.0;
+    Finish(is, report);
+
+    m_stCtl.m_bPlayLoop = false;
+    m_stCtl.stream_close(is);
+    m_stCtl.m_CurStream = nullptr;
+
+    report->wall_seconds = (av_gettime_relative() - nWallStart) / 1000000.0;
+    return 0;
+}
+
+QString SyncReplay::Format(const SyncReplayReport &report)
+{
+    QString strReport;
+
+    strReport += QString::asprintf("media %.3f s, wall %.3f s (%.1fx)\n", report.media_seconds, report.wall_seconds,
+                                   report.wall_seconds > 0 ? report.media_seconds / report.wall_seconds : 0.0);
+    strReport += QString::asprintf("frames presented %d, dropped late %d, dropped early %d\n",
+                                   report.frames_presented, report.drops_late, report.drops_early);
+    strReport += QString::asprintf("audio periods %d, stalls %d\n", report.audio_periods, report.stalls);
+    if (report.av_count)
+    {
+        strReport += QString::asprintf("a-v diff mean %+.2f ms, max %.2f ms, p99 %.2f ms (%d samples)\n",
+                                       report.av_mean * 1000, report.av_max * 1000, report.av_p99 * 1000, report.av_count);
+        for (size_t i = 0; i < report.av_minute_max.size(); i++)
+        {
+            strReport += QString::asprintf("  minute %3d max %.2f ms\n", (int)i, report.av_minute_max[i] * 1000);
+        }
+    }
+    strReport += QString::asprintf("fingerprint %016llx\n", (unsigned long long)report.fingerprint);
+    return strReport;
+}
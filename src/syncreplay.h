@@ -0,0 +1,75 @@
+﻿#ifndef SYNCREPLAY_H
+#define SYNCREPLAY_H
+
+#include <QString>
+
+#include <vector>
+
+#include "videoctl.h"
+
+#define SYNC_REPLAY_START_TIME 1000000000LL  // 虚拟时钟的起点（微秒），避开 0 这类特殊值
+#define SYNC_REPLAY_STALL_MS 200            // 等待解码的真实时间上限，超过时记为一次停顿
+#define SYNC_REPLAY_OPEN_MS 10000           // 等待打开文件的真实时间上限
+
+//同步回放的统计结果
+typedef struct SyncReplayReport {
+    double media_seconds;       // 回放的虚拟时长（秒）
+    double wall_seconds;        // 实际耗时（秒）
+    int frames_presented;       // 送显的帧数
+    int drops_early;            // 解码后提前丢弃的帧数（回放时关闭，应为0）
+    int drops_late;             // 刷新时因落后丢弃的帧数
+    int audio_periods;          // 模拟输出消耗的音频周期数
+    int stalls;                 // 等待解码超时的次数，非0时结果可能不可复现
+    int av_count;               // 参与统计的送显次数（有音频时钟时）
+    double av_mean;             // 送显时视频时钟减音频时钟的平均值（秒）
+    double av_max;              // 差值绝对值的最大值
+    double av_p99;              // 差值绝对值的99分位
+    std::vector<double> av_minute_max;  // 每分钟差值绝对值的最大值
+    uint64_t fingerprint;       // 送显序列（时间戳和送显时刻）的指纹，相同输入应得到相同的值
+} SyncReplayReport;
+
+/**
+ * @brief	虚拟时钟同步回放
+ *
+ * 用虚拟时钟代替系统时钟驱动播放引擎：不创建窗口，音频由模拟输出按周期消耗，
+ * 每次刷新视频或拉取音频前等待解码线程把帧队列填满，然后把虚拟时间直接推进到
+ * 下一次刷新或下一个音频周期。这样刷新和音频回调看到的状态与机器速度无关，
+ * 同一文件多次回放的送显序列和丢帧相同，而且通常远快于实时，
+ * 可以用来检查同步逻辑的修改是否引入漂移或丢帧。
+ * 解码后提前丢帧依赖解码线程的执行时机，回放时关闭。
+ */
+class SyncReplay
+{
+public:
+    SyncReplay();
+    ~SyncReplay();
+
+    /**
+     * @brief	回放文件并统计音视频同步情况
+     *
+     * @param	filename 媒体文件
+     * @param	dMaxSeconds 最多回放的虚拟时长，<=0 时回放到文件结束
+     * @param	report 统计结果
+     * @return	0 成功 <0 打开失败
+     */
+    int Run(const char *filename, double dMaxSeconds, SyncReplayReport *report);
+
+    /**
+     * @brief	把统计结果格式化为文本
+     */
+    static QString Format(const SyncReplayReport &report);
+
+private:
+    bool WaitReady(VideoState *is);
+    void Present(VideoState *is, int64_t nElapsed, SyncReplayReport *report);
+    void Finish(VideoState *is, SyncReplayReport *report);
+
+private:
+    VirtualTimeSource m_stClock;
+    AudioMixer m_stSink;
+    VideoCtl m_stCtl;
+    std::vector<double> m_vecAbsDiff;   //< 每次送显的差值绝对值
+    double m_dDiffSum;
+};
+
+#endif // SYNCREPLAY_H
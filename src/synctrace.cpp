@@ -0,0 +1,182 @@
+﻿#include <QFile>
+#include <QTextStream>
+
+#include <cmath>
+
+#include "synctrace.h"
+
+#pragma execution_character_set("utf-8")
+
+// Chrome trace 中的线程编号
+enum {
+    SYNC_TRACE_TID_DECODE = 1,
+    SYNC_TRACE_TID_REFRESH,
+    SYNC_TRACE_TID_AUDIO
+};
+
+static const char *sync_trace_drop_reason(int reason)
+{
+    switch (reason) {
+    case SYNC_TRACE_DROP_EARLY:  return "early";
+    case SYNC_TRACE_DROP_LATE:   return "late";
+    case SYNC_TRACE_DROP_SERIAL: return "serial";
+    case SYNC_TRACE_DROP_REPLAY: return "replay";
+    default:                     return "unknown";
+    }
+}
+
+/* JSON 不支持 NaN，无效值输出为 null */
+static QString sync_trace_number(double v, double scale = 1.0)
+{
+    return std::isnan(v) || std::isinf(v) ? QString("null") : QString::number(v * scale, 'f', 6);
+}
+
+// 构造函数
+SyncTrace::SyncTrace() :
+    m_bEnabled(false),
+    m_nWrite(0),
+    m_pRecords(NULL)
+{
+}
+
+// 析构函数
+SyncTrace::~SyncTrace()
+{
+    delete[] m_pRecords;
+}
+
+bool SyncTrace::Start()
+{
+    if (!m_pRecords) {
+        m_pRecords = new (std::nothrow) Record_t[SYNC_TRACE_CAPACITY];
+        if (!m_pRecords)
+            return false;
+    }
+    for (int i = 0; i < SYNC_TRACE_CAPACITY; i++)
+        m_pRecords[i].seq.store(0, std::memory_order_relaxed);
+    m_nWrite.store(0, std::memory_order_relaxed);
+    m_bEnabled.store(true, std::memory_order_release);
+    return true;
+}
+
+void SyncTrace::Stop()
+{
+    m_bEnabled.store(false, std::memory_order_release);
+}
+
+/* 多个线程同时写入：各自取得序号后只写自己的槽 */
+void SyncTrace::Write(int nType, int nSerial, double v0, double v1, double v2, int nReason)
+{
+    uint64_t nIndex = m_nWrite.fetch_add(1, std::memory_order_relaxed);
+    Record_t &rec = m_pRecords[nIndex & (SYNC_TRACE_CAPACITY - 1)];
+
+    rec.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    rec.time = av_gettime_relative();
+    rec.type = nType;
+    rec.serial = nSerial;
+    rec.reason = nReason;
+    rec.v[0] = v0;
+    rec.v[1] = v1;
+    rec.v[2] = v2;
+    rec.seq.store(nIndex + 1, std::memory_order_release);
+}
+
+/* 按序号读出缓冲中仍然有效的事件，转换为 Chrome trace 事件 */
+int SyncTrace::Export(const QString &strFile)
+{
+    QFile file(strFile);
+    int nCount = 0;
+
+    if (!m_pRecords || !file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+        return -1;
+
+    QTextStream out(&file);
+    out.setCodec("UTF-8");
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"CTTV_Player\"}},\n";
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << SYNC_TRACE_TID_DECODE << ",\"args\":{\"name\":\"video decode\"}},\n";
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << SYNC_TRACE_TID_REFRESH << ",\"args\":{\"name\":\"video refresh\"}},\n";
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << SYNC_TRACE_TID_AUDIO << ",\"args\":{\"name\":\"audio\"}}";
+
+    uint64_t nEnd = m_nWrite.load(std::memory_order_acquire);
+    uint64_t nBegin = nEnd > SYNC_TRACE_CAPACITY ? nEnd - SYNC_TRACE_CAPACITY : 0;
+    for (uint64_t i = nBegin; i < nEnd; i++) {
+        Record_t &slot = m_pRecords[i & (SYNC_TRACE_CAPACITY - 1)];
+        if (slot.seq.load(std::memory_order_acquire) != i + 1)
+            continue;
+        int64_t time = slot.time;
+        int type = slot.type, serial = slot.serial, reason = slot.reason;
+        double v0 = slot.v[0], v1 = slot.v[1], v2 = slot.v[2];
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != i + 1)
+            continue;   // 读取期间被覆盖
+
+        QString ts = QString::number(time);
+        QString common = QString(",\"ts\":%1,\"pid\":1").arg(ts);
+        QString serialArg = QString("\"serial\":%1").arg(serial);
+        out << ",\n";
+        switch (type) {
+        case SYNC_TRACE_VIDEO_DECODED:
+            out << "{\"name\":\"decoded\",\"ph\":\"i\",\"s\":\"t\"" << common << ",\"tid\":" << SYNC_TRACE_TID_DECODE
+                << ",\"args\":{\"pts\":" << sync_trace_number(v0) << "," << serialArg << "}}";
+            break;
+        case SYNC_TRACE_VIDEO_QUEUED:
+            out << "{\"name\":\"queued\",\"ph\":\"i\",\"s\":\"t\"" << common << ",\"tid\":" << SYNC_TRACE_TID_DECODE
+                << ",\"args\":{\"pts\":" << sync_trace_number(v0) << ",\"pictq\":" << sync_trace_number(v1) << "," << serialArg << "}}";
+            break;
+        case SYNC_TRACE_VIDEO_TARGET:
+            out << "{\"name\":\"target\",\"ph\":\"i\",\"s\":\"t\"" << common << ",\"tid\":" << SYNC_TRACE_TID_REFRESH
+                << ",\"args\":{\"pts\":" << sync_trace_number(v0) << ",\"delay_ms\":" << sync_trace_number(v1, 1000.0)
+                << ",\"target_ts\":" << sync_trace_number(v2, 1000000.0) << "," << serialArg << "}}";
+            break;
+        case SYNC_TRACE_VIDEO_PRESENT:
+            out << "{\"name\":\"present\",\"ph\":\"i\",\"s\":\"t\"" << common << ",\"tid\":" << SYNC_TRACE_TID_REFRESH
+                << ",\"args\":{\"pts\":" << sync_trace_number(v0) << ",\"late_ms\":" << sync_trace_number(time / 1000000.0 - v1, 1000.0)
+                << "," << serialArg << "}},\n";
+            out << "{\"name\":\"present late (ms)\",\"ph\":\"C\"" << common
+                << ",\"args\":{\"late\":" << sync_trace_number(time / 1000000.0 - v1, 1000.0) << "}}";
+            break;
+        case SYNC_TRACE_CLOCKS:
+            out << "{\"name\":\"clocks (s)\",\"ph\":\"C\"" << common << ",\"args\":{";
+            {
+                // 计数器中不能有 null，无效的时钟不输出
+                QStringList listArgs;
+                if (!std::isnan(v0))
+                    listArgs << "\"audclk\":" + sync_trace_number(v0);
+                if (!std::isnan(v1))
+                    listArgs << "\"vidclk\":" + sync_trace_number(v1);
+                if (!std::isnan(v2))
+                    listArgs << "\"extclk\":" + sync_trace_number(v2);
+                out << listArgs.join(",") << "}}";
+            }
+            if (!std::isnan(v0) && !std::isnan(v1))
+                out << ",\n{\"name\":\"A-V diff (ms)\",\"ph\":\"C\"" << common
+                    << ",\"args\":{\"diff\":" << sync_trace_number(v1 - v0, 1000.0) << "}}";
+            break;
+        case SYNC_TRACE_AUDIO_DECODED:
+            out << "{\"name\":\"audio\",\"ph\":\"i\",\"s\":\"t\"" << common << ",\"tid\":" << SYNC_TRACE_TID_AUDIO
+                << ",\"args\":{\"audio_clock\":" << sync_trace_number(v0) << ",\"bytes\":" << sync_trace_number(v1)
+                << "," << serialArg << "}}";
+            break;
+        case SYNC_TRACE_AUDIO_CORRECTION:
+            out << "{\"name\":\"audio correction\",\"ph\":\"C\"" << common
+                << ",\"args\":{\"diff_ms\":" << sync_trace_number(v0, 1000.0) << ",\"avg_diff_ms\":" << sync_trace_number(v1, 1000.0)
+                << ",\"samples\":" << sync_trace_number(v2) << "}}";
+            break;
+        case SYNC_TRACE_DROP:
+            out << "{\"name\":\"drop\",\"ph\":\"i\",\"s\":\"t\"" << common << ",\"tid\":"
+                << (reason == SYNC_TRACE_DROP_EARLY ? SYNC_TRACE_TID_DECODE : SYNC_TRACE_TID_REFRESH)
+                << ",\"args\":{\"pts\":" << sync_trace_number(v0) << ",\"reason\":\"" << sync_trace_drop_reason(reason)
+                << "\"," << serialArg << "}}";
+            break;
+        default:
+            out << "{\"name\":\"unknown\",\"ph\":\"i\",\"s\":\"t\"" << common << ",\"tid\":0}";
+            break;
+        }
+        nCount++;
+    }
+    out << "\n]}\n";
+    out.flush();
+    return file.error() == QFile::NoError ? nCount : -1;
+}
@@ -0,0 +1,100 @@
+﻿#ifndef SYNCTRACE_H
+#define SYNCTRACE_H
+
+#include <QString>
+
+#include <atomic>
+
+#include "globalhelper.h"
+
+#define SYNC_TRACE_CAPACITY (1 << 20)   // 环形缓冲的事件数（约 56MB），写满后覆盖最早的事件
+
+//事件类型，v0/v1/v2 的含义见各项注释
+enum SyncTraceEvent {
+    SYNC_TRACE_VIDEO_DECODED = 0,   // 视频帧解码完成：pts
+    SYNC_TRACE_VIDEO_QUEUED,        // 视频帧进入帧队列：pts，入队前的帧数
+    SYNC_TRACE_VIDEO_TARGET,        // compute_target_delay 的结果：pts，目标延迟（秒），目标显示时刻（秒）
+    SYNC_TRACE_VIDEO_PRESENT,       // 实际送显：pts，目标显示时刻（秒）
+    SYNC_TRACE_CLOCKS,              // 送显后的时钟：audclk，vidclk，extclk
+    SYNC_TRACE_AUDIO_DECODED,       // 音频帧送入输出缓冲：audio_clock，字节数
+    SYNC_TRACE_AUDIO_CORRECTION,    // synchronize_audio 修正：差值，平均差值，增减的样本数
+    SYNC_TRACE_DROP,                // 丢帧：pts，原因见 SyncTraceDropReason
+    SYNC_TRACE_EVENT_NB
+};
+
+//丢帧原因
+enum SyncTraceDropReason {
+    SYNC_TRACE_DROP_EARLY = 0,      // 解码后已落后于主时钟
+    SYNC_TRACE_DROP_LATE,           // 显示前已落后于下一帧的显示时间
+    SYNC_TRACE_DROP_SERIAL,         // seek 之前的旧帧
+    SYNC_TRACE_DROP_REPLAY          // 切换到历史帧/倒放时丢弃
+};
+
+/**
+ * @brief	音视频同步跟踪
+ *
+ * 播放线程、解码线程和音频回调把逐帧的同步事件写入固定大小的无锁环形缓冲：
+ * 写入者原子地取得序号，写完后发布该槽的序号，读取时序号不一致的槽跳过。
+ * 关闭时每个记录点只有一次 relaxed 读取。导出为 Chrome trace JSON，
+ * 可在 Perfetto 或 chrome://tracing 中离线查看。
+ */
+class SyncTrace
+{
+public:
+    SyncTrace();
+    ~SyncTrace();
+
+    /**
+     * @brief	清空并开始记录，第一次开始时分配缓冲
+     *
+     * @return	true 成功 false 内存不足
+     */
+    bool Start();
+
+    /**
+     * @brief	停止记录，已记录的事件保留到下次开始
+     */
+    void Stop();
+
+    bool IsEnabled() const { return m_bEnabled.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief	记录一个事件，未开启时立即返回
+     *
+     * @param	nType SyncTraceEvent
+     * @param	nSerial 包队列序列号
+     * @param	nReason 丢帧原因，其他事件为 0
+     */
+    void Record(int nType, int nSerial, double v0, double v1 = NAN, double v2 = NAN, int nReason = 0)
+    {
+        if (IsEnabled())
+            Write(nType, nSerial, v0, v1, v2, nReason);
+    }
+
+    /**
+     * @brief	导出为 Chrome trace JSON，记录中也可以导出
+     *
+     * @param	strFile 输出文件
+     * @return	导出的事件数，失败返回 -1
+     */
+    int Export(const QString &strFile);
+
+private:
+    struct Record_t {
+        std::atomic<uint64_t> seq;  ///< 写入中为 0，写完后为序号 + 1
+        int64_t time;               ///< av_gettime_relative()，微秒
+        int type;
+        int serial;
+        int reason;
+        double v[3];
+    };
+
+    void Write(int nType, int nSerial, double v0, double v1, double v2, int nReason);
+
+private:
+    std::atomic<bool> m_bEnabled;
+    std::atomic<uint64_t> m_nWrite;     ///< 下一个事件的序号
+    Record_t *m_pRecords;
+};
+
+#endif // SYNCTRACE_H
@@ -0,0 +1,307 @@
+﻿#include <algorithm>
+
+#include "taskexecutor.h"
+#include "globalhelper.h"
+
+#pragma execution_character_set("utf-8")
+
+// 当前线程所属的工作线程，外部线程为空
+static thread_local void *s_pCurrentWorker = nullptr;
+
+/* 等待任务结束并释放句柄 */
+void TaskHandle::Wait()
+{
+    if (!m_pState)
+    {
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(m_pState->mutex);
+        m_pState->cond.wait(lock, [this] { return m_pState->done; });
+    }
+    m_pState.reset();
+}
+
+// 构造函数，启动基础工作线程
+TaskExecutor::TaskExecutor(int nThreads) :
+    m_nWorkers(0),
+    m_nSignal(0),
+    m_bStop(false),
+    m_nLongRunning(0),
+    m_nBackground(0),
+    m_nNext(0)
+{
+    if (nThreads <= 0)
+    {
+        nThreads = std::max(2, (int)std::thread::hardware_concurrency());
+    }
+    m_nBaseThreads = std::min(nThreads, TASK_EXECUTOR_MAX_THREADS);
+    m_nMaxBackground = std::max(1, m_nBaseThreads / 2);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (int i = 0; i < m_nBaseThreads; i++)
+    {
+        SpawnWorker();
+    }
+}
+
+// 析构函数
+TaskExecutor::~TaskExecutor()
+{
+    Shutdown();
+}
+
+/* 进程共享的执行器 */
+TaskExecutor *TaskExecutor::Shared()
+{
+    static TaskExecutor s_stExecutor;
+    return &s_stExecutor;
+}
+
+const char *TaskExecutor::LaneName(int nLane)
+{
+    switch (nLane)
+    {
+    case TASK_LANE_AUDIO:
+        return "audio";
+    case TASK_LANE_VIDEO:
+        return "video";
+    case TASK_LANE_SUBTITLE:
+        return "subtitle";
+    case TASK_LANE_BACKGROUND:
+        return "background";
+    default:
+        return "unknown";
+    }
+}
+
+int TaskExecutor::ThreadCount() const
+{
+    return m_nWorkers;
+}
+
+/* 启动一个工作线程，调用者需持有 m_mutex */
+void TaskExecutor::SpawnWorker()
+{
+    int nIndex = m_nWorkers;
+    if (nIndex >= TASK_EXECUTOR_MAX_THREADS)
+    {
+        return;
+    }
+
+    Worker *pWorker = new Worker();
+    pWorker->index = nIndex;
+    m_arrWorkers[nIndex] = pWorker;
+    // 先写入指针再增加计数，窃取时只访问计数以内的线程
+    m_nWorkers = nIndex + 1;
+    pWorker->thread = std::thread(&TaskExecutor::WorkerThread, this, pWorker);
+}
+
+/* 提交任务 */
+TaskHandle TaskExecutor::Submit(int nLane, Task task, bool bLongRunning)
+{
+    TaskHandle handle;
+    Entry entry;
+
+    nLane = av_clip(nLane, TASK_LANE_AUDIO, TASK_LANE_BACKGROUND);
+    entry.task = std::move(task);
+    entry.state = std::make_shared<TaskState>();
+    entry.lane = nLane;
+    entry.long_running = bLongRunning;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_bStop)
+    {
+        return handle;
+    }
+
+    // 长任务会一直占住线程，保证剩余线程数不少于基础线程数
+    if (bLongRunning)
+    {
+        int nLongRunning = ++m_nLongRunning;
+        if (m_nWorkers - nLongRunning < m_nBaseThreads)
+        {
+            SpawnWorker();
+        }
+    }
+
+    // 工作线程中提交的任务放入自己的队列，其它线程空闲时会来窃取
+    Worker *pWorker = (Worker *)s_pCurrentWorker;
+    if (!pWorker)
+    {
+        pWorker = m_arrWorkers[m_nNext++ % m_nWorkers];
+    }
+    handle.m_pState = entry.state;
+    {
+        std::lock_guard<std::mutex> workerLock(pWorker->mutex);
+        pWorker->queues[nLane].push_back(std::move(entry));
+    }
+
+    m_nSignal++;
+    m_cond.notify_one();
+    return handle;
+}
+
+/* 取任务：按通道优先级，先取自己队列头部，再窃取其它线程队列尾部 */
+bool TaskExecutor::TakeTask(Worker *pSelf, Entry &entry)
+{
+    int nWorkers = m_nWorkers;
+
+    for (int nLane = 0; nLane < TASK_LANE_COUNT; nLane++)
+    {
+        // 后台任务限制并发，保证播放相关任务总有线程可用
+        if (nLane == TASK_LANE_BACKGROUND && ++m_nBackground > m_nMaxBackground)
+        {
+            m_nBackground--;
+            return false;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(pSelf->mutex);
+            std::deque<Entry> &queue = pSelf->queues[nLane];
+            if (!queue.empty())
+            {
+                entry = std::move(queue.front());
+                queue.pop_front();
+                return true;
+            }
+        }
+
+        for (int i = 1; i < nWorkers; i++)
+        {
+            Worker *pVictim = m_arrWorkers[(pSelf->index + i) % nWorkers];
+            std::lock_guard<std::mutex> lock(pVictim->mutex);
+            std::deque<Entry> &queue = pVictim->queues[nLane];
+            if (!queue.empty())
+            {
+                entry = std::move(queue.back());
+                queue.pop_back();
+                return true;
+            }
+        }
+
+        if (nLane == TASK_LANE_BACKGROUND)
+        {
+            m_nBackground--;
+        }
+    }
+
+    return false;
+}
+
+/* 执行任务并通知等待者 */
+void TaskExecutor::RunTask(Worker *pSelf, Entry &entry, int &nPriorityLane)
+{
+    (void)pSelf;
+
+    // 按通道调整线程优先级，只在通道变化时设置
+    if (entry.lane != nPriorityLane)
+    {
+        if (entry.lane == TASK_LANE_AUDIO)
+            SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH);
+        else if (entry.lane == TASK_LANE_BACKGROUND)
+            SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+        else
+            SDL_SetThreadPriority(SDL_THREAD_PRIORITY_NORMAL);
+        nPriorityLane = entry.lane;
+    }
+
+    entry.task();
+    entry.task = nullptr;
+
+    if (entry.long_running)
+    {
+        m_nLongRunning--;
+    }
+    if (entry.lane == TASK_LANE_BACKGROUND)
+    {
+        // 释放后台并发名额，唤醒其它线程取排队中的后台任务
+        m_nBackground--;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_nSignal++;
+        m_cond.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(entry.state->mutex);
+        entry.state->done = true;
+    }
+    entry.state->cond.notify_all();
+    entry.state.reset();
+}
+
+/* 工作线程：取任务执行，没有可执行的任务时等待唤醒 */
+void TaskExecutor::WorkerThread(Worker *pWorker)
+{
+    int nPriorityLane = TASK_LANE_VIDEO;
+    s_pCurrentWorker = pWorker;
+
+    for (;;)
+    {
+        uint64_t nSignal;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_bStop)
+            {
+                break;
+            }
+            nSignal = m_nSignal;
+        }
+
+        Entry entry;
+        if (TakeTask(pWorker, entry))
+        {
+            RunTask(pWorker, entry, nPriorityLane);
+            continue;
+        }
+
+        // 扫描期间有新任务提交时不会进入等待
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait(lock, [&] { return m_bStop || m_nSignal != nSignal; });
+    }
+
+    s_pCurrentWorker = nullptr;
+}
+
+/* 停止执行器 */
+void TaskExecutor::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_bStop)
+        {
+            return;
+        }
+        m_bStop = true;
+    }
+    m_cond.notify_all();
+
+    int nWorkers = m_nWorkers;
+    for (int i = 0; i < nWorkers; i++)
+    {
+        Worker *pWorker = m_arrWorkers[i];
+        if (pWorker->thread.joinable())
+        {
+            pWorker->thread.join();
+        }
+    }
+
+    // 丢弃未执行的任务，同时唤醒等待这些任务的句柄
+    for (int i = 0; i < nWorkers; i++)
+    {
+        Worker *pWorker = m_arrWorkers[i];
+        for (int nLane = 0; nLane < TASK_LANE_COUNT; nLane++)
+        {
+            for (Entry &entry : pWorker->queues[nLane])
+            {
+                std::lock_guard<std::mutex> lock(entry.state->mutex);
+                entry.state->done = true;
+                entry.state->cond.notify_all();
+            }
+            pWorker->queues[nLane].clear();
+        }
+        delete pWorker;
+    }
+    m_nWorkers = 0;
+}
@@ -0,0 +1,139 @@
+﻿#ifndef TASKEXECUTOR_H
+#define TASKEXECUTOR_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <deque>
+
+#define TASK_EXECUTOR_MAX_THREADS 64    // 工作线程数上限
+
+//任务通道，数值越小优先级越高
+enum TaskLane {
+    TASK_LANE_AUDIO = 0,    // 音频解码、解复用
+    TASK_LANE_VIDEO,        // 视频解码、显示
+    TASK_LANE_SUBTITLE,     // 字幕解码
+    TASK_LANE_BACKGROUND,   // 缩略图、扫描等后台任务
+    TASK_LANE_COUNT
+};
+
+//任务完成状态，由执行器和任务句柄共享
+struct TaskState {
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool done = false;
+};
+
+/**
+ * @brief	任务句柄，用于等待任务结束（替代 std::thread::join）
+ *
+ * 全零内存即为空句柄，可以放在 av_mallocz 分配的结构体中。
+ */
+class TaskHandle
+{
+public:
+    /**
+     * @brief	是否关联了任务
+     */
+    bool IsValid() const { return (bool)m_pState; }
+
+    /**
+     * @brief	等待任务结束并释放句柄，空句柄直接返回
+     * @note 	不能在任务自身中调用
+     */
+    void Wait();
+
+private:
+    friend class TaskExecutor;
+    std::shared_ptr<TaskState> m_pState;
+};
+
+/**
+ * @brief	常驻的任务执行器
+ *
+ * 每个工作线程有自己的分通道任务队列，空闲时按通道优先级从其它线程的
+ * 队列尾部窃取任务。解复用/解码这类长时间运行的任务会占住一个线程，
+ * 提交时执行器保证至少还有基础数量的线程可用于短任务，不够时补充线程；
+ * 线程创建后一直复用，切换文件不再创建新线程。
+ * 执行音频通道任务时提高线程优先级，后台任务降低优先级并限制并发数，
+ * 避免后台任务影响播放。
+ */
+class TaskExecutor
+{
+public:
+    typedef std::function<void()> Task;
+
+    /**
+     * @brief	构造并启动基础工作线程
+     *
+     * @param	nThreads 基础线程数，小于等于0时按CPU核数选择
+     */
+    explicit TaskExecutor(int nThreads = 0);
+    ~TaskExecutor();
+
+    /**
+     * @brief	进程共享的执行器
+     */
+    static TaskExecutor *Shared();
+
+    /**
+     * @brief	提交任务
+     *
+     * @param	nLane 任务通道 TaskLane
+     * @param	task 任务
+     * @param	bLongRunning 是否长时间占用线程（如解码循环）
+     * @return	任务句柄，执行器已停止时返回空句柄
+     */
+    TaskHandle Submit(int nLane, Task task, bool bLongRunning = false);
+
+    /**
+     * @brief	停止执行器，丢弃未执行的任务并等待工作线程退出
+     */
+    void Shutdown();
+
+    /**
+     * @brief	当前工作线程数
+     */
+    int ThreadCount() const;
+
+    static const char *LaneName(int nLane);
+
+private:
+    struct Entry {
+        Task task;
+        std::shared_ptr<TaskState> state;
+        int lane;
+        bool long_running;
+    };
+
+    struct Worker {
+        int index;
+        std::mutex mutex;
+        std::deque<Entry> queues[TASK_LANE_COUNT];
+        std::thread thread;
+    };
+
+    void SpawnWorker();
+    void WorkerThread(Worker *pWorker);
+    bool TakeTask(Worker *pSelf, Entry &entry);
+    void RunTask(Worker *pSelf, Entry &entry, int &nPriorityLane);
+
+    Worker *m_arrWorkers[TASK_EXECUTOR_MAX_THREADS];
+    std::atomic<int> m_nWorkers;        ///< 已启动的工作线程数
+    int m_nBaseThreads;                 ///< 保留给短任务的线程数
+    int m_nMaxBackground;               ///< 后台任务最大并发数
+
+    std::mutex m_mutex;                 ///< 保护线程创建、等待与唤醒
+    std::condition_variable m_cond;
+    uint64_t m_nSignal;                 ///< 唤醒计数，防止丢失唤醒
+    bool m_bStop;
+
+    std::atomic<int> m_nLongRunning;    ///< 已提交未结束的长任务数
+    std::atomic<int> m_nBackground;     ///< 正在执行的后台任务数
+    std::atomic<unsigned int> m_nNext;  ///< 外部线程提交时轮流选择队列
+};
+
+#endif // TASKEXECUTOR_H
@@ -0,0 +1,518 @@
+﻿#include <QCoreApplication>
+#include <QDir>
+#include <QLockFile>
+
+#include <algorithm>
+
+#include "timeshift.h"
+
+#pragma execution_character_set("utf-8")
+
+#define TIMESHIFT_MAX_PACKET (64 * 1024 * 1024)     // 读回的记录超过该大小视为数据损坏
+
+//包在分段文件中的记录头，之后是包数据
+typedef struct TimeshiftRecord {
+    int64_t pts;
+    int64_t dts;
+    int64_t duration;
+    int32_t stream_index;
+    int32_t flags;
+    int32_t size;
+    int32_t reserved;
+} TimeshiftRecord;
+
+// 构造函数
+TimeshiftBuffer::TimeshiftBuffer(TaskExecutor *pExecutor) :
+    m_pExecutor(pExecutor),
+    m_pFormatCtx(NULL),
+    m_bAbort(false),
+    m_nSlots(2),
+    m_nKeyStream(-1),
+    m_nSegmentSeq(0),
+    m_nWritten(0),
+    m_nFlushed(0),
+    m_nDiskBytes(0),
+    m_nBatchStart(0),
+    m_nPendingBytes(0),
+    m_bWriting(false),
+    m_bEnded(false),
+    m_nError(0),
+    m_dLastIndex(NAN),
+    m_nReadPos(0),
+    m_dReadTime(NAN),
+    m_nReadSlot(-1),
+    m_nWriteSlot(-1),
+    m_nPackets(0),
+    m_nDropped(0),
+    m_nWriteUs(0),
+    m_nMaxWriteUs(0),
+    m_pLock(NULL)
+{
+}
+
+// 析构函数
+TimeshiftBuffer::~TimeshiftBuffer()
+{
+    m_bAbort = true;
+    m_stIngest.Wait();
+    m_stWriter.Wait();
+    m_stReadFile.close();
+    m_stWriteFile.close();
+    delete m_pLock;
+    if (!m_strDir.isEmpty())
+    {
+        QDir(m_strDir).removeRecursively();
+    }
+}
+
+/* 删除已退出的进程留下的分段目录：目录中的锁文件无人持有时可以取得 */
+void TimeshiftBuffer::RemoveStale(const QString &strRoot)
+{
+    QDir root(strRoot);
+    for (const QString &strName : root.entryList(QDir::Dirs | QDir::NoDotAndDotDot))
+    {
+        QString strDir = root.filePath(strName);
+        QLockFile lock(strDir + "/lock");
+        if (lock.tryLock(0))
+        {
+            lock.unlock();
+            QDir(strDir).removeRecursively();
+        }
+    }
+}
+
+int TimeshiftBuffer::Start(const QString &strRoot, AVFormatContext *ic, double dWindow)
+{
+    RemoveStale(strRoot);
+
+    // 每个实例一个目录，锁文件表示目录正在使用
+    m_strDir = QString("%1/%2_%3").arg(strRoot).arg(QCoreApplication::applicationPid()).arg((quintptr)this, 0, 16);
+    if (!QDir().mkpath(m_strDir))
+    {
+        m_strDir.clear();
+        return AVERROR(EIO);
+    }
+    m_pLock = new QLockFile(m_strDir + "/lock");
+    m_pLock->tryLock(0);
+
+    m_pFormatCtx = ic;
+    m_nSlots = FFMAX((int)ceil(dWindow / TIMESHIFT_SEGMENT_SECONDS) + 1, 2);
+
+    // 接收开始后 ic->streams 可能被解复用器重新分配，其它线程只使用这里的快照
+    for (unsigned int i = 0; i < ic->nb_streams; i++)
+    {
+        m_vecStreams.push_back(ic->streams[i]);
+        m_vecTimeBase.push_back(ic->streams[i]->time_base);
+    }
+
+    // 有视频时按视频关键帧分段和建立索引，否则按音频
+    for (unsigned int i = 0; i < m_vecStreams.size(); i++)
+    {
+        AVStream *st = m_vecStreams[i];
+        if (st->discard >= AVDISCARD_ALL || (st->disposition & AV_DISPOSITION_ATTACHED_PIC))
+        {
+            continue;
+        }
+        if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+        {
+            m_nKeyStream = i;
+            break;
+        }
+        if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO && m_nKeyStream < 0)
+        {
+            m_nKeyStream = i;
+        }
+    }
+
+    // 接收不能被播放侧的任何等待阻塞，和读取线程一样作为长任务运行
+    m_stIngest = m_pExecutor->Submit(TASK_LANE_AUDIO, [this] { IngestLoop(); }, true);
+    if (!m_stIngest.IsValid())
+    {
+        return AVERROR(EINVAL);
+    }
+    return 0;
+}
+
+/* 接收任务：不停读取直播源，直到中断或出错 */
+void TimeshiftBuffer::IngestLoop()
+{
+    AVPacket pkt;
+    int ret = 0;
+
+    av_init_packet(&pkt);
+    while (!m_bAbort)
+    {
+        ret = av_read_frame(m_pFormatCtx, &pkt);
+        if (ret == AVERROR(EAGAIN))
+        {
+            av_usleep(10000);
+            continue;
+        }
+        if (ret < 0)
+        {
+            break;
+        }
+        // 开始之后新出现的流不在快照中，播放侧无法使用
+        if (pkt.stream_index < (int)m_vecStreams.size() && m_vecStreams[pkt.stream_index]->discard < AVDISCARD_ALL)
+        {
+            Append(&pkt);
+        }
+        av_packet_unref(&pkt);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_stBatch.data.empty())
+    {
+        SubmitBatch();
+    }
+    if (ret < 0 && ret != AVERROR_EOF && ret != AVERROR_EXIT)
+    {
+        av_log(NULL, AV_LOG_WARNING, "timeshift: live source stopped: %d\n", ret);
+    }
+    m_bEnded = true;
+    m_cond.notify_all();
+}
+
+/* 把一个包追加到当前批次，需要时开始新分段或提交批次，只在内存中操作 */
+void TimeshiftBuffer::Append(const AVPacket *pkt)
+{
+    int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+    double time = ts != AV_NOPTS_VALUE && pkt->stream_index == m_nKeyStream ? ts * av_q2d(m_vecTimeBase[pkt->stream_index]) : NAN;
+    int64_t now = av_gettime_relative();
+    TimeshiftRecord rec;
+
+    rec.pts = pkt->pts;
+    rec.dts = pkt->dts;
+    rec.duration = pkt->duration;
+    rec.stream_index = pkt->stream_index;
+    rec.flags = pkt->flags;
+    rec.size = pkt->size;
+    rec.reserved = 0;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_nPackets++;
+
+    // 磁盘跟不上时新包不进入缓冲，接收不等待
+    if (m_nPendingBytes + (int64_t)m_stBatch.data.size() > TIMESHIFT_MAX_PENDING)
+    {
+        m_nDropped++;
+        return;
+    }
+
+    // 关键帧作为跳转点，没有视频时按固定间隔取音频包；时间戳回退视为不连续，立即建立索引
+    bool bIndex = !std::isnan(time) && (pkt->flags & AV_PKT_FLAG_KEY) &&
+            (std::isnan(m_dLastIndex) || time < m_dLastIndex || time - m_dLastIndex >= TIMESHIFT_INDEX_INTERVAL);
+
+    if (m_deqSegments.empty() ||
+            (bIndex && (time - m_deqSegments.back().start_time >= TIMESHIFT_SEGMENT_SECONDS || time < m_deqSegments.back().start_time)))
+    {
+        // 批次不跨分段
+        if (!m_stBatch.data.empty())
+        {
+            SubmitBatch();
+        }
+        while (!m_deqSegments.empty() && ((int)m_deqSegments.size() >= m_nSlots || m_nDiskBytes > TIMESHIFT_MAX_BYTES))
+        {
+            Evict();
+        }
+        Segment seg;
+        seg.slot = (int)(m_nSegmentSeq++ % m_nSlots);
+        seg.start = seg.end = m_nWritten;
+        seg.start_time = seg.end_time = time;
+        m_deqSegments.push_back(seg);
+    }
+
+    Segment &seg = m_deqSegments.back();
+    if (m_stBatch.data.empty())
+    {
+        m_stBatch.slot = seg.slot;
+        m_stBatch.start = m_nWritten;
+        m_stBatch.file_offset = m_nWritten - seg.start;
+        m_stBatch.data.reserve(TIMESHIFT_BATCH_BYTES + sizeof(rec) + pkt->size);
+        m_nBatchStart = now;
+    }
+    m_stBatch.data.insert(m_stBatch.data.end(), (const uint8_t *)&rec, (const uint8_t *)&rec + sizeof(rec));
+    m_stBatch.data.insert(m_stBatch.data.end(), pkt->data, pkt->data + pkt->size);
+
+    if (bIndex)
+    {
+        IndexEntry entry;
+        entry.time = time;
+        entry.offset = m_nWritten;
+        seg.index.push_back(entry);
+        m_dLastIndex = time;
+    }
+    if (!std::isnan(time))
+    {
+        if (std::isnan(seg.start_time))
+        {
+            seg.start_time = time;
+        }
+        seg.end_time = time;
+    }
+    m_nWritten += sizeof(rec) + pkt->size;
+    m_nDiskBytes += sizeof(rec) + pkt->size;
+    seg.end = m_nWritten;
+
+    if ((int64_t)m_stBatch.data.size() >= TIMESHIFT_BATCH_BYTES || now - m_nBatchStart >= TIMESHIFT_BATCH_US)
+    {
+        SubmitBatch();
+    }
+    m_cond.notify_all();
+}
+
+/* 提交当前批次，没有写入任务在运行时在后台通道启动一个，调用时持有 m_mutex */
+void TimeshiftBuffer::SubmitBatch()
+{
+    m_nPendingBytes += m_stBatch.data.size();
+    m_deqPending.push_back(std::move(m_stBatch));
+    m_stBatch.data.clear();
+
+    if (!m_bWriting)
+    {
+        m_bWriting = true;
+        m_stWriter = m_pExecutor->Submit(TASK_LANE_BACKGROUND, [this] { WriteLoop(); });
+        if (!m_stWriter.IsValid())
+        {
+            m_bWriting = false;
+        }
+    }
+}
+
+/* 写入任务：按顺序写完所有已提交的批次，写完的批次才从内存中移除 */
+void TimeshiftBuffer::WriteLoop()
+{
+    for (;;)
+    {
+        Batch *pBatch;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_deqPending.empty() || m_bAbort)
+            {
+                m_bWriting = false;
+                return;
+            }
+            // 其它线程只在队尾追加，队首元素的地址不变
+            pBatch = &m_deqPending.front();
+        }
+
+        int64_t start = av_gettime_relative();
+        bool bOk = true;
+        // 分段开头截断复用的文件
+        if (pBatch->slot != m_nWriteSlot || pBatch->file_offset == 0)
+        {
+            m_stWriteFile.close();
+            m_stWriteFile.setFileName(SlotPath(pBatch->slot));
+            bOk = m_stWriteFile.open(QIODevice::WriteOnly | (pBatch->file_offset == 0 ? QIODevice::Truncate : QIODevice::Append));
+            m_nWriteSlot = bOk ? pBatch->slot : -1;
+        }
+        bOk = bOk && m_stWriteFile.write((const char *)pBatch->data.data(), pBatch->data.size()) == (qint64)pBatch->data.size() &&
+                m_stWriteFile.flush();
+        int64_t elapsed = av_gettime_relative() - start;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!bOk && !m_nError)
+        {
+            // 写入失败的范围读回时校验不通过，读取跳到最新位置
+            m_nError = AVERROR(EIO);
+            av_log(NULL, AV_LOG_ERROR, "timeshift: failed to write %s\n", m_stWriteFile.fileName().toUtf8().constData());
+        }
+        m_nFlushed = pBatch->start + pBatch->data.size();
+        m_nPendingBytes -= pBatch->data.size();
+        m_nWriteUs += elapsed;
+        m_nMaxWriteUs = FFMAX(m_nMaxWriteUs, elapsed);
+        m_deqPending.pop_front();
+    }
+}
+
+/* 淘汰最早的分段，调用时持有 m_mutex */
+void TimeshiftBuffer::Evict()
+{
+    const Segment &seg = m_deqSegments.front();
+    m_nDiskBytes -= seg.end - seg.start;
+    m_deqSegments.pop_front();
+}
+
+/* 找到包含指定位置的分段，调用时持有 m_mutex */
+int TimeshiftBuffer::FindSegment(int64_t nOffset) const
+{
+    auto it = std::upper_bound(m_deqSegments.begin(), m_deqSegments.end(), nOffset,
+                               [](int64_t offset, const Segment &seg) { return offset < seg.start; });
+    return (int)(it - m_deqSegments.begin()) - 1;
+}
+
+QString TimeshiftBuffer::SlotPath(int nSlot) const
+{
+    return QString("%1/seg%2.bin").arg(m_strDir).arg(nSlot, 4, 10, QChar('0'));
+}
+
+/* 读取下一个包：未写入磁盘的部分从内存批次复制，其余在不持锁的情况下读文件 */
+int TimeshiftBuffer::Read(AVPacket *pkt, int nTimeoutMs)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        if (m_nReadPos >= m_nWritten)
+        {
+            if (m_bEnded)
+            {
+                return AVERROR_EOF;
+            }
+            if (!m_cond.wait_for(lock, std::chrono::milliseconds(nTimeoutMs),
+                                 [this] { return m_nReadPos < m_nWritten || m_bEnded || m_bAbort; }) || m_bAbort)
+            {
+                return AVERROR(EAGAIN);
+            }
+            continue;
+        }
+
+        // 读取位置已被淘汰，从窗口开头继续
+        if (m_nReadPos < m_deqSegments.front().start)
+        {
+            m_nReadPos = m_deqSegments.front().start;
+        }
+
+        TimeshiftRecord rec;
+        int64_t pos = m_nReadPos;
+        if (pos >= m_nFlushed)
+        {
+            const Batch *pBatch = &m_stBatch;
+            for (const Batch &batch : m_deqPending)
+            {
+                if (pos < batch.start + (int64_t)batch.data.size())
+                {
+                    pBatch = &batch;
+                    break;
+                }
+            }
+            const uint8_t *p = pBatch->data.data() + (pos - pBatch->start);
+            memcpy(&rec, p, sizeof(rec));
+            if (av_new_packet(pkt, rec.size) < 0)
+            {
+                return AVERROR(ENOMEM);
+            }
+            memcpy(pkt->data, p + sizeof(rec), rec.size);
+        }
+        else
+        {
+            const Segment &seg = m_deqSegments[FindSegment(pos)];
+            int nSlot = seg.slot;
+            int64_t nFileOffset = pos - seg.start;
+            lock.unlock();
+
+            bool bOk = true;
+            if (nSlot != m_nReadSlot)
+            {
+                m_stReadFile.close();
+                m_stReadFile.setFileName(SlotPath(nSlot));
+                bOk = m_stReadFile.open(QIODevice::ReadOnly);
+                m_nReadSlot = bOk ? nSlot : -1;
+            }
+            bOk = bOk && m_stReadFile.seek(nFileOffset) &&
+                    m_stReadFile.read((char *)&rec, sizeof(rec)) == (qint64)sizeof(rec) &&
+                    rec.size >= 0 && rec.size <= TIMESHIFT_MAX_PACKET &&
+                    rec.stream_index >= 0 && rec.stream_index < (int)m_vecStreams.size() &&
+                    av_new_packet(pkt, rec.size) >= 0;
+            if (bOk && m_stReadFile.read((char *)pkt->data, rec.size) != rec.size)
+            {
+                av_packet_unref(pkt);
+                bOk = false;
+            }
+
+            lock.lock();
+            // 读取期间分段被淘汰，文件可能已被覆盖
+            if (pos < m_deqSegments.front().start)
+            {
+                if (bOk)
+                {
+                    av_packet_unref(pkt);
+                }
+                continue;
+            }
+            if (!bOk)
+            {
+                // 数据损坏或写入失败，跳到最新的跳转点
+                const Segment &last = m_deqSegments.back();
+                m_nReadPos = last.index.empty() ? last.start : last.index.back().offset;
+                av_log(NULL, AV_LOG_WARNING, "timeshift: bad record at %" PRId64 ", jumping to live\n", pos);
+                continue;
+            }
+        }
+
+        pkt->pts = rec.pts;
+        pkt->dts = rec.dts;
+        pkt->duration = rec.duration;
+        pkt->stream_index = rec.stream_index;
+        pkt->flags = rec.flags;
+        pkt->pos = -1;
+        m_nReadPos = pos + sizeof(rec) + rec.size;
+        if (rec.stream_index == m_nKeyStream)
+        {
+            int64_t ts = rec.pts != AV_NOPTS_VALUE ? rec.pts : rec.dts;
+            if (ts != AV_NOPTS_VALUE)
+            {
+                m_dReadTime = ts * av_q2d(m_vecTimeBase[rec.stream_index]);
+            }
+        }
+        return 0;
+    }
+}
+
+/* 跳转：在时间索引中找不晚于目标的最后一个跳转点 */
+int TimeshiftBuffer::Seek(double dTime)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto seg = m_deqSegments.rbegin(); seg != m_deqSegments.rend(); ++seg)
+    {
+        if (seg->index.empty() || seg->index.front().time > dTime)
+        {
+            continue;
+        }
+        auto it = std::upper_bound(seg->index.begin(), seg->index.end(), dTime,
+                                   [](double time, const IndexEntry &entry) { return time < entry.time; });
+        --it;
+        m_nReadPos = it->offset;
+        m_dReadTime = it->time;
+        return 0;
+    }
+
+    // 早于窗口：从最早的分段开始
+    if (!m_deqSegments.empty())
+    {
+        const Segment &first = m_deqSegments.front();
+        m_nReadPos = first.index.empty() ? first.start : first.index.front().offset;
+        m_dReadTime = first.start_time;
+    }
+    return 0;
+}
+
+double TimeshiftBuffer::StartTime()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_deqSegments.empty() ? NAN : m_deqSegments.front().start_time;
+}
+
+double TimeshiftBuffer::LiveTime()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_deqSegments.empty() ? NAN : m_deqSegments.back().end_time;
+}
+
+TimeshiftStats TimeshiftBuffer::Stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    TimeshiftStats stats;
+
+    stats.start = m_deqSegments.empty() ? NAN : m_deqSegments.front().start_time;
+    stats.live = m_deqSegments.empty() ? NAN : m_deqSegments.back().end_time;
+    stats.position = m_dReadTime;
+    stats.segments = (int)m_deqSegments.size();
+    stats.disk_bytes = m_nDiskBytes;
+    stats.pending_bytes = m_nPendingBytes + m_stBatch.data.size();
+    stats.packets = m_nPackets;
+    stats.dropped = m_nDropped;
+    stats.write_us = m_nWriteUs;
+    stats.max_write_us = m_nMaxWriteUs;
+    return stats;
+}
@@ -0,0 +1,177 @@
+﻿#ifndef TIMESHIFT_H
+#define TIMESHIFT_H
+
+#include <QFile>
+#include <QString>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "globalhelper.h"
+#include "taskexecutor.h"
+
+class QLockFile;
+
+#define TIMESHIFT_DIR_NAME "CTTV_Player_timeshift"  // 临时目录下存放分段文件的目录
+#define TIMESHIFT_WINDOW 7200.0                     // 默认时移窗口（秒）
+#define TIMESHIFT_SEGMENT_SECONDS 10.0              // 每个分段文件的时长，分段从关键帧开始
+#define TIMESHIFT_MAX_BYTES (8LL * 1024 * 1024 * 1024)  // 分段文件的总大小上限，超出时提前淘汰最早的分段
+#define TIMESHIFT_BATCH_BYTES (256 * 1024)          // 积累到该大小时提交写入
+#define TIMESHIFT_BATCH_US 200000                   // 批次最长积累时间（微秒）
+#define TIMESHIFT_MAX_PENDING (64 * 1024 * 1024)    // 尚未写入磁盘的数据上限，超出时新包不进入时移缓冲
+#define TIMESHIFT_INDEX_INTERVAL 0.5                // 没有视频时音频包的索引间隔（秒）
+#define TIMESHIFT_READ_WAIT_MS 20                   // 读到最新位置时等待新包的时长
+
+//时移缓冲的状态（时间为流的时间戳，秒）
+typedef struct TimeshiftStats {
+    double start;           // 窗口中最早的位置
+    double live;            // 最新收到的位置
+    double position;        // 播放读取的位置
+    int segments;           // 分段文件数
+    int64_t disk_bytes;     // 窗口中的数据量
+    int64_t pending_bytes;  // 等待写入磁盘的数据量
+    int64_t packets;        // 收到的包数
+    int64_t dropped;        // 写入跟不上而没有进入缓冲的包数
+    int64_t write_us;       // 累计写入耗时
+    int64_t max_write_us;   // 单个批次的最长写入耗时
+} TimeshiftStats;
+
+/**
+ * @brief	直播时移缓冲
+ *
+ * 接收任务不停地从直播源读包，序列化后追加到内存中的批次，批次按大小或时间
+ * 交给后台通道写入分段文件，接收不等待磁盘；待写入的数据超过 TIMESHIFT_MAX_PENDING
+ * 时新包直接丢弃，直播接收不受影响。分段文件组成固定个数的环：每段约
+ * TIMESHIFT_SEGMENT_SECONDS 秒、从关键帧开始，超出窗口时淘汰最早的分段并复用其文件。
+ * 每段在内存中保存关键帧的时间索引，跳转时定位到不晚于目标的关键帧。
+ * 播放通过 Read/Seek 代替 av_read_frame/avformat_seek_file，读取位置在内存批次或
+ * 磁盘文件中，被淘汰时跳到窗口开头。包的 side data 不保存。
+ * 接收任务读包时解复用器可能新建流并重新分配 ic->streams，开始后其它线程不能再访问
+ * ic 的 streams、nb_streams 和 pb，改用 StreamCount/Stream 返回的开始时的快照，
+ * 之后新出现的流的包不进入缓冲。
+ */
+class TimeshiftBuffer
+{
+public:
+    explicit TimeshiftBuffer(TaskExecutor *pExecutor);
+    ~TimeshiftBuffer();
+
+    /**
+     * @brief	创建分段目录并开始接收
+     *
+     * @param	strRoot 分段目录的上级目录，每个实例在其中建立自己的目录，析构时删除；
+     *        	已退出的进程留下的目录在这里清理
+     * @param	ic 已打开流的直播源，之后只由接收任务读取，流的列表以此时为准
+     * @param	dWindow 时移窗口（秒）
+     * @return	0 成功 <0 失败
+     * @note 	析构前需先让 ic 的中断回调返回非0，接收任务才能从阻塞的读取中退出
+     */
+    int Start(const QString &strRoot, AVFormatContext *ic, double dWindow);
+
+    /**
+     * @brief	读取下一个包
+     *
+     * @param	pkt 输出的包
+     * @param	nTimeoutMs 已读到最新位置时的最长等待时间
+     * @return	0 成功 AVERROR(EAGAIN) 超时 AVERROR_EOF 直播源已结束 <0 错误
+     */
+    int Read(AVPacket *pkt, int nTimeoutMs);
+
+    /**
+     * @brief	跳转到不晚于指定时间的关键帧，超出窗口时限制到窗口两端
+     *
+     * @param	dTime 流的时间戳（秒），不小于 LiveTime() 时跳到最新的关键帧
+     */
+    int Seek(double dTime);
+
+    double StartTime();
+    double LiveTime();
+
+    /**
+     * @brief	开始时直播源的流，其它线程用来代替 ic->nb_streams 和 ic->streams
+     */
+    int StreamCount() const { return (int)m_vecStreams.size(); }
+    AVStream *Stream(int nIndex) const { return m_vecStreams[nIndex]; }
+
+    TimeshiftStats Stats();
+
+private:
+    struct IndexEntry {
+        double time;
+        int64_t offset;
+    };
+
+    //一个分段，偏移为所有数据连续编号的位置
+    struct Segment {
+        int slot;               ///< 使用的分段文件
+        int64_t start;
+        int64_t end;
+        double start_time;
+        double end_time;
+        std::vector<IndexEntry> index;
+    };
+
+    //一批待写入的数据，不跨分段
+    struct Batch {
+        int slot;
+        int64_t start;
+        int64_t file_offset;
+        std::vector<uint8_t> data;
+    };
+
+    void IngestLoop();
+    void Append(const AVPacket *pkt);
+    void SubmitBatch();
+    void WriteLoop();
+    void Evict();
+    int FindSegment(int64_t nOffset) const;
+    QString SlotPath(int nSlot) const;
+    static void RemoveStale(const QString &strRoot);
+
+private:
+    TaskExecutor *m_pExecutor;
+    AVFormatContext *m_pFormatCtx;
+    std::atomic<bool> m_bAbort;
+    QString m_strDir;
+    int m_nSlots;
+    int m_nKeyStream;           ///< 建立索引的流：有视频时为视频，否则为音频
+    std::vector<AVStream *> m_vecStreams;   ///< 开始时的流，AVStream 本身在关闭前不会释放
+    std::vector<AVRational> m_vecTimeBase;  ///< 各流的时间基
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<Segment> m_deqSegments;
+    int64_t m_nSegmentSeq;      ///< 下一个分段的序号，决定使用的文件
+    int64_t m_nWritten;         ///< 已接收数据的末尾
+    int64_t m_nFlushed;         ///< 已写入磁盘的数据末尾
+    int64_t m_nDiskBytes;
+    Batch m_stBatch;            ///< 正在积累的批次
+    int64_t m_nBatchStart;      ///< 当前批次开始积累的时间
+    std::deque<Batch> m_deqPending;     ///< 已提交、未写完的批次，写完前读取直接取内存
+    int64_t m_nPendingBytes;
+    bool m_bWriting;
+    bool m_bEnded;
+    int m_nError;
+    double m_dLastIndex;
+
+    int64_t m_nReadPos;         ///< 播放读取的位置
+    double m_dReadTime;
+    QFile m_stReadFile;         ///< 只在读取线程中使用
+    int m_nReadSlot;
+    QFile m_stWriteFile;        ///< 只在写入任务中使用
+    int m_nWriteSlot;
+
+    int64_t m_nPackets;
+    int64_t m_nDropped;
+    int64_t m_nWriteUs;
+    int64_t m_nMaxWriteUs;
+    QLockFile *m_pLock;         ///< 表示分段目录正在使用
+
+    TaskHandle m_stIngest;
+    TaskHandle m_stWriter;
+};
+
+#endif // TIMESHIFT_H
@@ -0,0 +1,55 @@
+﻿#include "timesource.h"
+
+#pragma execution_character_set("utf-8")
+
+#define VIRTUAL_SLEEP_MAX 1000  // 虚拟时钟下每次 Sleep 最多让出的真实时间（微秒）
+
+//系统单调时钟
+class RealTimeSource : public TimeSource
+{
+public:
+    int64_t Now() override
+    {
+        return av_gettime_relative();
+    }
+
+    void Sleep(int64_t nUs) override
+    {
+        av_usleep((unsigned)nUs);
+    }
+};
+
+TimeSource *TimeSource::Real()
+{
+    static RealTimeSource s_stReal;
+    return &s_stReal;
+}
+
+VirtualTimeSource::VirtualTimeSource(int64_t nStart) :
+    m_nNow(nStart)
+{
+}
+
+int64_t VirtualTimeSource::Now()
+{
+    return m_nNow.load();
+}
+
+/* 时间由驱动推进，这里只短暂让出CPU */
+void VirtualTimeSource::Sleep(int64_t nUs)
+{
+    av_usleep((unsigned)FFMIN(FFMAX(nUs, 0), VIRTUAL_SLEEP_MAX));
+}
+
+void VirtualTimeSource::Set(int64_t nNow)
+{
+    int64_t nCur = m_nNow.load();
+    while (nNow > nCur && !m_nNow.compare_exchange_weak(nCur, nNow))
+    {
+    }
+}
+
+void VirtualTimeSource::Advance(int64_t nUs)
+{
+    m_nNow += FFMAX(nUs, 0);
+}
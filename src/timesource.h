@@ -0,0 +1,61 @@
+﻿#ifndef TIMESOURCE_H
+#define TIMESOURCE_H
+
+#include <atomic>
+
+#include "globalhelper.h"
+
+/**
+ * @brief	播放引擎使用的时间源
+ *
+ * 时钟、帧定时和音频回调时间都从时间源读取，默认使用系统的单调时钟。
+ * 同步回放时换成虚拟时钟，由回放驱动推进，从而不受机器负载影响、
+ * 可以快于实时运行并且每次结果相同。
+ */
+class TimeSource
+{
+public:
+    virtual ~TimeSource() {}
+
+    /**
+     * @brief	当前时间（微秒），与 av_gettime_relative 的含义相同
+     */
+    virtual int64_t Now() = 0;
+
+    /**
+     * @brief	等待一段时间（微秒）
+     */
+    virtual void Sleep(int64_t nUs) = 0;
+
+    /**
+     * @brief	进程共享的系统时间源
+     */
+    static TimeSource *Real();
+};
+
+/**
+ * @brief	虚拟时钟
+ *
+ * 时间只由 Set/Advance 推进。Sleep 不推进时间，只让出一小段真实时间，
+ * 等待中的线程在驱动推进时间后重新检查条件。
+ */
+class VirtualTimeSource : public TimeSource
+{
+public:
+    explicit VirtualTimeSource(int64_t nStart = 0);
+
+    int64_t Now() override;
+    void Sleep(int64_t nUs) override;
+
+    /**
+     * @brief	设置当前时间，不会倒退
+     */
+    void Set(int64_t nNow);
+
+    void Advance(int64_t nUs);
+
+private:
+    std::atomic<int64_t> m_nNow;
+};
+
+#endif // TIMESOURCE_H
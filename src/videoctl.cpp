@@ -1,19 +1,35 @@
 ﻿#include <QDebug>
 #include <QMutex>
 
+#include <QImage>
+#include <QPainter>
+#include <QPainterPath>
+#include <QFontMetrics>
+#include <QFileInfo>
+#include <QDir>
+
 #include <thread>
 #include "videoctl.h"
+#include "mmapio.h"
+#include "prefetchio.h"
+#include "hlssource.h"
+#include "livelatency.h"
+#include "timeshift.h"
 
 #pragma execution_character_set("utf-8")
 
-extern QMutex g_show_rect_mutex;
+#define VIDEOCTL_WINDOW_DATA "VideoCtl" // SDL窗口上记录所属播放引擎的键名
 
-// 这些静态变量用于控制视频播放和缓存
-static int framedrop = -1;          // 帧丢弃计数
-static int infinite_buffer = -1;    // 无限缓冲标志
-static int64_t audio_callback_time; // 音频回调时间
+/* 时移时直播源由接收任务读取，ic->streams 可能被重新分配，改用开始时的快照 */
+static int stream_count(VideoState *is)
+{
+    return is->timeshift ? is->timeshift->StreamCount() : (int)is->ic->nb_streams;
+}
 
-#define FF_QUIT_EVENT    (SDL_USEREVENT + 2) // 自定义事件类型，用于退出
+static AVStream *stream_at(VideoState *is, int stream_index)
+{
+    return is->timeshift ? is->timeshift->Stream(stream_index) : is->ic->streams[stream_index];
+}
 
 // 重新分配纹理的内存
 int VideoCtl::realloc_texture(SDL_Texture **texture, Uint32 new_format, int new_width, int new_height, SDL_BlendMode blendmode, int init_texture)
@@ -91,6 +107,7 @@ void VideoCtl::calculate_display_rect(SDL_Rect *rect,
 
 // 上传纹理数据
 int VideoCtl::upload_texture(SDL_Texture *tex, AVFrame *frame, struct SwsContext **img_convert_ctx) {
+    PROFILE_SCOPE(PROFILE_ZONE_UPLOAD_TEXTURE);
     int ret = 0;
 
     switch (frame->format) {
@@ -138,6 +155,61 @@ int VideoCtl::upload_texture(SDL_Texture *tex, AVFrame *frame, struct SwsContext
     return ret; // 返回操作结果
 }
 
+// 上传字幕：先清除旧字幕中不会被新字幕覆盖的区域，再上传新字幕的各个矩形
+int VideoCtl::upload_subtitle(VideoState *is, Frame *sp)
+{
+    int tex_w = 0, tex_h = 0;
+    int i, j;
+
+    // 字幕和视频都没有画布大小时无法显示
+    if (!sp->width || !sp->height)
+        return 0;
+
+    if (is->sub_texture)
+        SDL_QueryTexture(is->sub_texture, NULL, NULL, &tex_w, &tex_h);
+    // 纹理大小变化时会被重新创建并清零，没有旧内容需要清除
+    if (tex_w != sp->width || tex_h != sp->height)
+        is->nb_sub_dirty_rects = 0;
+    if (realloc_texture(&is->sub_texture, SDL_PIXELFORMAT_ARGB8888, sp->width, sp->height, SDL_BLENDMODE_BLEND, 1) < 0)
+        return -1;
+
+    for (i = 0; i < is->nb_sub_dirty_rects; i++) {
+        SDL_Rect *dirty = &is->sub_dirty_rects[i];
+        int covered = 0;
+        for (j = 0; j < sp->nb_sub_argb && !covered; j++)
+            covered = sp->sub_argb[j] && sub_rect_covered(dirty, (SDL_Rect *)sp->sub.rects[j]);
+        if (covered)
+            continue;
+
+        int size = dirty->w * dirty->h * 4;
+        if (size > is->sub_clear_buf_size) {
+            av_freep(&is->sub_clear_buf);
+            is->sub_clear_buf = (uint8_t *)av_mallocz(size);
+            is->sub_clear_buf_size = is->sub_clear_buf ? size : 0;
+        }
+        if (is->sub_clear_buf)
+            SDL_UpdateTexture(is->sub_texture, dirty, is->sub_clear_buf, dirty->w * 4);
+    }
+    is->nb_sub_dirty_rects = 0;
+
+    for (i = 0; i < sp->nb_sub_argb; i++) {
+        AVSubtitleRect *sub_rect = sp->sub.rects[i];
+        SDL_Rect rect = { sub_rect->x, sub_rect->y, sub_rect->w, sub_rect->h };
+        if (!sp->sub_argb[i])
+            continue;
+
+        SDL_UpdateTexture(is->sub_texture, &rect, sp->sub_argb[i], sub_rect->w * 4);
+
+        // 记录有内容的区域，超出上限时合并为外接矩形
+        if (is->nb_sub_dirty_rects < SUB_MAX_DIRTY_RECTS) {
+            is->sub_dirty_rects[is->nb_sub_dirty_rects++] = rect;
+        } else {
+            SDL_UnionRect(&is->sub_dirty_rects[SUB_MAX_DIRTY_RECTS - 1], &rect, &is->sub_dirty_rects[SUB_MAX_DIRTY_RECTS - 1]);
+        }
+    }
+    return 0;
+}
+
 // 显示视频画面
 void VideoCtl::video_image_display(VideoState *is)
 {
@@ -157,49 +229,10 @@ void VideoCtl::video_image_display(VideoState *is)
 
             // 如果当前视频帧的时间戳大于字幕帧的显示开始时间
             if (vp->pts >= sp->pts + ((float)sp->sub.start_display_time / 1000)) {
-                // 如果字幕帧尚未上传
+                // 如果字幕帧尚未上传（像素已在字幕线程中转换好，这里只上传）
                 if (!sp->uploaded) {
-                    uint8_t* pixels[4];
-                    int pitch[4];
-                    int i;
-
-                    // 如果字幕帧的宽高未设置，则使用视频帧的宽高
-                    if (!sp->width || !sp->height) {
-                        sp->width = vp->width;
-                        sp->height = vp->height;
-                    }
-
-                    // 重新分配字幕纹理
-                    if (realloc_texture(&is->sub_texture, SDL_PIXELFORMAT_ARGB8888, sp->width, sp->height, SDL_BLENDMODE_BLEND, 1) < 0)
+                    if (upload_subtitle(is, sp) < 0)
                         return;
-
-                    // 遍历每个字幕矩形
-                    for (i = 0; i < sp->sub.num_rects; i++) {
-                        AVSubtitleRect *sub_rect = sp->sub.rects[i];
-
-                        // 修正字幕矩形的边界
-                        sub_rect->x = av_clip(sub_rect->x, 0, sp->width);
-                        sub_rect->y = av_clip(sub_rect->y, 0, sp->height);
-                        sub_rect->w = av_clip(sub_rect->w, 0, sp->width - sub_rect->x);
-                        sub_rect->h = av_clip(sub_rect->h, 0, sp->height - sub_rect->y);
-
-                        // 获取或创建字幕转换上下文
-                        is->sub_convert_ctx = sws_getCachedContext(is->sub_convert_ctx,
-                                                                   sub_rect->w, sub_rect->h, AV_PIX_FMT_PAL8,
-                                                                   sub_rect->w, sub_rect->h, AV_PIX_FMT_BGRA,
-                                                                   0, NULL, NULL, NULL);
-                        if (!is->sub_convert_ctx) {
-                            av_log(NULL, AV_LOG_FATAL, "Cannot initialize the conversion context\n");
-                            return;
-                        }
-
-                        // 锁定纹理并进行图像转换
-                        if (!SDL_LockTexture(is->sub_texture, (SDL_Rect *)sub_rect, (void **)pixels, pitch)) {
-                            sws_scale(is->sub_convert_ctx, (const uint8_t * const *)sub_rect->data, sub_rect->linesize,
-                                      0, sub_rect->h, pixels, pitch);
-                            SDL_UnlockTexture(is->sub_texture);
-                        }
-                    }
                     // 标记字幕帧已上传
                     sp->uploaded = 1;
                 }
@@ -246,42 +279,133 @@ void VideoCtl::video_image_display(VideoState *is)
     if (sp) {
         SDL_RenderCopy(renderer, is->sub_texture, NULL, &rect);
     }
+
+    // 渲染文本字幕
+    text_subtitle_display(is, vp, &rect);
+}
+
+/* 显示频谱/波形：有新绘制的图像时上传纹理，拉伸到整个窗口 */
+void VideoCtl::video_audio_display(VideoState *is)
+{
+    const uint32_t *pixels;
+    int w, h;
+
+    is->visualizer->SetSize(is->width, is->height);
+    if (is->visualizer->LockFrame(&pixels, &w, &h)) {
+        if (realloc_texture(&is->vis_texture, SDL_PIXELFORMAT_ARGB8888, w, h, SDL_BLENDMODE_NONE, 0) == 0)
+            SDL_UpdateTexture(is->vis_texture, NULL, pixels, w * 4);
+        is->visualizer->UnlockFrame();
+    }
+
+    if (is->vis_texture)
+        SDL_RenderCopy(renderer, is->vis_texture, NULL, NULL);
+}
+
+/* 把字幕文字绘制为ARGB图像：白字黑边，逐行居中，宽度与视频帧相同 */
+static QImage render_subtitle_text(const QString &text, int frame_w, int frame_h)
+{
+    QFont font;
+    font.setPixelSize(FFMAX(16, frame_h / 18));
+    font.setBold(true);
+    QFontMetrics metrics(font);
+    QStringList lines = text.split('\n');
+    int line_h = metrics.height();
+    int outline = FFMAX(2, font.pixelSize() / 10);
+
+    QImage image(frame_w, line_h * lines.size() + outline * 2, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+
+    QPainterPath path;
+    for (int i = 0; i < lines.size(); i++) {
+        int x = (frame_w - metrics.width(lines.at(i))) / 2;
+        int y = outline + i * line_h + metrics.ascent();
+        path.addText(x, y, font, lines.at(i));
+    }
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(QPen(Qt::black, outline * 2, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+    painter.drawPath(path);
+    painter.fillPath(path, Qt::white);
+    painter.end();
+
+    // SDL按非预乘alpha混合，ARGB32与 SDL_PIXELFORMAT_ARGB8888 内存布局一致
+    return image.convertToFormat(QImage::Format_ARGB32);
+}
+
+/* 显示文本字幕：按当前帧时间查询字幕时间轴，字幕变化时才重新绘制纹理 */
+void VideoCtl::text_subtitle_display(VideoState *is, Frame *vp, SDL_Rect *rect)
+{
+    SubtitleStore *store = NULL;
+    int64_t time_ms = (int64_t)(vp->pts * 1000);
+    QString text;
+    uint64_t key;
+
+    // 外挂字幕优先，外挂字幕从0开始计时，需要减去文件的起始时间
+    if (is->sidecar_subs && !is->sidecar_subs->IsEmpty()) {
+        store = is->sidecar_subs;
+        if (is->ic && is->ic->start_time != AV_NOPTS_VALUE)
+            time_ms -= is->ic->start_time / 1000;
+    } else if (is->text_subs) {
+        store = is->text_subs;
+    }
+    if (!store || !vp->width || isnan(vp->pts) || !(key = store->Lookup(time_ms, text)))
+        return;
+
+    if (key != is->text_sub_key || vp->width != is->text_sub_w || !is->text_sub_texture) {
+        QImage image = render_subtitle_text(text, vp->width, vp->height);
+        if (realloc_texture(&is->text_sub_texture, SDL_PIXELFORMAT_ARGB8888, image.width(), image.height(), SDL_BLENDMODE_BLEND, 0) < 0)
+            return;
+        SDL_UpdateTexture(is->text_sub_texture, NULL, image.constBits(), image.bytesPerLine());
+        is->text_sub_key = key;
+        is->text_sub_w = image.width();
+        is->text_sub_h = image.height();
+    }
+
+    // 按视频显示区域缩放，放在画面底部
+    SDL_Rect dst;
+    dst.w = rect->w;
+    dst.h = (int)lrint(is->text_sub_h * (double)rect->w / is->text_sub_w);
+    dst.x = rect->x;
+    dst.y = rect->y + rect->h - dst.h - rect->h / 20;
+    SDL_RenderCopy(renderer, is->text_sub_texture, NULL, &dst);
 }
 
 // 关闭流对应的解码器等资源
 void VideoCtl::stream_component_close(VideoState *is, int stream_index)
 {
-    AVFormatContext *ic = is->ic; // 媒体格式上下文
     AVCodecParameters *codecpar;
 
     // 检查流索引是否合法
-    if (stream_index < 0 || stream_index >= ic->nb_streams)
+    if (stream_index < 0 || stream_index >= stream_count(is))
         return;
 
-    codecpar = ic->streams[stream_index]->codecpar; // 获取流的编解码参数
+    codecpar = stream_at(is, stream_index)->codecpar; // 获取流的编解码参数
 
     // 根据流的类型执行相应的关闭操作
     switch (codecpar->codec_type) {
     case AVMEDIA_TYPE_AUDIO: // 处理音频流
         // 终止音频解码器并关闭音频
         decoder_abort(&is->auddec, &is->sampq);
-        SDL_CloseAudio();
+        audio_close(is);
+        av_log(NULL, AV_LOG_VERBOSE, "audio: %" PRId64 " frames output directly, %" PRId64 " frames resampled, "
+               "resampler %d created %d reused\n",
+               is->audio_bypass_frames, is->audio_resample_frames,
+               m_stResampler.CreateCount(), m_stResampler.ReuseCount());
         // 销毁音频解码器
         decoder_destroy(&is->auddec);
-        // 释放音频重采样上下文
-        swr_free(&is->swr_ctx);
+        is->audio_history->Clear();
+        is->audio_history_req = 0;
+        is->audio_history_active = 0;
+        av_frame_unref(is->audio_history_frame.frame);
+        delete is->loudness_live;
+        is->loudness_live = NULL;
+        // 重采样上下文归 m_stResampler 所有，留给下一个参数相同的文件复用
+        is->swr_ctx = NULL;
         // 释放音频缓冲区
         av_freep(&is->audio_buf1);
         is->audio_buf1_size = 0;
         is->audio_buf = NULL;
-
-        // 如果存在离散傅里叶变换上下文，释放相关资源
-        if (is->rdft) {
-            av_rdft_end(is->rdft);
-            av_freep(&is->rdft_data);
-            is->rdft = NULL;
-            is->rdft_bits = 0;
-        }
         break;
 
     case AVMEDIA_TYPE_VIDEO: // 处理视频流
@@ -289,6 +413,8 @@ void VideoCtl::stream_component_close(VideoState *is, int stream_index)
         decoder_abort(&is->viddec, &is->pictq);
         // 销毁视频解码器
         decoder_destroy(&is->viddec);
+        is->frame_history->Clear();
+        is->history_active = 0;
         break;
 
     case AVMEDIA_TYPE_SUBTITLE: // 处理字幕流
@@ -296,6 +422,13 @@ void VideoCtl::stream_component_close(VideoState *is, int stream_index)
         decoder_abort(&is->subdec, &is->subpq);
         // 销毁字幕解码器
         decoder_destroy(&is->subdec);
+        // 中止预读并释放文本字幕时间轴
+        if (is->text_subs) {
+            is->text_subs->Abort();
+            is->text_subs_task.Wait();
+            delete is->text_subs;
+            is->text_subs = NULL;
+        }
         break;
 
     default:
@@ -303,7 +436,7 @@ void VideoCtl::stream_component_close(VideoState *is, int stream_index)
     }
 
     // 设置流的丢弃策略，丢弃所有数据
-    ic->streams[stream_index]->discard = AVDISCARD_ALL;
+    stream_at(is, stream_index)->discard = AVDISCARD_ALL;
 
     // 根据流的类型清理相关状态
     switch (codecpar->codec_type) {
@@ -330,9 +463,21 @@ void VideoCtl::stream_component_close(VideoState *is, int stream_index)
 // 关闭视频流和释放相关资源
 void VideoCtl::stream_close(VideoState *is)
 {
-    // 设置请求中止标志并等待读取线程结束
+    // 设置请求中止标志，唤醒可能挂起的读取线程并等待其结束
     is->abort_request = 1;
-    is->read_tid.join();
+    read_waker_signal(&is->continue_read);
+    is->read_task.Wait();
+    is->loudness_task.Wait();
+    // 接收任务已被中断回调唤醒，在关闭流之前结束
+    if (is->timeshift) {
+        TimeshiftStats stats = is->timeshift->Stats();
+        av_log(NULL, AV_LOG_VERBOSE, "timeshift: %.1fs in %d segments %.1f MB, %" PRId64 " packets, %" PRId64 " dropped, write %.3fs (max %.3fs)\n",
+               stats.live - stats.start, stats.segments, stats.disk_bytes / 1048576.0, stats.packets, stats.dropped,
+               stats.write_us / 1000000.0, stats.max_write_us / 1000000.0);
+        // 接收任务已结束，之后直接访问 ic 的流
+        delete is->timeshift;
+        is->timeshift = NULL;
+    }
 
     // 关闭每个流
     if (is->audio_stream >= 0)
@@ -344,6 +489,31 @@ void VideoCtl::stream_close(VideoState *is)
 
     // 关闭输入格式上下文
     avformat_close_input(&is->ic);
+    delete is->mmap_io;
+    if (is->prefetch_io) {
+        PrefetchStats stats = is->prefetch_io->Stats();
+        av_log(NULL, AV_LOG_VERBOSE, "prefetchio: %" PRId64 " reads, %" PRId64 " hits, %" PRId64 " stalls %.3fs (max %.3fs), %" PRId64 "/%" PRId64 " seeks in buffer\n",
+               stats.reads, stats.hits, stats.stalls, stats.stall_us / 1000000.0, stats.max_stall_us / 1000000.0,
+               stats.seek_hits, stats.seeks);
+        delete is->prefetch_io;
+    }
+    if (is->hls_source) {
+        HlsStats stats = is->hls_source->Stats();
+        av_log(NULL, AV_LOG_VERBOSE, "hls: %d segments %.1f MB, %d switches, bandwidth %" PRId64 " bps, startup %.3fs, %d stalls %.3fs (max %.3fs), %d errors\n",
+               stats.segments, stats.bytes / 1048576.0, stats.switches, stats.bandwidth, stats.startup_us / 1000000.0,
+               stats.stalls, stats.stall_us / 1000000.0, stats.max_stall_us / 1000000.0, stats.errors);
+        delete is->hls_source;
+    }
+    if (is->live_ctl) {
+        LiveLatencyStats stats = is->live_ctl->Stats();
+        av_log(NULL, AV_LOG_VERBOSE, "live: target %.3fs, latency p50 %.3fs p90 %.3fs p99 %.3fs max %.3fs (%" PRId64 " samples), %d catchups, %d drops %.3fs\n",
+               stats.target, stats.p50, stats.p90, stats.p99, stats.max, stats.samples,
+               stats.catchups, stats.drops, stats.dropped);
+        // 追赶使用的播放速率不带到下一个文件
+        if (is->live_rate != 1.0)
+            ffp_set_playback_rate(1.0);
+        delete is->live_ctl;
+    }
 
     // 销毁视频、音频和字幕的包队列
     packet_queue_destroy(&is->videoq);
@@ -355,11 +525,21 @@ void VideoCtl::stream_close(VideoState *is)
     frame_queue_destory(&is->sampq);
     frame_queue_destory(&is->subpq);
 
-    // 销毁条件变量
-    SDL_DestroyCond(is->continue_read_thread);
+    // 读取和视频线程都已结束，释放倒放缓存和历史帧
+    delete is->gop_cache;
+    delete is->frame_history;
+    delete is->audio_history;
+    av_frame_free(&is->audio_history_frame.frame);
+    // 销毁读取线程唤醒器
+    read_waker_destroy(&is->continue_read);
+    // 释放外挂字幕
+    is->sidecar_task.Wait();
+    delete is->sidecar_subs;
+    // 音频已关闭，释放频谱/波形显示
+    delete is->visualizer;
     // 释放图像转换上下文
     sws_freeContext(is->img_convert_ctx);
-    sws_freeContext(is->sub_convert_ctx);
+    av_freep(&is->sub_clear_buf);
     // 释放文件名缓冲区
     av_free(is->filename);
 
@@ -368,6 +548,10 @@ void VideoCtl::stream_close(VideoState *is)
         SDL_DestroyTexture(is->vid_texture);
     if (is->sub_texture)
         SDL_DestroyTexture(is->sub_texture);
+    if (is->text_sub_texture)
+        SDL_DestroyTexture(is->text_sub_texture);
+    if (is->vis_texture)
+        SDL_DestroyTexture(is->vis_texture);
 
     // 释放视频状态结构体
     av_free(is);
@@ -385,7 +569,7 @@ double VideoCtl::get_clock(Clock *c)
         return c->pts;
     } else {
         // 计算当前相对时间
-        double time = av_gettime_relative() / 1000000.0;
+        double time = time_now() / 1000000.0;
         // 返回时钟时间戳加上漂移值
         return c->pts_drift + time - (time - c->last_updated) * (1.0 - c->speed);
     }
@@ -403,7 +587,7 @@ void VideoCtl::set_clock_at(Clock *c, double pts, int serial, double time)
 // 设置时钟的时间戳，并使用当前时间作为更新时间
 void VideoCtl::set_clock(Clock *c, double pts, int serial)
 {
-    double time = av_gettime_relative() / 1000000.0;
+    double time = time_now() / 1000000.0;
     set_clock_at(c, pts, serial, time);
 }
 
@@ -452,16 +636,164 @@ void VideoCtl::ffp_set_property_float(int id, float value)
     }
 }
 
-// 增加播放速度
-void VideoCtl::OnSpeed()
+// 设置播放速度，按微调步长取整
+void VideoCtl::OnSetSpeed(float fRate)
 {
-    pf_playback_rate += PLAYBACK_RATE_SCALE; // 每次增加刻度
-    if (pf_playback_rate > PLAYBACK_RATE_MAX)
+    float fStep = PLAYBACK_RATE_FINE_STEP;
+    fRate = av_clipf(roundf(fRate / fStep) * fStep, PLAYBACK_RATE_MIN, PLAYBACK_RATE_MAX);
+    if (fabsf(fRate - pf_playback_rate) < fStep / 2)
     {
-        pf_playback_rate = PLAYBACK_RATE_MIN; // 超过最大值时重置
+        return;
     }
+    pf_playback_rate = fRate;
     pf_playback_rate_changed = 1;
-    emit SigSpeed(pf_playback_rate); // 发出速度变化信号
+    emit SigSpeed(pf_playback_rate);
+}
+
+// 微调播放速度
+void VideoCtl::OnSpeedStep(int nSteps)
+{
+    OnSetSpeed(pf_playback_rate + nSteps * PLAYBACK_RATE_FINE_STEP);
+}
+
+// 关键帧快进/快退，由读取线程执行
+void VideoCtl::OnScan(int nSpeed)
+{
+    if (m_CurStream == nullptr || m_CurStream->video_stream < 0 || m_CurStream->timeshift ||
+            (m_CurStream->video_st->disposition & AV_DISPOSITION_ATTACHED_PIC))
+    {
+        return;
+    }
+    if (nSpeed != 0 && m_CurStream->reverse_req)
+    {
+        OnReverse(false);
+    }
+    if (nSpeed != 0)
+    {
+        nSpeed = nSpeed > 0 ? av_clip(nSpeed, SCAN_SPEED_MIN, SCAN_SPEED_MAX) : -av_clip(-nSpeed, SCAN_SPEED_MIN, SCAN_SPEED_MAX);
+    }
+    m_CurStream->scan_speed = nSpeed;
+    read_waker_signal(&m_CurStream->continue_read);
+    emit SigScan(nSpeed);
+}
+
+// 开启/关闭倒放，由读取线程切换
+void VideoCtl::OnReverse(bool bReverse)
+{
+    if (m_CurStream == nullptr || m_CurStream->video_stream < 0 || m_CurStream->timeshift ||
+            (m_CurStream->video_st->disposition & AV_DISPOSITION_ATTACHED_PIC))
+    {
+        return;
+    }
+    if (bReverse && m_CurStream->scan_speed)
+    {
+        OnScan(0);
+    }
+    m_CurStream->reverse_req = bReverse;
+    read_waker_signal(&m_CurStream->continue_read);
+    emit SigReverse(bReverse);
+}
+
+void VideoCtl::OnToggleReverse()
+{
+    if (m_CurStream)
+    {
+        OnReverse(!m_CurStream->reverse_req);
+    }
+}
+
+// 后退一帧：未在倒放时先切换到倒放，显示前一帧后暂停
+void VideoCtl::OnStepBackward()
+{
+    if (m_CurStream == nullptr)
+    {
+        return;
+    }
+    if (m_CurStream->reverse_active && m_CurStream->reverse_req)
+    {
+        step_to_next_frame(m_CurStream);
+        emit SigPauseStat(true);
+        return;
+    }
+    // 前一帧还在历史中时直接显示，解码器不用跳转
+    double pos = m_CurStream->vidclk.pts * pf_playback_rate;
+    if (m_CurStream->frame_history && !std::isnan(pos) &&
+            history_seek(m_CurStream, m_CurStream->frame_history->PtsBefore(pos, m_CurStream->videoq.serial), true))
+    {
+        emit SigPauseStat(true);
+        return;
+    }
+    m_CurStream->reverse_step_req = 1;
+    OnReverse(true);
+}
+
+// 快进：8/16/32/64 倍循环，超过最高倍率恢复正常播放
+void VideoCtl::OnFastForward()
+{
+    if (m_CurStream == nullptr)
+    {
+        return;
+    }
+    int nSpeed = m_CurStream->scan_speed;
+    OnScan(nSpeed <= 0 ? SCAN_SPEED_MIN : (nSpeed < SCAN_SPEED_MAX ? nSpeed * 2 : 0));
+}
+
+// 快退：8/16/32/64 倍循环，超过最高倍率恢复正常播放
+void VideoCtl::OnFastRewind()
+{
+    if (m_CurStream == nullptr)
+    {
+        return;
+    }
+    int nSpeed = m_CurStream->scan_speed;
+    OnScan(nSpeed >= 0 ? -SCAN_SPEED_MIN : (-nSpeed < SCAN_SPEED_MAX ? nSpeed * 2 : 0));
+}
+
+/* 倍速播放时调整视频解码降级档位
+ * 先按速率选择基础档位；速率不低于 PLAYBACK_SKIP_NONREF_RATE 时，如果每秒解码的帧数
+ * 仍明显超过原速播放的帧率（例如没有B帧的码流），再降一档直到只解码关键帧，
+ * 使高倍速的解码开销接近原速。速率改变后重新从基础档位开始 */
+void VideoCtl::update_speed_skip(VideoState *is, AVRational frame_rate)
+{
+    int64_t now = time_now();
+    float rate = pf_playback_rate;
+    int level = is->speed_skip_level;
+
+    if (is->scan_active) {
+        // 关键帧扫描只解码关键帧，结束后按速率重新选择档位
+        level = DECODE_SKIP_MAX;
+        is->speed_skip_rate = 0;
+    } else if (rate != is->speed_skip_rate) {
+        if (rate >= PLAYBACK_SKIP_NONREF_RATE)
+            level = DECODE_SKIP_NONREF;
+        else if (rate >= PLAYBACK_SKIP_LOOP_FILTER_RATE)
+            level = DECODE_SKIP_LOOP_FILTER;
+        else
+            level = DECODE_SKIP_NONE;
+        is->speed_skip_rate = rate;
+        is->speed_skip_serial = is->viddec.pkt_serial;
+        is->speed_skip_start = now;
+        is->speed_skip_frames = 0;
+    } else if (is->speed_skip_serial != is->viddec.pkt_serial) {
+        // seek 后会集中解码填满队列，重新开始统计
+        is->speed_skip_serial = is->viddec.pkt_serial;
+        is->speed_skip_start = now;
+        is->speed_skip_frames = 0;
+    } else if (now - is->speed_skip_start >= PLAYBACK_SKIP_INTERVAL) {
+        double decoded_fps = is->speed_skip_frames * 1000000.0 / (now - is->speed_skip_start);
+        double budget_fps = frame_rate.num && frame_rate.den ? av_q2d(frame_rate) : 25.0;
+        if (level >= DECODE_SKIP_NONREF && level < DECODE_SKIP_MAX && decoded_fps > budget_fps * PLAYBACK_SKIP_BUDGET)
+            level++;
+        is->speed_skip_start = now;
+        is->speed_skip_frames = 0;
+    }
+
+    if (level != is->speed_skip_level) {
+        av_log(NULL, AV_LOG_VERBOSE, "playback rate %.2f: video decode skip level %d -> %d\n",
+               rate, is->speed_skip_level, level);
+        decoder_set_skip_level(is->viddec.avctx, level);
+        is->speed_skip_level = level;
+    }
 }
 
 // 获取主同步类型
@@ -524,6 +856,48 @@ void VideoCtl::check_external_clock_speed(VideoState *is) {
     }
 }
 
+/* 直播模式：测量端到端的缓冲延迟，按控制器的输出轻微调速、变速追赶或丢帧 */
+void VideoCtl::live_latency_control(VideoState *is)
+{
+    int64_t now = time_now();
+    if (now < is->live_next_control)
+        return;
+    is->live_next_control = now + LIVE_CONTROL_INTERVAL;
+
+    // 延迟 = 最新收到的包的时间戳 - 正在播放的位置，音频时钟已扣除输出设备缓冲
+    int sync_type = get_master_sync_type(is);
+    double played = get_master_clock(is) * pf_playback_rate;
+    LiveDecision decision = is->live_ctl->Update(is->live_recv_pts - played, now);
+
+    if (sync_type == AV_SYNC_AUDIO_MASTER) {
+        // 音频为主时钟：音频回调按调速系数增减样本、丢弃已解码的帧，视频随主时钟丢弃落后的帧
+        is->live_speed = (float)decision.speed;
+        if (decision.drop > 0)
+            is->live_drop_us = (int64_t)(decision.drop * 1000000);
+        // 追赶用 sonic 变速，与用户设置的倍速是同一机制
+        if (decision.rate != is->live_rate) {
+            is->live_rate = decision.rate;
+            ffp_set_playback_rate((float)decision.rate);
+            is->live_next_control = now + LIVE_RATE_SETTLE;
+        }
+    }
+    else if (sync_type == AV_SYNC_EXTERNAL_CLOCK) {
+        // 外部时钟为主时钟（没有音频）：直接调整时钟速度，丢帧时时钟前移
+        set_clock_speed(&is->extclk, decision.speed * decision.rate);
+        if (decision.drop > 0)
+            set_clock(&is->extclk, get_clock(&is->extclk) + decision.drop / pf_playback_rate, is->extclk.serial);
+    }
+}
+
+/* 直播落后过多时丢弃音频帧，返回 1 表示该帧已丢弃；只丢弃后面还有帧的帧，不在音频回调中等待解码 */
+int VideoCtl::live_drop_audio(VideoState *is, Frame *af)
+{
+    if (!is->live_ctl || is->live_drop_us <= 0 || frame_queue_nb_remaining(&is->sampq) == 0)
+        return 0;
+    is->live_drop_us -= (int64_t)af->frame->nb_samples * 1000000 / af->frame->sample_rate;
+    return 1;
+}
+
 /* 在流中进行查找 */
 void VideoCtl::stream_seek(VideoState *is, int64_t pos, int64_t rel)
 {
@@ -533,7 +907,7 @@ void VideoCtl::stream_seek(VideoState *is, int64_t pos, int64_t rel)
         is->seek_rel = rel;
         is->seek_flags &= ~AVSEEK_FLAG_BYTE;
         is->seek_req = 1;
-        SDL_CondSignal(is->continue_read_thread);
+        read_waker_signal(&is->continue_read);
     }
 }
 
@@ -542,7 +916,7 @@ void VideoCtl::stream_toggle_pause(VideoState *is)
 {
     if (is->paused) {
         // 计算暂停期间经过的时间，并更新时钟
-        is->frame_timer += av_gettime_relative() / 1000000.0 - is->vidclk.last_updated;
+        is->frame_timer += time_now() / 1000000.0 - is->vidclk.last_updated;
         if (is->read_pause_return != AVERROR(ENOSYS)) {
             is->vidclk.paused = 0;
         }
@@ -551,7 +925,10 @@ void VideoCtl::stream_toggle_pause(VideoState *is)
     // 同步外部时钟
     set_clock(&is->extclk, get_clock(&is->extclk), is->extclk.serial);
     // 切换暂停状态
-    is->paused = is->audclk.paused = is->vidclk.paused = is->extclk.paused = !is->paused;
+    set_clock(&is->scanclk, get_clock(&is->scanclk), is->scanclk.serial);
+    is->paused = is->audclk.paused = is->vidclk.paused = is->extclk.paused = is->scanclk.paused = !is->paused;
+    // 文件尾排空阶段读取线程在无超时等待，需要唤醒它重新检查结束条件
+    read_waker_signal(&is->continue_read);
 }
 
 /* 切换暂停状态，并重置步进标志 */
@@ -686,12 +1063,24 @@ void VideoCtl::video_refresh(void *opaque, double *remaining_time)
 
     Frame *sp, *sp2;
 
-    double rdftspeed = 0.02; // 设置 RDFT 速度
+    double rdftspeed = VISUALIZER_INTERVAL / 1000.0; // 频谱/波形刷新间隔
 
-    // 如果未暂停且主同步类型为外部时钟，检查并调整外部时钟速度
-    if (!is->paused && get_master_sync_type(is) == AV_SYNC_EXTERNAL_CLOCK && is->realtime)
+    // 直播模式按目标延迟控制；否则未暂停且主同步类型为外部时钟时，检查并调整外部时钟速度
+    if (!is->paused && is->live_ctl)
+        live_latency_control(is);
+    else if (!is->paused && get_master_sync_type(is) == AV_SYNC_EXTERNAL_CLOCK && is->realtime)
         check_external_clock_speed(is);
 
+    // 纯音频播放时按固定间隔显示频谱/波形
+    if (is->visualizer) {
+        time = time_now() / 1000000.0;
+        if (is->force_refresh || is->last_vis_time + rdftspeed < time) {
+            video_display(is);
+            is->last_vis_time = time;
+        }
+        *remaining_time = FFMIN(*remaining_time, is->last_vis_time + rdftspeed - time);
+    }
+
     if (is->video_st) { // 如果存在视频流
 retry:
         // 如果帧队列为空，则什么都不做
@@ -708,22 +1097,99 @@ retry:
 
             // 如果当前帧的序列号与视频队列的序列号不匹配，跳过并重试
             if (vp->serial != is->videoq.serial) {
+                m_stSyncTrace.Record(SYNC_TRACE_DROP, vp->serial, vp->pts, NAN, NAN, SYNC_TRACE_DROP_SERIAL);
                 frame_queue_next(&is->pictq);
                 goto retry;
             }
 
             // 如果当前帧的序列号与上一帧不同，更新帧计时器
             if (lastvp->serial != vp->serial)
-                is->frame_timer = av_gettime_relative() / 1000000.0;
+                is->frame_timer = time_now() / 1000000.0;
+
+            // 切换到历史帧时丢弃帧队列中较新的帧，包括视频线程切换之前写入的
+            if (is->history_req || is->history_skip > 0) {
+                int drop;
+                PROFILE_MUTEX_LOCK(is->pictq.mutex, PROFILE_LOCK_FRAME_QUEUE);
+                drop = is->history_req || is->history_skip > 0;
+                if (drop) {
+                    if (!is->history_req)
+                        is->history_skip--;
+                    m_stSyncTrace.Record(SYNC_TRACE_DROP, vp->serial, vp->pts, NAN, NAN, SYNC_TRACE_DROP_REPLAY);
+                    frame_queue_next(&is->pictq);
+                }
+                PROFILE_MUTEX_UNLOCK(is->pictq.mutex, PROFILE_LOCK_FRAME_QUEUE);
+                if (drop)
+                    goto retry;
+            }
 
             if (is->paused)
                 goto display; // 如果视频暂停，跳到显示逻辑
 
+            // 历史帧重放：按重放时钟显示，步进时立即显示
+            if (is->history_active) {
+                double clock = get_clock(&is->scanclk);
+                time = time_now() / 1000000.0;
+                if (!is->step && !std::isnan(vp->pts) && !std::isnan(clock) && vp->pts > clock) {
+                    *remaining_time = FFMIN((vp->pts - clock) / pf_playback_rate, *remaining_time);
+                    goto display;
+                }
+                if (!std::isnan(vp->pts)) {
+                    update_video_pts(is, vp->pts, vp->pos, vp->serial);
+                    if (is->step)
+                        set_clock(&is->scanclk, vp->pts, 0);
+                }
+                frame_queue_next(&is->pictq);
+                is->force_refresh = 1;
+                is->last_present_time = time_now();
+                is->frame_timer = time;
+                if (is->step && !is->paused)
+                    stream_toggle_pause(is);
+                goto display;
+            }
+
+            // 倒放：按倒着走的时钟显示，时钟越过后面的帧时丢弃当前帧
+            if (is->reverse_active) {
+                double clock = get_clock(&is->scanclk);
+                time = time_now() / 1000000.0;
+                if (!std::isnan(vp->pts) && vp->pts < clock) {
+                    *remaining_time = FFMIN(clock - vp->pts, *remaining_time);
+                    goto display;
+                }
+                if (!is->step && frame_queue_nb_remaining(&is->pictq) > 1) {
+                    Frame *nextvp = frame_queue_peek_next(&is->pictq);
+                    if (nextvp->serial == vp->serial && nextvp->pts >= clock) {
+                        is->frame_drops_late++;
+                        m_stSyncTrace.Record(SYNC_TRACE_DROP, vp->serial, vp->pts, NAN, NAN, SYNC_TRACE_DROP_LATE);
+                        frame_queue_next(&is->pictq);
+                        goto retry;
+                    }
+                }
+                if (!std::isnan(vp->pts))
+                    update_video_pts(is, vp->pts, vp->pos, vp->serial);
+                frame_queue_next(&is->pictq);
+                is->force_refresh = 1;
+                is->last_present_time = time_now();
+                if (is->step && !is->paused)
+                    stream_toggle_pause(is);
+                goto display;
+            }
+
+            // 关键帧扫描：读取线程已按扫描时钟挑选关键帧，解码出来即显示
+            if (is->scan_active) {
+                if (!std::isnan(vp->pts))
+                    update_video_pts(is, vp->pts, vp->pos, vp->serial);
+                frame_queue_next(&is->pictq);
+                is->force_refresh = 1;
+                is->last_present_time = time_now();
+                goto display;
+            }
+
             /* 计算名义上的 last_duration */
             last_duration = vp_duration(is, lastvp, vp); // 计算上一帧与当前帧的持续时间
             delay = compute_target_delay(last_duration, is); // 计算目标延迟
+            m_stSyncTrace.Record(SYNC_TRACE_VIDEO_TARGET, vp->serial, vp->pts, delay, is->frame_timer + delay);
 
-            time = av_gettime_relative() / 1000000.0; // 获取当前时间
+            time = time_now() / 1000000.0; // 获取当前时间
             // 如果当前时间还没到达预期的帧时间，加上延迟
             if (time < is->frame_timer + delay) {
                 *remaining_time = FFMIN(is->frame_timer + delay - time, *remaining_time);
@@ -736,17 +1202,19 @@ retry:
                 is->frame_timer = time;
 
             // 锁定图片队列的互斥锁
-            SDL_LockMutex(is->pictq.mutex);
+            PROFILE_MUTEX_LOCK(is->pictq.mutex, PROFILE_LOCK_FRAME_QUEUE);
             if (!std::isnan(vp->pts))
                 update_video_pts(is, vp->pts, vp->pos, vp->serial); // 更新视频时间戳
-            SDL_UnlockMutex(is->pictq.mutex);
+            PROFILE_MUTEX_UNLOCK(is->pictq.mutex, PROFILE_LOCK_FRAME_QUEUE);
+            m_stSyncTrace.Record(SYNC_TRACE_CLOCKS, vp->serial, get_clock(&is->audclk), get_clock(&is->vidclk), get_clock(&is->extclk));
 
             // 如果队列中还有多于1帧，计算下一帧的持续时间并根据条件丢弃帧
             if (frame_queue_nb_remaining(&is->pictq) > 1) {
                 Frame *nextvp = frame_queue_peek_next(&is->pictq);
                 duration = vp_duration(is, vp, nextvp);
-                if (!is->step && (framedrop > 0 || (framedrop && get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER)) && time > is->frame_timer + duration) {
+                if (!is->step && (this->framedrop > 0 || (this->framedrop && get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER)) && time > is->frame_timer + duration) {
                     is->frame_drops_late++;
+                    m_stSyncTrace.Record(SYNC_TRACE_DROP, vp->serial, vp->pts, NAN, NAN, SYNC_TRACE_DROP_LATE);
                     frame_queue_next(&is->pictq);
                     goto retry;
                 }
@@ -763,25 +1231,11 @@ retry:
                         sp2 = NULL;
 
                     // 如果字幕的显示时间已过期，或者下一帧的显示时间已过期，移除字幕
+                    // 没有字幕要显示时不绘制字幕纹理，旧内容留到下一条字幕上传时按脏区域清除
                     if (sp->serial != is->subtitleq.serial
                             || (is->vidclk.pts > (sp->pts + ((float)sp->sub.end_display_time / 1000)))
                             || (sp2 && is->vidclk.pts > (sp2->pts + ((float)sp2->sub.start_display_time / 1000))))
                     {
-                        if (sp->uploaded) {
-                            int i;
-                            for (i = 0; i < sp->sub.num_rects; i++) {
-                                AVSubtitleRect *sub_rect = sp->sub.rects[i];
-                                uint8_t *pixels;
-                                int pitch, j;
-
-                                // 清除已上传字幕的区域
-                                if (!SDL_LockTexture(is->sub_texture, (SDL_Rect *)sub_rect, (void **)&pixels, &pitch)) {
-                                    for (j = 0; j < sub_rect->h; j++, pixels += pitch)
-                                        memset(pixels, 0, sub_rect->w << 2);
-                                    SDL_UnlockTexture(is->sub_texture);
-                                }
-                            }
-                        }
                         frame_queue_next(&is->subpq);
                     }
                     else {
@@ -792,6 +1246,11 @@ retry:
 
             frame_queue_next(&is->pictq); // 显示当前帧
             is->force_refresh = 1;
+            is->last_present_time = time_now();
+
+            // 最后一帧已送显，通知读取线程播放结束
+            if (is->eof && frame_queue_nb_remaining(&is->pictq) == 0 && is->viddec.finished == is->videoq.serial)
+                read_waker_signal(&is->continue_read);
 
             // 如果在步进模式且未暂停，则切换到暂停状态
             if (is->step && !is->paused)
@@ -804,13 +1263,36 @@ display:
     }
     is->force_refresh = 0;
 
-    // 发出信号，表示视频播放的秒数（考虑播放速率）
-    emit SigVideoPlaySeconds(get_master_clock(is) * pf_playback_rate);
+    // 发出信号，表示视频播放的秒数（考虑播放速率，扫描时为扫描位置）
+    if (is->timeshift)
+        timeshift_report(is);
+    else if (is->scan_active || is->reverse_active || is->history_active)
+        emit SigVideoPlaySeconds(get_clock(&is->scanclk));
+    else
+        emit SigVideoPlaySeconds(get_master_clock(is) * pf_playback_rate);
+}
+
+/* 时移时进度条对应时移窗口：总时长为窗口长度，播放位置相对窗口开头，与 OnPlaySeek 的换算一致 */
+void VideoCtl::timeshift_report(VideoState *is)
+{
+    TimeshiftStats stats = is->timeshift->Stats();
+    double pos = get_master_clock(is) * pf_playback_rate;
+
+    if (std::isnan(stats.start) || std::isnan(stats.live))
+        return;
+    int total = (int)(stats.live - stats.start);
+    if (total != is->timeshift_total) {
+        is->timeshift_total = total;
+        emit SigVideoTotalSeconds(FFMAX(total, 1));
+    }
+    if (!std::isnan(pos))
+        emit SigVideoPlaySeconds(av_clip((int)(pos - stats.start), 0, FFMAX(total, 1)));
 }
 
 /* 将解码后的视频帧添加到视频帧队列 */
 int VideoCtl::queue_picture(VideoState *is, AVFrame *src_frame, double pts, double duration, int64_t pos, int serial)
 {
+    PROFILE_SCOPE(PROFILE_ZONE_QUEUE_PICTURE);
     Frame *vp;
 
     // 获取队列中可写的帧，如果队列满则返回 -1
@@ -830,6 +1312,8 @@ int VideoCtl::queue_picture(VideoState *is, AVFrame *src_frame, double pts, doub
     vp->pos = pos;
     vp->serial = serial;
 
+    m_stSyncTrace.Record(SYNC_TRACE_VIDEO_QUEUED, serial, pts, is->pictq.size);
+
     // 将源帧的内容移动到目标帧
     av_frame_move_ref(vp->frame, src_frame);
     // 将帧推送到帧队列
@@ -850,15 +1334,18 @@ int VideoCtl::get_video_frame(VideoState *is, AVFrame *frame)
 
         double dpts = NAN;
 
+        is->speed_skip_frames++;
+
         // 计算解码帧的时间戳
         if (frame->pts != AV_NOPTS_VALUE)
             dpts = av_q2d(is->video_st->time_base) * frame->pts;
+        m_stSyncTrace.Record(SYNC_TRACE_VIDEO_DECODED, is->viddec.pkt_serial, dpts);
 
         // 估算帧的样本纵横比
         frame->sample_aspect_ratio = av_guess_sample_aspect_ratio(is->ic, is->video_st, frame);
 
         // 判断是否丢帧的条件
-        if (framedrop > 0 || (framedrop && get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER)) {
+        if (!is->scan_active && !m_bSyncReplay && (this->framedrop > 0 || (this->framedrop && get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER))) {
             if (frame->pts != AV_NOPTS_VALUE) {
                 double diff = dpts - get_master_clock(is);
                 if (!std::isnan(diff) && fabs(diff) < AV_NOSYNC_THRESHOLD &&
@@ -867,6 +1354,7 @@ int VideoCtl::get_video_frame(VideoState *is, AVFrame *frame)
                         is->videoq.nb_packets) {
                     // 丢帧并释放帧
                     is->frame_drops_early++;
+                    m_stSyncTrace.Record(SYNC_TRACE_DROP, is->viddec.pkt_serial, dpts, NAN, NAN, SYNC_TRACE_DROP_EARLY);
                     av_frame_unref(frame);
                     got_picture = 0;
                 }
@@ -899,6 +1387,13 @@ int VideoCtl::audio_thread(void *arg)
         if (got_frame) {
             tb = { 1, frame->sample_rate }; // 设置音频时间基
 
+            // 整个文件的分析结果出来之前，用已解码部分的综合响度估计增益
+            if (is->loudness_live && !is->loudness_known) {
+                is->loudness_live->AddFrame(frame);
+                if (is->loudness_live->BlockCount() >= LOUDNESS_LIVE_MIN_BLOCKS)
+                    is->loudness_gain = LoudnessMeter::NormalizeGain(is->loudness_live->Integrated(), is->loudness_live->Peak());
+            }
+
             // 获取队列中可写的音频帧，如果队列满则跳转到结束
             if (!(af = frame_queue_peek_writable(&is->sampq)))
                 goto the_end;
@@ -940,6 +1435,21 @@ int VideoCtl::video_thread(void *arg)
 
     // 循环从队列中获取视频帧并处理
     for (;;) {
+        // 倒放时从GOP缓存取帧，不经过解码器
+        if (is->reverse_active) {
+            if (reverse_output(is, frame, frame_rate) < 0)
+                goto the_end;
+            continue;
+        }
+        // 后退到历史帧范围内时从历史中取帧，解码器停在原来的位置
+        if (is->history_req)
+            history_start(is);
+        if (is->history_active) {
+            if (history_output(is, frame) < 0)
+                goto the_end;
+            continue;
+        }
+        update_speed_skip(is, frame_rate); // 按播放速率调整解码档位
         ret = get_video_frame(is, frame); // 获取解码后的视频帧
         if (ret < 0)
             goto the_end; // 如果出错，跳转到结束部分
@@ -950,6 +1460,10 @@ int VideoCtl::video_thread(void *arg)
         duration = (frame_rate.num && frame_rate.den ? av_q2d({ frame_rate.den, frame_rate.num }) : 0);
         pts = (frame->pts == AV_NOPTS_VALUE) ? NAN : frame->pts * av_q2d(tb);
 
+        // 记入历史，后退时可直接取用
+        if (!is->scan_active)
+            is->frame_history->Push(frame, pts, duration, is->viddec.pkt_serial);
+
         // 将帧添加到视频帧队列
         ret = queue_picture(is, frame, pts, duration, av_frame_get_pkt_pos(frame), is->viddec.pkt_serial);
         av_frame_unref(frame); // 释放 AVFrame 结构体的引用
@@ -990,36 +1504,37 @@ int VideoCtl::subtitle_thread(void *arg)
             sp->serial = is->subdec.pkt_serial;
             sp->width = is->subdec.avctx->width;
             sp->height = is->subdec.avctx->height;
+            // 字幕没有画布大小时使用视频的宽高
+            if ((!sp->width || !sp->height) && is->video_st) {
+                sp->width = is->video_st->codecpar->width;
+                sp->height = is->video_st->codecpar->height;
+            }
             sp->uploaded = 0;
 
+            // 预先转换为ARGB像素，渲染线程只需上传
+            if (subtitle_rasterize(sp) < 0) {
+                frame_queue_unref_item(sp);
+                break;
+            }
+
             // 将字幕帧添加到字幕帧队列
             frame_queue_push(&is->subpq);
         }
         else if (got_subtitle) {
-            // 释放无效的字幕帧
+            // 文本字幕加入时间轴，由渲染线程按时间查询显示
+            if (is->text_subs && sp->sub.pts != AV_NOPTS_VALUE)
+                is->text_subs->AddSubtitle(&sp->sub, sp->sub.pts / (double)AV_TIME_BASE);
             avsubtitle_free(&sp->sub);
         }
     }
     return 0;
 }
 
-/* 更新用于编辑窗口显示的音频样本 */
-void VideoCtl::update_sample_display(VideoState *is, short *samples, int samples_size)
+/* 更新用于频谱/波形显示的音频样本，只在纯音频播放时有效 */
+void VideoCtl::update_sample_display(VideoState *is, const uint8_t *samples, int samples_size)
 {
-    int size, len;
-
-    size = samples_size / sizeof(short);
-    while (size > 0) {
-        len = SAMPLE_ARRAY_SIZE - is->sample_array_index; // 计算剩余空间
-        if (len > size)
-            len = size; // 计算实际拷贝的长度
-        memcpy(is->sample_array + is->sample_array_index, samples, len * sizeof(short)); // 拷贝样本数据
-        samples += len;
-        is->sample_array_index += len; // 更新样本数组索引
-        if (is->sample_array_index >= SAMPLE_ARRAY_SIZE)
-            is->sample_array_index = 0; // 循环使用样本数组
-        size -= len;
-    }
+    if (is->visualizer)
+        is->visualizer->PushSamples(samples, samples_size, is->audio_tgt.fmt, is->audio_tgt.channels);
 }
 
 /* 根据音频与视频同步类型调整所需的样本数，以获得更好的同步 */
@@ -1049,6 +1564,7 @@ int VideoCtl::synchronize_audio(VideoState *is, int nb_samples)
                     min_nb_samples = ((nb_samples * (100 - SAMPLE_CORRECTION_PERCENT_MAX) / 100));
                     max_nb_samples = ((nb_samples * (100 + SAMPLE_CORRECTION_PERCENT_MAX) / 100));
                     wanted_nb_samples = av_clip(wanted_nb_samples, min_nb_samples, max_nb_samples); // 限制样本数在最小和最大值之间
+                    m_stSyncTrace.Record(SYNC_TRACE_AUDIO_CORRECTION, is->auddec.pkt_serial, diff, avg_diff, wanted_nb_samples - nb_samples);
                 }
                 av_log(NULL, AV_LOG_TRACE, "diff=%f adiff=%f sample_diff=%d apts=%0.3f %f\n",
                        diff, avg_diff, wanted_nb_samples - nb_samples,
@@ -1061,6 +1577,10 @@ int VideoCtl::synchronize_audio(VideoState *is, int nb_samples)
             is->audio_diff_cum = 0;
         }
     }
+    // 直播轻微调速：音频为主时钟时按调速系数增减样本，幅度不超过 LIVE_GENTLE_MAX，不经过 sonic
+    else if (is->live_ctl && is->live_speed != 1.0f) {
+        wanted_nb_samples = (int)lrint(nb_samples / is->live_speed);
+    }
 
     return wanted_nb_samples;
 }
@@ -1072,31 +1592,51 @@ int VideoCtl::synchronize_audio(VideoState *is, int nb_samples)
  */
 int VideoCtl::audio_decode_frame(VideoState *is)
 {
+    PROFILE_SCOPE(PROFILE_ZONE_AUDIO_DECODE);
     int data_size, resampled_data_size;
     int64_t dec_channel_layout;
     av_unused double audio_clock0;
     int wanted_nb_samples;
+    int swr_mode;
     Frame *af;
 
-    // 如果处于暂停状态，则返回 -1
-    if (is->paused)
+    // 如果处于暂停状态、关键帧扫描或倒放（静音），则返回 -1
+    if (is->paused || is->scan_active || is->reverse_active)
         return -1;
 
+    // 后退到历史帧时音频也从历史中取帧，取完后 sampq 正好接着原来的位置
+    if (is->audio_history_req)
+        audio_history_start(is);
+    af = is->audio_history_active ? audio_history_output(is) : NULL;
+    if (af)
+        goto convert;
+
     do {
+        // 同步回放时驱动线程已等到帧队列填满，队列为空说明音频已经结束
+        if (m_bSyncReplay && frame_queue_nb_remaining(&is->sampq) == 0)
+            return -1;
 #if defined(_WIN32)
         // Windows 特定代码：等待帧队列中有可读的帧
         while (frame_queue_nb_remaining(&is->sampq) == 0) {
-            if ((av_gettime_relative() - audio_callback_time) > 1000000LL * is->audio_hw_buf_size / is->audio_tgt.bytes_per_sec / 2)
+            if ((time_now() - is->audio_callback_time) > 1000000LL * is->audio_hw_buf_size / is->audio_tgt.bytes_per_sec / 2)
                 return -1;
-            av_usleep(1000);
+            m_pTimeSource->Sleep(1000);
         }
 #endif
         // 从帧队列中获取可读的帧
         if (!(af = frame_queue_peek_readable(&is->sampq)))
             return -1;
         frame_queue_next(&is->sampq);
-    } while (af->serial != is->audioq.serial);
+    } while (af->serial != is->audioq.serial || live_drop_audio(is, af));
 
+    // 最后一帧音频已取出，通知读取线程播放结束
+    if (is->eof && frame_queue_nb_remaining(&is->sampq) == 0 && is->auddec.finished == is->audioq.serial)
+        read_waker_signal(&is->continue_read);
+
+    // 记入历史，播放中后退时与视频一起重放
+    is->audio_history->Push(af->frame, af->pts, af->duration, af->serial);
+
+convert:
     // 计算音频帧的数据大小
     data_size = av_samples_get_buffer_size(NULL, av_frame_get_channels(af->frame),
                                            af->frame->nb_samples,
@@ -1107,25 +1647,38 @@ int VideoCtl::audio_decode_frame(VideoState *is)
         (af->frame->channel_layout && av_frame_get_channels(af->frame) == av_get_channel_layout_nb_channels(af->frame->channel_layout)) ?
             af->frame->channel_layout : av_get_default_channel_layout(av_frame_get_channels(af->frame));
     wanted_nb_samples = synchronize_audio(is, af->frame->nb_samples);
+    swr_mode = AudioResampler::ResolveMode(m_nResamplerMode, ffp_get_playback_rate());
 
-    // 如果音频参数需要改变，重新初始化采样率转换上下文
+    // 如果音频参数或重采样模式需要改变，重新配置采样率转换上下文
     if (af->frame->format != is->audio_src.fmt ||
             dec_channel_layout != is->audio_src.channel_layout ||
             af->frame->sample_rate != is->audio_src.freq ||
-            (wanted_nb_samples != af->frame->nb_samples && !is->swr_ctx)) {
-        swr_free(&is->swr_ctx);
-        is->swr_ctx = swr_alloc_set_opts(NULL,
-                                         is->audio_tgt.channel_layout, is->audio_tgt.fmt, is->audio_tgt.freq,
-                                         dec_channel_layout, (AVSampleFormat)af->frame->format, af->frame->sample_rate,
-                                         0, NULL);
-        if (!is->swr_ctx || swr_init(is->swr_ctx) < 0) {
+            (wanted_nb_samples != af->frame->nb_samples && !is->swr_ctx) ||
+            (is->swr_ctx && swr_mode != is->swr_mode)) {
+        is->swr_ctx = NULL;
+        // 与输出格式只差 planar/packed 且不需要同步补偿时不创建重采样器，直接交错输出
+        if (av_get_packed_sample_fmt((AVSampleFormat)af->frame->format) == is->audio_tgt.fmt &&
+                dec_channel_layout == is->audio_tgt.channel_layout &&
+                af->frame->sample_rate == is->audio_tgt.freq &&
+                wanted_nb_samples == af->frame->nb_samples)
+            goto update_src;
+        ResamplerParams params;
+        params.in_layout = dec_channel_layout;
+        params.in_fmt = (AVSampleFormat)af->frame->format;
+        params.in_rate = af->frame->sample_rate;
+        params.out_layout = is->audio_tgt.channel_layout;
+        params.out_fmt = is->audio_tgt.fmt;
+        params.out_rate = is->audio_tgt.freq;
+        is->swr_ctx = m_stResampler.Configure(params, swr_mode);
+        if (!is->swr_ctx) {
             av_log(NULL, AV_LOG_ERROR,
                    "无法创建采样率转换器，将 %d Hz %s %d 个通道转换为 %d Hz %s %d 个通道失败！\n",
                    af->frame->sample_rate, av_get_sample_fmt_name((AVSampleFormat)af->frame->format), av_frame_get_channels(af->frame),
                    is->audio_tgt.freq, av_get_sample_fmt_name(is->audio_tgt.fmt), is->audio_tgt.channels);
-            swr_free(&is->swr_ctx);
             return -1;
         }
+        is->swr_mode = swr_mode;
+update_src:
         // 更新音频源参数
         is->audio_src.channel_layout = dec_channel_layout;
         is->audio_src.channels = av_frame_get_channels(af->frame);
@@ -1162,15 +1715,28 @@ int VideoCtl::audio_decode_frame(VideoState *is)
         if (len2 == out_count) {
             av_log(NULL, AV_LOG_WARNING, "音频缓冲区可能太小\n");
             if (swr_init(is->swr_ctx) < 0)
-                swr_free(&is->swr_ctx);
+                is->swr_ctx = NULL;
         }
         is->audio_buf = is->audio_buf1;
         resampled_data_size = len2 * is->audio_tgt.channels * av_get_bytes_per_sample(is->audio_tgt.fmt);
+        is->audio_resample_frames++;
+    }
+    else if (av_sample_fmt_is_planar((AVSampleFormat)af->frame->format) && is->audio_tgt.channels > 1) {
+        // planar 数据交错后输出
+        av_fast_malloc(&is->audio_buf1, &is->audio_buf1_size, data_size);
+        if (!is->audio_buf1)
+            return AVERROR(ENOMEM);
+        audio_interleave(is->audio_buf1, af->frame->extended_data, af->frame->nb_samples,
+                         is->audio_tgt.channels, av_get_bytes_per_sample(is->audio_tgt.fmt));
+        is->audio_buf = is->audio_buf1;
+        resampled_data_size = data_size;
+        is->audio_bypass_frames++;
     }
     else {
         // 不需要转换，直接使用解码后的数据
         is->audio_buf = af->frame->data[0];
         resampled_data_size = data_size;
+        is->audio_bypass_frames++;
     }
 
     audio_clock0 = is->audio_clock;
@@ -1180,6 +1746,7 @@ int VideoCtl::audio_decode_frame(VideoState *is)
     else
         is->audio_clock = NAN;
     is->audio_clock_serial = af->serial;
+    m_stSyncTrace.Record(SYNC_TRACE_AUDIO_DECODED, af->serial, is->audio_clock, resampled_data_size);
 
     return resampled_data_size;
 }
@@ -1190,9 +1757,14 @@ void sdl_audio_callback(void *opaque, Uint8 *stream, int len)
     VideoState *is = (VideoState *)opaque;
     int audio_size, len1;
 
-    VideoCtl *pVideoCtl = VideoCtl::GetInstance();
+    VideoCtl *pVideoCtl = is->ctl;
+
+    is->audio_callback_time = pVideoCtl->time_now();
 
-    audio_callback_time = av_gettime_relative();
+    // 音量与响度标准化增益合成一个系数，输出时每个样本只做一次乘法
+    float target_gain = pVideoCtl->GetLoudnessNormalization() ? is->loudness_gain.load() : 1.0f;
+    is->loudness_cur_gain = av_clipf(target_gain, is->loudness_cur_gain / LOUDNESS_GAIN_STEP, is->loudness_cur_gain * LOUDNESS_GAIN_STEP);
+    float gain = is->audio_volume / (float)SDL_MIX_MAXVOLUME * is->loudness_cur_gain;
 
     while (len > 0) {
         // 如果音频缓冲区已处理完毕，解码新的音频帧
@@ -1229,6 +1801,7 @@ void sdl_audio_callback(void *opaque, Uint8 *stream, int len)
             }
             if(!pVideoCtl->is_normal_playback_rate() && is->audio_buf)
             {
+                PROFILE_SCOPE(PROFILE_ZONE_SONIC);
                 // 处理非正常播放速率
                 int actual_out_samples = is->audio_buf_size / (is->audio_tgt.channels * av_get_bytes_per_sample(is->audio_tgt.fmt));
                 int out_ret = 0;
@@ -1287,9 +1860,12 @@ void sdl_audio_callback(void *opaque, Uint8 *stream, int len)
         len1 = is->audio_buf_size - is->audio_buf_index;
         if (len1 > len)
             len1 = len;
-        if (is->audio_buf && is->audio_volume == SDL_MIX_MAXVOLUME)
+        // 送给可视化的是正在输出的样本（已变速）
+        if (is->audio_buf)
+            pVideoCtl->update_sample_display(is, (uint8_t *)is->audio_buf + is->audio_buf_index, len1);
+        if (is->audio_buf && gain == 1.0f)
             memcpy(stream, (uint8_t *)is->audio_buf + is->audio_buf_index, len1);
-        else {
+        else if (!is->audio_buf || audio_apply_gain(stream, (uint8_t *)is->audio_buf + is->audio_buf_index, len1, is->audio_tgt.fmt, gain) < 0) {
             memset(stream, 0, len1);
             if (is->audio_buf)
                 SDL_MixAudio(stream, (uint8_t *)is->audio_buf + is->audio_buf_index, len1, is->audio_volume);
@@ -1297,12 +1873,14 @@ void sdl_audio_callback(void *opaque, Uint8 *stream, int len)
         len -= len1;
         stream += len1;
         is->audio_buf_index += len1;
+        if (is->audio_buf)
+            is->last_present_time = is->audio_callback_time;
     }
     is->audio_write_buf_size = is->audio_buf_size - is->audio_buf_index;
     /* 假设 SDL 使用的音频驱动有两个周期。 */
     if (!std::isnan(is->audio_clock)) {
         double audio_clock = is->audio_clock / pVideoCtl->ffp_get_playback_rate();
-        pVideoCtl->set_clock_at(&is->audclk, audio_clock  - (double)(2 * is->audio_hw_buf_size + is->audio_write_buf_size) / is->audio_tgt.bytes_per_sec, is->audio_clock_serial, audio_callback_time / 1000000.0);
+        pVideoCtl->set_clock_at(&is->audclk, audio_clock  - (double)(2 * is->audio_hw_buf_size + is->audio_write_buf_size) / is->audio_tgt.bytes_per_sec, is->audio_clock_serial, is->audio_callback_time / 1000000.0);
         pVideoCtl->sync_clock_to_slave(&is->extclk, &is->audclk);
     }
 }
@@ -1311,10 +1889,12 @@ int VideoCtl::audio_open(void *opaque, int64_t wanted_channel_layout, int wanted
                          struct AudioParams *audio_hw_params)
 {
     SDL_AudioSpec wanted_spec, spec;
+    SDL_AudioDeviceID audio_dev = 0;
     const char *env;
     static const int next_nb_channels[] = { 0, 0, 1, 6, 2, 6, 4, 6 };
     static const int next_sample_rates[] = { 0, 44100, 48000, 96000, 192000 };
     int next_sample_rate_idx = FF_ARRAY_ELEMS(next_sample_rates) - 1;
+    int allowed_changes = SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_CHANNELS_CHANGE | SDL_AUDIO_ALLOW_FORMAT_CHANGE;
 
     // 从环境变量获取音频通道数（如果设置了）
     env = SDL_getenv("SDL_AUDIO_CHANNELS");
@@ -1341,15 +1921,21 @@ int VideoCtl::audio_open(void *opaque, int64_t wanted_channel_layout, int wanted
     // 确定音频回调的缓冲区大小
     while (next_sample_rate_idx && next_sample_rates[next_sample_rate_idx] >= wanted_spec.freq)
         next_sample_rate_idx--;
-    wanted_spec.format = AUDIO_S16SYS; // 设置音频格式为 16-bit signed little-endian
+    // 优先使用浮点输出，大多数解码器输出浮点，可以省去格式转换
+    wanted_spec.format = AUDIO_F32SYS;
     wanted_spec.silence = 0;
     wanted_spec.samples = FFMAX(SDL_AUDIO_MIN_BUFFER_SIZE, 2 << av_log2(wanted_spec.freq / SDL_AUDIO_MAX_CALLBACKS_PER_SEC));
     wanted_spec.callback = sdl_audio_callback; // 设置回调函数
     wanted_spec.userdata = opaque;
 
-    // 打开音频设备
-    while (SDL_OpenAudio(&wanted_spec, &spec) < 0) {
-        av_log(NULL, AV_LOG_WARNING, "SDL_OpenAudio (%d channels, %d Hz): %s\n",
+    // 使用混音输出时由混音器决定设备格式
+    if (m_pAudioMixer && !m_pAudioMixer->AddSource(sdl_audio_callback, opaque, &wanted_spec, &spec))
+        return -1;
+
+    // 否则打开本实例独占的音频设备，允许设备选择自己的格式、采样率和声道数
+    while (!m_pAudioMixer &&
+           !(audio_dev = SDL_OpenAudioDevice(NULL, 0, &wanted_spec, &spec, allowed_changes))) {
+        av_log(NULL, AV_LOG_WARNING, "SDL_OpenAudioDevice (%d channels, %d Hz): %s\n",
                wanted_spec.channels, wanted_spec.freq, SDL_GetError());
 
         // 尝试不同的通道数
@@ -1365,12 +1951,24 @@ int VideoCtl::audio_open(void *opaque, int64_t wanted_channel_layout, int wanted
         }
         wanted_channel_layout = av_get_default_channel_layout(wanted_spec.channels);
     }
+    // 设备选择的格式不能直接处理时（sonic 变速只支持 FLT/S16），改为由SDL转换浮点数据
+    if (audio_dev && spec.format != AUDIO_F32SYS && spec.format != AUDIO_S16SYS) {
+        SDL_CloseAudioDevice(audio_dev);
+        audio_dev = SDL_OpenAudioDevice(NULL, 0, &wanted_spec, &spec, allowed_changes & ~SDL_AUDIO_ALLOW_FORMAT_CHANGE);
+        if (!audio_dev) {
+            av_log(NULL, AV_LOG_ERROR, "SDL_OpenAudioDevice (%d channels, %d Hz): %s\n",
+                   wanted_spec.channels, wanted_spec.freq, SDL_GetError());
+            return -1;
+        }
+    }
+    ((VideoState *)opaque)->audio_dev = audio_dev;
 
     // 更新音频通道布局
     if (spec.channels != wanted_spec.channels) {
         wanted_channel_layout = av_get_default_channel_layout(spec.channels);
         if (!wanted_channel_layout) {
             av_log(NULL, AV_LOG_ERROR, "SDL advised channel count %d is not supported!\n", spec.channels);
+            audio_close((VideoState *)opaque);
             return -1;
         }
     }
@@ -1408,14 +2006,24 @@ int VideoCtl::audio_open(void *opaque, int64_t wanted_channel_layout, int wanted
     // 检查计算结果
     if (audio_hw_params->bytes_per_sec <= 0 || audio_hw_params->frame_size <= 0) {
         av_log(NULL, AV_LOG_ERROR, "av_samples_get_buffer_size failed\n");
+        audio_close((VideoState *)opaque);
         return -1;
     }
     return spec.size;
 }
 
+/* 关闭音频输出：从混音器移除或关闭独占的设备 */
+void VideoCtl::audio_close(VideoState *is)
+{
+    if (m_pAudioMixer)
+        m_pAudioMixer->RemoveSource(is);
+    else if (is->audio_dev)
+        SDL_CloseAudioDevice(is->audio_dev);
+    is->audio_dev = 0;
+}
+
 int VideoCtl::stream_component_open(VideoState *is, int stream_index)
 {
-    AVFormatContext *ic = is->ic;          // 输入的 AVFormatContext
     AVCodecContext *avctx;                 // 解码上下文
     AVCodec *codec;                        // 解码器
     const char *forced_codec_name = NULL;  // 强制使用的编解码器名称
@@ -1427,7 +2035,7 @@ int VideoCtl::stream_component_open(VideoState *is, int stream_index)
     int stream_lowres = 0;                 // 低分辨率设置
 
     // 检查流索引有效性
-    if (stream_index < 0 || stream_index >= ic->nb_streams)
+    if (stream_index < 0 || stream_index >= stream_count(is))
         return -1;
 
     // 初始化解码上下文
@@ -1436,10 +2044,10 @@ int VideoCtl::stream_component_open(VideoState *is, int stream_index)
         return AVERROR(ENOMEM);
 
     // 从流的编码参数中初始化解码上下文
-    ret = avcodec_parameters_to_context(avctx, ic->streams[stream_index]->codecpar);
+    ret = avcodec_parameters_to_context(avctx, stream_at(is, stream_index)->codecpar);
     if (ret < 0)
         goto fail;
-    av_codec_set_pkt_timebase(avctx, ic->streams[stream_index]->time_base);
+    av_codec_set_pkt_timebase(avctx, stream_at(is, stream_index)->time_base);
 
     // 查找解码器
     codec = avcodec_find_decoder(avctx->codec_id);
@@ -1489,7 +2097,7 @@ int VideoCtl::stream_component_open(VideoState *is, int stream_index)
     }
 
     is->eof = 0;  // 标记流是否结束
-    ic->streams[stream_index]->discard = AVDISCARD_DEFAULT; // 默认丢弃策略
+    stream_at(is, stream_index)->discard = AVDISCARD_DEFAULT; // 默认丢弃策略
 
     // 根据流类型进行初始化
     switch (avctx->codec_type) {
@@ -1498,6 +2106,12 @@ int VideoCtl::stream_component_open(VideoState *is, int stream_index)
         nb_channels = avctx->channels;
         channel_layout = avctx->channel_layout;
 
+        // 音频回调从打开设备开始就会记录历史，先创建
+        if (!is->audio_history) {
+            is->audio_history = new FrameHistory();
+            is->audio_history_frame.frame = av_frame_alloc();
+        }
+
         /* 准备音频输出 */
         if ((ret = audio_open(is, channel_layout, nb_channels, sample_rate, &is->audio_tgt)) < 0)
             goto fail;
@@ -1512,40 +2126,65 @@ int VideoCtl::stream_component_open(VideoState *is, int stream_index)
         is->audio_diff_threshold = (double)(is->audio_hw_buf_size) / is->audio_tgt.bytes_per_sec;
 
         is->audio_stream = stream_index;
-        is->audio_st = ic->streams[stream_index];
+        is->audio_st = stream_at(is, stream_index);
+
+        // 文件响度还未知时，在解码线程中实时估计
+        if (m_bLoudnessNorm && !is->loudness_known) {
+            is->loudness_live = new LoudnessMeter();
+            is->loudness_live->Init(avctx->sample_rate, avctx->channels, false);
+        }
 
         // 创建音频解码线程
-        decoder_init(&is->auddec, avctx, &is->audioq, is->continue_read_thread);
+        decoder_init(&is->auddec, avctx, &is->audioq, &is->continue_read);
         if ((is->ic->iformat->flags & (AVFMT_NOBINSEARCH | AVFMT_NOGENSEARCH | AVFMT_NO_BYTE_SEEK)) && !is->ic->iformat->read_seek) {
             is->auddec.start_pts = is->audio_st->start_time;
             is->auddec.start_pts_tb = is->audio_st->time_base;
         }
         packet_queue_start(is->auddec.queue);
-        is->auddec.decode_thread = std::thread(&VideoCtl::audio_thread, this, is);
-        SDL_PauseAudio(0);
+        is->auddec.decode_task = m_pExecutor->Submit(TASK_LANE_AUDIO, [this, is] { audio_thread(is); }, true);
+        if (m_pAudioMixer)
+            m_pAudioMixer->PauseSource(is, false);
+        else
+            SDL_PauseAudioDevice(is->audio_dev, 0);
         break;
     case AVMEDIA_TYPE_VIDEO:
         is->video_stream = stream_index;
-        is->video_st = ic->streams[stream_index];
+        is->video_st = stream_at(is, stream_index);
+
+        if (!is->frame_history)
+            is->frame_history = new FrameHistory();
 
         // 创建视频解码线程
-        decoder_init(&is->viddec, avctx, &is->videoq, is->continue_read_thread);
+        decoder_init(&is->viddec, avctx, &is->videoq, &is->continue_read);
+        is->viddec.reorder_pts = decoder_reorder_pts;
         packet_queue_start(is->viddec.queue);
-        is->viddec.decode_thread = std::thread(&VideoCtl::video_thread, this, is);
+        is->viddec.decode_task = m_pExecutor->Submit(TASK_LANE_VIDEO, [this, is] { video_thread(is); }, true);
         is->queue_attachments_req = 1;
         break;
     case AVMEDIA_TYPE_SUBTITLE:
         is->subtitle_stream = stream_index;
-        is->subtitle_st = ic->streams[stream_index];
+        is->subtitle_st = stream_at(is, stream_index);
+
+        // 文本字幕放入时间轴，seek后无需等待解码即可显示；本地文件在后台预读整条字幕流
+        is->text_subs = new SubtitleStore();
+        {
+            const AVCodecDescriptor *desc = avcodec_descriptor_get(avctx->codec_id);
+            if (desc && (desc->props & AV_CODEC_PROP_TEXT_SUB) && !is->realtime)
+                is->text_subs_task = m_pExecutor->Submit(TASK_LANE_BACKGROUND, [is, stream_index] {
+                    is->text_subs->PreReadStream(is->filename, stream_index);
+                });
+        }
 
         // 创建字幕解码线程
-        decoder_init(&is->subdec, avctx, &is->subtitleq, is->continue_read_thread);
+        decoder_init(&is->subdec, avctx, &is->subtitleq, &is->continue_read);
         packet_queue_start(is->subdec.queue);
-        is->subdec.decode_thread = std::thread(&VideoCtl::subtitle_thread, this, is);
+        is->subdec.decode_task = m_pExecutor->Submit(TASK_LANE_SUBTITLE, [this, is] { subtitle_thread(is); }, true);
         break;
     default:
         break;
     }
+    // 新打开的流需要继续读取数据（可能处于文件尾等待中）
+    read_waker_signal(&is->continue_read);
 
     goto out;
 
@@ -1563,11 +2202,11 @@ int decode_interrupt_cb(void *ctx)
     return is->abort_request;
 }
 
-int VideoCtl::stream_has_enough_packets(AVStream *st, int stream_id, PacketQueue *queue) {
+int VideoCtl::stream_has_enough_packets(AVStream *st, int stream_id, PacketQueue *queue, double min_seconds) {
     return stream_id < 0 ||
             queue->abort_request ||
             (st->disposition & AV_DISPOSITION_ATTACHED_PIC) ||
-            queue->nb_packets > MIN_FRAMES && (!queue->duration || av_q2d(st->time_base) * queue->duration > 1.0);
+            queue->nb_packets > MIN_FRAMES && (!queue->duration || av_q2d(st->time_base) * queue->duration > min_seconds);
 }
 
 int VideoCtl::is_realtime(AVFormatContext *s)
@@ -1600,19 +2239,12 @@ void VideoCtl::ReadThread(VideoState *is)
     AVDictionaryEntry *t;
     AVDictionary **opts;
     int orig_nb_streams;
-    SDL_mutex *wait_mutex = SDL_CreateMutex();
     int scan_all_pmts_set = 0;
     int64_t pkt_ts;
+    double queue_seconds;
 
     const char* wanted_stream_spec[AVMEDIA_TYPE_NB] = { 0 };
 
-    // 创建互斥锁
-    if (!wait_mutex) {
-        av_log(NULL, AV_LOG_FATAL, "SDL_CreateMutex(): %s\n", SDL_GetError());
-        ret = AVERROR(ENOMEM);
-        goto fail;
-    }
-
     // 初始化流索引
     memset(st_index, -1, sizeof(st_index));
     is->last_video_stream = is->video_stream = -1;
@@ -1630,6 +2262,43 @@ void VideoCtl::ReadThread(VideoState *is)
     ic->interrupt_callback.callback = decode_interrupt_cb;
     ic->interrupt_callback.opaque = is;
 
+    // HLS 播放列表由分片预取读取，不支持的播放列表仍交给 hls 解复用器；
+    // HTTP 渐进下载和慢速存储上的本地文件通过后台预读，其它本地文件通过内存映射读取，都失败时仍使用默认协议
+    if (!is->iformat && m_bHlsSource && HlsSource::IsHlsUrl(is->filename)) {
+        is->hls_source = new HlsSource(m_pExecutor);
+        is->hls_source->SetBufferTarget(m_dNetworkBuffer);
+        err = is->hls_source->Open(is->filename, &ic->interrupt_callback);
+        if (err < 0) {
+            av_log(NULL, AV_LOG_VERBOSE, "hls: fall back to hls demuxer (%d)\n", err);
+            delete is->hls_source;
+            is->hls_source = NULL;
+        } else {
+            ic->pb = is->hls_source->Context();
+            ic->flags |= AVFMT_FLAG_CUSTOM_IO;
+        }
+    }
+    else if (!is->iformat && m_bPrefetchIO &&
+             (PrefetchIO::IsHttpUrl(is->filename) ||
+              (MmapIO::IsLocalFile(is->filename) && PrefetchIO::IsSlowStorage(is->filename)))) {
+        is->prefetch_io = new PrefetchIO(m_pExecutor);
+        if (is->prefetch_io->Open(is->filename, &ic->interrupt_callback) < 0) {
+            delete is->prefetch_io;
+            is->prefetch_io = NULL;
+        } else {
+            ic->pb = is->prefetch_io->Context();
+            ic->flags |= AVFMT_FLAG_CUSTOM_IO;
+        }
+    }
+    if (!ic->pb && !is->iformat && MmapIO::IsLocalFile(is->filename)) {
+        if (m_bMmapIO) {
+            is->mmap_io = MmapIO::Open(is->filename);
+            if (is->mmap_io) {
+                ic->pb = is->mmap_io->Context();
+                ic->flags |= AVFMT_FLAG_CUSTOM_IO;
+            }
+        }
+    }
+
     // 打开输入文件并获取封装信息
     err = avformat_open_input(&ic, is->filename, is->iformat, nullptr/*&format_opts*/);
     if (err < 0) {
@@ -1658,6 +2327,21 @@ void VideoCtl::ReadThread(VideoState *is)
     is->max_frame_duration = (ic->iformat->flags & AVFMT_TS_DISCONT) ? 10.0 : 3600.0;
 
     is->realtime = is_realtime(ic);
+    is->network = is->hls_source || PrefetchIO::IsHttpUrl(is->filename);
+
+    // 直播模式：实时流按目标延迟控制，代替按包数调整外部时钟速度
+    if (m_bLiveMode && is->realtime) {
+        is->live_recv_pts = NAN;
+        is->live_speed = 1.0f;
+        is->live_rate = 1.0;
+        LiveLatencyController *live_ctl = new LiveLatencyController();
+        live_ctl->Reset(m_dLiveTarget);
+        is->live_ctl = live_ctl;
+    }
+
+    // 拼接的分片流没有文件大小，无法估计时长，使用播放列表的总时长
+    if (is->hls_source && ic->duration == AV_NOPTS_VALUE && !is->hls_source->IsLive())
+        ic->duration = (int64_t)(is->hls_source->Duration() * AV_TIME_BASE);
 
     emit SigVideoTotalSeconds(ic->duration / 1000000LL);
 
@@ -1702,6 +2386,15 @@ void VideoCtl::ReadThread(VideoState *is)
         AVRational sar = av_guess_sample_aspect_ratio(ic, st, NULL);
     }
 
+    // 没有视频流时显示频谱/波形，需在音频回调开始前创建
+    if (st_index[AVMEDIA_TYPE_VIDEO] < 0 && st_index[AVMEDIA_TYPE_AUDIO] >= 0) {
+        is->visualizer = new AudioVisualizer();
+        if (!is->visualizer->Start()) {
+            delete is->visualizer;
+            is->visualizer = NULL;
+        }
+    }
+
     // 打开音频、视频和字幕流
     if (st_index[AVMEDIA_TYPE_AUDIO] >= 0) {
         stream_component_open(is, st_index[AVMEDIA_TYPE_AUDIO]);
@@ -1722,8 +2415,22 @@ void VideoCtl::ReadThread(VideoState *is)
         goto fail;
     }
 
-    if (infinite_buffer < 0 && is->realtime)
-        infinite_buffer = 1;
+    // 时移：接收任务把直播包写入磁盘上的分段环，读取线程改为从环中读包，暂停和跳转不影响接收
+    if (m_bTimeshift && is->realtime) {
+        TimeshiftBuffer *timeshift = new TimeshiftBuffer(m_pExecutor);
+        if (timeshift->Start(QDir::tempPath() + "/" + TIMESHIFT_DIR_NAME, ic, m_dTimeshiftWindow) < 0) {
+            av_log(NULL, AV_LOG_WARNING, "%s: failed to start timeshift\n", is->filename);
+            delete timeshift;
+        }
+        else {
+            is->timeshift = timeshift;
+        }
+    }
+
+    // 时移时包已缓冲在磁盘上，包队列按普通文件限制大小
+    if (is->infinite_buffer < 0 && is->realtime && !is->timeshift)
+        is->infinite_buffer = 1;
+    is->streams_opened = 1;
 
     // 主循环：读取数据包并将其存入队列
     for (;;) {
@@ -1731,10 +2438,13 @@ void VideoCtl::ReadThread(VideoState *is)
             break;
         if (is->paused != is->last_paused) {
             is->last_paused = is->paused;
-            if (is->paused)
-                is->read_pause_return = av_read_pause(ic);
-            else
-                av_read_play(ic);
+            // 时移时直播源由接收任务继续读取，不暂停
+            if (!is->timeshift) {
+                if (is->paused)
+                    is->read_pause_return = av_read_pause(ic);
+                else
+                    av_read_play(ic);
+            }
         }
 
         if (is->seek_req) {
@@ -1742,33 +2452,57 @@ void VideoCtl::ReadThread(VideoState *is)
             int64_t seek_min = is->seek_rel > 0 ? seek_target - is->seek_rel + 2 : INT64_MIN;
             int64_t seek_max = is->seek_rel < 0 ? seek_target - is->seek_rel - 2 : INT64_MAX;
 
-            ret = avformat_seek_file(is->ic, -1, seek_min, seek_target, seek_max, is->seek_flags);
+            if (is->timeshift) {
+                // 时移跳转到不晚于目标的关键帧，超出窗口时限制到窗口两端
+                ret = is->timeshift->Seek(seek_target / (double)AV_TIME_BASE);
+            }
+            else if (is->hls_source && !(is->seek_flags & AVSEEK_FLAG_BYTE)) {
+                // 分片流跳转到包含目标时间的分片开头，清空解复用器的状态后重新同步
+                double start = ic->start_time != AV_NOPTS_VALUE ? ic->start_time / (double)AV_TIME_BASE : 0;
+                int64_t offset = avio_seek(ic->pb, is->hls_source->SegmentOffset(seek_target / (double)AV_TIME_BASE - start), SEEK_SET);
+                ret = offset < 0 ? (int)offset : avformat_flush(ic);
+            }
+            else {
+                ret = avformat_seek_file(is->ic, -1, seek_min, seek_target, seek_max, is->seek_flags);
+            }
             if (ret < 0) {
                 av_log(NULL, AV_LOG_ERROR, "%s: error while seeking\n", is->ic->filename);
             }
             else {
+                // 倒放时先切换GOP缓存再更新序列号，新序列号下取到的都是新位置的帧
+                if (is->reverse_active && !(is->seek_flags & AVSEEK_FLAG_BYTE))
+                    is->gop_cache->Start(seek_target / (double)AV_TIME_BASE);
                 if (is->audio_stream >= 0) {
                     packet_queue_flush(&is->audioq);
-                    packet_queue_put(&is->audioq, &flush_pkt);
+                    packet_queue_put(&is->audioq, &is->flush_pkt);
                 }
                 if (is->subtitle_stream >= 0) {
                     packet_queue_flush(&is->subtitleq);
-                    packet_queue_put(&is->subtitleq, &flush_pkt);
+                    packet_queue_put(&is->subtitleq, &is->flush_pkt);
                 }
                 if (is->video_stream >= 0) {
                     packet_queue_flush(&is->videoq);
-                    packet_queue_put(&is->videoq, &flush_pkt);
+                    packet_queue_put(&is->videoq, &is->flush_pkt);
                 }
                 if (is->seek_flags & AVSEEK_FLAG_BYTE) {
                     set_clock(&is->extclk, NAN, 0);
                 }
                 else {
                     set_clock(&is->extclk, seek_target / (double)AV_TIME_BASE, 0);
+                    // 扫描中拖动进度条，从新位置继续扫描
+                    if (is->scan_active) {
+                        set_clock(&is->scanclk, seek_target / (double)AV_TIME_BASE, 0);
+                        is->scan_last_key = AV_NOPTS_VALUE;
+                    }
+                    // 倒放中拖动进度条，从新位置继续倒放
+                    if (is->reverse_active)
+                        set_clock(&is->scanclk, seek_target / (double)AV_TIME_BASE, 0);
                 }
             }
             is->seek_req = 0;
             is->queue_attachments_req = 1;
             is->eof = 0;
+            is->eos_state = EOS_STATE_NONE;
             if (is->paused)
                 step_to_next_frame(is);
         }
@@ -1783,30 +2517,59 @@ void VideoCtl::ReadThread(VideoState *is)
             is->queue_attachments_req = 0;
         }
 
+        // 关键帧快进/快退，代替正常读取
+        if (is->scan_speed != is->scan_active)
+            scan_switch(is, is->scan_speed);
+        if (is->scan_active) {
+            scan_step(is);
+            continue;
+        }
+
+        // 倒放：画面由视频线程从GOP缓存取出，读取线程只等待状态变化
+        if (is->reverse_req != is->reverse_active)
+            reverse_switch(is, is->reverse_req);
+        if (is->reverse_active) {
+            read_waker_wait(&is->continue_read, -1);
+            continue;
+        }
+
+        if (is->eos_state == EOS_STATE_ENDED) {
+            // 播放结束后挂起，直到跳转（循环播放）或退出
+            wait_for_end_action(is);
+            continue;
+        }
+
         /* if the queue are full, no need to read more */
-        if (infinite_buffer < 1 &&
+        queue_seconds = is->network ? NETWORK_QUEUE_SECONDS : 1.0;
+        if (is->infinite_buffer < 1 &&
                 (is->audioq.size + is->videoq.size + is->subtitleq.size > MAX_QUEUE_SIZE
-                 || (stream_has_enough_packets(is->audio_st, is->audio_stream, &is->audioq) &&
-                     stream_has_enough_packets(is->video_st, is->video_stream, &is->videoq) &&
-                     stream_has_enough_packets(is->subtitle_st, is->subtitle_stream, &is->subtitleq)))) {
-            /* wait 10 ms */
-            SDL_LockMutex(wait_mutex);
-            SDL_CondWaitTimeout(is->continue_read_thread, wait_mutex, 10);
-            SDL_UnlockMutex(wait_mutex);
+                 || (stream_has_enough_packets(is->audio_st, is->audio_stream, &is->audioq, queue_seconds) &&
+                     stream_has_enough_packets(is->video_st, is->video_stream, &is->videoq, queue_seconds) &&
+                     stream_has_enough_packets(is->subtitle_st, is->subtitle_stream, &is->subtitleq, queue_seconds)))) {
+            /* wait 10 ms（文件尾时由解码器排空通知唤醒） */
+            read_waker_wait(&is->continue_read, is->eof ? -1 : 10);
             continue;
         }
-        if (!is->paused &&
-                (!is->audio_st || (is->auddec.finished == is->audioq.serial && frame_queue_nb_remaining(&is->sampq) == 0)) &&
-                (!is->video_st || (is->viddec.finished == is->videoq.serial && frame_queue_nb_remaining(&is->pictq) == 0))) {
-
-            //播放结束
-            emit SigStop();
+        if (!is->paused && stream_drained(is)) {
+            //播放结束，只通知一次
+            is->eos_state = EOS_STATE_ENDED;
+            handle_play_end(is);
             continue;
         }
         //按帧读取
-        ret = av_read_frame(ic, pkt);
+        {
+            PROFILE_SCOPE(PROFILE_ZONE_READ_FRAME);
+            if (is->timeshift)
+                ret = is->timeshift->Read(pkt, TIMESHIFT_READ_WAIT_MS);
+            else
+                ret = av_read_frame(ic, pkt);
+        }
+        // 已读到直播的最新位置，Read 中已等待过
+        if (ret == AVERROR(EAGAIN) && is->timeshift)
+            continue;
         if (ret < 0) {
-            if ((ret == AVERROR_EOF || avio_feof(ic->pb)) && !is->eof) {
+            // 时移时 ic 由接收任务使用，是否结束只看缓冲返回的结果
+            if ((ret == AVERROR_EOF || (!is->timeshift && avio_feof(ic->pb))) && !is->eof) {
                 if (is->video_stream >= 0)
                     packet_queue_put_nullpacket(&is->videoq, is->video_stream);
                 if (is->audio_stream >= 0)
@@ -1814,25 +2577,29 @@ void VideoCtl::ReadThread(VideoState *is)
                 if (is->subtitle_stream >= 0)
                     packet_queue_put_nullpacket(&is->subtitleq, is->subtitle_stream);
                 is->eof = 1;
+                is->eos_state = EOS_STATE_DRAINING;
             }
-            if (ic->pb && ic->pb->error)
+            if (!is->timeshift && ic->pb && ic->pb->error)
                 break;
-            SDL_LockMutex(wait_mutex);
-            SDL_CondWaitTimeout(is->continue_read_thread, wait_mutex, 10);
-            SDL_UnlockMutex(wait_mutex);
+            // 文件尾：等待解码器排空/跳转/退出的通知，不再定时轮询
+            read_waker_wait(&is->continue_read, is->eof ? -1 : 10);
             continue;
         }
         else {
             is->eof = 0;
         }
         /* check if packet is in play range specified by user, then queue, otherwise discard */
-        stream_start_time = ic->streams[pkt->stream_index]->start_time;
+        stream_start_time = stream_at(is, pkt->stream_index)->start_time;
         pkt_ts = pkt->pts == AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
         pkt_in_play_range = AV_NOPTS_VALUE == AV_NOPTS_VALUE ||
                 (pkt_ts - (stream_start_time != AV_NOPTS_VALUE ? stream_start_time : 0)) *
-                av_q2d(ic->streams[pkt->stream_index]->time_base) -
+                av_q2d(stream_at(is, pkt->stream_index)->time_base) -
                 (double)(0) / 1000000
                 <= ((double)AV_NOPTS_VALUE / 1000000);
+        // 直播延迟以参考流（有音频时为音频）最新收到的包为准
+        if (is->live_ctl && pkt_ts != AV_NOPTS_VALUE &&
+                pkt->stream_index == (is->audio_stream >= 0 ? is->audio_stream : is->video_stream))
+            is->live_recv_pts = pkt_ts * av_q2d(stream_at(is, pkt->stream_index)->time_base);
         //按数据帧的类型存放至对应队列
         if (pkt->stream_index == is->audio_stream && pkt_in_play_range) {
             packet_queue_put(&is->audioq, pkt);
@@ -1854,15 +2621,380 @@ fail:
     if (ic && !is->ic)
         avformat_close_input(&ic);
 
-    if (ret != 0) {
-        SDL_Event event;
+    // 打开失败时结束本实例的事件循环
+    if (ret != 0)
+        m_bPlayLoop = false;
+    return ;
+}
 
-        event.type = FF_QUIT_EVENT;
-        event.user.data1 = is;
-        SDL_PushEvent(&event);
+/* 进入/退出关键帧扫描或改变扫描倍率，在读取线程中调用 */
+void VideoCtl::scan_switch(VideoState *is, int speed)
+{
+    if (speed && !is->scan_active) {
+        // 从当前播放位置开始扫描，丢弃已缓冲的音频和字幕
+        double pos = get_master_clock(is) * pf_playback_rate;
+        if (std::isnan(pos))
+            pos = (double)is->seek_pos / AV_TIME_BASE;
+        if (is->audio_stream >= 0) {
+            packet_queue_flush(&is->audioq);
+            packet_queue_put(&is->audioq, &is->flush_pkt);
+        }
+        if (is->subtitle_stream >= 0) {
+            packet_queue_flush(&is->subtitleq);
+            packet_queue_put(&is->subtitleq, &is->flush_pkt);
+        }
+        set_clock(&is->scanclk, pos, 0);
+        is->scan_last_key = AV_NOPTS_VALUE;
+        is->eof = 0;
+        is->eos_state = EOS_STATE_NONE;
+        av_log(NULL, AV_LOG_VERBOSE, "scan %dx from %.3f\n", speed, pos);
+    }
+
+    if (speed) {
+        set_clock_speed(&is->scanclk, speed);
+    } else if (is->scan_active) {
+        // 从扫描到的位置恢复正常播放
+        double pos = get_clock(&is->scanclk);
+        set_clock_speed(&is->scanclk, 1.0);
+        is->seek_pos = (int64_t)(pos * AV_TIME_BASE);
+        is->seek_rel = 0;
+        is->seek_flags &= ~AVSEEK_FLAG_BYTE;
+        is->seek_req = 1;
+        av_log(NULL, AV_LOG_VERBOSE, "scan stopped at %.3f\n", pos);
+    }
+    is->scan_active = speed;
+}
+
+/* 进入/退出倒放，在读取线程中调用 */
+void VideoCtl::reverse_switch(VideoState *is, int reverse)
+{
+    if (reverse) {
+        // 从当前画面的位置开始倒放
+        double pos = is->vidclk.pts * pf_playback_rate;
+        if (std::isnan(pos))
+            pos = get_master_clock(is) * pf_playback_rate;
+        if (std::isnan(pos))
+            pos = (double)is->seek_pos / AV_TIME_BASE;
+
+        if (!is->gop_cache) {
+            is->gop_cache = new GopCache(m_pExecutor);
+            if (is->gop_cache->Open(is->filename, is->video_stream) < 0) {
+                av_log(NULL, AV_LOG_ERROR, "%s: cannot open video for reverse playback\n", is->filename);
+                delete is->gop_cache;
+                is->gop_cache = NULL;
+                is->reverse_req = 0;
+                is->reverse_step_req = 0;
+                emit SigReverse(false);
+                return;
+            }
+        }
+        is->gop_cache->Start(pos);
+        set_clock(&is->scanclk, pos, 0);
+        set_clock_speed(&is->scanclk, -1.0);
+        // 先置标志再送空包，视频线程退出解码器后直接转为从GOP缓存取帧
+        is->reverse_active = 1;
+
+        // 丢弃已缓冲的数据
+        if (is->audio_stream >= 0) {
+            packet_queue_flush(&is->audioq);
+            packet_queue_put(&is->audioq, &is->flush_pkt);
+        }
+        if (is->subtitle_stream >= 0) {
+            packet_queue_flush(&is->subtitleq);
+            packet_queue_put(&is->subtitleq, &is->flush_pkt);
+        }
+        packet_queue_flush(&is->videoq);
+        packet_queue_put(&is->videoq, &is->flush_pkt);
+        packet_queue_put_nullpacket(&is->videoq, is->video_stream);
+
+        is->eof = 0;
+        is->eos_state = EOS_STATE_NONE;
+        if (is->reverse_step_req) {
+            is->reverse_step_req = 0;
+            step_to_next_frame(is);
+        }
+        av_log(NULL, AV_LOG_VERBOSE, "reverse playback from %.3f\n", pos);
+    } else {
+        // 从当前倒放到的位置恢复正常播放
+        double pos = get_clock(&is->scanclk);
+        is->reverse_active = 0;
+        is->gop_cache->Stop();
+        set_clock_speed(&is->scanclk, 1.0);
+        is->seek_pos = (int64_t)(pos * AV_TIME_BASE);
+        is->seek_rel = 0;
+        is->seek_flags &= ~AVSEEK_FLAG_BYTE;
+        is->seek_req = 1;
+        av_log(NULL, AV_LOG_VERBOSE, "reverse playback stopped at %.3f\n", pos);
+    }
+}
+
+/* 倒放时视频线程从GOP缓存取出一帧送入帧队列，返回 <0 表示退出 */
+int VideoCtl::reverse_output(VideoState *is, AVFrame *frame, AVRational frame_rate)
+{
+    int serial = is->videoq.serial;
+    double duration = (frame_rate.num && frame_rate.den ? av_q2d({ frame_rate.den, frame_rate.num }) : 0);
+    int ret;
+
+    if (is->videoq.abort_request)
+        return -1;
+
+    ret = is->gop_cache->Take(frame, 10);
+    if (ret == AVERROR_EOF) {
+        // 倒放到文件开头，恢复正常播放
+        if (is->reverse_req) {
+            is->reverse_req = 0;
+            read_waker_signal(&is->continue_read);
+            emit SigReverse(false);
+        }
+        m_pTimeSource->Sleep(10000);
+        return 0;
+    }
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "reverse playback: gop decode failed\n");
+        if (is->reverse_req) {
+            is->reverse_req = 0;
+            read_waker_signal(&is->continue_read);
+            emit SigReverse(false);
+        }
+        m_pTimeSource->Sleep(10000);
+        return 0;
+    }
+    if (ret == 0)
+        return 0;
+
+    ret = queue_picture(is, frame, frame->pts / (double)AV_TIME_BASE, duration, frame->pkt_pos, serial);
+    av_frame_unref(frame);
+    return ret;
+}
+
+/* 请求从历史帧的指定位置开始播放，历史中没有该位置时返回 false。
+ * 音频历史也包含该位置时音频一起重放；播放中后退要求音频能重放，否则后退期间没有声音，
+ * 后退一帧时音频本来就暂停，音频历史不够也可以只重放视频 */
+bool VideoCtl::history_seek(VideoState *is, double pos, bool step)
+{
+    if (!is->frame_history || std::isnan(pos) || is->scan_active || is->reverse_active ||
+            is->scan_speed || is->reverse_req || is->seek_req)
+        return false;
+    if (!is->frame_history->Covers(pos, is->videoq.serial))
+        return false;
+    bool audio = is->audio_st && is->audio_history_frame.frame &&
+            is->audio_history->Covers(pos, is->audioq.serial);
+    if (!step && is->audio_st && !audio)
+        return false;
+
+    is->history_target = pos;
+    is->history_req = 1;
+    if (audio)
+        is->audio_history_req = 1;
+    if (step)
+        step_to_next_frame(is);
+    return true;
+}
+
+/* 视频线程切换到历史帧：记下帧队列中要丢弃的较新的帧，时钟从目标帧开始走 */
+void VideoCtl::history_start(VideoState *is)
+{
+    PROFILE_MUTEX_LOCK(is->pictq.mutex, PROFILE_LOCK_FRAME_QUEUE);
+    is->history_skip = frame_queue_nb_remaining(&is->pictq);
+    is->history_serial = is->videoq.serial;
+    is->history_next = is->frame_history->PtsAtOrBefore(is->history_target);
+    if (std::isnan(is->history_next) || is->viddec.pkt_serial != is->history_serial) {
+        // 请求之后发生了 seek，历史已失效
+        is->history_skip = 0;
+        is->history_req = 0;
+        PROFILE_MUTEX_UNLOCK(is->pictq.mutex, PROFILE_LOCK_FRAME_QUEUE);
+        return;
+    }
+    set_clock(&is->scanclk, is->history_next, 0);
+    set_clock_speed(&is->scanclk, pf_playback_rate);
+    is->history_active = 1;
+    is->history_req = 0;
+    PROFILE_MUTEX_UNLOCK(is->pictq.mutex, PROFILE_LOCK_FRAME_QUEUE);
+}
+
+/* 输出一个历史帧，追上解码位置后恢复解码，返回 <0 表示退出 */
+int VideoCtl::history_output(VideoState *is, AVFrame *frame)
+{
+    double pts, duration;
+    int ret;
+
+    if (is->videoq.abort_request)
+        return -1;
+
+    if (is->history_serial != is->videoq.serial) {
+        // 播放中 seek，放弃重放，由解码器处理刷新包
+        PROFILE_MUTEX_LOCK(is->pictq.mutex, PROFILE_LOCK_FRAME_QUEUE);
+        is->history_skip = 0;
+        is->history_active = 0;
+        PROFILE_MUTEX_UNLOCK(is->pictq.mutex, PROFILE_LOCK_FRAME_QUEUE);
+        return 0;
+    }
+
+    // 帧队列满时不阻塞等待，以便暂停中再次后退时能及时切换
+    if (is->pictq.size >= is->pictq.max_size) {
+        m_pTimeSource->Sleep(5000);
+        return 0;
+    }
+
+    ret = is->frame_history->Get(is->history_next, frame, &pts, &duration);
+    if (ret <= 0) {
+        // 已输出到最新解码的帧，解码器从原来的位置继续
+        is->history_active = 0;
+        return 0;
+    }
+    is->history_next = pts + 0.0005;
+
+    ret = queue_picture(is, frame, pts, duration, frame->pkt_pos, is->history_serial);
+    av_frame_unref(frame);
+    return ret;
+}
+
+/* 音频回调切换到历史帧，请求之后发生了 seek 时放弃 */
+void VideoCtl::audio_history_start(VideoState *is)
+{
+    double pos = is->history_target;
+
+    is->audio_history_req = 0;
+    is->audio_history_serial = is->audioq.serial;
+    is->audio_history_next = is->audio_history->PtsAtOrBefore(pos);
+    is->audio_history_active = !std::isnan(is->audio_history_next) &&
+            is->audio_history->Covers(pos, is->audio_history_serial);
+}
+
+/* 取出下一个历史音频帧，已输出到最后播放的帧或播放中 seek 时返回 NULL，回到 sampq */
+Frame *VideoCtl::audio_history_output(VideoState *is)
+{
+    Frame *af = &is->audio_history_frame;
+    double pts, duration;
+
+    // 调用时上一帧的数据已经输出完毕
+    av_frame_unref(af->frame);
+    if (is->audio_history_serial != is->audioq.serial ||
+            is->audio_history->Get(is->audio_history_next, af->frame, &pts, &duration) <= 0) {
+        is->audio_history_active = 0;
+        return NULL;
+    }
+    is->audio_history_next = pts + duration / 2;
+    af->pts = pts;
+    af->duration = duration;
+    af->serial = is->audio_history_serial;
+    return af;
+}
+
+/* 扫描一步：按扫描时钟定位不晚于当前位置的关键帧，只把这一个关键帧送给解码器。
+ * 每 SCAN_FRAME_INTERVAL 最多一次跳转和读取，开销与扫描倍率无关 */
+void VideoCtl::scan_step(VideoState *is)
+{
+    AVFormatContext *ic = is->ic;
+    AVStream *st = is->video_st;
+    AVPacket pkt1, *pkt = &pkt1;
+    int64_t start_time = ic->start_time != AV_NOPTS_VALUE ? ic->start_time : 0;
+    int64_t pos_us, target, key_ts;
+    int speed = is->scan_active;
+    int found = 0, i, ret;
+
+    // 暂停时扫描时钟不走，不需要读取
+    if (is->paused) {
+        read_waker_wait(&is->continue_read, SCAN_FRAME_INTERVAL);
+        return;
+    }
+
+    pos_us = (int64_t)(get_clock(&is->scanclk) * AV_TIME_BASE);
+    // 扫描到文件头/尾时恢复正常播放
+    if (pos_us <= start_time ||
+            (ic->duration != AV_NOPTS_VALUE && pos_us >= start_time + ic->duration)) {
+        pos_us = av_clip64(pos_us, start_time, ic->duration != AV_NOPTS_VALUE ? start_time + ic->duration : pos_us);
+        set_clock(&is->scanclk, pos_us / (double)AV_TIME_BASE, 0);
+        is->scan_speed = 0;
+        scan_switch(is, 0);
+        emit SigScan(0);
+        return;
+    }
+
+    target = av_rescale_q(pos_us, AV_TIME_BASE_Q, st->time_base);
+    // 有索引时先查关键帧，仍是正在显示的关键帧则不必读取
+    key_ts = index_keyframe_before(st, target);
+    if (key_ts != AV_NOPTS_VALUE && key_ts == is->scan_last_key) {
+        read_waker_wait(&is->continue_read, SCAN_FRAME_INTERVAL);
+        return;
+    }
+    if (key_ts != AV_NOPTS_VALUE)
+        target = key_ts;
+
+    ret = avformat_seek_file(ic, is->video_stream, INT64_MIN, target, target, 0);
+    for (i = 0; ret >= 0 && i < SCAN_MAX_READ_PACKETS && !is->abort_request; i++) {
+        if (av_read_frame(ic, pkt) < 0)
+            break;
+        if (pkt->stream_index == is->video_stream && (pkt->flags & AV_PKT_FLAG_KEY)) {
+            found = 1;
+            break;
+        }
+        av_packet_unref(pkt);
+    }
+
+    if (found) {
+        int64_t pkt_ts = pkt->pts == AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+        if (pkt_ts != is->scan_last_key) {
+            // 每个关键帧单独成一段：冲刷解码器、送入关键帧、再送空包取出画面
+            packet_queue_flush(&is->videoq);
+            packet_queue_put(&is->videoq, &is->flush_pkt);
+            packet_queue_put(&is->videoq, pkt);
+            packet_queue_put_nullpacket(&is->videoq, is->video_stream);
+            is->scan_last_key = pkt_ts;
+        } else {
+            av_packet_unref(pkt);
+        }
+    } else if (speed > 0 && ic->pb && avio_feof(ic->pb)) {
+        // 快进到最后一个关键帧之后，恢复正常播放直到文件结束
+        is->scan_speed = 0;
+        scan_switch(is, 0);
+        emit SigScan(0);
+        return;
+    }
+
+    read_waker_wait(&is->continue_read, SCAN_FRAME_INTERVAL);
+}
+
+/* 解码器是否都已排空（所有帧都已送显/播放） */
+int VideoCtl::stream_drained(VideoState *is)
+{
+    return (!is->audio_st || (is->auddec.finished == is->audioq.serial && frame_queue_nb_remaining(&is->sampq) == 0)) &&
+           (!is->video_st || (is->viddec.finished == is->videoq.serial && frame_queue_nb_remaining(&is->pictq) == 0));
+}
+
+/* 播放结束后挂起读取线程，直到有跳转请求或退出 */
+void VideoCtl::wait_for_end_action(VideoState *is)
+{
+    while (is->eos_state == EOS_STATE_ENDED && !is->abort_request && !is->seek_req)
+        read_waker_wait(&is->continue_read, -1);
+}
+
+/* 播放结束：发出完成事件并执行结束动作 */
+void VideoCtl::handle_play_end(VideoState *is)
+{
+    double latency = 0.0;
+    int64_t start_time;
+
+    if (is->last_present_time)
+        latency = (time_now() - is->last_present_time) / 1000.0;
+    av_log(NULL, AV_LOG_INFO, "Play end: %.1f ms from last frame to end action %d\n", latency, m_nPlayEndAction);
+
+    emit SigPlayEnd(latency);
+
+    switch (m_nPlayEndAction) {
+    case PLAY_END_LOOP:
+        // 回到开头重新播放，读取线程由跳转请求唤醒
+        start_time = is->ic->start_time != AV_NOPTS_VALUE ? is->ic->start_time : 0;
+        stream_seek(is, start_time, 0);
+        break;
+    case PLAY_END_NEXT:
+        // 由播放列表切换到下一个（StartPlay 会关闭当前流）
+        emit SigPlayNext();
+        break;
+    default:
+        OnStop();
+        break;
     }
-    SDL_DestroyMutex(wait_mutex);
-    return ;
 }
 
 VideoState* VideoCtl::stream_open(const char *filename)
@@ -1872,6 +3004,7 @@ VideoState* VideoCtl::stream_open(const char *filename)
     is = (VideoState *)av_mallocz(sizeof(VideoState));
     if (!is)
         return NULL;
+    is->ctl = this;
     // 复制文件名
     is->filename = av_strdup(filename);
     if (!is->filename)
@@ -1892,21 +3025,55 @@ VideoState* VideoCtl::stream_open(const char *filename)
     if (frame_queue_init(&is->sampq, &is->audioq, SAMPLE_QUEUE_SIZE, 1) < 0)
         goto fail;
     // 初始化数据包队列
-    if (packet_queue_init(&is->videoq) < 0 ||
-            packet_queue_init(&is->audioq) < 0 ||
-            packet_queue_init(&is->subtitleq) < 0)
+    // 初始化本实例的刷新包，用于识别seek后的新序列
+    av_init_packet(&is->flush_pkt);
+    is->flush_pkt.data = (uint8_t *)&is->flush_pkt;
+
+    // 初始化数据包队列
+    if (packet_queue_init(&is->videoq, &is->flush_pkt) < 0 ||
+            packet_queue_init(&is->audioq, &is->flush_pkt) < 0 ||
+            packet_queue_init(&is->subtitleq, &is->flush_pkt) < 0)
         goto fail;
+    is->infinite_buffer = infinite_buffer;
 
-    // 创建继续读取线程的条件变量
-    if (!(is->continue_read_thread = SDL_CreateCond())) {
-        av_log(NULL, AV_LOG_FATAL, "SDL_CreateCond(): %s\n", SDL_GetError());
+    // 创建读取线程唤醒器
+    if (read_waker_init(&is->continue_read) < 0)
         goto fail;
+    is->eos_state = EOS_STATE_NONE;
+
+    // 响度标准化：有缓存时直接使用文件增益，否则后台分析，分析完成前使用实时估计
+    is->loudness_gain = 1.0f;
+    is->loudness_cur_gain = 1.0f;
+    if (m_bLoudnessNorm) {
+        LoudnessInfo info;
+        QString strFile = QString::fromLocal8Bit(is->filename);
+        if (LoudnessAnalyzer::Lookup(strFile, info)) {
+            is->loudness_gain = LoudnessMeter::NormalizeGain(info.integrated, info.true_peak);
+            is->loudness_known = true;
+        } else if (QFileInfo(strFile).isFile()) {
+            is->loudness_task = m_pExecutor->Submit(TASK_LANE_BACKGROUND, [is, strFile] {
+                LoudnessInfo info;
+                AVIOInterruptCB interrupt = { decode_interrupt_cb, is };
+                if (LoudnessAnalyzer::Analyze(is->filename, &info, &interrupt) == 0) {
+                    LoudnessAnalyzer::Save(strFile, info);
+                    is->loudness_gain = LoudnessMeter::NormalizeGain(info.integrated, info.true_peak);
+                    is->loudness_known = true;
+                }
+            });
+        }
     }
 
+    // 后台查找并加载外挂字幕
+    is->sidecar_subs = new SubtitleStore();
+    is->sidecar_task = m_pExecutor->Submit(TASK_LANE_BACKGROUND, [is] {
+        is->sidecar_subs->LoadSidecar(QString::fromLocal8Bit(is->filename));
+    });
+
     // 初始化时钟
     init_clock(&is->vidclk, &is->videoq.serial);
     init_clock(&is->audclk, &is->audioq.serial);
     init_clock(&is->extclk, &is->extclk.serial);
+    init_clock(&is->scanclk, &is->scanclk.serial);
     is->audio_clock_serial = -1;
 
     // 设置音量
@@ -1924,7 +3091,8 @@ VideoState* VideoCtl::stream_open(const char *filename)
     is->av_sync_type = AV_SYNC_AUDIO_MASTER;
 
     // 创建并启动读取线程
-    is->read_tid = std::thread(&VideoCtl::ReadThread, this, is);
+    // 解复用为所有解码器供数据，放在最高优先级的音频通道
+    is->read_task = m_pExecutor->Submit(TASK_LANE_AUDIO, [this, is] { ReadThread(is); }, true);
 
     return is;
 
@@ -1940,7 +3108,7 @@ void VideoCtl::stream_cycle_channel(VideoState *is, int codec_type)
     int old_index;
     AVStream *st;
     AVProgram *p = NULL;
-    int nb_streams = is->ic->nb_streams;
+    int nb_streams = stream_count(is);
 
     // 根据传入的 codec_type 确定流的开始索引和旧索引
     if (codec_type == AVMEDIA_TYPE_VIDEO) {
@@ -1957,8 +3125,8 @@ void VideoCtl::stream_cycle_channel(VideoState *is, int codec_type)
     }
     stream_index = start_index;
 
-    // 检查是否需要更新流的起始索引
-    if (codec_type != AVMEDIA_TYPE_VIDEO && is->video_stream != -1) {
+    // 检查是否需要更新流的起始索引；时移时 ic->programs 可能被接收任务重新分配，不按节目查找
+    if (codec_type != AVMEDIA_TYPE_VIDEO && is->video_stream != -1 && !is->timeshift) {
         p = av_find_program_from_stream(ic, NULL, is->video_stream);
         if (p) {
             nb_streams = p->nb_stream_indexes;
@@ -1987,7 +3155,7 @@ void VideoCtl::stream_cycle_channel(VideoState *is, int codec_type)
         }
         if (stream_index == start_index)
             return;
-        st = is->ic->streams[p ? p->stream_index[stream_index] : stream_index];
+        st = stream_at(is, p ? p->stream_index[stream_index] : stream_index);
         if (st->codecpar->codec_type == codec_type) {
             /* check that parameters are OK */
             switch (codec_type) {
@@ -2020,10 +3188,10 @@ the_end:
 void VideoCtl::refresh_loop_wait_event(VideoState *is, SDL_Event *event) {
     double remaining_time = 0.0;
     SDL_PumpEvents();
-    while (!SDL_PeepEvents(event, 1, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT) && m_bPlayLoop)
+    while (!peek_own_event(event) && m_bPlayLoop)
     {
         if (remaining_time > 0.0)
-            av_usleep((int64_t)(remaining_time * 1000000.0));
+            m_pTimeSource->Sleep((int64_t)(remaining_time * 1000000.0));
         remaining_time = REFRESH_RATE;
         if (!is->paused || is->force_refresh)
             video_refresh(is, &remaining_time);
@@ -2031,6 +3199,39 @@ void VideoCtl::refresh_loop_wait_event(VideoState *is, SDL_Event *event) {
     }
 }
 
+/* 取出属于本实例的事件，其它播放引擎窗口的事件留在队列中由其所属实例处理 */
+int VideoCtl::peek_own_event(SDL_Event *event)
+{
+    if (SDL_PeepEvents(event, 1, SDL_PEEKEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT) <= 0)
+        return 0;
+
+    Uint32 window_id = 0;
+    switch (event->type) {
+    case SDL_WINDOWEVENT:
+        window_id = event->window.windowID;
+        break;
+    case SDL_KEYDOWN:
+    case SDL_KEYUP:
+        window_id = event->key.windowID;
+        break;
+    case SDL_QUIT:
+        // 退出事件由各实例的停止流程处理，这里直接丢弃
+        SDL_PeepEvents(event, 1, SDL_GETEVENT, SDL_QUIT, SDL_QUIT);
+        return 0;
+    default:
+        break;
+    }
+
+    if (window_id) {
+        SDL_Window *owner_window = SDL_GetWindowFromID(window_id);
+        void *owner = owner_window ? SDL_GetWindowData(owner_window, VIDEOCTL_WINDOW_DATA) : NULL;
+        if (owner && owner != this)
+            return 0;
+    }
+
+    return SDL_PeepEvents(event, 1, SDL_GETEVENT, event->type, event->type) > 0;
+}
+
 // 跳转到指定章节
 void VideoCtl::seek_chapter(VideoState *is, int incr)
 {
@@ -2072,8 +3273,7 @@ void VideoCtl::LoopThread(VideoState *cur_stream)
     SDL_Event event;
     double incr, pos, frac;
 
-    m_bPlayLoop = true; // 标记播放循环状态为真
-
+    // 播放循环标志在 StartPlay 中打开流之前置位，读取线程打开失败时已经清除，这里不能再覆盖
     while (m_bPlayLoop)
     {
         double x;
@@ -2116,10 +3316,6 @@ void VideoCtl::LoopThread(VideoState *cur_stream)
                 break;
             }
             break;
-        case SDL_QUIT: // 处理退出事件
-        case FF_QUIT_EVENT:
-            do_exit(cur_stream);
-            break;
         default:
             break;
         }
@@ -2163,10 +3359,24 @@ void VideoCtl::OnPlaySeek(double dPercent)
     {
         return;
     }
-    // 计算目标时间戳
-    int64_t ts = dPercent * m_CurStream->ic->duration;
-    if (m_CurStream->ic->start_time != AV_NOPTS_VALUE)
-        ts += m_CurStream->ic->start_time;
+    // 计算目标时间戳，时移时进度条对应时移窗口
+    int64_t ts;
+    if (m_CurStream->timeshift)
+    {
+        double dStart = m_CurStream->timeshift->StartTime();
+        double dLive = m_CurStream->timeshift->LiveTime();
+        if (std::isnan(dStart) || std::isnan(dLive))
+        {
+            return;
+        }
+        ts = (int64_t)((dStart + dPercent * (dLive - dStart)) * AV_TIME_BASE);
+    }
+    else
+    {
+        ts = dPercent * m_CurStream->ic->duration;
+        if (m_CurStream->ic->start_time != AV_NOPTS_VALUE)
+            ts += m_CurStream->ic->start_time;
+    }
     // 跳转到指定位置
     stream_seek(m_CurStream, ts, 0);
 }
@@ -2208,6 +3418,12 @@ void VideoCtl::OnSeekBack()
         return;
     }
     double incr = -5.0; // 跳转增量（秒）
+    // 目标位置还在历史帧范围内时视频和音频直接重放，不需要跳转和重新解码
+    double cur = m_CurStream->vidclk.pts * pf_playback_rate;
+    if (!std::isnan(cur) && history_seek(m_CurStream, cur + incr, false))
+    {
+        return;
+    }
     double pos = get_master_clock(m_CurStream);
     if (std::isnan(pos))
         pos = (double)m_CurStream->seek_pos / AV_TIME_BASE;
@@ -2238,6 +3454,15 @@ void VideoCtl::UpdateVolume(int sign, double step)
 /* 显示当前图像（如果有的话） */
 void VideoCtl::video_display(VideoState *is)
 {
+    // 同步回放不输出画面，只记录送显
+    if (m_bSyncReplay) {
+        if (is->video_st && m_stSyncTrace.IsEnabled()) {
+            Frame *vp = frame_queue_peek_last(&is->pictq);
+            m_stSyncTrace.Record(SYNC_TRACE_VIDEO_PRESENT, vp->serial, vp->pts, is->frame_timer);
+        }
+        return;
+    }
+
     // 如果窗口未创建，创建窗口
     if (!window)
         video_open(is);
@@ -2245,19 +3470,30 @@ void VideoCtl::video_display(VideoState *is)
     if (renderer)
     {
         // 如果显示控件的大小正在变化，则不刷新显示
-        if (g_show_rect_mutex.tryLock())
+        if (!m_pShowRectMutex || m_pShowRectMutex->tryLock())
         {
             // 设置渲染器的绘制颜色为黑色
             SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
             // 清除当前渲染器的显示
             SDL_RenderClear(renderer);
-            // 显示视频图像
-            video_image_display(is);
+            // 显示视频图像，纯音频时显示频谱/波形
+            if (is->video_st)
+                video_image_display(is);
+            else if (is->visualizer)
+                video_audio_display(is);
             // 显示渲染的图像
-            SDL_RenderPresent(renderer);
+            {
+                PROFILE_SCOPE(PROFILE_ZONE_RENDER_PRESENT);
+                SDL_RenderPresent(renderer);
+            }
+            if (is->video_st && m_stSyncTrace.IsEnabled()) {
+                Frame *vp = frame_queue_peek_last(&is->pictq);
+                m_stSyncTrace.Record(SYNC_TRACE_VIDEO_PRESENT, vp->serial, vp->pts, is->frame_timer);
+            }
 
             // 解锁互斥锁
-            g_show_rect_mutex.unlock();
+            if (m_pShowRectMutex)
+                m_pShowRectMutex->unlock();
         }
     }
 }
@@ -2277,6 +3513,9 @@ int VideoCtl::video_open(VideoState *is)
 
         // 从现有窗口句柄创建窗口
         window = SDL_CreateWindowFrom((void *)play_wid);
+        // 记录窗口所属的播放引擎，事件循环据此过滤其它实例的事件
+        if (window)
+            SDL_SetWindowData(window, VIDEOCTL_WINDOW_DATA, this);
         SDL_GetWindowSize(window, &w, &h); // 获取窗口的宽高
         SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear"); // 设置渲染缩放质量
         if (window) {
@@ -2334,6 +3573,7 @@ void VideoCtl::do_exit(VideoState* &is)
     {
         // 销毁窗口
         // SDL_DestroyWindow(window);
+        SDL_SetWindowData(window, VIDEOCTL_WINDOW_DATA, NULL);
         window = nullptr;
     }
 
@@ -2383,6 +3623,196 @@ void VideoCtl::OnStop()
     m_bPlayLoop = false;
 }
 
+/* 设置播放结束后的动作 */
+void VideoCtl::SetPlayEndAction(int nAction)
+{
+    m_nPlayEndAction = av_clip(nAction, PLAY_END_STOP, PLAY_END_NEXT);
+}
+
+/* 获取播放结束后的动作 */
+int VideoCtl::GetPlayEndAction()
+{
+    return m_nPlayEndAction;
+}
+
+/* 设置响度标准化，增益立即生效，分析从下一个文件开始 */
+void VideoCtl::SetLoudnessNormalization(bool bEnable)
+{
+    m_bLoudnessNorm = bEnable;
+}
+
+bool VideoCtl::GetLoudnessNormalization()
+{
+    return m_bLoudnessNorm;
+}
+
+/* 设置本地文件的读取方式，打开文件时生效 */
+void VideoCtl::SetMmapIO(bool bEnable)
+{
+    m_bMmapIO = bEnable;
+}
+
+bool VideoCtl::GetMmapIO()
+{
+    return m_bMmapIO;
+}
+
+/* 设置慢速存储上的文件是否异步预读，打开文件时生效 */
+void VideoCtl::SetPrefetchIO(bool bEnable)
+{
+    m_bPrefetchIO = bEnable;
+}
+
+bool VideoCtl::GetPrefetchIO()
+{
+    return m_bPrefetchIO;
+}
+
+/* 设置 HLS 是否使用分片预取，打开文件时生效 */
+void VideoCtl::SetHlsSource(bool bEnable)
+{
+    m_bHlsSource = bEnable;
+}
+
+bool VideoCtl::GetHlsSource()
+{
+    return m_bHlsSource;
+}
+
+/* 设置 HLS 的缓冲目标，打开文件时生效 */
+void VideoCtl::SetNetworkBuffer(double dSeconds)
+{
+    m_dNetworkBuffer = av_clipd(dSeconds, NETWORK_QUEUE_SECONDS, 600.0);
+}
+
+double VideoCtl::GetNetworkBuffer()
+{
+    return m_dNetworkBuffer;
+}
+
+/* 当前 HLS 流的下载统计 */
+bool VideoCtl::GetHlsStats(HlsStats &stats)
+{
+    if (m_CurStream == nullptr || m_CurStream->hls_source == nullptr)
+    {
+        return false;
+    }
+    stats = m_CurStream->hls_source->Stats();
+    return true;
+}
+
+/* 设置直播模式，打开文件时生效 */
+void VideoCtl::SetLiveMode(bool bEnable)
+{
+    m_bLiveMode = bEnable;
+}
+
+bool VideoCtl::GetLiveMode()
+{
+    return m_bLiveMode;
+}
+
+/* 设置直播目标延迟，打开文件时生效 */
+void VideoCtl::SetLiveTargetLatency(double dSeconds)
+{
+    m_dLiveTarget = av_clipd(dSeconds, 0.2, 30.0);
+}
+
+double VideoCtl::GetLiveTargetLatency()
+{
+    return m_dLiveTarget;
+}
+
+/* 当前直播流的延迟统计 */
+bool VideoCtl::GetLiveLatencyStats(LiveLatencyStats &stats)
+{
+    if (m_CurStream == nullptr || m_CurStream->live_ctl == nullptr)
+    {
+        return false;
+    }
+    stats = m_CurStream->live_ctl->Stats();
+    return true;
+}
+
+/* 设置直播时移，打开文件时生效 */
+void VideoCtl::SetTimeshift(bool bEnable)
+{
+    m_bTimeshift = bEnable;
+}
+
+bool VideoCtl::GetTimeshift()
+{
+    return m_bTimeshift;
+}
+
+/* 设置时移窗口，打开文件时生效 */
+void VideoCtl::SetTimeshiftWindow(double dSeconds)
+{
+    m_dTimeshiftWindow = av_clipd(dSeconds, 60.0, 24 * 3600.0);
+}
+
+double VideoCtl::GetTimeshiftWindow()
+{
+    return m_dTimeshiftWindow;
+}
+
+/* 当前直播流的时移状态 */
+bool VideoCtl::GetTimeshiftStats(TimeshiftStats &stats)
+{
+    if (m_CurStream == nullptr || m_CurStream->timeshift == nullptr)
+    {
+        return false;
+    }
+    stats = m_CurStream->timeshift->Stats();
+    return true;
+}
+
+// 时移时跳到最新的关键帧
+void VideoCtl::OnTimeshiftLive()
+{
+    if (m_CurStream == nullptr || m_CurStream->timeshift == nullptr)
+    {
+        return;
+    }
+    double dLive = m_CurStream->timeshift->LiveTime();
+    if (!std::isnan(dLive))
+    {
+        stream_seek(m_CurStream, (int64_t)(dLive * AV_TIME_BASE), 0);
+    }
+}
+
+/* 设置重采样质量，音频回调取帧时检查并切换 */
+void VideoCtl::SetResamplerMode(int nMode)
+{
+    m_nResamplerMode = av_clip(nMode, RESAMPLER_MODE_AUTO, RESAMPLER_MODE_HIGH);
+}
+
+int VideoCtl::GetResamplerMode()
+{
+    return m_nResamplerMode;
+}
+
+// 开始/停止同步跟踪
+bool VideoCtl::SetSyncTrace(bool bEnable)
+{
+    if (!bEnable)
+    {
+        m_stSyncTrace.Stop();
+        return true;
+    }
+    return m_stSyncTrace.Start();
+}
+
+bool VideoCtl::GetSyncTrace()
+{
+    return m_stSyncTrace.IsEnabled();
+}
+
+int VideoCtl::ExportSyncTrace(const QString &strFile)
+{
+    return m_stSyncTrace.Export(strFile);
+}
+
 /* 构造函数，初始化类成员变量 */
 VideoCtl::VideoCtl(QObject *parent) :
     QObject(parent),
@@ -2398,7 +3828,26 @@ VideoCtl::VideoCtl(QObject *parent) :
     m_nFrameH(0),
     pf_playback_rate(1.0),
     pf_playback_rate_changed(0),
-    audio_speed_convert(NULL)
+    m_nPlayEndAction(PLAY_END_STOP),
+    m_bLoudnessNorm(false),
+    m_bMmapIO(true),
+    m_bPrefetchIO(true),
+    m_bHlsSource(true),
+    m_dNetworkBuffer(HLS_BUFFER_TARGET),
+    m_bLiveMode(false),
+    m_dLiveTarget(LIVE_TARGET_LATENCY),
+    m_bTimeshift(false),
+    m_dTimeshiftWindow(TIMESHIFT_WINDOW),
+    m_nResamplerMode(RESAMPLER_MODE_AUTO),
+    audio_speed_convert(NULL),
+    m_pShowRectMutex(nullptr),
+    m_pAudioMixer(nullptr),
+    framedrop(-1),
+    infinite_buffer(-1),
+    decoder_reorder_pts(-1),
+    m_pExecutor(TaskExecutor::Shared()),
+    m_pTimeSource(TimeSource::Real()),
+    m_bSyncReplay(false)
 {
     // 注册所有复用器、编码器
     av_register_all();
@@ -2421,8 +3870,8 @@ bool VideoCtl::Init()
         return false;
     }
 
-    // 初始化SDL视频、音频和计时器模块
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER))
+    // 初始化SDL视频、音频和计时器模块（SDL内部按子系统计数，多个实例可以重复初始化）
+    if (SDL_InitSubSystem(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER))
     {
         av_log(NULL, AV_LOG_FATAL, "Could not initialize SDL - %s\n", SDL_GetError());
         av_log(NULL, AV_LOG_FATAL, "(Did you set the DISPLAY variable?)\n");
@@ -2449,37 +3898,54 @@ bool VideoCtl::Init()
 /* 连接信号与槽 */
 bool VideoCtl::ConnectSignalSlots()
 {
-    // 连接停止播放信号到OnStop槽函数
-    connect(this, &VideoCtl::SigStop, &VideoCtl::OnStop);
-
     return true;
 }
 
-/* 静态实例化对象 */
-VideoCtl *VideoCtl::m_pInstance = new VideoCtl();
+/* 设置混音输出 */
+void VideoCtl::SetAudioMixer(AudioMixer *pMixer)
+{
+    m_pAudioMixer = pMixer;
+}
 
-/* 获取VideoCtl的实例 */
-VideoCtl *VideoCtl::GetInstance()
+/* 设置任务执行器 */
+void VideoCtl::SetTaskExecutor(TaskExecutor *pExecutor)
 {
-    // 如果初始化失败，则返回空指针
-    if (false == m_pInstance->Init())
-    {
-        return nullptr;
-    }
-    return m_pInstance;
+    m_pExecutor = pExecutor ? pExecutor : TaskExecutor::Shared();
+}
+
+/* 设置时间源 */
+void VideoCtl::SetTimeSource(TimeSource *pTimeSource)
+{
+    m_pTimeSource = pTimeSource ? pTimeSource : TimeSource::Real();
 }
 
-/* 析构函数，释放资源 */
+/* 设置显示区域互斥锁 */
+void VideoCtl::SetShowRectMutex(QMutex *pMutex)
+{
+    m_pShowRectMutex = pMutex;
+}
+
+/* 析构函数，停止播放并释放资源 */
 VideoCtl::~VideoCtl()
 {
-    // 注销锁管理器
-    av_lockmgr_register(NULL);
+    // 结束播放循环线程，线程退出时会关闭流
+    StopPlay();
 
     // 反初始化网络格式
     avformat_network_deinit();
 
-    // 退出SDL
-    SDL_Quit();
+    // 释放本实例持有的SDL子系统
+    if (m_bInited)
+    {
+        SDL_QuitSubSystem(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER);
+    }
+}
+
+/* 停止播放并等待播放线程退出 */
+void VideoCtl::StopPlay()
+{
+    m_bPlayLoop = false;
+    m_stPlayLoopTask.Wait();
 }
 
 /* 启动播放，打开视频流并创建播放线程 */
@@ -2487,17 +3953,17 @@ bool VideoCtl::StartPlay(QString strFileName, WId widPlayWid)
 {
     // 设置播放循环标志为假
     m_bPlayLoop = false;
-    // 如果播放线程可连接，等待线程结束
-    if (m_tPlayLoopThread.joinable())
-    {
-        m_tPlayLoopThread.join();
-    }
+    // 等待上一个播放循环结束
+    m_stPlayLoopTask.Wait();
     // 发送播放开始信号，通知标题栏
     emit SigStartPlay(strFileName);
 
     // 保存播放窗口的ID
     play_wid = widPlayWid;
 
+    // 在启动读取线程之前标记播放循环，读取线程打开失败时清除该标志结束循环
+    m_bPlayLoop = true;
+
     VideoState *is;
 
     char file_name[1024];
@@ -2516,8 +3982,8 @@ bool VideoCtl::StartPlay(QString strFileName, WId widPlayWid)
     // 设置当前流
     m_CurStream = is;
 
-    // 创建播放循环线程
-    m_tPlayLoopThread = std::thread(&VideoCtl::LoopThread, this, is);
+    // 提交播放循环任务
+    m_stPlayLoopTask = m_pExecutor->Submit(TASK_LANE_VIDEO, [this, is] { LoopThread(is); }, true);
 
     return true;
 }
@@ -4,27 +4,91 @@
 #include <QObject>
 #include <QThread>
 #include <QString>
+#include <QMutex>
 
 #include "globalhelper.h"
 #include "datactl.h"
 #include "sonic.h"
+#include "audiomixer.h"
+#include "synctrace.h"
+#include "timesource.h"
+
+struct HlsStats;
+struct LiveLatencyStats;
+struct TimeshiftStats;
 
 #define FFP_PROP_FLOAT_PLAYBACK_RATE                    10003       // 设置播放速率
 #define FFP_PROP_FLOAT_PLAYBACK_VOLUME                  10006
 
 #define PLAYBACK_RATE_MIN           0.25     // 最慢
-#define PLAYBACK_RATE_MAX           3.0     // 最快
+#define PLAYBACK_RATE_MAX           4.0     // 最快
 #define PLAYBACK_RATE_SCALE         0.25    // 变速刻度
-//单例模式
+#define PLAYBACK_RATE_FINE_STEP     0.05    // 微调步长
+
+#define PLAYBACK_SKIP_LOOP_FILTER_RATE  1.5     // 不低于该速率时跳过环路滤波
+#define PLAYBACK_SKIP_NONREF_RATE       2.0     // 不低于该速率时丢弃非参考帧
+#define PLAYBACK_SKIP_INTERVAL          1000000 // 解码帧率统计周期（微秒）
+#define PLAYBACK_SKIP_BUDGET            1.25    // 每秒解码帧数超过原速帧率的该倍数时再降一档
+
+#define SCAN_SPEED_MIN              8       // 关键帧扫描的最低倍率
+#define SCAN_SPEED_MAX              64      // 关键帧扫描的最高倍率
+#define SCAN_FRAME_INTERVAL         100     // 扫描时取关键帧的间隔（毫秒），I/O 和解码开销与倍率无关
+#define SCAN_MAX_READ_PACKETS       1000    // 跳转后寻找关键帧最多读取的包数
+
+//播放结束后的动作
+enum PlayEndAction
+{
+    PLAY_END_STOP = 0,  // 停止播放
+    PLAY_END_LOOP,      // 单个循环
+    PLAY_END_NEXT,      // 播放列表下一个
+};
+//播放引擎，所有状态都属于实例，同一进程可以同时运行多个播放器
 class VideoCtl : public QObject
 {
     Q_OBJECT
 
-public:
-    //explicit VideoCtl(QObject *parent = nullptr);
+    friend class SyncReplay;
 
-    static VideoCtl* GetInstance();
+public:
+    explicit VideoCtl(QObject *parent = nullptr);
     ~VideoCtl();
+
+    /**
+     * @brief	初始化
+     *
+     * @return	true 成功 false 失败
+     * @note
+     */
+    bool Init();
+
+    /**
+     * @brief	设置混音输出
+     *
+     * @param	pMixer 共享的混音输出，为空时本实例独立打开音频设备
+     * @note 	在开始播放前设置
+     */
+    void SetAudioMixer(AudioMixer *pMixer);
+
+    /**
+     * @brief	设置显示区域互斥锁，显示控件调整大小时不刷新画面
+     */
+    void SetShowRectMutex(QMutex *pMutex);
+
+    /**
+     * @brief	设置任务执行器
+     *
+     * @param	pExecutor 执行器，默认使用进程共享的执行器
+     * @note 	在开始播放前设置
+     */
+    void SetTaskExecutor(TaskExecutor *pExecutor);
+
+    /**
+     * @brief	设置时间源
+     *
+     * @param	pTimeSource 时间源，为空时使用系统时钟
+     * @note 	在开始播放前设置
+     */
+    void SetTimeSource(TimeSource *pTimeSource);
     /**
     * @brief	开始播放
     *
@@ -34,10 +98,17 @@ public:
     * @note
     */
     bool StartPlay(QString strFileName, WId widPlayWid);
+    /**
+    * @brief	停止播放并等待播放线程退出
+    *
+    * @note 	会阻塞到流关闭完成，用于窗口销毁前释放播放窗口
+    */
+    void StopPlay();
     int audio_decode_frame(VideoState *is);
-    void update_sample_display(VideoState *is, short *samples, int samples_size);
+    void update_sample_display(VideoState *is, const uint8_t *samples, int samples_size);
     void set_clock_at(Clock *c, double pts, int serial, double time);
     void sync_clock_to_slave(Clock *c, Clock *slave);
+    int64_t time_now() { return m_pTimeSource->Now(); }
 
     float     ffp_get_property_float(int id, float default_value);
     void      ffp_set_property_float(int id, float value);
@@ -54,13 +125,69 @@ signals:
     void SigVideoVolume(double dPercent);
     void SigPauseStat(bool bPaused);
 
-    void SigStop();
+    /**
+    * @brief	播放结束（解码器与帧队列均已排空，每个文件只发出一次）
+    *
+    * @param	dLatencyMs 最后一帧送显到结束动作执行的延迟（毫秒）
+    */
+    void SigPlayEnd(double dLatencyMs);
+    void SigPlayNext();//请求播放列表切换到下一个
 
     void SigStopFinished();//停止播放完成
 
     void SigStartPlay(QString strFileName);
+
+    /**
+    * @brief	关键帧扫描状态变化
+    *
+    * @param	nSpeed 扫描倍率，正数快进、负数快退，0 为恢复正常播放
+    */
+    void SigScan(int nSpeed);
+
+    /**
+    * @brief	倒放状态变化
+    */
+    void SigReverse(bool bReverse);
 public:
-    void OnSpeed();
+    /**
+    * @brief	设置播放速率
+    *
+    * @param	fRate 播放速率，限制在 PLAYBACK_RATE_MIN ~ PLAYBACK_RATE_MAX，按 PLAYBACK_RATE_FINE_STEP 取整
+    * @note 	速率较高时自动降低视频解码档位，音频由 sonic 变速不变调
+    */
+    void OnSetSpeed(float fRate);
+
+    /**
+    * @brief	按 PLAYBACK_RATE_FINE_STEP 微调播放速率
+    *
+    * @param	nSteps 步数，负数减速
+    */
+    void OnSpeedStep(int nSteps);
+
+    /**
+    * @brief	关键帧快进/快退
+    *
+    * @param	nSpeed 扫描倍率，绝对值在 SCAN_SPEED_MIN ~ SCAN_SPEED_MAX 之间，正数快进、负数快退，0 恢复正常播放
+    * @note 	扫描时静音，只读取和解码关键帧，画面按以扫描倍率走动的时钟更新；
+    *        	结束时从扫描到的位置恢复正常播放。只对有视频的文件有效
+    */
+    void OnScan(int nSpeed);
+    void OnFastForward();   //快进，按 8/16/32/64 倍循环，再按一次恢复正常播放
+    void OnFastRewind();    //快退，同上
+
+    /**
+    * @brief	开启/关闭倒放
+    *
+    * @note 	倒放时静音，按GOP正向解码到缓存后倒序显示，播放到文件开头后恢复正常播放。
+    *        	关闭时从当前画面位置恢复正常播放。只对有视频的文件有效
+    */
+    void OnReverse(bool bReverse);
+    void OnToggleReverse();
+
+    /**
+    * @brief	后退一帧并暂停
+    */
+    void OnStepBackward();
     void OnPlaySeek(double dPercent);
     void OnPlayVolume(double dPercent);
     void OnSeekForward();
@@ -70,16 +197,133 @@ public:
     void OnPause();
     void OnStop();
 
-private:
-    explicit VideoCtl(QObject *parent = nullptr);
     /**
-     * @brief	初始化
-     *
-     * @return	true 成功 false 失败
-     * @note
-     */
-    bool Init();
+    * @brief	设置播放结束后的动作
+    *
+    * @param	nAction PlayEndAction
+    */
+    void SetPlayEndAction(int nAction);
+    int GetPlayEndAction();
+
+    /**
+    * @brief	开启/关闭响度标准化
+    *
+    * @note 	开启后按 EBU R128 把每个文件的响度调整到 LOUDNESS_TARGET，
+    *        	已打开的文件没有分析结果时从下一个文件开始生效
+    */
+    void SetLoudnessNormalization(bool bEnable);
+    bool GetLoudnessNormalization();
+
+    /**
+    * @brief	设置重采样质量
+    *
+    * @param	nMode ResamplerMode
+    * @note 	播放中切换时从下一帧开始使用新的模式
+    */
+    void SetResamplerMode(int nMode);
+    int GetResamplerMode();
+
+    /**
+    * @brief	本地文件是否通过内存映射读取
+    *
+    * @note 	默认开启，映射失败时自动使用 file 协议，从下一个文件开始生效
+    */
+    void SetMmapIO(bool bEnable);
+    bool GetMmapIO();
+
+    /**
+    * @brief	网络共享、U盘等慢速存储上的文件是否通过后台预读
+    *
+    * @note 	默认开启，优先于内存映射，从下一个文件开始生效
+    */
+    void SetPrefetchIO(bool bEnable);
+    bool GetPrefetchIO();
+
+    /**
+    * @brief	HTTP 上的 HLS 播放列表是否使用分片预取（并行下载、按带宽选择码率）
+    *
+    * @note 	默认开启，不支持的播放列表自动使用 hls 解复用器，从下一个文件开始生效
+    */
+    void SetHlsSource(bool bEnable);
+    bool GetHlsSource();
+
+    /**
+    * @brief	HLS 预取领先播放位置的时长（秒）
+    */
+    void SetNetworkBuffer(double dSeconds);
+    double GetNetworkBuffer();
+
+    /**
+    * @brief	当前 HLS 流的带宽、缓冲和卡顿统计
+    *
+    * @return	false 没有播放使用分片预取的 HLS 流
+    */
+    bool GetHlsStats(HlsStats &stats);
+
+    /**
+    * @brief	直播模式：实时流（UDP/RTP/RTSP 等）按目标延迟控制播放速度
+    *
+    * @note 	默认关闭，关闭时按包队列长度调整外部时钟速度，从下一个文件开始生效
+    */
+    void SetLiveMode(bool bEnable);
+    bool GetLiveMode();
+
+    /**
+    * @brief	直播模式的目标延迟（秒），即最新收到的数据与当前播放位置之差
+    */
+    void SetLiveTargetLatency(double dSeconds);
+    double GetLiveTargetLatency();
+
+    /**
+    * @brief	当前直播流的延迟分位数和追赶、丢帧统计
+    *
+    * @return	false 没有以直播模式播放的实时流
+    */
+    bool GetLiveLatencyStats(LiveLatencyStats &stats);
+
+    /**
+    * @brief	直播时移：实时流写入磁盘上的分段环，可以暂停、回退和回到直播
+    *
+    * @note 	默认关闭，从下一个文件开始生效。时移时不支持关键帧扫描和倒放
+    */
+    void SetTimeshift(bool bEnable);
+    bool GetTimeshift();
+
+    /**
+    * @brief	时移窗口（秒），最早可以回退到的位置
+    */
+    void SetTimeshiftWindow(double dSeconds);
+    double GetTimeshiftWindow();
+
+    /**
+    * @brief	当前直播流的时移窗口、播放位置和写入统计
+    *
+    * @return	false 没有使用时移的直播流
+    */
+    bool GetTimeshiftStats(TimeshiftStats &stats);
+
+    /**
+    * @brief	时移时回到直播的最新位置
+    */
+    void OnTimeshiftLive();
+
+    /**
+    * @brief	开始/停止记录音视频同步跟踪
+    *
+    * @return	true 成功 false 内存不足
+    * @note 	开始时清空之前的记录，停止后记录保留到导出或下次开始
+    */
+    bool SetSyncTrace(bool bEnable);
+    bool GetSyncTrace();
 
+    /**
+    * @brief	把同步跟踪导出为 Chrome trace JSON
+    *
+    * @return	导出的事件数，失败返回 -1
+    */
+    int ExportSyncTrace(const QString &strFile);
+
+private:
     /**
      * @brief	连接信号槽
      *
@@ -96,15 +340,20 @@ private:
     int synchronize_audio(VideoState *is, int nb_samples);
 
     int audio_open(void *opaque, int64_t wanted_channel_layout, int wanted_nb_channels, int wanted_sample_rate, struct AudioParams *audio_hw_params);
+    void audio_close(VideoState *is);
     int stream_component_open(VideoState *is, int stream_index);
-    int stream_has_enough_packets(AVStream *st, int stream_id, PacketQueue *queue);
+    int stream_has_enough_packets(AVStream *st, int stream_id, PacketQueue *queue, double min_seconds);
     int is_realtime(AVFormatContext *s);
     void ReadThread(VideoState *CurStream);
+    int stream_drained(VideoState *is);
+    void wait_for_end_action(VideoState *is);
+    void handle_play_end(VideoState *is);
     void LoopThread(VideoState *CurStream);
     VideoState *stream_open(const char *filename);
 
     void stream_cycle_channel(VideoState *is, int codec_type);
     void refresh_loop_wait_event(VideoState *is, SDL_Event *event);
+    int peek_own_event(SDL_Event *event);
     void seek_chapter(VideoState *is, int incr);
     void video_refresh(void *opaque, double *remaining_time);
     int queue_picture(VideoState *is, AVFrame *src_frame, double pts, double duration, int64_t pos, int serial);
@@ -117,6 +366,9 @@ private:
 
     int realloc_texture(SDL_Texture **texture, Uint32 new_format, int new_width, int new_height, SDL_BlendMode blendmode, int init_texture);
     void calculate_display_rect(SDL_Rect *rect, int scr_xleft, int scr_ytop, int scr_width, int scr_height, int pic_width, int pic_height, AVRational pic_sar);
+    int upload_subtitle(VideoState *is, Frame *sp);
+    void text_subtitle_display(VideoState *is, Frame *vp, SDL_Rect *rect);
+    void video_audio_display(VideoState *is);
     int upload_texture(SDL_Texture *tex, AVFrame *frame, struct SwsContext **img_convert_ctx);
     void video_image_display(VideoState *is);
     void stream_component_close(VideoState *is, int stream_index);
@@ -130,12 +382,25 @@ private:
     int get_master_sync_type(VideoState *is);
     double get_master_clock(VideoState *is);
     void check_external_clock_speed(VideoState *is);
+    void live_latency_control(VideoState *is);
+    int live_drop_audio(VideoState *is, Frame *af);
     void stream_seek(VideoState *is, int64_t pos, int64_t rel);
     void stream_toggle_pause(VideoState *is);
     void toggle_pause(VideoState *is);
     void step_to_next_frame(VideoState *is);
     double compute_target_delay(double delay, VideoState *is);
     double vp_duration(VideoState *is, Frame *vp, Frame *nextvp);
+    void update_speed_skip(VideoState *is, AVRational frame_rate);
+    void scan_switch(VideoState *is, int speed);
+    void scan_step(VideoState *is);
+    void reverse_switch(VideoState *is, int reverse);
+    int reverse_output(VideoState *is, AVFrame *frame, AVRational frame_rate);
+    bool history_seek(VideoState *is, double pos, bool step);
+    void history_start(VideoState *is);
+    int history_output(VideoState *is, AVFrame *frame);
+    void audio_history_start(VideoState *is);
+    Frame *audio_history_output(VideoState *is);
+    void timeshift_report(VideoState *is);
     void update_video_pts(VideoState *is, double pts, int64_t pos, int serial);
 
 
@@ -152,9 +417,6 @@ public:
     int     get_target_channels();
     int   is_normal_playback_rate();
 private:
-
-    static VideoCtl* m_pInstance; //< 单例指针
-
     bool m_bInited;	//< 初始化标志
     bool m_bPlayLoop; //刷新循环标志
 
@@ -163,15 +425,23 @@ private:
     SDL_Window *window;
     SDL_Renderer *renderer;
     WId play_wid;//播放窗口
+    QMutex *m_pShowRectMutex; //< 显示区域互斥锁
+    AudioMixer *m_pAudioMixer; //< 混音输出（为空时独立打开音频设备）
 
 
     /* options specified by the user */
     int screen_width;
     int screen_height;
     int startup_volume;
+    int framedrop;          // 丢帧策略：-1 非视频主时钟时丢帧，0 不丢帧，1 总是丢帧
+    int infinite_buffer;    // 无限缓冲：-1 实时流自动开启，0 关闭，1 开启
+    int decoder_reorder_pts;// 解码器pts重排：-1 自动，0 使用dts，1 使用pts
 
-    //播放刷新循环线程
-    std::thread m_tPlayLoopThread;
+    //播放刷新循环任务
+    TaskHandle m_stPlayLoopTask;
+    TaskExecutor *m_pExecutor; //< 读取/解码/刷新任务的执行器
+    TimeSource *m_pTimeSource; //< 时钟与帧定时使用的时间源
+    bool m_bSyncReplay; //< 同步回放：不创建窗口、不提前丢帧，音频回调不阻塞等待
 
     int m_nFrameW;
     int m_nFrameH;
@@ -180,6 +450,20 @@ private:
 
     float       pf_playback_rate;           // 播放速率
     int         pf_playback_rate_changed;   // 播放速率改变
+
+    int m_nPlayEndAction; //< 播放结束后的动作
+    bool m_bLoudnessNorm; //< 响度标准化
+    bool m_bMmapIO; //< 本地文件使用内存映射读取
+    bool m_bPrefetchIO; //< 慢速存储和 HTTP 渐进下载异步预读
+    bool m_bHlsSource; //< HLS 使用分片预取
+    double m_dNetworkBuffer; //< HLS 缓冲目标（秒）
+    bool m_bLiveMode; //< 实时流按目标延迟控制
+    double m_dLiveTarget; //< 直播目标延迟（秒）
+    bool m_bTimeshift; //< 实时流使用磁盘时移缓冲
+    double m_dTimeshiftWindow; //< 时移窗口（秒）
+    std::atomic<int> m_nResamplerMode; //< 重采样质量
+    AudioResampler m_stResampler; //< 音频重采样器，上下文在文件间复用
+    SyncTrace m_stSyncTrace; //< 音视频同步跟踪，默认关闭
 public:
     // 变速相关
     sonicStreamStruct *audio_speed_convert;
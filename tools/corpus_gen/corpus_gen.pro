@@ -0,0 +1,44 @@
+﻿# ----------------------------------------------------
+# 基准测试素材生成：按种子生成编码/封装/分辨率组合的测试文件
+# ----------------------------------------------------
+
+TEMPLATE = app
+TARGET = corpus_gen
+DESTDIR = $$PWD/../../bin
+QT += core gui widgets
+CONFIG += console
+CONFIG -= app_bundle
+
+win32 {
+LIBS += -L$$PWD/../../lib/SDL2/lib/x86 \
+    -L$$PWD/../../lib/ffmpeg-4.2.1-win32-dev/lib \
+    -lSDL2 \
+    -lavcodec \
+    -lavdevice \
+    -lavfilter \
+    -lavformat \
+    -lavutil \
+    -lswresample \
+    -lswscale
+
+INCLUDEPATH += $$PWD/../../lib/SDL2/include \
+    $$PWD/../../lib/ffmpeg-4.2.1-win32-dev/include
+}
+
+unix {
+LIBS += \
+    -lSDL2 \
+    -lavcodec \
+    -lavdevice \
+    -lavfilter \
+    -lavformat \
+    -lavutil \
+    -lswresample \
+    -lswscale
+}
+
+INCLUDEPATH += $$PWD/../../src
+
+HEADERS += ../../src/globalhelper.h
+
+SOURCES += main.cpp
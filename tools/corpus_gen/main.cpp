@@ -0,0 +1,649 @@
+﻿#define SDL_MAIN_HANDLED
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "globalhelper.h"
+
+#pragma execution_character_set("utf-8")
+
+/*
+ * 基准测试素材生成
+ *
+ * 用链接的 libavcodec/libavformat 编码器生成覆盖常见编码、像素格式、分辨率、帧率、
+ * GOP长度、封装格式、声道数和字幕组合的测试文件。画面和声音都由种子确定：
+ * 滚动彩条、填充噪声的移动方块、按二进制显示帧号的色块，每秒第一帧全白，
+ * 同时音频在每秒开头有 20ms 的 1kHz 提示音，可以直接用来检查音画同步。
+ * 编码器和封装器都设置 bitexact，同一种子在不同机器上生成相同的文件。
+ *
+ * 默认只生成覆盖每个取值至少一次的组合，--all 生成全部有效组合。
+ * 生成的文件可以作为 sync_replay 等无窗口回放测试的输入。
+ *
+ * 用法：corpus_gen <输出目录> [--seed N] [--duration 秒] [--all] [--filter 子串]
+ */
+
+#define CORPUS_SAMPLE_RATE 48000
+#define CORPUS_BEEP_FREQ 1000.0         // 每秒开头的提示音频率
+#define CORPUS_BEEP_MS 20               // 提示音时长
+#define CORPUS_COUNTER_BITS 16          // 画面底部帧号的位数
+#define CORPUS_CUE_INTERVAL 2000        // 字幕间隔（毫秒）
+#define CORPUS_CUE_DURATION 1500        // 每条字幕的显示时长（毫秒）
+
+typedef struct CorpusCodec {
+    const char *name;
+    enum AVCodecID id;
+} CorpusCodec;
+
+typedef struct CorpusContainer {
+    const char *format;
+    const char *ext;
+    const char *video_codecs;       // 支持的视频编码，逗号分隔
+    enum AVCodecID audio_codec;
+    enum AVCodecID subtitle_codec;  // 不支持字幕时为 AV_CODEC_ID_NONE
+} CorpusContainer;
+
+typedef struct CorpusCase {
+    const CorpusCodec *codec;
+    enum AVPixelFormat pix_fmt;
+    const CorpusContainer *container;
+    int width;
+    int height;
+    int fps;
+    int long_gop;
+    int channels;
+    int subtitles;
+} CorpusCase;
+
+static const CorpusCodec s_arrCodecs[] = {
+    { "h264",  AV_CODEC_ID_H264 },
+    { "mpeg4", AV_CODEC_ID_MPEG4 },
+    { "mjpeg", AV_CODEC_ID_MJPEG },
+};
+
+static const enum AVPixelFormat s_arrPixFmts[] = { AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUVJ420P, AV_PIX_FMT_NV12 };
+
+static const CorpusContainer s_arrContainers[] = {
+    { "matroska", "mkv", "h264,mpeg4,mjpeg", AV_CODEC_ID_AAC, AV_CODEC_ID_SUBRIP },
+    { "mp4",      "mp4", "h264,mpeg4,mjpeg", AV_CODEC_ID_AAC, AV_CODEC_ID_MOV_TEXT },
+    { "avi",      "avi", "h264,mpeg4,mjpeg", AV_CODEC_ID_AC3, AV_CODEC_ID_NONE },
+    { "flv",      "flv", "h264",             AV_CODEC_ID_AAC, AV_CODEC_ID_NONE },
+    { "mpegts",   "ts",  "h264,mpeg4",       AV_CODEC_ID_AAC, AV_CODEC_ID_NONE },
+};
+
+static const int s_arrHeights[] = { 480, 720, 1080, 2160 };
+static const int s_arrWidths[] = { 854, 1280, 1920, 3840 };
+static const int s_arrFps[] = { 24, 30, 60, 120 };
+static const int s_arrChannels[] = { 2, 6 };
+
+static const char *s_szAssHeader =
+    "[Script Info]\r\n"
+    "ScriptType: v4.00+\r\n"
+    "PlayResX: 384\r\n"
+    "PlayResY: 288\r\n"
+    "\r\n"
+    "[V4+ Styles]\r\n"
+    "Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, OutlineColour, BackColour, "
+    "Bold, Italic, Underline, StrikeOut, ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, Shadow, "
+    "Alignment, MarginL, MarginR, MarginV, Encoding\r\n"
+    "Style: Default,Arial,16,&Hffffff,&Hffffff,&H0,&H0,0,0,0,0,100,100,0,0,1,1,0,2,10,10,10,0\r\n"
+    "\r\n"
+    "[Events]\r\n"
+    "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\r\n";
+
+/* 线性同余随机数，所有内容都从种子派生 */
+static uint32_t lcg_next(uint32_t *state)
+{
+    *state = *state * 1664525 + 1013904223;
+    return *state >> 8;
+}
+
+static bool codec_in_list(const char *list, const char *name)
+{
+    std::string strList = std::string(",") + list + ",";
+    std::string strName = std::string(",") + name + ",";
+    return strList.find(strName) != std::string::npos;
+}
+
+/* 编码器是否支持该像素格式（编码器不可用时返回 false） */
+static bool encoder_supports(enum AVCodecID id, enum AVPixelFormat pix_fmt)
+{
+    AVCodec *codec = avcodec_find_encoder(id);
+    if (!codec)
+        return false;
+    if (!codec->pix_fmts)
+        return true;
+    for (const enum AVPixelFormat *p = codec->pix_fmts; *p != AV_PIX_FMT_NONE; p++) {
+        if (*p == pix_fmt)
+            return true;
+    }
+    return false;
+}
+
+static std::string case_name(const CorpusCase &c)
+{
+    char szName[256];
+    snprintf(szName, sizeof(szName), "%s_%s_%dp%d_%s_%s%s.%s", c.codec->name, av_get_pix_fmt_name(c.pix_fmt),
+             c.height, c.fps, c.long_gop ? "longgop" : "shortgop", c.channels == 6 ? "51" : "stereo",
+             c.subtitles ? "_sub" : "", c.container->ext);
+    return szName;
+}
+
+/* 列出所有有效的组合：编码器支持该像素格式，封装格式支持该编码，请求字幕时封装支持字幕 */
+static void build_matrix(std::vector<CorpusCase> &vecCases, bool bAll, uint32_t nSeed)
+{
+    std::vector<CorpusCase> vecBase;
+
+    for (const CorpusCodec &codec : s_arrCodecs) {
+        for (enum AVPixelFormat pix_fmt : s_arrPixFmts) {
+            if (!encoder_supports(codec.id, pix_fmt)) {
+                fprintf(stderr, "skip %s %s: not supported by the linked encoder\n", codec.name, av_get_pix_fmt_name(pix_fmt));
+                continue;
+            }
+            for (const CorpusContainer &container : s_arrContainers) {
+                if (!codec_in_list(container.video_codecs, codec.name))
+                    continue;
+                CorpusCase c;
+                memset(&c, 0, sizeof(c));
+                c.codec = &codec;
+                c.pix_fmt = pix_fmt;
+                c.container = &container;
+                vecBase.push_back(c);
+            }
+        }
+    }
+
+    if (bAll) {
+        for (const CorpusCase &base : vecBase) {
+            for (size_t r = 0; r < FF_ARRAY_ELEMS(s_arrHeights); r++)
+            for (int fps : s_arrFps)
+            for (int gop = 0; gop < 2; gop++)
+            for (int channels : s_arrChannels)
+            for (int sub = 0; sub < 2; sub++) {
+                if (sub && base.container->subtitle_codec == AV_CODEC_ID_NONE)
+                    continue;
+                CorpusCase c = base;
+                c.width = s_arrWidths[r];
+                c.height = s_arrHeights[r];
+                c.fps = fps;
+                c.long_gop = gop;
+                c.channels = channels;
+                c.subtitles = sub;
+                vecCases.push_back(c);
+            }
+        }
+        return;
+    }
+
+    // 覆盖模式：每个基础组合取一组参数，各维度从种子决定的起点轮流取值，保证每个取值都出现
+    uint32_t state = nSeed;
+    int nResOffset = lcg_next(&state) % FF_ARRAY_ELEMS(s_arrHeights);
+    int nFpsOffset = lcg_next(&state) % FF_ARRAY_ELEMS(s_arrFps);
+    int nGopOffset = lcg_next(&state) % 2;
+    int nChOffset = lcg_next(&state) % 2;
+    int nSubOffset = lcg_next(&state) % 2;
+    for (size_t i = 0; i < vecBase.size(); i++) {
+        CorpusCase c = vecBase[i];
+        int nRes = (i + nResOffset) % FF_ARRAY_ELEMS(s_arrHeights);
+        c.width = s_arrWidths[nRes];
+        c.height = s_arrHeights[nRes];
+        c.fps = s_arrFps[(i / 2 + nFpsOffset) % FF_ARRAY_ELEMS(s_arrFps)];
+        c.long_gop = (i + nGopOffset) % 2;
+        c.channels = s_arrChannels[(i / 3 + nChOffset) % 2];
+        c.subtitles = c.container->subtitle_codec != AV_CODEC_ID_NONE && (i + nSubOffset) % 2;
+        vecCases.push_back(c);
+    }
+}
+
+//生成一个文件的状态
+typedef struct CorpusWriter {
+    AVFormatContext *oc;
+    AVCodecContext *venc;
+    AVCodecContext *aenc;
+    AVCodecContext *senc;
+    AVStream *vst;
+    AVStream *ast;
+    AVStream *sst;
+    AVFrame *vframe;
+    AVFrame *aframe;
+    AVPacket *pkt;
+    uint32_t seed;
+    std::vector<uint8_t> bars[3];   // 彩条的一行（两倍宽度，滚动时直接截取）
+    double tone_phase[8];
+} CorpusWriter;
+
+static void writer_free(CorpusWriter *w)
+{
+    avcodec_free_context(&w->venc);
+    avcodec_free_context(&w->aenc);
+    avcodec_free_context(&w->senc);
+    av_frame_free(&w->vframe);
+    av_frame_free(&w->aframe);
+    av_packet_free(&w->pkt);
+    if (w->oc) {
+        if (!(w->oc->oformat->flags & AVFMT_NOFILE))
+            avio_closep(&w->oc->pb);
+        avformat_free_context(w->oc);
+        w->oc = NULL;
+    }
+}
+
+/* 打开编码器并创建对应的流 */
+static int add_stream(CorpusWriter *w, AVCodecContext *enc, AVStream **st, AVDictionary **opts)
+{
+    if (w->oc->oformat->flags & AVFMT_GLOBALHEADER)
+        enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    enc->flags |= AV_CODEC_FLAG_BITEXACT;
+
+    int ret = avcodec_open2(enc, enc->codec, opts);
+    av_dict_free(opts);
+    if (ret < 0)
+        return ret;
+
+    *st = avformat_new_stream(w->oc, NULL);
+    if (!*st)
+        return AVERROR(ENOMEM);
+    (*st)->time_base = enc->time_base;
+    return avcodec_parameters_from_context((*st)->codecpar, enc);
+}
+
+static int open_video(CorpusWriter *w, const CorpusCase &c)
+{
+    AVCodec *codec = avcodec_find_encoder(c.codec->id);
+    AVDictionary *opts = NULL;
+
+    w->venc = avcodec_alloc_context3(codec);
+    if (!w->venc)
+        return AVERROR(ENOMEM);
+    w->venc->width = c.width;
+    w->venc->height = c.height;
+    w->venc->pix_fmt = c.pix_fmt;
+    w->venc->time_base = { 1, c.fps };
+    w->venc->framerate = { c.fps, 1 };
+    w->venc->gop_size = c.long_gop ? c.fps * 10 : c.fps / 2;
+    w->venc->max_b_frames = c.codec->id == AV_CODEC_ID_MJPEG ? 0 : 2;
+    if (c.pix_fmt == AV_PIX_FMT_YUVJ420P)
+        w->venc->color_range = AVCOL_RANGE_JPEG;
+    // MJPEG 编码限定范围的 YUV420P 属于非标准用法，需要放宽标准检查
+    if (c.codec->id == AV_CODEC_ID_MJPEG)
+        w->venc->strict_std_compliance = FF_COMPLIANCE_UNOFFICIAL;
+
+    if (c.codec->id == AV_CODEC_ID_H264) {
+        av_dict_set(&opts, "preset", "veryfast", 0);
+        av_dict_set(&opts, "crf", "23", 0);
+    } else {
+        // MPEG-4 和 MJPEG 用固定量化
+        w->venc->flags |= AV_CODEC_FLAG_QSCALE;
+        w->venc->global_quality = FF_QP2LAMBDA * 4;
+    }
+    return add_stream(w, w->venc, &w->vst, &opts);
+}
+
+static int open_audio(CorpusWriter *w, const CorpusCase &c)
+{
+    AVCodec *codec = avcodec_find_encoder(c.container->audio_codec);
+    AVDictionary *opts = NULL;
+
+    if (!codec)
+        return AVERROR_ENCODER_NOT_FOUND;
+    w->aenc = avcodec_alloc_context3(codec);
+    if (!w->aenc)
+        return AVERROR(ENOMEM);
+    w->aenc->sample_fmt = codec->sample_fmts ? codec->sample_fmts[0] : AV_SAMPLE_FMT_FLTP;
+    w->aenc->sample_rate = CORPUS_SAMPLE_RATE;
+    w->aenc->channel_layout = c.channels == 6 ? AV_CH_LAYOUT_5POINT1 : AV_CH_LAYOUT_STEREO;
+    w->aenc->channels = c.channels;
+    w->aenc->bit_rate = 64000 * c.channels;
+    w->aenc->time_base = { 1, CORPUS_SAMPLE_RATE };
+    if (w->aenc->sample_fmt != AV_SAMPLE_FMT_FLTP)
+        return AVERROR(ENOSYS);
+    return add_stream(w, w->aenc, &w->ast, &opts);
+}
+
+static int open_subtitle(CorpusWriter *w, const CorpusCase &c)
+{
+    AVCodec *codec = avcodec_find_encoder(c.container->subtitle_codec);
+    AVDictionary *opts = NULL;
+
+    if (!codec)
+        return AVERROR_ENCODER_NOT_FOUND;
+    w->senc = avcodec_alloc_context3(codec);
+    if (!w->senc)
+        return AVERROR(ENOMEM);
+    w->senc->time_base = { 1, 1000 };
+    w->senc->subtitle_header = (uint8_t *)av_strdup(s_szAssHeader);
+    w->senc->subtitle_header_size = (int)strlen(s_szAssHeader);
+    return add_stream(w, w->senc, &w->sst, &opts);
+}
+
+/* 彩条的 YUV 值（BT.601 有限范围），全范围格式在填充时换算 */
+static void build_bars(CorpusWriter *w, int width)
+{
+    static const uint8_t arrBars[8][3] = {
+        { 235, 128, 128 }, { 210, 16, 146 }, { 170, 166, 16 }, { 145, 54, 34 },
+        { 106, 202, 222 }, { 81, 90, 240 }, { 41, 240, 110 }, { 16, 128, 128 },
+    };
+    int chroma_width = width / 2;
+
+    w->bars[0].resize(width * 2);
+    w->bars[1].resize(chroma_width * 2);
+    w->bars[2].resize(chroma_width * 2);
+    for (int x = 0; x < width * 2; x++)
+        w->bars[0][x] = arrBars[(x % width) * 8 / width][0];
+    for (int x = 0; x < chroma_width * 2; x++) {
+        w->bars[1][x] = arrBars[(x % chroma_width) * 8 / chroma_width][1];
+        w->bars[2][x] = arrBars[(x % chroma_width) * 8 / chroma_width][2];
+    }
+}
+
+/* 生成第 n 帧 */
+static void fill_video(CorpusWriter *w, const CorpusCase &c, int64_t n)
+{
+    AVFrame *f = w->vframe;
+    int width = c.width, height = c.height;
+    int chroma_width = width / 2, chroma_height = height / 2;
+    bool bFlash = (n % c.fps) == 0;
+    bool bNv12 = c.pix_fmt == AV_PIX_FMT_NV12;
+
+    // 彩条每 4 秒滚动一屏
+    int offset = (int)(n * width / (c.fps * 4) % width);
+    for (int y = 0; y < height; y++) {
+        uint8_t *dst = f->data[0] + y * f->linesize[0];
+        if (bFlash)
+            memset(dst, 235, width);
+        else
+            memcpy(dst, &w->bars[0][offset], width);
+    }
+    for (int y = 0; y < chroma_height; y++) {
+        const uint8_t *u = bFlash ? NULL : &w->bars[1][offset / 2];
+        const uint8_t *v = bFlash ? NULL : &w->bars[2][offset / 2];
+        if (bNv12) {
+            uint8_t *dst = f->data[1] + y * f->linesize[1];
+            for (int x = 0; x < chroma_width; x++) {
+                dst[2 * x] = u ? u[x] : 128;
+                dst[2 * x + 1] = v ? v[x] : 128;
+            }
+        } else {
+            uint8_t *dst_u = f->data[1] + y * f->linesize[1];
+            uint8_t *dst_v = f->data[2] + y * f->linesize[2];
+            if (u) {
+                memcpy(dst_u, u, chroma_width);
+                memcpy(dst_v, v, chroma_width);
+            } else {
+                memset(dst_u, 128, chroma_width);
+                memset(dst_v, 128, chroma_width);
+            }
+        }
+    }
+
+    // 往返移动的噪声方块，给编码器一些纹理和运动
+    int box = FFALIGN(height / 8, 2);
+    int period = FFMAX(2 * (width - box), 1);
+    int pos = (int)(n * width / (c.fps * 2) % period);
+    int box_x = (pos < width - box ? pos : period - pos) & ~1;
+    int box_y = ((height - box) / 2) & ~1;
+    uint32_t state = w->seed ^ (uint32_t)(n * 2654435761u);
+    for (int y = 0; y < box; y++) {
+        uint8_t *dst = f->data[0] + (box_y + y) * f->linesize[0] + box_x;
+        for (int x = 0; x < box; x++)
+            dst[x] = 16 + lcg_next(&state) % 220;
+    }
+
+    // 底部按二进制显示帧号，白色为1
+    int bit_size = FFALIGN(FFMAX(width / (CORPUS_COUNTER_BITS * 2), 8), 2);
+    for (int bit = 0; bit < CORPUS_COUNTER_BITS; bit++) {
+        uint8_t value = (n >> bit) & 1 ? 235 : 16;
+        int x0 = bit * bit_size;
+        for (int y = height - bit_size; y < height; y++)
+            memset(f->data[0] + y * f->linesize[0] + x0, value, bit_size);
+    }
+
+    // 全范围格式把亮度从 16~235 展开到 0~255
+    if (c.pix_fmt == AV_PIX_FMT_YUVJ420P) {
+        for (int y = 0; y < height; y++) {
+            uint8_t *dst = f->data[0] + y * f->linesize[0];
+            for (int x = 0; x < width; x++)
+                dst[x] = av_clip_uint8((dst[x] - 16) * 255 / 219);
+        }
+    }
+    f->pts = n;
+}
+
+/* 生成从第 n 个样本开始的一帧音频：各声道不同频率的正弦，每秒开头叠加提示音 */
+static void fill_audio(CorpusWriter *w, const CorpusCase &c, int64_t n)
+{
+    AVFrame *f = w->aframe;
+    int beep_samples = CORPUS_SAMPLE_RATE * CORPUS_BEEP_MS / 1000;
+
+    for (int ch = 0; ch < c.channels; ch++) {
+        float *dst = (float *)f->data[ch];
+        double freq = 200.0 + 50.0 * ch + w->seed % 100;
+        for (int i = 0; i < f->nb_samples; i++) {
+            int64_t pos = n + i;
+            double sample = 0.2 * sin(w->tone_phase[ch]);
+            w->tone_phase[ch] += 2 * M_PI * freq / CORPUS_SAMPLE_RATE;
+            if (pos % CORPUS_SAMPLE_RATE < beep_samples)
+                sample += 0.6 * sin(2 * M_PI * CORPUS_BEEP_FREQ * (pos % CORPUS_SAMPLE_RATE) / CORPUS_SAMPLE_RATE);
+            dst[i] = (float)sample;
+        }
+    }
+    f->pts = n;
+}
+
+/* 送入一帧（frame 为空时冲刷编码器）并写出得到的包 */
+static int encode_write(CorpusWriter *w, AVCodecContext *enc, AVStream *st, AVFrame *frame)
+{
+    int ret = avcodec_send_frame(enc, frame);
+    if (ret < 0)
+        return ret;
+
+    while ((ret = avcodec_receive_packet(enc, w->pkt)) >= 0) {
+        av_packet_rescale_ts(w->pkt, enc->time_base, st->time_base);
+        w->pkt->stream_index = st->index;
+        ret = av_interleaved_write_frame(w->oc, w->pkt);
+        if (ret < 0)
+            return ret;
+    }
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+}
+
+/* 编码并写出第 n 条字幕 */
+static int write_cue(CorpusWriter *w, int64_t n)
+{
+    char szText[128];
+    uint8_t buf[1024];
+    AVSubtitleRect rect;
+    AVSubtitleRect *rects[1] = { &rect };
+    AVSubtitle sub;
+    int64_t start = n * CORPUS_CUE_INTERVAL;
+
+    snprintf(szText, sizeof(szText), "%d,0,Default,,0,0,0,,Cue %d at %d.%03d s (seed %u)",
+             (int)n, (int)n, (int)(start / 1000), (int)(start % 1000), w->seed);
+    memset(&rect, 0, sizeof(rect));
+    rect.type = SUBTITLE_ASS;
+    rect.ass = szText;
+    memset(&sub, 0, sizeof(sub));
+    sub.num_rects = 1;
+    sub.rects = rects;
+    sub.pts = start * 1000;
+    sub.end_display_time = CORPUS_CUE_DURATION;
+
+    int size = avcodec_encode_subtitle(w->senc, buf, sizeof(buf), &sub);
+    if (size < 0)
+        return size;
+
+    int ret = av_new_packet(w->pkt, size);
+    if (ret < 0)
+        return ret;
+    memcpy(w->pkt->data, buf, size);
+    w->pkt->pts = w->pkt->dts = av_rescale_q(start, { 1, 1000 }, w->sst->time_base);
+    w->pkt->duration = av_rescale_q(CORPUS_CUE_DURATION, { 1, 1000 }, w->sst->time_base);
+    w->pkt->stream_index = w->sst->index;
+    return av_interleaved_write_frame(w->oc, w->pkt);
+}
+
+/* 生成一个文件，返回 0 成功 */
+static int generate(const CorpusCase &c, const std::string &strPath, uint32_t nSeed, int nSeconds)
+{
+    CorpusWriter w;
+    int ret;
+
+    w.oc = NULL;
+    w.venc = w.aenc = w.senc = NULL;
+    w.vst = w.ast = w.sst = NULL;
+    w.vframe = w.aframe = NULL;
+    w.pkt = NULL;
+    memset(w.tone_phase, 0, sizeof(w.tone_phase));
+    w.seed = nSeed;
+
+    ret = avformat_alloc_output_context2(&w.oc, NULL, c.container->format, strPath.c_str());
+    if (ret < 0)
+        return ret;
+    w.oc->flags |= AVFMT_FLAG_BITEXACT;
+
+    w.pkt = av_packet_alloc();
+    w.vframe = av_frame_alloc();
+    w.aframe = av_frame_alloc();
+    if (!w.pkt || !w.vframe || !w.aframe) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    if ((ret = open_video(&w, c)) < 0 || (ret = open_audio(&w, c)) < 0 ||
+            (c.subtitles && (ret = open_subtitle(&w, c)) < 0))
+        goto fail;
+
+    w.vframe->format = c.pix_fmt;
+    w.vframe->width = c.width;
+    w.vframe->height = c.height;
+    w.aframe->format = w.aenc->sample_fmt;
+    w.aframe->channel_layout = w.aenc->channel_layout;
+    w.aframe->channels = w.aenc->channels;
+    w.aframe->sample_rate = w.aenc->sample_rate;
+    w.aframe->nb_samples = w.aenc->frame_size;
+    if ((ret = av_frame_get_buffer(w.vframe, 32)) < 0 || (ret = av_frame_get_buffer(w.aframe, 0)) < 0)
+        goto fail;
+    build_bars(&w, c.width);
+
+    if (!(w.oc->oformat->flags & AVFMT_NOFILE) && (ret = avio_open(&w.oc->pb, strPath.c_str(), AVIO_FLAG_WRITE)) < 0)
+        goto fail;
+    if ((ret = avformat_write_header(w.oc, NULL)) < 0)
+        goto fail;
+
+    {
+        int64_t nFrames = (int64_t)nSeconds * c.fps;
+        int64_t nSamples = (int64_t)nSeconds * CORPUS_SAMPLE_RATE;
+        int64_t nCues = c.subtitles ? (int64_t)nSeconds * 1000 / CORPUS_CUE_INTERVAL : 0;
+        int64_t v = 0, a = 0, s = 0;
+
+        // 按时间先后交替生成三路数据
+        while (v < nFrames || a < nSamples || s < nCues) {
+            double tv = v < nFrames ? (double)v / c.fps : HUGE_VAL;
+            double ta = a < nSamples ? (double)a / CORPUS_SAMPLE_RATE : HUGE_VAL;
+            double ts = s < nCues ? s * CORPUS_CUE_INTERVAL / 1000.0 : HUGE_VAL;
+
+            if (ts <= tv && ts <= ta) {
+                ret = write_cue(&w, s++);
+            } else if (tv <= ta) {
+                if ((ret = av_frame_make_writable(w.vframe)) >= 0) {
+                    fill_video(&w, c, v++);
+                    ret = encode_write(&w, w.venc, w.vst, w.vframe);
+                }
+            } else {
+                if ((ret = av_frame_make_writable(w.aframe)) >= 0) {
+                    fill_audio(&w, c, a);
+                    a += w.aframe->nb_samples;
+                    ret = encode_write(&w, w.aenc, w.ast, w.aframe);
+                }
+            }
+            if (ret < 0)
+                goto fail;
+        }
+    }
+
+    if ((ret = encode_write(&w, w.venc, w.vst, NULL)) < 0 || (ret = encode_write(&w, w.aenc, w.ast, NULL)) < 0)
+        goto fail;
+    ret = av_write_trailer(w.oc);
+
+fail:
+    writer_free(&w);
+    return ret;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: corpus_gen <output dir> [--seed N] [--duration seconds] [--all] [--filter substring]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *szOutDir = NULL;
+    const char *szFilter = NULL;
+    uint32_t nSeed = 1;
+    int nSeconds = 10;
+    bool bAll = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+            nSeed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "--duration") && i + 1 < argc)
+            nSeconds = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--all"))
+            bAll = true;
+        else if (!strcmp(argv[i], "--filter") && i + 1 < argc)
+            szFilter = argv[++i];
+        else if (argv[i][0] != '-' && !szOutDir)
+            szOutDir = argv[i];
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if (!szOutDir || nSeconds <= 0) {
+        usage();
+        return 1;
+    }
+
+    av_log_set_level(AV_LOG_ERROR);
+
+    std::vector<CorpusCase> vecCases;
+    build_matrix(vecCases, bAll, nSeed);
+
+    // 清单记录每个文件的参数，测试脚本据此选择输入
+    std::string strManifest = std::string(szOutDir) + "/manifest.csv";
+    FILE *fpManifest = fopen(strManifest.c_str(), "w");
+    if (!fpManifest) {
+        fprintf(stderr, "cannot write %s\n", strManifest.c_str());
+        return 1;
+    }
+    fprintf(fpManifest, "file,codec,pix_fmt,width,height,fps,gop,channels,subtitles,container,seed,seconds\n");
+
+    int nFailed = 0, nWritten = 0;
+    for (const CorpusCase &c : vecCases) {
+        std::string strName = case_name(c);
+        if (szFilter && strName.find(szFilter) == std::string::npos)
+            continue;
+
+        std::string strPath = std::string(szOutDir) + "/" + strName;
+        int ret = generate(c, strPath, nSeed, nSeconds);
+        if (ret < 0) {
+            char szErr[AV_ERROR_MAX_STRING_SIZE] = { 0 };
+            av_strerror(ret, szErr, sizeof(szErr));
+            printf("%-56s failed: %s\n", strName.c_str(), szErr);
+            nFailed++;
+            continue;
+        }
+        printf("%-56s ok\n", strName.c_str());
+        fprintf(fpManifest, "%s,%s,%s,%d,%d,%d,%d,%d,%d,%s,%u,%d\n", strName.c_str(), c.codec->name,
+                av_get_pix_fmt_name(c.pix_fmt), c.width, c.height, c.fps,
+                c.long_gop ? c.fps * 10 : c.fps / 2, c.channels, c.subtitles, c.container->format, nSeed, nSeconds);
+        nWritten++;
+    }
+    fclose(fpManifest);
+
+    printf("\n%d files written, %d failed\n", nWritten, nFailed);
+    return nFailed ? 2 : 0;
+}
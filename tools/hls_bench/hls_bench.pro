@@ -0,0 +1,47 @@
+﻿# ----------------------------------------------------
+# HLS 分片预取测试：生成多码率 HLS，本机限速 http 服务，统计码率切换和卡顿
+# ----------------------------------------------------
+
+TEMPLATE = app
+TARGET = hls_bench
+DESTDIR = $$PWD/../../bin
+QT += core gui widgets
+CONFIG += console
+CONFIG -= app_bundle
+
+win32 {
+LIBS += -L$$PWD/../../lib/SDL2/lib/x86 \
+    -L$$PWD/../../lib/ffmpeg-4.2.1-win32-dev/lib \
+    -lSDL2 \
+    -lavcodec \
+    -lavdevice \
+    -lavfilter \
+    -lavformat \
+    -lavutil \
+    -lswresample \
+    -lswscale
+
+INCLUDEPATH += $$PWD/../../lib/SDL2/include \
+    $$PWD/../../lib/ffmpeg-4.2.1-win32-dev/include
+}
+
+unix {
+LIBS += \
+    -lSDL2 \
+    -lavcodec \
+    -lavdevice \
+    -lavfilter \
+    -lavformat \
+    -lavutil \
+    -lswresample \
+    -lswscale
+}
+
+INCLUDEPATH += $$PWD/../../src
+
+HEADERS += ../../src/hlssource.h \
+    ../../src/taskexecutor.h
+
+SOURCES += main.cpp \
+    ../../src/hlssource.cpp \
+    ../../src/taskexecutor.cpp
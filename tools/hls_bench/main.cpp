@@ -0,0 +1,452 @@
+﻿#define SDL_MAIN_HANDLED
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hlssource.h"
+
+#pragma execution_character_set("utf-8")
+
+/*
+ * HLS 分片预取测试
+ *
+ * 1. 在工作目录中生成三档码率（240p/360p/720p，MPEG-2，2秒分片）的点播 HLS 和主播放列表，已存在时直接使用；
+ * 2. 用 libavformat 的 http 协议在本机监听，每个请求一个线程，按 --rate 限制每个连接的带宽，
+ *    每次请求先等待 --latency 毫秒，--drop-at 秒后带宽降为 --drop-rate；
+ *    --live 时按时间逐步放出分片，播放列表只保留最近6个分片且没有结束标记；
+ * 3. 通过 HlsSource 按播放速度解复用，读取最多领先播放 --lead 秒，
+ *    统计播放卡顿，每5秒打印当前码率档、估计带宽和缓冲时长。
+ *
+ * 用法：hls_bench <工作目录> [--seconds N] [--rate KB/s] [--latency ms] [--drop-at S] [--drop-rate KB/s]
+ *                 [--buffer S] [--lead S] [--live] [--port N]
+ */
+
+#define BENCH_FPS 25
+#define BENCH_SEGMENT_SECONDS 2
+#define BENCH_DURATION 120                  // 生成的点播时长（秒）
+#define BENCH_LIVE_WINDOW 6                 // 直播播放列表保留的分片数
+#define BENCH_WRITE_CHUNK (16 * 1024)
+#define BENCH_REPORT_INTERVAL 5.0
+
+typedef struct BenchVariant {
+    int width;
+    int height;
+    int64_t bit_rate;
+} BenchVariant;
+
+static const BenchVariant s_arrVariants[] = {
+    { 426, 240, 400000 },
+    { 640, 360, 1000000 },
+    { 1280, 720, 2500000 },
+};
+
+typedef struct ServerConfig {
+    std::string root;
+    int64_t rate;           // 每个连接的带宽（字节/秒）
+    int latency_ms;
+    double drop_at;         // 带宽下降的时间（秒），0 不下降
+    int64_t drop_rate;
+    bool live;
+    int64_t start;
+} ServerConfig;
+
+/* 生成一档码率的点播分片 */
+static int encode_variant(const std::string &dir, int index)
+{
+    const BenchVariant *v = &s_arrVariants[index];
+    std::string sub = dir + "/v" + std::to_string(index);
+    std::string playlist = sub + "/index.m3u8";
+    std::string segments = sub + "/seg%03d.ts";
+    AVFormatContext *oc = NULL;
+    AVCodecContext *enc = NULL;
+    AVDictionary *opts = NULL;
+    AVFrame *frame = NULL;
+    AVPacket pkt;
+    AVStream *st;
+    uint32_t seed = 12345 + index;
+    int ret;
+
+#ifdef _WIN32
+    _mkdir(sub.c_str());
+#else
+    mkdir(sub.c_str(), 0755);
+#endif
+
+    ret = avformat_alloc_output_context2(&oc, NULL, "hls", playlist.c_str());
+    if (ret < 0)
+        return ret;
+    AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_MPEG2VIDEO);
+    st = avformat_new_stream(oc, NULL);
+    enc = avcodec_alloc_context3(codec);
+    frame = av_frame_alloc();
+    if (!codec || !st || !enc || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    // 每个分片以关键帧开始，CBR 便于按码率选择
+    enc->width = v->width;
+    enc->height = v->height;
+    enc->pix_fmt = AV_PIX_FMT_YUV420P;
+    enc->time_base = av_make_q(1, BENCH_FPS);
+    enc->framerate = av_make_q(BENCH_FPS, 1);
+    enc->gop_size = BENCH_FPS * BENCH_SEGMENT_SECONDS;
+    enc->bit_rate = v->bit_rate;
+    enc->rc_max_rate = v->bit_rate;
+    enc->rc_buffer_size = (int)v->bit_rate;
+    enc->max_b_frames = 0;
+    if ((ret = avcodec_open2(enc, codec, NULL)) < 0 ||
+            (ret = avcodec_parameters_from_context(st->codecpar, enc)) < 0)
+        goto end;
+    st->time_base = enc->time_base;
+
+    av_dict_set_int(&opts, "hls_time", BENCH_SEGMENT_SECONDS, 0);
+    av_dict_set_int(&opts, "hls_list_size", 0, 0);
+    av_dict_set(&opts, "hls_playlist_type", "vod", 0);
+    av_dict_set(&opts, "hls_segment_filename", segments.c_str(), 0);
+    ret = avformat_write_header(oc, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        goto end;
+
+    frame->format = enc->pix_fmt;
+    frame->width = enc->width;
+    frame->height = enc->height;
+    if ((ret = av_frame_get_buffer(frame, 32)) < 0)
+        goto end;
+
+    for (int i = 0; i <= BENCH_DURATION * BENCH_FPS; i++) {
+        AVFrame *in = NULL;
+        if (i < BENCH_DURATION * BENCH_FPS) {
+            // 滚动的渐变加噪声，使编码器用满码率
+            if ((ret = av_frame_make_writable(frame)) < 0)
+                goto end;
+            for (int y = 0; y < frame->height; y++) {
+                uint8_t *row = frame->data[0] + y * frame->linesize[0];
+                for (int x = 0; x < frame->width; x++) {
+                    seed = seed * 1664525 + 1013904223;
+                    row[x] = (uint8_t)(((x + y + i * 4) & 0xFF) / 2 + (seed >> 26));
+                }
+            }
+            for (int y = 0; y < frame->height / 2; y++) {
+                memset(frame->data[1] + y * frame->linesize[1], 128 + (i % 64), frame->width / 2);
+                memset(frame->data[2] + y * frame->linesize[2], 128 - (i % 64), frame->width / 2);
+            }
+            frame->pts = i;
+            in = frame;
+        }
+        if ((ret = avcodec_send_frame(enc, in)) < 0)
+            goto end;
+        av_init_packet(&pkt);
+        pkt.data = NULL;
+        pkt.size = 0;
+        while ((ret = avcodec_receive_packet(enc, &pkt)) >= 0) {
+            av_packet_rescale_ts(&pkt, enc->time_base, st->time_base);
+            pkt.stream_index = st->index;
+            if ((ret = av_interleaved_write_frame(oc, &pkt)) < 0)
+                goto end;
+        }
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+            goto end;
+    }
+    ret = av_write_trailer(oc);
+
+end:
+    av_frame_free(&frame);
+    avcodec_free_context(&enc);
+    avformat_free_context(oc);
+    return ret;
+}
+
+static int generate(const std::string &dir)
+{
+    std::string master = dir + "/master.m3u8";
+    FILE *fp = fopen(master.c_str(), "r");
+    if (fp) {
+        fclose(fp);
+        return 0;
+    }
+
+    printf("generating %d variants x %d s in %s ...\n", (int)FF_ARRAY_ELEMS(s_arrVariants), BENCH_DURATION, dir.c_str());
+    for (int i = 0; i < (int)FF_ARRAY_ELEMS(s_arrVariants); i++) {
+        int ret = encode_variant(dir, i);
+        if (ret < 0)
+            return ret;
+    }
+
+    // 主播放列表最后写入，存在即表示生成完整
+    fp = fopen(master.c_str(), "w");
+    if (!fp)
+        return AVERROR(errno);
+    fprintf(fp, "#EXTM3U\n");
+    for (int i = 0; i < (int)FF_ARRAY_ELEMS(s_arrVariants); i++) {
+        const BenchVariant *v = &s_arrVariants[i];
+        // 标称码率包含 TS 封装开销
+        fprintf(fp, "#EXT-X-STREAM-INF:BANDWIDTH=%lld,RESOLUTION=%dx%d\nv%d/index.m3u8\n",
+                (long long)(v->bit_rate * 11 / 10), v->width, v->height, i);
+    }
+    fclose(fp);
+    return 0;
+}
+
+static bool read_file(const std::string &path, std::string &data)
+{
+    FILE *fp = fopen(path.c_str(), "rb");
+    char buf[65536];
+    size_t n;
+
+    if (!fp)
+        return false;
+    data.clear();
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        data.append(buf, n);
+    fclose(fp);
+    return true;
+}
+
+/* 直播：只放出已经“录制”完的分片，保留最近 BENCH_LIVE_WINDOW 个 */
+static std::string live_window(const std::string &vod, double elapsed)
+{
+    std::vector<std::string> extinf, uris;
+    std::string out;
+    size_t pos = 0;
+
+    while (pos < vod.size()) {
+        size_t end = vod.find('\n', pos);
+        std::string line = vod.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        pos = end == std::string::npos ? vod.size() : end + 1;
+        if (!line.compare(0, 8, "#EXTINF:"))
+            extinf.push_back(line);
+        else if (!line.empty() && line[0] != '#')
+            uris.push_back(line);
+    }
+
+    int available = FFMIN((int)uris.size(), (int)(elapsed / BENCH_SEGMENT_SECONDS) + BENCH_LIVE_WINDOW);
+    int first = FFMAX(available - BENCH_LIVE_WINDOW, 0);
+    out = "#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:" + std::to_string(BENCH_SEGMENT_SECONDS) +
+            "\n#EXT-X-MEDIA-SEQUENCE:" + std::to_string(first) + "\n";
+    for (int i = first; i < available; i++)
+        out += extinf[i] + "\n" + uris[i] + "\n";
+    if (available == (int)uris.size())
+        out += "#EXT-X-ENDLIST\n";
+    return out;
+}
+
+static void serve_client(AVIOContext *client, const ServerConfig *cfg)
+{
+    uint8_t *resource = NULL;
+    std::string data;
+    bool found = false;
+    int ret;
+
+    while ((ret = avio_handshake(client)) > 0) {
+        av_opt_get(client, "resource", AV_OPT_SEARCH_CHILDREN, &resource);
+        if (resource && *resource)
+            break;
+        av_freep(&resource);
+    }
+    if (ret >= 0 && resource) {
+        std::string path((char *)resource);
+        path = path.substr(0, path.find('?'));
+        if (path.find("..") == std::string::npos)
+            found = read_file(cfg->root + path, data);
+        if (found && cfg->live && path.size() > 11 && !path.compare(path.size() - 11, 11, "/index.m3u8"))
+            data = live_window(data, (av_gettime_relative() - cfg->start) / 1000000.0);
+        av_opt_set_int(client, "reply_code", found ? 200 : AVERROR_HTTP_NOT_FOUND, AV_OPT_SEARCH_CHILDREN);
+        av_opt_set_int(client, "chunked_post", 0, AV_OPT_SEARCH_CHILDREN);
+        if (found)
+            av_opt_set(client, "headers", ("Content-Length: " + std::to_string(data.size()) + "\r\n").c_str(),
+                       AV_OPT_SEARCH_CHILDREN);
+        while ((ret = avio_handshake(client)) > 0)
+            ;
+    }
+
+    if (ret >= 0 && found) {
+        av_usleep(cfg->latency_ms * 1000);
+        for (size_t pos = 0; pos < data.size(); pos += BENCH_WRITE_CHUNK) {
+            int n = (int)FFMIN(data.size() - pos, (size_t)BENCH_WRITE_CHUNK);
+            double elapsed = (av_gettime_relative() - cfg->start) / 1000000.0;
+            int64_t rate = cfg->drop_at > 0 && elapsed >= cfg->drop_at ? cfg->drop_rate : cfg->rate;
+            avio_write(client, (const unsigned char *)data.data() + pos, n);
+            avio_flush(client);
+            if (rate > 0)
+                av_usleep((unsigned)(n * 1000000LL / rate));
+        }
+    }
+    avio_flush(client);
+    avio_close(client);
+    av_free(resource);
+}
+
+static void server_loop(AVIOContext *server, const ServerConfig *cfg)
+{
+    for (;;) {
+        AVIOContext *client = NULL;
+        if (avio_accept(server, &client) < 0)
+            break;
+        std::thread(serve_client, client, cfg).detach();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    ServerConfig cfg;
+    std::string dir;
+    double dSeconds = 60, dLead = 1, dBuffer = HLS_BUFFER_TARGET;
+    int nPort = 8089;
+    AVIOContext *server = NULL;
+    AVDictionary *opts = NULL;
+    AVFormatContext *ic = NULL;
+    HlsSource *pSource = NULL;
+    AVPacket pkt;
+    int ret;
+
+    cfg.rate = 800 * 1024;
+    cfg.latency_ms = 50;
+    cfg.drop_at = 0;
+    cfg.drop_rate = 100 * 1024;
+    cfg.live = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : "";
+        if (arg[0] != '-') {
+            dir = arg;
+            continue;
+        }
+        if (!strcmp(arg, "--live")) {
+            cfg.live = true;
+            continue;
+        }
+        i++;
+        if (!strcmp(arg, "--seconds"))
+            dSeconds = atof(value);
+        else if (!strcmp(arg, "--rate"))
+            cfg.rate = atoll(value) * 1024;
+        else if (!strcmp(arg, "--latency"))
+            cfg.latency_ms = atoi(value);
+        else if (!strcmp(arg, "--drop-at"))
+            cfg.drop_at = atof(value);
+        else if (!strcmp(arg, "--drop-rate"))
+            cfg.drop_rate = atoll(value) * 1024;
+        else if (!strcmp(arg, "--buffer"))
+            dBuffer = atof(value);
+        else if (!strcmp(arg, "--lead"))
+            dLead = atof(value);
+        else if (!strcmp(arg, "--port"))
+            nPort = atoi(value);
+        else {
+            dir.clear();
+            break;
+        }
+    }
+    if (dir.empty()) {
+        fprintf(stderr, "usage: %s <dir> [--seconds N] [--rate KB/s] [--latency ms] [--drop-at S] [--drop-rate KB/s]\n"
+                        "       [--buffer S] [--lead S] [--live] [--port N]\n", argv[0]);
+        return 1;
+    }
+
+    av_log_set_level(AV_LOG_INFO);
+    avformat_network_init();
+    if ((ret = generate(dir)) < 0) {
+        fprintf(stderr, "failed to generate HLS in %s: %d\n", dir.c_str(), ret);
+        return 1;
+    }
+
+    // 本机 http 服务，每个连接一个线程
+    std::string host = "http://127.0.0.1:" + std::to_string(nPort);
+    cfg.root = dir;
+    cfg.start = av_gettime_relative();
+    av_dict_set(&opts, "listen", "2", 0);
+    ret = avio_open2(&server, host.c_str(), AVIO_FLAG_WRITE, NULL, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        fprintf(stderr, "failed to listen on %s: %d\n", host.c_str(), ret);
+        return 1;
+    }
+    std::thread(server_loop, server, &cfg).detach();
+
+    printf("%s/master.m3u8: %s, %lld KB/s + %d ms per request", host.c_str(), cfg.live ? "live" : "vod",
+           (long long)(cfg.rate / 1024), cfg.latency_ms);
+    if (cfg.drop_at > 0)
+        printf(", %lld KB/s after %.0f s", (long long)(cfg.drop_rate / 1024), cfg.drop_at);
+    printf("\nbuffer target %.0f s, lead %.1f s\n\n", dBuffer, dLead);
+
+    pSource = new HlsSource(TaskExecutor::Shared());
+    pSource->SetBufferTarget(dBuffer);
+    ret = pSource->Open((host + "/master.m3u8").c_str(), NULL);
+    if (ret >= 0 && !(ic = avformat_alloc_context()))
+        ret = AVERROR(ENOMEM);
+    if (ret >= 0) {
+        ic->pb = pSource->Context();
+        ic->flags |= AVFMT_FLAG_CUSTOM_IO;
+        ret = avformat_open_input(&ic, NULL, NULL, NULL);
+    }
+    if (ret >= 0)
+        ret = avformat_find_stream_info(ic, NULL);
+    if (ret < 0) {
+        fprintf(stderr, "failed to open stream: %d\n", ret);
+        return 1;
+    }
+
+    // 与 prefetch_bench 相同的播放节奏：包晚于播放需要的时刻读到时计为卡顿，之后整体顺延
+    int64_t nStart = 0, nUnderrunUs = 0;
+    int nUnderruns = 0;
+    double dFirst = NAN, dPlayed = 0, dLast = 0, dNextReport = BENCH_REPORT_INTERVAL;
+    while ((ret = av_read_frame(ic, &pkt)) >= 0) {
+        int64_t ts = pkt.dts != AV_NOPTS_VALUE ? pkt.dts : pkt.pts;
+        AVRational tb = ic->streams[pkt.stream_index]->time_base;
+        av_packet_unref(&pkt);
+        if (ts == AV_NOPTS_VALUE)
+            continue;
+
+        int64_t now = av_gettime_relative();
+        double t = ts * av_q2d(tb);
+        if (isnan(dFirst)) {
+            dFirst = dLast = t;
+            nStart = now;
+        }
+        if (t > dLast)
+            dPlayed += t - dLast;
+        dLast = t;
+        if (dPlayed >= dSeconds)
+            break;
+
+        int64_t deadline = nStart + (int64_t)(dPlayed * 1000000);
+        if (now > deadline) {
+            nUnderruns++;
+            nUnderrunUs += now - deadline;
+            nStart += now - deadline;
+        } else if (deadline - now > dLead * 1000000) {
+            av_usleep((unsigned)(deadline - now - dLead * 1000000));
+        }
+
+        if (dPlayed >= dNextReport) {
+            HlsStats s = pSource->Stats();
+            dNextReport += BENCH_REPORT_INTERVAL;
+            printf("%6.1f s  variant %d/%d %5lld kbps  estimate %6lld kbps  buffered %5.1f s  underruns %d\n",
+                   dPlayed, s.variant + 1, s.variants, (long long)(s.variant_bandwidth / 1000),
+                   (long long)(s.bandwidth / 1000), s.buffered, nUnderruns);
+        }
+    }
+
+    HlsStats s = pSource->Stats();
+    printf("\nplayed %.1f s: %d underruns %.3f s\n", dPlayed, nUnderruns, nUnderrunUs / 1000000.0);
+    printf("segments %d (%.1f MB), %d switches, %d errors, startup %.3f s\n",
+           s.segments, s.bytes / 1048576.0, s.switches, s.errors, s.startup_us / 1000000.0);
+    printf("source stalls %d %.3f s (max %.3f s)\n", s.stalls, s.stall_us / 1000000.0, s.max_stall_us / 1000000.0);
+
+    avformat_close_input(&ic);
+    delete pSource;
+    return 0;
+}
@@ -0,0 +1,45 @@
+﻿# ----------------------------------------------------
+# 直播延迟测试：本机 UDP/RTP 推流，按目标延迟控制模拟播放并统计延迟分位数
+# ----------------------------------------------------
+
+TEMPLATE = app
+TARGET = live_bench
+DESTDIR = $$PWD/../../bin
+QT += core gui widgets
+CONFIG += console
+CONFIG -= app_bundle
+
+win32 {
+LIBS += -L$$PWD/../../lib/SDL2/lib/x86 \
+    -L$$PWD/../../lib/ffmpeg-4.2.1-win32-dev/lib \
+    -lSDL2 \
+    -lavcodec \
+    -lavdevice \
+    -lavfilter \
+    -lavformat \
+    -lavutil \
+    -lswresample \
+    -lswscale
+
+INCLUDEPATH += $$PWD/../../lib/SDL2/include \
+    $$PWD/../../lib/ffmpeg-4.2.1-win32-dev/include
+}
+
+unix {
+LIBS += \
+    -lSDL2 \
+    -lavcodec \
+    -lavdevice \
+    -lavfilter \
+    -lavformat \
+    -lavutil \
+    -lswresample \
+    -lswscale
+}
+
+INCLUDEPATH += $$PWD/../../src
+
+HEADERS += ../../src/livelatency.h
+
+SOURCES += main.cpp \
+    ../../src/livelatency.cpp
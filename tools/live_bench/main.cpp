@@ -0,0 +1,364 @@
+﻿#define SDL_MAIN_HANDLED
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "livelatency.h"
+
+#pragma execution_character_set("utf-8")
+
+/*
+ * 直播延迟测试
+ *
+ * 1. 发送线程实时编码测试信号（MPEG-2 视频 + MP2 音频），封装为 MPEG-TS 推送到本机 UDP，
+ *    --rtp 时使用 RTP（rtp_mpegts）；--drift 让发送端时钟偏快，模拟编码器与播放端的时钟漂移，
+ *    --jitter 给每帧加随机的发送延迟，--burst-every/--burst 周期性地停顿后突发发送；
+ * 2. 接收端用 libavformat 打开同一地址，按 LiveLatencyController 的输出模拟播放：
+ *    播放位置按调速系数和追赶速率走动，丢帧时直接前移，数据用完时停在最新收到的位置（计为卡顿）；
+ *    --no-control 时始终按 1 倍速播放，只统计延迟，用于对比；
+ * 3. 每5秒打印当前延迟、分位数、调速和卡顿统计。
+ * --send-only 只推流，可用开启直播模式的播放器打开 udp://127.0.0.1:端口 实际测试。
+ *
+ * 用法：live_bench [--port N] [--rtp] [--seconds N] [--target S] [--drift ppm] [--jitter ms]
+ *                  [--burst-every S] [--burst ms] [--no-control] [--send-only]
+ */
+
+#define BENCH_FPS 25
+#define BENCH_WIDTH 640
+#define BENCH_HEIGHT 360
+#define BENCH_VIDEO_RATE 1000000
+#define BENCH_SAMPLE_RATE 48000
+#define BENCH_AUDIO_RATE 128000
+#define BENCH_TS_PACKET 1316                // 每个 UDP 包 7 个 TS 包
+#define BENCH_REPORT_INTERVAL 5.0
+
+typedef struct SenderConfig {
+    std::string url;
+    bool rtp;
+    double drift_ppm;       // 发送端时钟偏快的比例（百万分之一）
+    int jitter_ms;
+    double burst_every;     // 突发的周期（秒），0 不突发
+    int burst_ms;           // 每次突发前停顿的时长
+} SenderConfig;
+
+static std::atomic<bool> s_bStop(false);
+
+static AVCodecContext *open_encoder(AVFormatContext *oc, AVStream **st, enum AVCodecID id)
+{
+    AVCodec *codec = avcodec_find_encoder(id);
+    AVCodecContext *enc = codec ? avcodec_alloc_context3(codec) : NULL;
+
+    if (!enc || !(*st = avformat_new_stream(oc, NULL))) {
+        avcodec_free_context(&enc);
+        return NULL;
+    }
+    if (codec->type == AVMEDIA_TYPE_VIDEO) {
+        enc->width = BENCH_WIDTH;
+        enc->height = BENCH_HEIGHT;
+        enc->pix_fmt = AV_PIX_FMT_YUV420P;
+        enc->time_base = av_make_q(1, BENCH_FPS);
+        enc->framerate = av_make_q(BENCH_FPS, 1);
+        enc->gop_size = BENCH_FPS;
+        enc->max_b_frames = 0;
+        enc->bit_rate = BENCH_VIDEO_RATE;
+    } else {
+        enc->sample_fmt = AV_SAMPLE_FMT_S16;
+        enc->sample_rate = BENCH_SAMPLE_RATE;
+        enc->channel_layout = AV_CH_LAYOUT_STEREO;
+        enc->channels = 2;
+        enc->time_base = av_make_q(1, BENCH_SAMPLE_RATE);
+        enc->bit_rate = BENCH_AUDIO_RATE;
+    }
+    if (avcodec_open2(enc, codec, NULL) < 0 ||
+            avcodec_parameters_from_context((*st)->codecpar, enc) < 0) {
+        avcodec_free_context(&enc);
+        return NULL;
+    }
+    (*st)->time_base = enc->time_base;
+    return enc;
+}
+
+static int write_frame(AVFormatContext *oc, AVCodecContext *enc, AVStream *st, AVFrame *frame)
+{
+    AVPacket pkt;
+    int ret;
+
+    if ((ret = avcodec_send_frame(enc, frame)) < 0)
+        return ret;
+    av_init_packet(&pkt);
+    pkt.data = NULL;
+    pkt.size = 0;
+    while ((ret = avcodec_receive_packet(enc, &pkt)) >= 0) {
+        av_packet_rescale_ts(&pkt, enc->time_base, st->time_base);
+        pkt.stream_index = st->index;
+        if ((ret = av_interleaved_write_frame(oc, &pkt)) < 0)
+            return ret;
+    }
+    return ret == AVERROR(EAGAIN) ? 0 : ret;
+}
+
+/* 按发送端的时钟实时编码并推流，直到 s_bStop */
+static void sender_loop(const SenderConfig *cfg)
+{
+    AVFormatContext *oc = NULL;
+    AVCodecContext *venc = NULL, *aenc = NULL;
+    AVStream *vst = NULL, *ast = NULL;
+    AVFrame *vframe = av_frame_alloc(), *aframe = av_frame_alloc();
+    uint32_t seed = 12345;
+    int64_t nSamples = 0;
+    int ret;
+
+    ret = avformat_alloc_output_context2(&oc, NULL, cfg->rtp ? "rtp_mpegts" : "mpegts", cfg->url.c_str());
+    if (ret < 0 || !vframe || !aframe ||
+            !(venc = open_encoder(oc, &vst, AV_CODEC_ID_MPEG2VIDEO)) ||
+            !(aenc = open_encoder(oc, &ast, AV_CODEC_ID_MP2))) {
+        fprintf(stderr, "failed to create encoders\n");
+        goto end;
+    }
+    if ((ret = avio_open(&oc->pb, cfg->url.c_str(), AVIO_FLAG_WRITE)) < 0 ||
+            (ret = avformat_write_header(oc, NULL)) < 0) {
+        fprintf(stderr, "failed to open %s: %d\n", cfg->url.c_str(), ret);
+        goto end;
+    }
+
+    vframe->format = venc->pix_fmt;
+    vframe->width = venc->width;
+    vframe->height = venc->height;
+    aframe->format = aenc->sample_fmt;
+    aframe->channel_layout = aenc->channel_layout;
+    aframe->nb_samples = aenc->frame_size;
+    if (av_frame_get_buffer(vframe, 32) < 0 || av_frame_get_buffer(aframe, 0) < 0)
+        goto end;
+
+    {
+        int64_t nStart = av_gettime_relative();
+        double dNextBurst = cfg->burst_every;
+        for (int64_t i = 0; !s_bStop; i++) {
+            double t = (double)i / BENCH_FPS;
+
+            // 发送端时钟偏快 drift_ppm：媒体时间 t 在 t / (1 + drift) 时发出
+            int64_t target = nStart + (int64_t)(t * 1000000 / (1 + cfg->drift_ppm / 1000000));
+            if (cfg->jitter_ms > 0) {
+                seed = seed * 1664525 + 1013904223;
+                target += (int64_t)(seed >> 8) % (cfg->jitter_ms * 1000);
+            }
+            // 停顿一段后，之前积压的帧一起发出
+            if (cfg->burst_every > 0 && t >= dNextBurst) {
+                dNextBurst += cfg->burst_every;
+                target += cfg->burst_ms * 1000;
+                nStart += cfg->burst_ms * 1000;
+            }
+            int64_t now = av_gettime_relative();
+            if (target > now)
+                av_usleep((unsigned)(target - now));
+
+            // 移动的竖条，便于在播放器中看出卡顿和跳帧
+            if (av_frame_make_writable(vframe) < 0)
+                break;
+            for (int y = 0; y < vframe->height; y++) {
+                uint8_t *row = vframe->data[0] + y * vframe->linesize[0];
+                for (int x = 0; x < vframe->width; x++)
+                    row[x] = (uint8_t)(abs(x - (int)(i * 8 % vframe->width)) < 16 ? 235 : 16 + (y & 0x3F));
+            }
+            for (int y = 0; y < vframe->height / 2; y++) {
+                memset(vframe->data[1] + y * vframe->linesize[1], 128, vframe->width / 2);
+                memset(vframe->data[2] + y * vframe->linesize[2], 128, vframe->width / 2);
+            }
+            vframe->pts = i;
+            if (write_frame(oc, venc, vst, vframe) < 0)
+                break;
+
+            // 音频追上视频的时间：每秒一次短促的 1kHz 提示音
+            while (nSamples < (i + 1) * BENCH_SAMPLE_RATE / BENCH_FPS) {
+                if (av_frame_make_writable(aframe) < 0)
+                    break;
+                int16_t *samples = (int16_t *)aframe->data[0];
+                for (int j = 0; j < aframe->nb_samples; j++) {
+                    int64_t n = nSamples + j;
+                    int16_t v = n % BENCH_SAMPLE_RATE < BENCH_SAMPLE_RATE / 20 ?
+                                (int16_t)(8000 * sin(2 * M_PI * 1000 * n / BENCH_SAMPLE_RATE)) : 0;
+                    samples[2 * j] = samples[2 * j + 1] = v;
+                }
+                aframe->pts = nSamples;
+                nSamples += aframe->nb_samples;
+                if (write_frame(oc, aenc, ast, aframe) < 0)
+                    break;
+            }
+            avio_flush(oc->pb);
+        }
+    }
+    av_write_trailer(oc);
+
+end:
+    av_frame_free(&vframe);
+    av_frame_free(&aframe);
+    avcodec_free_context(&venc);
+    avcodec_free_context(&aenc);
+    if (oc)
+        avio_closep(&oc->pb);
+    avformat_free_context(oc);
+}
+
+int main(int argc, char *argv[])
+{
+    SenderConfig cfg;
+    double dSeconds = 120, dTarget = LIVE_TARGET_LATENCY;
+    int nPort = 1234;
+    bool bControl = true, bSendOnly = false, bUsage = false;
+    AVFormatContext *ic = NULL;
+    AVDictionary *opts = NULL;
+    AVPacket pkt;
+    int ret;
+
+    cfg.rtp = false;
+    cfg.drift_ppm = 0;
+    cfg.jitter_ms = 0;
+    cfg.burst_every = 0;
+    cfg.burst_ms = 0;
+
+    for (int i = 1; i < argc && !bUsage; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : "";
+        if (!strcmp(arg, "--rtp")) {
+            cfg.rtp = true;
+            continue;
+        }
+        if (!strcmp(arg, "--no-control")) {
+            bControl = false;
+            continue;
+        }
+        if (!strcmp(arg, "--send-only")) {
+            bSendOnly = true;
+            continue;
+        }
+        i++;
+        if (!strcmp(arg, "--port"))
+            nPort = atoi(value);
+        else if (!strcmp(arg, "--seconds"))
+            dSeconds = atof(value);
+        else if (!strcmp(arg, "--target"))
+            dTarget = atof(value);
+        else if (!strcmp(arg, "--drift"))
+            cfg.drift_ppm = atof(value);
+        else if (!strcmp(arg, "--jitter"))
+            cfg.jitter_ms = atoi(value);
+        else if (!strcmp(arg, "--burst-every"))
+            cfg.burst_every = atof(value);
+        else if (!strcmp(arg, "--burst"))
+            cfg.burst_ms = atoi(value);
+        else
+            bUsage = true;
+    }
+    if (bUsage) {
+        fprintf(stderr, "usage: %s [--port N] [--rtp] [--seconds N] [--target S] [--drift ppm] [--jitter ms]\n"
+                        "       [--burst-every S] [--burst ms] [--no-control] [--send-only]\n", argv[0]);
+        return 1;
+    }
+
+    av_log_set_level(AV_LOG_WARNING);
+    avformat_network_init();
+
+    std::string input = std::string(cfg.rtp ? "rtp" : "udp") + "://127.0.0.1:" + std::to_string(nPort);
+    cfg.url = input + "?pkt_size=" + std::to_string(BENCH_TS_PACKET);
+    printf("sending %s: drift %+.0f ppm, jitter %d ms", input.c_str(), cfg.drift_ppm, cfg.jitter_ms);
+    if (cfg.burst_every > 0)
+        printf(", %d ms burst every %.0f s", cfg.burst_ms, cfg.burst_every);
+    printf("\n");
+    std::thread sender(sender_loop, &cfg);
+
+    if (bSendOnly) {
+        av_usleep((unsigned)(dSeconds * 1000000));
+        s_bStop = true;
+        sender.join();
+        return 0;
+    }
+
+    // 接收缓冲足够大，接收端暂时跟不上时不丢包
+    av_dict_set(&opts, "fifo_size", "1000000", 0);
+    av_dict_set(&opts, "overrun_nonfatal", "1", 0);
+    ret = avformat_open_input(&ic, input.c_str(), NULL, &opts);
+    av_dict_free(&opts);
+    if (ret >= 0)
+        ret = avformat_find_stream_info(ic, NULL);
+    if (ret < 0) {
+        fprintf(stderr, "failed to open %s: %d\n", input.c_str(), ret);
+        s_bStop = true;
+        sender.join();
+        return 1;
+    }
+    int nRef = av_find_best_stream(ic, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
+    if (nRef < 0)
+        nRef = av_find_best_stream(ic, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    printf("receiving %s, target %.3f s, control %s\n\n", input.c_str(), dTarget, bControl ? "on" : "off");
+
+    // 模拟播放：从第一个读到的包开始，播放位置按控制器的速度走动，不超过最新收到的位置
+    LiveLatencyController ctl;
+    ctl.Reset(dTarget);
+    double dRecv = NAN, dPos = NAN, dSpeed = 1.0, dNextReport = BENCH_REPORT_INTERVAL;
+    int64_t nStart = 0, nLast = 0, nNextControl = 0, nStallUs = 0;
+    int nStalls = 0;
+    bool bStalled = false;
+    while ((ret = av_read_frame(ic, &pkt)) >= 0) {
+        int64_t ts = pkt.pts != AV_NOPTS_VALUE ? pkt.pts : pkt.dts;
+        bool bRef = pkt.stream_index == nRef && ts != AV_NOPTS_VALUE;
+        AVRational tb = ic->streams[pkt.stream_index]->time_base;
+        av_packet_unref(&pkt);
+        if (!bRef)
+            continue;
+
+        int64_t now = av_gettime_relative();
+        dRecv = ts * av_q2d(tb);
+        if (std::isnan(dPos)) {
+            dPos = dRecv;
+            nStart = nLast = nNextControl = now;
+        }
+
+        // 数据用完时停在最新收到的位置，直到新数据到达
+        dPos += (now - nLast) / 1000000.0 * dSpeed;
+        if (dPos > dRecv) {
+            if (!bStalled)
+                nStalls++;
+            bStalled = true;
+            nStallUs += (int64_t)((dPos - dRecv) / dSpeed * 1000000);
+            dPos = dRecv;
+        } else {
+            bStalled = false;
+        }
+        nLast = now;
+
+        if (now >= nNextControl) {
+            nNextControl = now + LIVE_CONTROL_INTERVAL;
+            LiveDecision decision = ctl.Update(dRecv - dPos, now);
+            if (bControl) {
+                dSpeed = decision.speed * decision.rate;
+                dPos += decision.drop;
+            }
+        }
+
+        double elapsed = (now - nStart) / 1000000.0;
+        if (elapsed >= dNextReport) {
+            LiveLatencyStats s = ctl.Stats();
+            dNextReport += BENCH_REPORT_INTERVAL;
+            printf("%6.1f s  latency %6.3f s  p50 %6.3f  p90 %6.3f  p99 %6.3f  speed %.3f x %.2f  catchups %d  drops %d  stalls %d\n",
+                   elapsed, s.current, s.p50, s.p90, s.p99, s.speed, s.rate, s.catchups, s.drops, nStalls);
+            fflush(stdout);
+        }
+        if (elapsed >= dSeconds)
+            break;
+    }
+
+    LiveLatencyStats s = ctl.Stats();
+    printf("\nlatency target %.3f s: p50 %.3f s, p90 %.3f s, p99 %.3f s, max %.3f s (%lld samples)\n",
+           s.target, s.p50, s.p90, s.p99, s.max, (long long)s.samples);
+    printf("%d catchups, %d drops %.3f s, %d stalls %.3f s\n",
+           s.catchups, s.drops, s.dropped, nStalls, nStallUs / 1000000.0);
+
+    s_bStop = true;
+    sender.join();
+    avformat_close_input(&ic);
+    return 0;
+}
@@ -0,0 +1,45 @@
+﻿# ----------------------------------------------------
+# 内存映射读取对比：与 file 协议比较解复用吞吐量和系统调用次数
+# ----------------------------------------------------
+
+TEMPLATE = app
+TARGET = mmap_bench
+DESTDIR = $$PWD/../../bin
+QT += core gui widgets
+CONFIG += console
+CONFIG -= app_bundle
+
+win32 {
+LIBS += -L$$PWD/../../lib/SDL2/lib/x86 \
+    -L$$PWD/../../lib/ffmpeg-4.2.1-win32-dev/lib \
+    -lSDL2 \
+    -lavcodec \
+    -lavdevice \
+    -lavfilter \
+    -lavformat \
+    -lavutil \
+    -lswresample \
+    -lswscale
+
+INCLUDEPATH += $$PWD/../../lib/SDL2/include \
+    $$PWD/../../lib/ffmpeg-4.2.1-win32-dev/include
+}
+
+unix {
+LIBS += \
+    -lSDL2 \
+    -lavcodec \
+    -lavdevice \
+    -lavfilter \
+    -lavformat \
+    -lavutil \
+    -lswresample \
+    -lswscale
+}
+
+INCLUDEPATH += $$PWD/../../src
+
+HEADERS += ../../src/mmapio.h
+
+SOURCES += main.cpp \
+    ../../src/mmapio.cpp
@@ -0,0 +1,216 @@
+﻿#define SDL_MAIN_HANDLED
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "prefetchio.h"
+
+#pragma execution_character_set("utf-8")
+
+/*
+ * 异步预读对比测试
+ *
+ * 用人为限速的文件读取模拟慢速存储（固定延迟 + 带宽上限 + 周期性延迟尖峰），
+ * 分别不预读（每次读取直接访问存储）和通过 PrefetchIO 预读，按播放速度解复用文件：
+ * 读取线程最多领先播放位置 --lead 秒（相当于包队列中缓存的时长），
+ * 包在播放需要之后才读到时计为一次卡顿，播放时间顺延。
+ * 可选每播放 --rewind 秒向回跳转3秒，检查缓冲范围内的跳转是否从内存读取。
+ *
+ * 用法：prefetch_bench <文件> [--seconds N] [--speed X] [--lead S] [--rate KB/s] [--latency ms]
+ *                      [--spike ms] [--spike-every MB] [--block KB] [--depth N] [--rewind S]
+ */
+
+#define BENCH_REWIND_SECONDS 3.0
+
+typedef struct BenchOptions {
+    double seconds;         // 解复用的媒体时长
+    double speed;           // 播放速度
+    double lead;            // 读取最多领先播放的时长
+    double rewind;          // 每隔多少秒向回跳转，0 不跳转
+    int block_size;
+    int depth;
+    PrefetchThrottle throttle;
+} BenchOptions;
+
+typedef struct BenchResult {
+    double seconds;         // 实际耗时
+    int64_t packets;
+    int underruns;          // 播放等待数据的次数
+    int64_t underrun_us;    // 播放累计等待时间
+    int64_t max_read_us;    // 最长一次 av_read_frame
+    PrefetchStats stats;
+} BenchResult;
+
+static int run(const char *filename, int nDepth, const BenchOptions *opt, BenchResult *res)
+{
+    PrefetchIO *pIO = new PrefetchIO(TaskExecutor::Shared(), opt->block_size, nDepth);
+    AVFormatContext *ic = NULL;
+    AVPacket pkt;
+    int ret;
+
+    memset(res, 0, sizeof(*res));
+    pIO->SetThrottle(opt->throttle);
+    ret = pIO->Open(filename, NULL);
+    if (ret >= 0 && !(ic = avformat_alloc_context()))
+        ret = AVERROR(ENOMEM);
+    if (ret >= 0) {
+        ic->pb = pIO->Context();
+        ic->flags |= AVFMT_FLAG_CUSTOM_IO;
+        ret = avformat_open_input(&ic, filename, NULL, NULL);
+    }
+    if (ret >= 0)
+        ret = avformat_find_stream_info(ic, NULL);
+    if (ret < 0) {
+        if (ic)
+            avformat_close_input(&ic);
+        delete pIO;
+        return ret;
+    }
+
+    // 媒体时间映射到播放时钟：played 为已播放的时长，跳转后继续累加
+    int64_t nBegin = av_gettime_relative(), nStart = nBegin;
+    double dFirst = NAN, dLast = 0, dPlayed = 0, dNextRewind = opt->rewind;
+    for (;;) {
+        int64_t t0 = av_gettime_relative();
+        ret = av_read_frame(ic, &pkt);
+        int64_t now = av_gettime_relative();
+        res->max_read_us = FFMAX(res->max_read_us, now - t0);
+        if (ret < 0)
+            break;
+        res->packets++;
+
+        int64_t ts = pkt.dts != AV_NOPTS_VALUE ? pkt.dts : pkt.pts;
+        AVRational tb = ic->streams[pkt.stream_index]->time_base;
+        av_packet_unref(&pkt);
+        if (ts == AV_NOPTS_VALUE)
+            continue;
+
+        double t = ts * av_q2d(tb);
+        if (isnan(dFirst)) {
+            dFirst = dLast = t;
+            nStart = now;
+        }
+        if (t > dLast)
+            dPlayed += t - dLast;
+        dLast = t;
+        if (dPlayed >= opt->seconds)
+            break;
+
+        // 播放到该包的时刻，包晚于此时读到则播放卡顿，之后的时刻整体顺延
+        int64_t deadline = nStart + (int64_t)(dPlayed / opt->speed * 1000000);
+        if (now > deadline) {
+            res->underruns++;
+            res->underrun_us += now - deadline;
+            nStart += now - deadline;
+        } else if (deadline - now > opt->lead / opt->speed * 1000000) {
+            av_usleep((unsigned)(deadline - now - opt->lead / opt->speed * 1000000));
+        }
+
+        if (opt->rewind > 0 && dPlayed >= dNextRewind) {
+            dNextRewind += opt->rewind;
+            int64_t target = (int64_t)(FFMAX(t - BENCH_REWIND_SECONDS, dFirst) * AV_TIME_BASE);
+            avformat_seek_file(ic, -1, INT64_MIN, target, target, 0);
+            dLast = t - BENCH_REWIND_SECONDS;
+        }
+    }
+    res->seconds = (av_gettime_relative() - nBegin) / 1000000.0;
+
+    avformat_close_input(&ic);
+    res->stats = pIO->Stats();
+    delete pIO;
+    return 0;
+}
+
+static void print(const char *szName, const BenchResult *res)
+{
+    const PrefetchStats *s = &res->stats;
+
+    printf("  %-9s %8.2f s %8lld pkts %5d underruns %8.3f s  max read %7.3f s\n",
+           szName, res->seconds, (long long)res->packets, res->underruns,
+           res->underrun_us / 1000000.0, res->max_read_us / 1000000.0);
+    printf("  %-9s hit rate %5.1f%%  %lld stalls %.3f s (max %.3f s)  seeks %lld/%lld in buffer  %.1f MB fetched\n",
+           "", s->reads ? 100.0 * s->hits / s->reads : 0.0, (long long)s->stalls,
+           s->stall_us / 1000000.0, s->max_stall_us / 1000000.0,
+           (long long)s->seek_hits, (long long)s->seeks, s->bytes_fetched / 1048576.0);
+}
+
+int main(int argc, char *argv[])
+{
+    BenchOptions opt;
+    const char *filename = NULL;
+    BenchResult res;
+
+    memset(&opt, 0, sizeof(opt));
+    opt.seconds = 60;
+    opt.speed = 1;
+    opt.lead = 1;
+    opt.block_size = PREFETCH_IO_BLOCK_SIZE;
+    opt.depth = PREFETCH_IO_DEPTH;
+    // 默认模拟一个偶尔卡顿的网络共享：20 MB/s，每次读取 5ms，每 16 MB 卡顿 800ms
+    opt.throttle.bytes_per_sec = 20 << 20;
+    opt.throttle.latency_ms = 5;
+    opt.throttle.spike_ms = 800;
+    opt.throttle.spike_bytes = 16 << 20;
+
+    av_log_set_level(AV_LOG_ERROR);
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (arg[0] != '-' || arg[1] != '-') {
+            filename = arg;
+            continue;
+        }
+        if (!value) {
+            filename = NULL;
+            break;
+        }
+        i++;
+        if (!strcmp(arg, "--seconds"))
+            opt.seconds = atof(value);
+        else if (!strcmp(arg, "--speed"))
+            opt.speed = FFMAX(atof(value), 0.1);
+        else if (!strcmp(arg, "--lead"))
+            opt.lead = FFMAX(atof(value), 0.0);
+        else if (!strcmp(arg, "--rate"))
+            opt.throttle.bytes_per_sec = atoll(value) * 1024;
+        else if (!strcmp(arg, "--latency"))
+            opt.throttle.latency_ms = atoi(value);
+        else if (!strcmp(arg, "--spike"))
+            opt.throttle.spike_ms = atoi(value);
+        else if (!strcmp(arg, "--spike-every"))
+            opt.throttle.spike_bytes = (int64_t)(atof(value) * (1 << 20));
+        else if (!strcmp(arg, "--block"))
+            opt.block_size = atoi(value) * 1024;
+        else if (!strcmp(arg, "--depth"))
+            opt.depth = FFMAX(atoi(value), 1);
+        else if (!strcmp(arg, "--rewind"))
+            opt.rewind = FFMAX(atof(value), 0.0);
+        else {
+            filename = NULL;
+            break;
+        }
+    }
+    if (!filename) {
+        fprintf(stderr, "usage: %s <file> [--seconds N] [--speed X] [--lead S] [--rate KB/s] [--latency ms]\n"
+                        "       [--spike ms] [--spike-every MB] [--block KB] [--depth N] [--rewind S]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%s: %.0f s at %.1fx, lead %.1f s, throttle %lld KB/s + %d ms/read, %d ms spike every %.1f MB\n",
+           filename, opt.seconds, opt.speed, opt.lead, (long long)(opt.throttle.bytes_per_sec / 1024),
+           opt.throttle.latency_ms, opt.throttle.spike_ms, opt.throttle.spike_bytes / 1048576.0);
+    printf("prefetch: %d KB x %d = %.1f MB\n\n", opt.block_size / 1024, opt.depth,
+           (double)opt.block_size * opt.depth / 1048576.0);
+
+    if (run(filename, 0, &opt, &res) < 0) {
+        fprintf(stderr, "failed to open %s\n", filename);
+        return 1;
+    }
+    print("direct", &res);
+    if (run(filename, opt.depth, &opt, &res) < 0) {
+        fprintf(stderr, "failed to open %s\n", filename);
+        return 1;
+    }
+    print("prefetch", &res);
+    return 0;
+}
@@ -0,0 +1,47 @@
+﻿# ----------------------------------------------------
+# 异步预读对比：限速模拟慢速存储，比较按播放速度解复用时的卡顿
+# ----------------------------------------------------
+
+TEMPLATE = app
+TARGET = prefetch_bench
+DESTDIR = $$PWD/../../bin
+QT += core gui widgets
+CONFIG += console
+CONFIG -= app_bundle
+
+win32 {
+LIBS += -L$$PWD/../../lib/SDL2/lib/x86 \
+    -L$$PWD/../../lib/ffmpeg-4.2.1-win32-dev/lib \
+    -lSDL2 \
+    -lavcodec \
+    -lavdevice \
+    -lavfilter \
+    -lavformat \
+    -lavutil \
+    -lswresample \
+    -lswscale
+
+INCLUDEPATH += $$PWD/../../lib/SDL2/include \
+    $$PWD/../../lib/ffmpeg-4.2.1-win32-dev/include
+}
+
+unix {
+LIBS += \
+    -lSDL2 \
+    -lavcodec \
+    -lavdevice \
+    -lavfilter \
+    -lavformat \
+    -lavutil \
+    -lswresample \
+    -lswscale
+}
+
+INCLUDEPATH += $$PWD/../../src
+
+HEADERS += ../../src/prefetchio.h \
+    ../../src/taskexecutor.h
+
+SOURCES += main.cpp \
+    ../../src/prefetchio.cpp \
+    ../../src/taskexecutor.cpp
@@ -0,0 +1,512 @@
+﻿#define SDL_MAIN_HANDLED
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "datactl.h"
+
+#pragma execution_character_set("utf-8")
+
+/*
+ * 队列原语微基准
+ *
+ * 单独运行 datactl.h 中的包队列、帧队列和 decoder_decode_frame，
+ * 按播放器中的生产者/消费者模式施加负载：稳定读包、突发读包（两路队列）、
+ * 播放中跳转清空队列、负载下中止、帧队列交接，以及带跳转的完整解码管线
+ * （rawvideo 解码器，解码开销可以忽略）。
+ * 每项输出吞吐量、交接延迟（放入到取出）的 p50/p99，以及每项数据的上下文切换次数
+ * （只在有 getrusage 的系统上统计）。修改队列实现前后各运行一次比较。
+ *
+ * 用法：queue_bench [每项数据量]
+ */
+
+#define BENCH_QUEUE_LIMIT 64            // 读包线程在队列达到该长度后等待，相当于播放器的“包已足够”
+#define BENCH_BURST 16                  // 突发读包每次的包数
+#define BENCH_BURST_GAP_US 2000         // 两次突发之间的间隔（模拟 I/O 等待）
+#define BENCH_SEEK_INTERVAL 500         // 每读这么多包跳转一次
+#define BENCH_ABORT_ROUNDS 200          // 中止测试的轮数
+#define BENCH_ABORT_LOAD_US 2000        // 每轮中止前加载的时间
+#define BENCH_VIDEO_WIDTH 64
+#define BENCH_VIDEO_HEIGHT 36
+
+typedef struct BenchResult {
+    const char *name;
+    int64_t items;
+    double seconds;
+    int64_t switches;                   // 上下文切换次数，-1 表示无法统计
+    int64_t dropped;                    // 因序列号过期而丢弃的数量
+    std::vector<int64_t> latency;       // 每项的交接延迟（纳秒）
+} BenchResult;
+
+static int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* 本进程所有线程的上下文切换次数 */
+static int64_t context_switches()
+{
+#ifndef _WIN32
+    struct rusage usage;
+    if (!getrusage(RUSAGE_SELF, &usage))
+        return (int64_t)usage.ru_nvcsw + usage.ru_nivcsw;
+#endif
+    return -1;
+}
+
+/* 伪随机的包大小，视频包偶尔出现大的关键帧 */
+static int packet_size(uint32_t *state, bool bVideo)
+{
+    *state = *state * 1664525 + 1013904223;
+    if (!bVideo)
+        return 200 + (*state >> 8) % 600;
+    return (*state >> 8) % 30 == 0 ? 60000 + (*state >> 8) % 40000 : 2000 + (*state >> 8) % 20000;
+}
+
+//一组包队列及其清理包
+typedef struct BenchQueue {
+    AVPacket flush_pkt;
+    PacketQueue q;
+} BenchQueue;
+
+static void bench_queue_init(BenchQueue *b)
+{
+    av_init_packet(&b->flush_pkt);
+    b->flush_pkt.data = (uint8_t *)&b->flush_pkt;
+    packet_queue_init(&b->q, &b->flush_pkt);
+    packet_queue_start(&b->q);
+}
+
+/* 放入一个带序号的包，序号对应的放入时间记在 vecStamp 中 */
+static int put_packet(PacketQueue *q, int64_t seq, int size, std::vector<int64_t> &vecStamp)
+{
+    AVPacket pkt;
+    if (av_new_packet(&pkt, size) < 0)
+        return -1;
+    pkt.pos = seq;
+    pkt.pts = pkt.dts = seq;
+    vecStamp[seq] = now_ns();
+    return packet_queue_put(q, &pkt);
+}
+
+/* 读包线程达到队列上限后等待解码线程唤醒，与播放器的读取循环相同 */
+static void wait_for_space(PacketQueue *q, ReadWaker *waker)
+{
+    while (q->nb_packets >= BENCH_QUEUE_LIMIT && !q->abort_request)
+        read_waker_wait(waker, 10);
+}
+
+/* 解码线程一侧：取包，队列空时唤醒读包线程，丢弃过期序列号的包 */
+static void consume_packets(PacketQueue *q, ReadWaker *waker, const std::vector<int64_t> &vecStamp,
+                            std::vector<int64_t> &vecLatency, int64_t *dropped)
+{
+    AVPacket pkt;
+    int serial;
+
+    for (;;) {
+        if (q->nb_packets == 0)
+            read_waker_signal(waker);
+        if (packet_queue_get(q, &pkt, 1, &serial) < 0)
+            break;
+        if (pkt.data == q->flush_pkt->data)
+            continue;
+        if (serial != q->serial) {
+            (*dropped)++;
+        } else {
+            int64_t now = now_ns();
+            vecLatency.push_back(now - vecStamp[pkt.pos]);
+        }
+        av_packet_unref(&pkt);
+    }
+}
+
+/* 稳定读包：一个读包线程，一个解码线程 */
+static void bench_packet_steady(BenchResult &r, int64_t nItems)
+{
+    BenchQueue b;
+    ReadWaker waker;
+    std::vector<int64_t> vecStamp(nItems);
+    uint32_t state = 1;
+
+    bench_queue_init(&b);
+    read_waker_init(&waker);
+    r.latency.reserve(nItems);
+
+    std::thread consumer([&] { consume_packets(&b.q, &waker, vecStamp, r.latency, &r.dropped); });
+    for (int64_t i = 0; i < nItems; i++) {
+        wait_for_space(&b.q, &waker);
+        put_packet(&b.q, i, packet_size(&state, true), vecStamp);
+    }
+    while (b.q.nb_packets > 0)
+        read_waker_wait(&waker, 10);
+    packet_queue_abort(&b.q);
+    consumer.join();
+
+    r.items = nItems;
+    packet_queue_destroy(&b.q);
+    read_waker_destroy(&waker);
+}
+
+/* 突发读包：读包线程按突发向视频、音频两路队列交替放包，两个解码线程 */
+static void bench_packet_burst(BenchResult &r, int64_t nItems)
+{
+    BenchQueue video, audio;
+    ReadWaker waker;
+    std::vector<int64_t> vecStamp(nItems);
+    std::vector<int64_t> vecAudioLatency;
+    int64_t nAudioDropped = 0;
+    uint32_t state = 2;
+
+    bench_queue_init(&video);
+    bench_queue_init(&audio);
+    read_waker_init(&waker);
+    r.latency.reserve(nItems);
+    vecAudioLatency.reserve(nItems);
+
+    std::thread video_consumer([&] { consume_packets(&video.q, &waker, vecStamp, r.latency, &r.dropped); });
+    std::thread audio_consumer([&] { consume_packets(&audio.q, &waker, vecStamp, vecAudioLatency, &nAudioDropped); });
+    for (int64_t i = 0; i < nItems; i++) {
+        // 大约每个视频包对应两个音频包
+        bool bVideo = i % 3 == 0;
+        PacketQueue *q = bVideo ? &video.q : &audio.q;
+        if (i % BENCH_BURST == 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(BENCH_BURST_GAP_US));
+        wait_for_space(q, &waker);
+        put_packet(q, i, packet_size(&state, bVideo), vecStamp);
+    }
+    while (video.q.nb_packets > 0 || audio.q.nb_packets > 0)
+        read_waker_wait(&waker, 10);
+    packet_queue_abort(&video.q);
+    packet_queue_abort(&audio.q);
+    video_consumer.join();
+    audio_consumer.join();
+
+    r.items = nItems;
+    r.dropped += nAudioDropped;
+    r.latency.insert(r.latency.end(), vecAudioLatency.begin(), vecAudioLatency.end());
+    packet_queue_destroy(&video.q);
+    packet_queue_destroy(&audio.q);
+    read_waker_destroy(&waker);
+}
+
+/* 跳转清空：稳定读包，定期清空队列并放入清理包，解码线程丢弃过期的包 */
+static void bench_packet_seek(BenchResult &r, int64_t nItems)
+{
+    BenchQueue b;
+    ReadWaker waker;
+    std::vector<int64_t> vecStamp(nItems);
+    uint32_t state = 3;
+
+    bench_queue_init(&b);
+    read_waker_init(&waker);
+    r.latency.reserve(nItems);
+
+    std::thread consumer([&] { consume_packets(&b.q, &waker, vecStamp, r.latency, &r.dropped); });
+    for (int64_t i = 0; i < nItems; i++) {
+        if (i && i % BENCH_SEEK_INTERVAL == 0) {
+            packet_queue_flush(&b.q);
+            packet_queue_put(&b.q, &b.flush_pkt);
+        }
+        wait_for_space(&b.q, &waker);
+        put_packet(&b.q, i, packet_size(&state, true), vecStamp);
+    }
+    while (b.q.nb_packets > 0)
+        read_waker_wait(&waker, 10);
+    packet_queue_abort(&b.q);
+    consumer.join();
+
+    r.items = nItems;
+    packet_queue_destroy(&b.q);
+    read_waker_destroy(&waker);
+}
+
+/* 负载下中止：解码线程阻塞在已满的帧队列上，另一个线程阻塞在空的包队列上，
+ * 统计从中止到所有线程退出的时间 */
+static void bench_abort(BenchResult &r)
+{
+    r.latency.reserve(BENCH_ABORT_ROUNDS);
+
+    for (int round = 0; round < BENCH_ABORT_ROUNDS; round++) {
+        BenchQueue busy, idle;
+        FrameQueue fq;
+        ReadWaker waker;
+        std::vector<int64_t> vecStamp(1 << 16);
+        uint32_t state = round;
+        std::atomic<int64_t> nExitTime(0);
+        std::atomic<int> nExited(0);
+
+        bench_queue_init(&busy);
+        bench_queue_init(&idle);
+        read_waker_init(&waker);
+        frame_queue_init(&fq, &busy.q, VIDEO_PICTURE_QUEUE_SIZE, 1);
+
+        auto on_exit = [&] {
+            int64_t now = now_ns();
+            int64_t prev = nExitTime.load();
+            while (now > prev && !nExitTime.compare_exchange_weak(prev, now)) {
+            }
+            nExited++;
+        };
+
+        // 解码线程：取包后写帧队列，没有人读帧，很快阻塞在 peek_writable
+        std::thread decoder([&] {
+            AVPacket pkt;
+            for (;;) {
+                if (packet_queue_get(&busy.q, &pkt, 1, NULL) < 0)
+                    break;
+                av_packet_unref(&pkt);
+                Frame *vp = frame_queue_peek_writable(&fq);
+                if (!vp)
+                    break;
+                frame_queue_push(&fq);
+            }
+            on_exit();
+        });
+        // 字幕线程：包队列一直为空，阻塞在 packet_queue_get
+        std::thread idle_consumer([&] {
+            AVPacket pkt;
+            while (packet_queue_get(&idle.q, &pkt, 1, NULL) >= 0)
+                av_packet_unref(&pkt);
+            on_exit();
+        });
+
+        int64_t nLoadEnd = now_ns() + BENCH_ABORT_LOAD_US * 1000LL;
+        for (int64_t i = 0; now_ns() < nLoadEnd && i < (int64_t)vecStamp.size(); i++) {
+            if (busy.q.nb_packets < BENCH_QUEUE_LIMIT)
+                put_packet(&busy.q, i, packet_size(&state, true), vecStamp);
+            else
+                std::this_thread::yield();
+        }
+
+        // 与 decoder_abort 相同的顺序
+        int64_t nAbort = now_ns();
+        packet_queue_abort(&busy.q);
+        frame_queue_signal(&fq);
+        packet_queue_abort(&idle.q);
+        decoder.join();
+        idle_consumer.join();
+        r.latency.push_back(nExitTime.load() - nAbort);
+
+        frame_queue_destory(&fq);
+        packet_queue_destroy(&busy.q);
+        packet_queue_destroy(&idle.q);
+        read_waker_destroy(&waker);
+    }
+    r.items = BENCH_ABORT_ROUNDS;
+}
+
+/* 帧队列交接：解码线程 peek_writable/push，刷新线程 peek_readable/next */
+static void bench_frame_queue(BenchResult &r, int64_t nItems, int nMaxSize)
+{
+    BenchQueue b;
+    FrameQueue fq;
+    std::vector<int64_t> vecStamp(nItems);
+
+    bench_queue_init(&b);
+    frame_queue_init(&fq, &b.q, nMaxSize, 1);
+    r.latency.reserve(nItems);
+
+    std::thread consumer([&] {
+        for (int64_t i = 0; i < nItems; i++) {
+            Frame *vp = frame_queue_peek_readable(&fq);
+            if (!vp)
+                break;
+            r.latency.push_back(now_ns() - vecStamp[(int64_t)vp->pts]);
+            frame_queue_next(&fq);
+        }
+    });
+    for (int64_t i = 0; i < nItems; i++) {
+        Frame *vp = frame_queue_peek_writable(&fq);
+        if (!vp)
+            break;
+        vp->pts = (double)i;
+        vp->serial = b.q.serial;
+        vecStamp[i] = now_ns();
+        frame_queue_push(&fq);
+    }
+    consumer.join();
+
+    r.items = nItems;
+    packet_queue_abort(&b.q);
+    frame_queue_destory(&fq);
+    packet_queue_destroy(&b.q);
+}
+
+/* 完整解码管线：读包线程（含跳转）-> decoder_decode_frame -> 帧队列 -> 刷新线程 */
+static int bench_decoder(BenchResult &r, int64_t nItems)
+{
+    BenchQueue b;
+    FrameQueue fq;
+    ReadWaker waker;
+    Decoder d;
+    std::vector<int64_t> vecStamp(nItems);
+    std::atomic<int64_t> nConsumed(0);
+
+    AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_RAWVIDEO);
+    AVCodecContext *avctx = avcodec_alloc_context3(codec);
+    if (!avctx)
+        return AVERROR(ENOMEM);
+    avctx->width = BENCH_VIDEO_WIDTH;
+    avctx->height = BENCH_VIDEO_HEIGHT;
+    avctx->pix_fmt = AV_PIX_FMT_YUV420P;
+    avctx->pkt_timebase = { 1, 25 };
+    if (avcodec_open2(avctx, codec, NULL) < 0) {
+        avcodec_free_context(&avctx);
+        return -1;
+    }
+    int nFrameSize = av_image_get_buffer_size(AV_PIX_FMT_YUV420P, BENCH_VIDEO_WIDTH, BENCH_VIDEO_HEIGHT, 1);
+
+    bench_queue_init(&b);
+    read_waker_init(&waker);
+    frame_queue_init(&fq, &b.q, VIDEO_PICTURE_QUEUE_SIZE, 1);
+    decoder_init(&d, avctx, &b.q, &waker);
+    r.latency.reserve(nItems);
+
+    // 视频线程：过期序列号的帧也放入帧队列，由刷新线程丢弃，与播放器相同
+    std::thread decoder([&] {
+        AVFrame *frame = av_frame_alloc();
+        for (;;) {
+            int ret = decoder_decode_frame(&d, frame, NULL);
+            if (ret < 0)
+                break;
+            if (!ret)
+                continue;
+            Frame *vp = frame_queue_peek_writable(&fq);
+            if (!vp)
+                break;
+            vp->pts = (double)frame->pts;
+            vp->serial = d.pkt_serial;
+            av_frame_move_ref(vp->frame, frame);
+            frame_queue_push(&fq);
+        }
+        av_frame_free(&frame);
+    });
+    std::thread consumer([&] {
+        for (;;) {
+            Frame *vp = frame_queue_peek_readable(&fq);
+            if (!vp)
+                break;
+            if (vp->serial != b.q.serial)
+                r.dropped++;
+            else
+                r.latency.push_back(now_ns() - vecStamp[(int64_t)vp->pts]);
+            frame_queue_next(&fq);
+            nConsumed++;
+        }
+    });
+
+    for (int64_t i = 0; i < nItems; i++) {
+        if (i && i % BENCH_SEEK_INTERVAL == 0) {
+            packet_queue_flush(&b.q);
+            packet_queue_put(&b.q, &b.flush_pkt);
+        }
+        wait_for_space(&b.q, &waker);
+        put_packet(&b.q, i, nFrameSize, vecStamp);
+    }
+
+    // 等待管线排空：包队列和帧队列都为空并保持一段时间
+    int64_t nIdleSince = 0, nLast = -1;
+    for (;;) {
+        int64_t nNow = now_ns();
+        if (b.q.nb_packets || frame_queue_nb_remaining(&fq) || nConsumed.load() != nLast) {
+            nLast = nConsumed.load();
+            nIdleSince = nNow;
+        } else if (nNow - nIdleSince > 20000000LL) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    decoder_abort(&d, &fq);
+    consumer.join();
+    decoder.join();
+
+    r.items = nItems;
+    decoder_destroy(&d);
+    frame_queue_destory(&fq);
+    packet_queue_destroy(&b.q);
+    read_waker_destroy(&waker);
+    return 0;
+}
+
+static double percentile(std::vector<int64_t> &vecValues, double p)
+{
+    if (vecValues.empty())
+        return NAN;
+    size_t nIndex = FFMIN((size_t)(vecValues.size() * p), vecValues.size() - 1);
+    std::nth_element(vecValues.begin(), vecValues.begin() + nIndex, vecValues.end());
+    return vecValues[nIndex] / 1000.0;
+}
+
+static void print_result(BenchResult &r)
+{
+    char szSwitches[32];
+    if (r.switches >= 0)
+        snprintf(szSwitches, sizeof(szSwitches), "%.3f", r.items ? (double)r.switches / r.items : 0.0);
+    else
+        snprintf(szSwitches, sizeof(szSwitches), "n/a");
+
+    printf("%-28s %10lld %12.0f %10.2f %10.2f %10s %8lld\n", r.name, (long long)r.items,
+           r.seconds > 0 ? r.items / r.seconds : 0.0, percentile(r.latency, 0.5), percentile(r.latency, 0.99),
+           szSwitches, (long long)r.dropped);
+}
+
+/* 运行一项测试并统计耗时和上下文切换 */
+template <typename Fn>
+static void run(const char *szName, Fn fn)
+{
+    BenchResult r;
+    r.name = szName;
+    r.items = 0;
+    r.dropped = 0;
+
+    int64_t nSwitches = context_switches();
+    int64_t nStart = now_ns();
+    fn(r);
+    r.seconds = (now_ns() - nStart) / 1e9;
+    r.switches = nSwitches >= 0 ? context_switches() - nSwitches : -1;
+    print_result(r);
+}
+
+int main(int argc, char *argv[])
+{
+    int64_t nItems = argc > 1 ? atoll(argv[1]) : 200000;
+    if (nItems <= 0) {
+        fprintf(stderr, "usage: %s [items]\n", argv[0]);
+        return 1;
+    }
+
+    av_log_set_level(AV_LOG_ERROR);
+    if (SDL_Init(0)) {
+        fprintf(stderr, "SDL_Init: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    printf("%lld items per case, latency in us (abort: abort-to-exit per round)\n\n", (long long)nItems);
+    printf("%-28s %10s %12s %10s %10s %10s %8s\n", "case", "items", "items/s", "p50", "p99", "csw/item", "dropped");
+    run("packet steady", [&](BenchResult &r) { bench_packet_steady(r, nItems); });
+    run("packet burst (2 queues)", [&](BenchResult &r) { bench_packet_burst(r, nItems); });
+    run("packet seek flush", [&](BenchResult &r) { bench_packet_seek(r, nItems); });
+    run("abort under load", [&](BenchResult &r) { bench_abort(r); });
+    run("frame queue (3, video)", [&](BenchResult &r) { bench_frame_queue(r, nItems, VIDEO_PICTURE_QUEUE_SIZE); });
+    run("frame queue (9, audio)", [&](BenchResult &r) { bench_frame_queue(r, nItems, SAMPLE_QUEUE_SIZE); });
+    run("decode pipeline + seek", [&](BenchResult &r) {
+        if (bench_decoder(r, nItems) < 0)
+            fprintf(stderr, "rawvideo decoder unavailable\n");
+    });
+
+#ifdef CTTV_PROFILE
+    printf("\n%s", Profiler::Dump().toLocal8Bit().data());
+#endif
+    SDL_Quit();
+    return 0;
+}
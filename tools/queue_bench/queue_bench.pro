@@ -0,0 +1,64 @@
+﻿# ----------------------------------------------------
+# 队列原语微基准：包队列、帧队列和解码循环在竞争下的吞吐量与交接延迟
+# ----------------------------------------------------
+
+TEMPLATE = app
+TARGET = queue_bench
+DESTDIR = $$PWD/../../bin
+QT += core gui widgets
+CONFIG += console
+CONFIG -= app_bundle
+
+# 同时统计队列锁的等待与持有时间（src/profiler.h），会增加交接延迟
+#DEFINES += CTTV_PROFILE
+
+win32 {
+LIBS += -L$$PWD/../../lib/SDL2/lib/x86 \
+    -L$$PWD/../../lib/ffmpeg-4.2.1-win32-dev/lib \
+    -lSDL2 \
+    -lavcodec \
+    -lavdevice \
+    -lavfilter \
+    -lavformat \
+    -lavutil \
+    -lswresample \
+    -lswscale
+
+INCLUDEPATH += $$PWD/../../lib/SDL2/include \
+    $$PWD/../../lib/ffmpeg-4.2.1-win32-dev/include
+}
+
+unix {
+LIBS += \
+    -lSDL2 \
+    -lavcodec \
+    -lavdevice \
+    -lavfilter \
+    -lavformat \
+    -lavutil \
+    -lswresample \
+    -lswscale
+}
+
+INCLUDEPATH += $$PWD/../../src
+
+HEADERS += ../../src/datactl.h \
+    ../../src/globalhelper.h \
+    ../../src/taskexecutor.h \
+    ../../src/subtitlestore.h \
+    ../../src/audiovisualizer.h \
+    ../../src/loudness.h \
+    ../../src/resampler.h \
+    ../../src/gopcache.h \
+    ../../src/framehistory.h \
+    ../../src/profiler.h
+
+SOURCES += main.cpp \
+    ../../src/taskexecutor.cpp \
+    ../../src/subtitlestore.cpp \
+    ../../src/audiovisualizer.cpp \
+    ../../src/loudness.cpp \
+    ../../src/resampler.cpp \
+    ../../src/gopcache.cpp \
+    ../../src/framehistory.cpp \
+    ../../src/profiler.cpp
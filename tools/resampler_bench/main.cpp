@@ -0,0 +1,124 @@
+﻿#define SDL_MAIN_HANDLED
+
+#include <stdio.h>
+#include <time.h>
+
+#include <vector>
+
+#include "resampler.h"
+
+#pragma execution_character_set("utf-8")
+
+/*
+ * 重采样 CPU 开销测试
+ *
+ * 用合成的音频测量各重采样模式处理 1 秒音频所用的 CPU 时间，
+ * 并测量参数相同时复用上下文与重新创建上下文的耗时。
+ *
+ * 用法：resampler_bench [秒数]
+ */
+
+#define BENCH_FRAME_SAMPLES 1024        // 与常见解码器输出的帧长一致
+
+typedef struct BenchCase {
+    const char *name;
+    ResamplerParams params;
+} BenchCase;
+
+/* 生成 planar float 测试信号：扫频正弦叠加少量噪声 */
+static void fill_signal(std::vector<float> &vecSamples, int nb_samples, int sample_rate, int channels)
+{
+    unsigned int seed = 1;
+    double phase = 0;
+
+    vecSamples.resize((size_t)nb_samples * channels);
+    for (int i = 0; i < nb_samples; i++) {
+        double freq = 50.0 + 15000.0 * (i % sample_rate) / sample_rate;
+        phase += 2 * M_PI * freq / sample_rate;
+        seed = seed * 1664525 + 1013904223;
+        float noise = ((int)(seed >> 16) - 32768) / 32768.0f * 0.01f;
+        for (int ch = 0; ch < channels; ch++)
+            vecSamples[(size_t)ch * nb_samples + i] = 0.5f * (float)sin(phase + ch) + noise;
+    }
+}
+
+/* 返回处理 1 秒音频所用的 CPU 毫秒数，失败返回负值 */
+static double run_case(const BenchCase &stCase, int nMode, int nSeconds, const std::vector<float> &vecSamples)
+{
+    AudioResampler stResampler;
+    struct SwrContext *swr_ctx = stResampler.Configure(stCase.params, nMode);
+    if (!swr_ctx)
+        return -1;
+
+    int channels = av_get_channel_layout_nb_channels(stCase.params.in_layout);
+    int out_channels = av_get_channel_layout_nb_channels(stCase.params.out_layout);
+    int nb_samples = stCase.params.in_rate * nSeconds;
+    int out_count = (int64_t)BENCH_FRAME_SAMPLES * stCase.params.out_rate / stCase.params.in_rate + 256;
+    std::vector<uint8_t> vecOut((size_t)out_count * out_channels * av_get_bytes_per_sample(stCase.params.out_fmt));
+    uint8_t *out = vecOut.data();
+
+    clock_t start = clock();
+    for (int pos = 0; pos + BENCH_FRAME_SAMPLES <= nb_samples; pos += BENCH_FRAME_SAMPLES) {
+        const uint8_t *in[AV_NUM_DATA_POINTERS];
+        for (int ch = 0; ch < channels; ch++)
+            in[ch] = (const uint8_t *)&vecSamples[(size_t)ch * nb_samples + pos];
+        if (swr_convert(swr_ctx, &out, out_count, in, BENCH_FRAME_SAMPLES) < 0)
+            return -1;
+    }
+    double cpu_ms = (double)(clock() - start) * 1000 / CLOCKS_PER_SEC;
+    return cpu_ms / nSeconds;
+}
+
+/* 返回配置一次重采样器所用的 CPU 微秒数 */
+static double run_configure(const BenchCase &stCase, int nMode, bool bReuse)
+{
+    const int nRounds = 50;
+    AudioResampler stResampler;
+
+    clock_t start = clock();
+    for (int i = 0; i < nRounds; i++) {
+        if (!bReuse)
+            stResampler.Clear();
+        if (!stResampler.Configure(stCase.params, nMode))
+            return -1;
+    }
+    return (double)(clock() - start) * 1000000 / CLOCKS_PER_SEC / nRounds;
+}
+
+int main(int argc, char *argv[])
+{
+    int nSeconds = argc > 1 ? atoi(argv[1]) : 60;
+    if (nSeconds <= 0) {
+        fprintf(stderr, "usage: %s [seconds]\n", argv[0]);
+        return 1;
+    }
+
+    av_log_set_level(AV_LOG_ERROR);
+
+    BenchCase arrCases[] = {
+        { "44100 fltp stereo -> 48000 flt",  { AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_FLTP, 44100, AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_FLT, 48000 } },
+        { "48000 fltp stereo -> 44100 s16",  { AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_FLTP, 48000, AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_S16, 44100 } },
+        { "48000 fltp 5.1 -> 48000 flt stereo", { AV_CH_LAYOUT_5POINT1, AV_SAMPLE_FMT_FLTP, 48000, AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_FLT, 48000 } },
+    };
+    int arrModes[] = { RESAMPLER_MODE_FAST, RESAMPLER_MODE_DEFAULT, RESAMPLER_MODE_HIGH };
+
+    printf("%d s of audio per case, %d samples per frame\n\n", nSeconds, BENCH_FRAME_SAMPLES);
+    printf("%-36s %-8s %14s %10s %12s %12s\n", "conversion", "mode", "cpu ms/s", "x realtime", "create us", "reuse us");
+    for (const BenchCase &stCase : arrCases) {
+        std::vector<float> vecSamples;
+        fill_signal(vecSamples, stCase.params.in_rate * nSeconds, stCase.params.in_rate,
+                    av_get_channel_layout_nb_channels(stCase.params.in_layout));
+
+        for (int nMode : arrModes) {
+            double cpu_ms = run_case(stCase, nMode, nSeconds, vecSamples);
+            if (cpu_ms < 0) {
+                printf("%-36s %-8s %14s\n", stCase.name, AudioResampler::ModeName(nMode), "failed");
+                continue;
+            }
+            printf("%-36s %-8s %14.3f %10.0f %12.1f %12.1f\n", stCase.name, AudioResampler::ModeName(nMode),
+                   cpu_ms, cpu_ms > 0 ? 1000.0 / cpu_ms : 0.0,
+                   run_configure(stCase, nMode, false), run_configure(stCase, nMode, true));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,53 @@
+﻿#define SDL_MAIN_HANDLED
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "syncreplay.h"
+
+#pragma execution_character_set("utf-8")
+
+/*
+ * 虚拟时钟同步回放
+ *
+ * 用虚拟时钟和模拟音频输出回放文件，输出送显帧数、丢帧和音视频差值统计。
+ * 多次回放时比较送显序列的指纹，不一致说明同步逻辑存在与机器速度相关的行为。
+ *
+ * 用法：sync_replay <文件> [秒数] [次数]
+ */
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: sync_replay <file> [seconds] [runs]\n");
+        return 1;
+    }
+    double dSeconds = argc > 2 ? atof(argv[2]) : 0;
+    int nRuns = argc > 3 ? FFMAX(atoi(argv[3]), 1) : 1;
+
+    // 不需要窗口和声卡
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+    SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+    av_log_set_level(AV_LOG_WARNING);
+
+    uint64_t nFingerprint = 0;
+    bool bMismatch = false;
+    for (int i = 0; i < nRuns; i++) {
+        SyncReplay stReplay;
+        SyncReplayReport stReport;
+
+        if (stReplay.Run(argv[1], dSeconds, &stReport) < 0) {
+            fprintf(stderr, "failed to open %s\n", argv[1]);
+            return 1;
+        }
+        printf("run %d\n%s\n", i + 1, SyncReplay::Format(stReport).toLocal8Bit().data());
+
+        if (i > 0 && stReport.fingerprint != nFingerprint)
+            bMismatch = true;
+        nFingerprint = stReport.fingerprint;
+    }
+
+    if (nRuns > 1)
+        printf("%s\n", bMismatch ? "runs differ" : "runs identical");
+    return bMismatch ? 2 : 0;
+}
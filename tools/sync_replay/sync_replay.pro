@@ -0,0 +1,83 @@
+﻿# ----------------------------------------------------
+# 虚拟时钟同步回放：快于实时地检查音视频漂移与丢帧
+# ----------------------------------------------------
+
+TEMPLATE = app
+TARGET = sync_replay
+DESTDIR = $$PWD/../../bin
+QT += core gui widgets
+CONFIG += console
+CONFIG -= app_bundle
+
+win32 {
+LIBS += -L$$PWD/../../lib/SDL2/lib/x86 \
+    -L$$PWD/../../lib/ffmpeg-4.2.1-win32-dev/lib \
+    -lSDL2 \
+    -lavcodec \
+    -lavdevice \
+    -lavfilter \
+    -lavformat \
+    -lavutil \
+    -lswresample \
+    -lswscale
+
+INCLUDEPATH += $$PWD/../../lib/SDL2/include \
+    $$PWD/../../lib/ffmpeg-4.2.1-win32-dev/include
+}
+
+unix {
+LIBS += \
+    -lSDL2 \
+    -lavcodec \
+    -lavdevice \
+    -lavfilter \
+    -lavformat \
+    -lavutil \
+    -lswresample \
+    -lswscale
+}
+
+INCLUDEPATH += $$PWD/../../src
+
+HEADERS += ../../src/datactl.h \
+    ../../src/globalhelper.h \
+    ../../src/videoctl.h \
+    ../../src/audiomixer.h \
+    ../../src/taskexecutor.h \
+    ../../src/sonic.h \
+    ../../src/subtitlestore.h \
+    ../../src/audiovisualizer.h \
+    ../../src/loudness.h \
+    ../../src/resampler.h \
+    ../../src/gopcache.h \
+    ../../src/framehistory.h \
+    ../../src/synctrace.h \
+    ../../src/profiler.h \
+    ../../src/mmapio.h \
+    ../../src/prefetchio.h \
+    ../../src/hlssource.h \
+    ../../src/livelatency.h \
+    ../../src/timeshift.h \
+    ../../src/timesource.h \
+    ../../src/syncreplay.h
+
+SOURCES += main.cpp \
+    ../../src/videoctl.cpp \
+    ../../src/audiomixer.cpp \
+    ../../src/taskexecutor.cpp \
+    ../../src/sonic.cpp \
+    ../../src/subtitlestore.cpp \
+    ../../src/audiovisualizer.cpp \
+    ../../src/loudness.cpp \
+    ../../src/resampler.cpp \
+    ../../src/gopcache.cpp \
+    ../../src/framehistory.cpp \
+    ../../src/synctrace.cpp \
+    ../../src/profiler.cpp \
+    ../../src/mmapio.cpp \
+    ../../src/prefetchio.cpp \
+    ../../src/hlssource.cpp \
+    ../../src/livelatency.cpp \
+    ../../src/timeshift.cpp \
+    ../../src/timesource.cpp \
+    ../../src/syncreplay.cpp
@@ -0,0 +1,192 @@
+﻿#define SDL_MAIN_HANDLED
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <QDir>
+
+#include <atomic>
+#include <vector>
+
+#include "timeshift.h"
+
+#pragma execution_character_set("utf-8")
+
+/*
+ * 直播时移测试
+ *
+ * 配合 live_bench --send-only 推流使用。通过 TimeshiftBuffer 接收直播，依次模拟：
+ * 1. 在直播位置播放 --play 秒；
+ * 2. 暂停 --pause 秒，期间接收继续写入磁盘；
+ * 3. 恢复后尽快读完暂停期间积累的数据，检查每路流的时间戳连续；
+ * 4. 回退到直播前 --rewind 秒，检查跳转到的关键帧与目标的差距；
+ * 5. 回到直播，检查读取位置与直播的差距。
+ * 每个阶段打印窗口、磁盘占用、待写入数据和写入耗时。--window 小于暂停时长时可以观察淘汰。
+ * 开始时移后 ic 只由接收任务读取，这里和播放器一样使用缓冲中的流快照。
+ *
+ * 用法：timeshift_bench <直播地址> [--window S] [--play S] [--pause S] [--rewind S]
+ */
+
+#define BENCH_GAP_THRESHOLD 1.0     // 同一路流相邻包的时间差超过该值视为数据缺失
+
+static std::atomic<bool> s_bAbort(false);
+
+static int interrupt_cb(void *opaque)
+{
+    return s_bAbort;
+}
+
+static void print_stats(const char *phase, TimeshiftBuffer *pBuffer)
+{
+    TimeshiftStats s = pBuffer->Stats();
+    printf("%-8s window %8.3f ~ %8.3f s  position %8.3f s (%.3f s behind)  %d segments %7.1f MB  pending %6.1f KB  "
+           "packets %lld dropped %lld  write %.3f s (max %.1f ms)\n",
+           phase, s.start, s.live, s.position, s.live - s.position, s.segments, s.disk_bytes / 1048576.0,
+           s.pending_bytes / 1024.0, (long long)s.packets, (long long)s.dropped,
+           s.write_us / 1000000.0, s.max_write_us / 1000.0);
+}
+
+/* 读取 dSeconds 秒（按墙上时间），dSeconds 为 0 时读到直播位置为止；检查每路流时间戳连续 */
+static int read_for(TimeshiftBuffer *pBuffer, double dSeconds, int64_t *pPackets, int *pGaps)
+{
+    std::vector<double> vecLast(pBuffer->StreamCount(), NAN);
+    int64_t nEnd = av_gettime_relative() + (int64_t)(dSeconds * 1000000);
+    AVPacket pkt;
+    int ret;
+
+    av_init_packet(&pkt);
+    *pPackets = 0;
+    *pGaps = 0;
+    for (;;) {
+        if (dSeconds > 0 && av_gettime_relative() >= nEnd)
+            return 0;
+        ret = pBuffer->Read(&pkt, TIMESHIFT_READ_WAIT_MS);
+        if (ret == AVERROR(EAGAIN)) {
+            if (dSeconds > 0)
+                continue;
+            return 0;
+        }
+        if (ret < 0)
+            return ret;
+
+        int64_t ts = pkt.dts != AV_NOPTS_VALUE ? pkt.dts : pkt.pts;
+        if (ts != AV_NOPTS_VALUE) {
+            double t = ts * av_q2d(pBuffer->Stream(pkt.stream_index)->time_base);
+            double &last = vecLast[pkt.stream_index];
+            if (!std::isnan(last) && (t < last || t - last > BENCH_GAP_THRESHOLD))
+                (*pGaps)++;
+            last = t;
+        }
+        (*pPackets)++;
+        av_packet_unref(&pkt);
+    }
+}
+
+/* 跳转后读到的第一个建立索引的流的包的时间 */
+static double first_time_after_seek(TimeshiftBuffer *pBuffer)
+{
+    AVPacket pkt;
+
+    av_init_packet(&pkt);
+    while (pBuffer->Read(&pkt, 1000) >= 0) {
+        AVStream *st = pBuffer->Stream(pkt.stream_index);
+        int64_t ts = pkt.pts != AV_NOPTS_VALUE ? pkt.pts : pkt.dts;
+        bool bKey = (pkt.flags & AV_PKT_FLAG_KEY) && ts != AV_NOPTS_VALUE &&
+                (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO || st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO);
+        av_packet_unref(&pkt);
+        if (bKey)
+            return ts * av_q2d(st->time_base);
+    }
+    return NAN;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *url = NULL;
+    double dWindow = 120, dPlay = 10, dPause = 20, dRewind = 30;
+    AVFormatContext *ic = NULL;
+    AVDictionary *opts = NULL;
+    int64_t nPackets;
+    int nGaps, ret;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : "";
+        if (arg[0] != '-') {
+            url = arg;
+            continue;
+        }
+        i++;
+        if (!strcmp(arg, "--window"))
+            dWindow = atof(value);
+        else if (!strcmp(arg, "--play"))
+            dPlay = atof(value);
+        else if (!strcmp(arg, "--pause"))
+            dPause = atof(value);
+        else if (!strcmp(arg, "--rewind"))
+            dRewind = atof(value);
+        else {
+            url = NULL;
+            break;
+        }
+    }
+    if (!url) {
+        fprintf(stderr, "usage: %s <url> [--window S] [--play S] [--pause S] [--rewind S]\n", argv[0]);
+        return 1;
+    }
+
+    av_log_set_level(AV_LOG_WARNING);
+    avformat_network_init();
+
+    // 结束时通过中断回调让接收任务从阻塞的读取中退出
+    if (!(ic = avformat_alloc_context()))
+        return 1;
+    ic->interrupt_callback.callback = interrupt_cb;
+    av_dict_set(&opts, "fifo_size", "1000000", 0);
+    av_dict_set(&opts, "overrun_nonfatal", "1", 0);
+    ret = avformat_open_input(&ic, url, NULL, &opts);
+    av_dict_free(&opts);
+    if (ret >= 0)
+        ret = avformat_find_stream_info(ic, NULL);
+    if (ret < 0) {
+        fprintf(stderr, "failed to open %s: %d\n", url, ret);
+        return 1;
+    }
+
+    TimeshiftBuffer *pBuffer = new TimeshiftBuffer(TaskExecutor::Shared());
+    if ((ret = pBuffer->Start(QDir::tempPath() + "/" + TIMESHIFT_DIR_NAME, ic, dWindow)) < 0) {
+        fprintf(stderr, "failed to start timeshift: %d\n", ret);
+        return 1;
+    }
+    printf("%s: window %.0f s, play %.0f s, pause %.0f s, rewind %.0f s\n\n", url, dWindow, dPlay, dPause, dRewind);
+
+    ret = read_for(pBuffer, dPlay, &nPackets, &nGaps);
+    print_stats("live", pBuffer);
+    printf("         %lld packets, %d gaps\n", (long long)nPackets, nGaps);
+
+    av_usleep((unsigned)(dPause * 1000000));
+    print_stats("paused", pBuffer);
+
+    int64_t nStart = av_gettime_relative();
+    if (ret >= 0)
+        ret = read_for(pBuffer, 0, &nPackets, &nGaps);
+    print_stats("resumed", pBuffer);
+    printf("         %lld packets in %.3f s, %d gaps\n", (long long)nPackets,
+           (av_gettime_relative() - nStart) / 1000000.0, nGaps);
+
+    double dTarget = pBuffer->LiveTime() - dRewind;
+    pBuffer->Seek(dTarget);
+    double dFirst = first_time_after_seek(pBuffer);
+    print_stats("rewound", pBuffer);
+    printf("         target %.3f s, first key packet %.3f s (%+.3f s)\n", dTarget, dFirst, dFirst - dTarget);
+
+    pBuffer->Seek(pBuffer->LiveTime());
+    dFirst = first_time_after_seek(pBuffer);
+    print_stats("to live", pBuffer);
+    printf("         first key packet %.3f s behind live\n", pBuffer->LiveTime() - dFirst);
+
+    s_bAbort = true;
+    delete pBuffer;
+    avformat_close_input(&ic);
+    return ret < 0 ? 1 : 0;
+}
@@ -0,0 +1,47 @@
+﻿# ----------------------------------------------------
+# 直播时移测试：暂停、回退和回到直播，检查写入耗时和数据连续
+# ----------------------------------------------------
+
+TEMPLATE = app
+TARGET = timeshift_bench
+DESTDIR = $$PWD/../../bin
+QT += core gui widgets
+CONFIG += console
+CONFIG -= app_bundle
+
+win32 {
+LIBS += -L$$PWD/../../lib/SDL2/lib/x86 \
+    -L$$PWD/../../lib/ffmpeg-4.2.1-win32-dev/lib \
+    -lSDL2 \
+    -lavcodec \
+    -lavdevice \
+    -lavfilter \
+    -lavformat \
+    -lavutil \
+    -lswresample \
+    -lswscale
+
+INCLUDEPATH += $$PWD/../../lib/SDL2/include \
+    $$PWD/../../lib/ffmpeg-4.2.1-win32-dev/include
+}
+
+unix {
+LIBS += \
+    -lSDL2 \
+    -lavcodec \
+    -lavdevice \
+    -lavfilter \
+    -lavformat \
+    -lavutil \
+    -lswresample \
+    -lswscale
+}
+
+INCLUDEPATH += $$PWD/../../src
+
+HEADERS += ../../src/timeshift.h \
+    ../../src/taskexecutor.h
+
+SOURCES += main.cpp \
+    ../../src/timeshift.cpp \
+    ../../src/taskexecutor.cpp